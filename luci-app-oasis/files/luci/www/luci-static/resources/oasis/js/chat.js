@@ -21,6 +21,7 @@
     const URL_BASE_INFO = getUrl('baseInfo');
     const URL_DELETE_CHAT = getUrl('deleteChat');
     const URL_RENAME_CHAT = getUrl('renameChat');
+    const URL_CHAT_TITLE = getUrl('chatTitle');
     const URL_LOAD_CHAT = getUrl('loadChat');
     const URL_APPLY_UCI_CMD = getUrl('applyUciCmd');
     const URL_SYSTEM_REBOOT = getUrl('systemReboot');
@@ -1655,6 +1656,73 @@
         
         // New Chat List Item (refactored)
         addChatListEntry(jsonResponse.id, jsonResponse.title);
+
+        // The title is generated in the background on the device
+        if (jsonResponse.title_pending) {
+            pollChatTitle(jsonResponse.id, 0);
+        }
+    }
+
+    const TITLE_POLL_INTERVAL_MS = 2000;
+    const TITLE_POLL_MAX = 30;
+
+    function pollChatTitle(id, attempt) {
+        if (attempt >= TITLE_POLL_MAX) {
+            return;
+        }
+
+        setTimeout(() => {
+            fetch(URL_CHAT_TITLE, {
+                method: "POST",
+                headers: {
+                    'Content-Type': 'application/x-www-form-urlencoded'
+                },
+                body: new URLSearchParams({ params: id })
+            })
+            .then((response) => response.json())
+            .then((data) => {
+                if (!data || data.error || data.status !== 'OK') {
+                    return;
+                }
+
+                if (data.title && data.title !== '--') {
+                    updateChatTitle(id, data.title);
+                    return;
+                }
+
+                // No job left (failed and dropped): the placeholder stays
+                if (data.pending === false) {
+                    return;
+                }
+
+                pollChatTitle(id, attempt + 1);
+            })
+            .catch((error) => {
+                console.error("Request failed:", error);
+            });
+        }, TITLE_POLL_INTERVAL_MS);
+    }
+
+    function updateChatTitle(id, title) {
+        const desktopItem = document.querySelector(`#chat-list li[data-id='${id}']`);
+        const mbItem = document.querySelector(`#mb-chat-list li[data-id='${id}']`);
+        const desktopSpan = desktopItem ? desktopItem.querySelector('span') : null;
+        const mbSpan = mbItem ? mbItem.querySelector('span') : null;
+
+        if (desktopSpan) desktopSpan.textContent = title;
+        if (mbSpan) mbSpan.textContent = title;
+
+        if (chatList && Array.isArray(chatList.item)) {
+            chatList.item.forEach(chat => {
+                if (chat.id === id) {
+                    chat.title = title;
+                }
+            });
+        }
+
+        if (typeof updateMobileBottomSheetFromDesktop === 'function') {
+            updateMobileBottomSheetFromDesktop();
+        }
     }
 
     function save_apply_proc(jsonResponse, type) {
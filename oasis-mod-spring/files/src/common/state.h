@@ -0,0 +1,82 @@
+#ifndef SPRING_STATE_H
+#define SPRING_STATE_H
+
+#include <stdint.h>
+
+/*
+ * [Shared State]
+ * springd publishes its state (current phase, last detector results, sampled
+ * interfaces) in a memory-mapped file with a fixed layout. Readers map the
+ * file once and copy a consistent snapshot without any syscall and without
+ * blocking the daemon.
+ *
+ * Consistency (seqlock): the writer makes seq odd, writes, then makes it
+ * even again. A reader copies the record and keeps the copy only when seq
+ * was even and unchanged around the copy; otherwise it copies again.
+ *
+ * The layout is versioned: a reader must check magic, version and size.
+ * New fields go at the end (size grows); anything else bumps the version.
+ */
+
+#define SPRING_STATE_PATH           "/tmp/spring/state.shm"
+#define SPRING_STATE_MAGIC          0x53505247  // "SPRG"
+#define SPRING_STATE_VERSION        1
+
+#define SPRING_STATE_NAME_LEN       32
+#define SPRING_STATE_VALUE_LEN      96
+#define SPRING_STATE_IFNAME_LEN     16
+#define SPRING_STATE_RESULT_MAX     32
+#define SPRING_STATE_IF_MAX         32
+
+typedef struct spring_state_result {
+    char name[SPRING_STATE_NAME_LEN];           // detector function
+    char value[SPRING_STATE_VALUE_LEN];         // result as text (truncated)
+    int64_t updated;                            // unix time (ms)
+} spring_state_result;
+
+typedef struct spring_state_if {
+    char ifname[SPRING_STATE_IFNAME_LEN];
+    int32_t index;                              // 0 = not present
+    uint32_t reserved;
+    char ipv4[16];
+    char ipv6[48];
+    double rx_rate;                             // bytes/s (EWMA)
+    double tx_rate;                             // bytes/s (EWMA)
+    double err_rate;                            // errors + drops/s (EWMA)
+} spring_state_if;
+
+typedef struct spring_state {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                              // sizeof(spring_state)
+    uint32_t seq;                               // odd while a write is in progress
+    int32_t pid;                                // springd
+    uint32_t reserved;
+    int64_t updated;                            // unix time (ms) of the last write
+
+    char phase[SPRING_STATE_NAME_LEN];
+    int64_t phase_since;                        // unix time (ms)
+
+    uint32_t result_count;
+    uint32_t if_count;
+    spring_state_result results[SPRING_STATE_RESULT_MAX];
+    spring_state_if ifs[SPRING_STATE_IF_MAX];
+} spring_state;
+
+/*
+ * Reader library (libspringstate)
+ */
+
+// Map the state file read-only (path NULL: SPRING_STATE_PATH); NULL on failure
+const spring_state *spring_state_map(const char *path);
+
+/*
+ * Copy a consistent snapshot of a mapping into out.
+ * Returns 0, or -1 when the layout does not match or the writer kept the
+ * record busy for all retries.
+ */
+int spring_state_snapshot(const spring_state *map, spring_state *out);
+
+void spring_state_unmap(const spring_state *map);
+
+#endif // SPRING_STATE_H
@@ -0,0 +1,268 @@
+/*
+ * Benchmark of the packet capture (util/capture.c), driven by capture_veth.sh
+ *
+ *   capture_bench capture <ifname> <seconds>
+ *       Capture on ifname and report frames, drops and the CPU time of the
+ *       capture thread.
+ *   capture_bench send <ifname> <seconds> [bulk_per_control]
+ *       Send as fast as possible: a mix of ARP requests, DNS queries, router
+ *       advertisements and rogue DHCP offers, each followed by
+ *       bulk_per_control (default 8) UDP frames the filter drops in the
+ *       kernel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include "../util/capture.h"
+
+#define FRAME_MAX   512
+
+typedef struct frame {
+    uint8_t data[FRAME_MAX];
+    int len;
+} frame;
+
+static volatile bool terminate = false;
+
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Frames
+ */
+
+static const uint8_t src_mac[6] = { 0x02, 0x53, 0x50, 0x52, 0x47, 0x01 };
+static const uint8_t bcast_mac[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+    return p + 2;
+}
+
+static uint8_t *put_eth(uint8_t *p, uint16_t type) {
+    memcpy(p, bcast_mac, 6);
+    memcpy(p + 6, src_mac, 6);
+    return put16(p + 12, type);
+}
+
+// IPv4 + UDP headers (checksums are not looked at by the capture)
+static uint8_t *put_ip4_udp(uint8_t *p, const char *src, const char *dst, uint16_t sport, uint16_t dport, int payload) {
+    memset(p, 0, 28);
+    p[0] = 0x45;
+    put16(p + 2, 28 + payload);
+    p[8] = 64;
+    p[9] = IPPROTO_UDP;
+    inet_pton(AF_INET, src, p + 12);
+    inet_pton(AF_INET, dst, p + 16);
+    put16(p + 20, sport);
+    put16(p + 22, dport);
+    put16(p + 24, 8 + payload);
+    return p + 28;
+}
+
+static void build_arp(frame *f) {
+    uint8_t *p = put_eth(f->data, ETH_P_ARP);
+    memset(p, 0, 28);
+    put16(p, 1);
+    put16(p + 2, ETH_P_IP);
+    p[4] = 6;
+    p[5] = 4;
+    put16(p + 6, 1);
+    memcpy(p + 8, src_mac, 6);
+    inet_pton(AF_INET, "192.168.77.2", p + 14);
+    inet_pton(AF_INET, "192.168.77.1", p + 24);
+    f->len = 14 + 28;
+}
+
+static void build_dns(frame *f) {
+    static const uint8_t query[] = {
+        0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        7, 'o', 'p', 'e', 'n', 'w', 'r', 't', 3, 'o', 'r', 'g', 0, 0x00, 0x01, 0x00, 0x01,
+    };
+    uint8_t *p = put_eth(f->data, ETH_P_IP);
+    p = put_ip4_udp(p, "192.168.77.2", "192.168.77.1", 40000, 53, sizeof(query));
+    memcpy(p, query, sizeof(query));
+    f->len = (int)(p + sizeof(query) - f->data);
+}
+
+static void build_dhcp_offer(frame *f) {
+    uint8_t *p = put_eth(f->data, ETH_P_IP);
+    p = put_ip4_udp(p, "192.168.77.254", "255.255.255.255", 67, 68, 248);
+    memset(p, 0, 248);
+    p[0] = 2;                                   // BOOTREPLY
+    p[1] = 1;
+    p[2] = 6;
+    p[236] = 0x63; p[237] = 0x82; p[238] = 0x53; p[239] = 0x63;
+    uint8_t *o = p + 240;
+    *o++ = 53; *o++ = 1; *o++ = 2;              // OFFER
+    *o++ = 54; *o++ = 4;                        // server identifier
+    inet_pton(AF_INET, "192.168.77.254", o);
+    o += 4;
+    *o++ = 255;
+    f->len = (int)(p + 248 - f->data);
+}
+
+static void build_ra(frame *f) {
+    uint8_t *p = put_eth(f->data, ETH_P_IPV6);
+    memset(p, 0, 40 + 16);
+    p[0] = 0x60;
+    put16(p + 4, 16);
+    p[6] = IPPROTO_ICMPV6;
+    p[7] = 255;
+    inet_pton(AF_INET6, "fe80::53:50ff:fe52:4701", p + 8);
+    inet_pton(AF_INET6, "ff02::1", p + 24);
+    p[40] = 134;                                // router advertisement
+    p[44] = 64;
+    put16(p + 46, 1800);
+    f->len = 14 + 40 + 16;
+}
+
+static void build_bulk(frame *f) {
+    uint8_t *p = put_eth(f->data, ETH_P_IP);
+    p = put_ip4_udp(p, "192.168.77.2", "192.168.77.1", 5001, 5001, 400);
+    memset(p, 0xa5, 400);
+    f->len = (int)(p + 400 - f->data);
+}
+
+/*
+ * Modes
+ */
+
+static int run_send(const char *ifname, int seconds, int bulk) {
+    int fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_ifindex = (int)if_nametoindex(ifname);
+    addr.sll_halen = 6;
+    memcpy(addr.sll_addr, bcast_mac, 6);
+
+    if (addr.sll_ifindex == 0) {
+        fprintf(stderr, "no interface %s\n", ifname);
+        close(fd);
+        return 1;
+    }
+
+    frame control[4];
+    frame bulk_frame;
+    build_arp(&control[0]);
+    build_dns(&control[1]);
+    build_ra(&control[2]);
+    build_dhcp_offer(&control[3]);
+    build_bulk(&bulk_frame);
+
+    unsigned long sent_control = 0;
+    unsigned long sent_bulk = 0;
+    double start = monotonic_now();
+    double end = start + seconds;
+
+    while (monotonic_now() < end) {
+        for (int i = 0; i < 1000; i++) {
+            frame *f = &control[sent_control % 4];
+            if (sendto(fd, f->data, f->len, 0, (struct sockaddr *)&addr, sizeof(addr)) > 0) {
+                sent_control++;
+            }
+            for (int b = 0; b < bulk; b++) {
+                if (sendto(fd, bulk_frame.data, bulk_frame.len, 0, (struct sockaddr *)&addr, sizeof(addr)) > 0) {
+                    sent_bulk++;
+                }
+            }
+        }
+    }
+
+    double elapsed = monotonic_now() - start;
+    printf("sent       %lu control + %lu bulk frames in %.1f s (%.0f frames/s)\n",
+           sent_control, sent_bulk, elapsed, (sent_control + sent_bulk) / elapsed);
+
+    close(fd);
+    return 0;
+}
+
+typedef struct capture_thread {
+    capture_config config;
+    double cpu;             // seconds of CPU used by the capture thread
+    int ret;
+} capture_thread;
+
+static void *capture_thread_main(void *arg) {
+    capture_thread *ct = arg;
+    struct timespec ts;
+
+    ct->ret = capture_run(&ct->config, &terminate);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    ct->cpu = ts.tv_sec + ts.tv_nsec / 1e9;
+    return NULL;
+}
+
+static int run_capture(const char *ifname, int seconds) {
+    capture_thread ct;
+    memset(&ct, 0, sizeof(ct));
+    snprintf(ct.config.ifname, sizeof(ct.config.ifname), "%s", ifname);
+    ct.config.block_size = 32 * 1024;
+    ct.config.block_nr = 8;
+    ct.config.block_timeout_ms = 100;
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, capture_thread_main, &ct);
+
+    capture_stats st;
+    double start = monotonic_now();
+    while (monotonic_now() - start < seconds) {
+        usleep(100000);
+    }
+
+    // Last statistics before the ring goes away
+    int have_stats = capture_get_stats(&st);
+    terminate = true;
+    pthread_join(thread, NULL);
+
+    if (have_stats != 0) {
+        fprintf(stderr, "capture on %s did not run\n", ifname);
+        return 1;
+    }
+
+    double elapsed = monotonic_now() - start;
+    printf("captured   %lu frames in %lu blocks, %lu dropped by the kernel\n", st.frames, st.blocks, st.drops);
+    printf("rate       %.0f frames/s, %.1f frames/block\n", st.frames / elapsed, st.blocks ? (double)st.frames / st.blocks : 0.0);
+    printf("cpu        %.3f s (%.2f %% of one core), %.0f ns/frame\n",
+           ct.cpu, ct.cpu / elapsed * 100, st.frames ? ct.cpu / st.frames * 1e9 : 0.0);
+    for (int i = 0; i < CAPTURE_COUNTER_NUM; i++) {
+        printf("%-14s %lu (peak %.0f/s)\n", capture_counter_name(i), st.counters[i].total, st.counters[i].peak);
+    }
+    for (int i = 0; i < st.dhcp_server_count; i++) {
+        printf("dhcp server    %s%s\n", st.dhcp_servers[i].address, st.dhcp_servers[i].rogue ? " (rogue)" : "");
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "capture") == 0) {
+        return run_capture(argv[2], atoi(argv[3]));
+    }
+    if (argc >= 4 && strcmp(argv[1], "send") == 0) {
+        return run_send(argv[2], atoi(argv[3]), (argc >= 5) ? atoi(argv[4]) : 8);
+    }
+
+    fprintf(stderr, "usage: %s capture <ifname> <seconds>\n"
+                    "       %s send <ifname> <seconds> [bulk_per_control]\n", argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Capture benchmark over a veth pair: the sender runs in a network namespace,
+# the capture on the host end. Needs root, ip (iproute2) and capture_bench
+# (make -C files/src/springd capture_bench).
+#
+#   capture_veth.sh [seconds] [bulk_per_control]
+
+SECONDS_RUN=${1:-10}
+BULK=${2:-8}
+NS=spring-bench
+HOST_IF=sbench0
+PEER_IF=sbench1
+BENCH=$(dirname "$0")/../capture_bench
+
+[ -x "${BENCH}" ] || BENCH=$(command -v capture_bench)
+if [ -z "${BENCH}" ]; then
+	echo "capture_bench not found"
+	exit 1
+fi
+
+cleanup() {
+	ip link del ${HOST_IF} 2>/dev/null
+	ip netns del ${NS} 2>/dev/null
+}
+trap cleanup EXIT INT TERM
+
+cleanup
+ip netns add ${NS} || exit 1
+ip link add ${HOST_IF} type veth peer name ${PEER_IF} || exit 1
+ip link set ${PEER_IF} netns ${NS}
+ip addr add 192.168.77.1/24 dev ${HOST_IF}
+ip link set ${HOST_IF} up
+ip netns exec ${NS} ip link set ${PEER_IF} up
+ip netns exec ${NS} ip link set lo up
+
+"${BENCH}" capture ${HOST_IF} $((SECONDS_RUN + 2)) &
+CAPTURE_PID=$!
+sleep 1
+
+ip netns exec ${NS} "${BENCH}" send ${PEER_IF} ${SECONDS_RUN} ${BULK}
+wait ${CAPTURE_PID}
@@ -0,0 +1,217 @@
+/*
+ * Test of the conntrack subscriber (util/conntrack.c) and the get_flow_stats
+ * detector, driven by conntrack_veth.sh
+ *
+ *   conntrack_bench watch <seconds> [ifname]
+ *       Run the subscriber (needs spring.conntrack.enable=1) for seconds, or
+ *       until SIGINT/SIGTERM. Prints get_flow_stats() every second and, at
+ *       the end, every interface and zone it reports, and
+ *       get_flow_stats(ifname).
+ *   conntrack_bench flows <address> <count> [port]
+ *       Open count UDP flows to address: one datagram from its own port each.
+ *   conntrack_bench flush
+ *       Delete the conntrack entries of the namespace (DESTROY events).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nfnetlink_conntrack.h>
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+#include "../util/conntrack.h"
+#include "../util/ifcache.h"
+#include "../util/netlink/events.h"
+
+static volatile bool terminate = false;
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+// The detector as a phase calls it, printed as "<label> flows=.. new_total=.. destroy_total=.. new_rate=.."
+static const char *report_chunk =
+    "local ifname, final = ...\n"
+    "local line = function(label, f)\n"
+    "    print(string.format('%s flows=%d new_total=%d destroy_total=%d new_rate=%.1f',\n"
+    "        label, f.flows, f.new_total, f.destroy_total, f.new_rate))\n"
+    "end\n"
+    "local all = get_flow_stats()\n"
+    "if not all then print('get_flow_stats: nil') return end\n"
+    "line('total', all)\n"
+    "if not final then return end\n"
+    "for name, f in pairs(all.interfaces) do line('if ' .. name, f) end\n"
+    "for zone, f in pairs(all.zones) do line('zone ' .. zone, f) end\n"
+    "if ifname then\n"
+    "    local one = get_flow_stats(ifname)\n"
+    "    if one then line('get_flow_stats(' .. ifname .. ')', one) else print('get_flow_stats(' .. ifname .. '): nil') end\n"
+    "end\n";
+
+static void report(lua_State *L, const char *ifname, bool final) {
+    if (luaL_loadstring(L, report_chunk) != 0) {
+        fprintf(stderr, "%s\n", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return;
+    }
+    if (ifname) {
+        lua_pushstring(L, ifname);
+    } else {
+        lua_pushnil(L);
+    }
+    lua_pushboolean(L, final);
+    if (lua_pcall(L, 2, 0, 0) != 0) {
+        fprintf(stderr, "%s\n", lua_tostring(L, -1));
+        lua_pop(L, 1);
+    }
+    fflush(stdout);
+}
+
+static int run_watch(int seconds, const char *ifname) {
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    pthread_t ifcache_thread, conntrack_thread;
+    pthread_create(&ifcache_thread, NULL, ifcache_monitor_process, (void *)&terminate);
+    pthread_create(&conntrack_thread, NULL, conntrack_process, (void *)&terminate);
+
+    for (int i = 0; i < 50 && !conntrack_running(); i++) {
+        usleep(100000);
+    }
+    if (!conntrack_running()) {
+        fprintf(stderr, "conntrack subscriber did not start (spring.conntrack.enable=1? root?)\n");
+        terminate = true;
+        pthread_join(conntrack_thread, NULL);
+        pthread_join(ifcache_thread, NULL);
+        return 1;
+    }
+
+    lua_State *L = luaL_newstate();
+    luaL_openlibs(L);
+    lua_register(L, "get_flow_stats", get_flow_stats);
+
+    printf("ready\n");
+    fflush(stdout);
+
+    for (int i = 0; i < seconds && !stop; i++) {
+        sleep(1);
+        report(L, ifname, false);
+    }
+
+    // get_flow_stats is nil once the subscriber stopped: the last report comes first
+    report(L, ifname, true);
+
+    terminate = true;
+    pthread_join(conntrack_thread, NULL);
+    pthread_join(ifcache_thread, NULL);
+    lua_close(L);
+    return 0;
+}
+
+static int run_flows(const char *address, int count, int port) {
+    struct sockaddr_storage dst;
+    socklen_t dst_len;
+
+    memset(&dst, 0, sizeof(dst));
+    struct sockaddr_in *in4 = (struct sockaddr_in *)&dst;
+    struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&dst;
+    if (inet_pton(AF_INET, address, &in4->sin_addr) == 1) {
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(port);
+        dst_len = sizeof(*in4);
+    } else if (inet_pton(AF_INET6, address, &in6->sin6_addr) == 1) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        dst_len = sizeof(*in6);
+    } else {
+        fprintf(stderr, "bad address %s\n", address);
+        return 1;
+    }
+
+    int sent = 0;
+    for (int i = 0; i < count; i++) {
+        // A socket of its own: another source port, another flow
+        int fd = socket(dst.ss_family, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            perror("socket");
+            break;
+        }
+        if (sendto(fd, "spring", 6, 0, (struct sockaddr *)&dst, dst_len) == 6) {
+            sent++;
+        }
+        close(fd);
+    }
+
+    printf("flows      %d of %d sent to %s:%d\n", sent, count, address, port);
+    return (sent == count) ? 0 : 1;
+}
+
+static int run_flush(void) {
+    int fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_NETFILTER);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    int ret = 0;
+    int families[] = { AF_INET, AF_INET6 };
+    for (int i = 0; i < 2; i++) {
+        struct {
+            struct nlmsghdr nlh;
+            struct nfgenmsg gen;
+        } request;
+        memset(&request, 0, sizeof(request));
+        request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+        request.nlh.nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_DELETE;
+        request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+        request.nlh.nlmsg_seq = i + 1;
+        request.gen.nfgen_family = families[i];
+        request.gen.version = NFNETLINK_V0;
+
+        // No tuple: the whole table of the family
+        char reply[256];
+        if (send(fd, &request, request.nlh.nlmsg_len, 0) < 0 || recv(fd, reply, sizeof(reply), 0) < 0) {
+            perror("conntrack flush");
+            ret = 1;
+            continue;
+        }
+        struct nlmsghdr *nlh = (struct nlmsghdr *)reply;
+        if (nlh->nlmsg_type == NLMSG_ERROR) {
+            int error = ((struct nlmsgerr *)NLMSG_DATA(nlh))->error;
+            if (error != 0) {
+                fprintf(stderr, "conntrack flush: %s\n", strerror(-error));
+                ret = 1;
+            }
+        }
+    }
+
+    close(fd);
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && strcmp(argv[1], "watch") == 0) {
+        return run_watch(atoi(argv[2]), (argc >= 4) ? argv[3] : NULL);
+    }
+    if (argc >= 4 && strcmp(argv[1], "flows") == 0) {
+        return run_flows(argv[2], atoi(argv[3]), (argc >= 5) ? atoi(argv[4]) : 9);
+    }
+    if (argc >= 2 && strcmp(argv[1], "flush") == 0) {
+        return run_flush();
+    }
+
+    fprintf(stderr, "usage: %s watch <seconds> [ifname]\n"
+                    "       %s flows <address> <count> [port]\n"
+                    "       %s flush\n", argv[0], argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,130 @@
+#!/bin/sh
+# Test of the conntrack subscriber and get_flow_stats over a veth pair: the
+# subscriber runs in a "router" namespace, a client namespace opens UDP flows
+# to it, then the router's conntrack table is flushed. The router also opens
+# flows over loopback, which the socket filter must drop. Needs root, ip
+# (iproute2), nft or iptables, uci and conntrack_bench
+# (make -C files/src/springd conntrack_bench).
+#
+#   conntrack_veth.sh [flows]
+
+FLOWS=${1:-200}
+NS_ROUTER=spring-ct-router
+NS_CLIENT=spring-ct-client
+ROUTER_IF=sct0
+CLIENT_IF=sct1
+ROUTER_ADDR=192.168.78.1
+CLIENT_ADDR=192.168.78.2
+BENCH=$(dirname "$0")/../conntrack_bench
+OUT=/tmp/conntrack_veth.$$
+UCI_STAGED=0
+
+[ -x "${BENCH}" ] || BENCH=$(command -v conntrack_bench)
+if [ -z "${BENCH}" ]; then
+	echo "conntrack_bench not found"
+	exit 1
+fi
+
+cleanup() {
+	[ -n "${WATCH_PID}" ] && kill ${WATCH_PID} 2>/dev/null
+	ip netns del ${NS_ROUTER} 2>/dev/null
+	ip netns del ${NS_CLIENT} 2>/dev/null
+	[ ${UCI_STAGED} = 1 ] && uci revert spring.conntrack.enable
+	rm -f ${OUT}
+}
+trap cleanup EXIT INT TERM
+
+router() {
+	ip netns exec ${NS_ROUTER} "$@"
+}
+
+client() {
+	ip netns exec ${NS_CLIENT} "$@"
+}
+
+# Staged only (not committed): conntrack_bench reads it through libuci
+if [ "$(uci -q get spring.conntrack.enable)" != "1" ]; then
+	uci set spring.conntrack.enable=1 || exit 1
+	UCI_STAGED=1
+fi
+
+ip netns del ${NS_ROUTER} 2>/dev/null
+ip netns del ${NS_CLIENT} 2>/dev/null
+ip netns add ${NS_ROUTER} || exit 1
+ip netns add ${NS_CLIENT} || exit 1
+ip link add ${ROUTER_IF} netns ${NS_ROUTER} type veth peer name ${CLIENT_IF} netns ${NS_CLIENT} || exit 1
+
+# IPv4 only: no NDP/MLD traffic besides the test flows
+for ns in ${NS_ROUTER} ${NS_CLIENT}; do
+	ip netns exec ${ns} sh -c 'echo 1 > /proc/sys/net/ipv6/conf/all/disable_ipv6'
+	ip netns exec ${ns} ip link set lo up
+done
+router ip addr add ${ROUTER_ADDR}/24 dev ${ROUTER_IF}
+client ip addr add ${CLIENT_ADDR}/24 dev ${CLIENT_IF}
+router ip link set ${ROUTER_IF} up
+client ip link set ${CLIENT_IF} up
+
+# A new namespace tracks connections only once a rule needs conntrack
+if command -v nft >/dev/null; then
+	router nft -f - <<EOF || exit 1
+table inet spring_ct {
+	chain input {
+		type filter hook input priority 0;
+		ct state new accept
+	}
+}
+EOF
+elif command -v iptables >/dev/null; then
+	router iptables -A INPUT -m conntrack --ctstate NEW -j ACCEPT || exit 1
+else
+	echo "nft or iptables needed"
+	exit 1
+fi
+router sh -c 'echo 1 > /proc/sys/net/netfilter/nf_conntrack_events'
+
+# ready, flows, 2 s, flush, 2 s: the watch ends on its own afterwards
+router "${BENCH}" watch 8 ${ROUTER_IF} > ${OUT} &
+WATCH_PID=$!
+for i in $(seq 50); do
+	grep -q '^ready' ${OUT} 2>/dev/null && break
+	sleep 0.1
+done
+if ! grep -q '^ready' ${OUT}; then
+	echo "conntrack_bench watch did not start"
+	exit 1
+fi
+
+client "${BENCH}" flows ${ROUTER_ADDR} ${FLOWS}
+router "${BENCH}" flows 127.0.0.1 ${FLOWS}
+sleep 2
+router "${BENCH}" flush
+
+wait ${WATCH_PID}
+WATCH_PID=
+cat ${OUT}
+
+# Every client flow counted on the router interface, opened and destroyed;
+# no loopback flow counted
+FAILED=0
+check() {
+	if grep -q "^$1 " ${OUT} && grep "^$1 " ${OUT} | tail -n 1 | grep -q -- "$2"; then
+		echo "ok      $1: $2"
+	else
+		echo "FAILED  $1: expected $2"
+		FAILED=1
+	fi
+}
+
+check "get_flow_stats(${ROUTER_IF})" "flows=0 new_total=${FLOWS} destroy_total=${FLOWS} "
+check "if ${ROUTER_IF}" "flows=0 new_total=${FLOWS} destroy_total=${FLOWS} "
+check "total" "new_total=${FLOWS} destroy_total=${FLOWS} "
+check "zone 0" "new_total=${FLOWS} "
+
+if grep '^total ' ${OUT} | grep -q -v 'new_rate=0.0$'; then
+	echo "ok      new_rate > 0 while the flows were opened"
+else
+	echo "FAILED  new_rate stayed 0"
+	FAILED=1
+fi
+
+exit ${FAILED}
@@ -11,20 +11,41 @@
 #include <lauxlib.h>
 #include <lua.h>
 #include <time.h>
+#include <limits.h>
 #include "./util/ioctl/events.h"
 #include "./util/ioctl/actions.h"
 #include "./util/netlink/events.h"
 #include "./util/netlink/actions.h"
 #include "./util/uci.h"
+#include "./util/ifcache.h"
+#include "./util/sampler.h"
+#include "./util/publish.h"
+#include "./util/reload.h"
+#include "./util/conntrack.h"
+#include "./util/capture.h"
+#include "./util/neigh.h"
+#include "./util/luacache.h"
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/syscall.h>
+#include <dirent.h>
 #include "../common/debug.h"
 
 #define SPRING_TERMINATE_FILE "/tmp/spring/terminate"
 
 bool is_terminate = false;
 
+// Startup timing, published as the "springd_startup" result
+static double started_at = 0;
+static double close_fds_ms = 0;
+
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
 // Get thread interval from UCI config
 int get_thread_interval(const char* option, int default_val) {
     char uci_parameter[256];
@@ -39,6 +60,35 @@ int get_thread_interval(const char* option, int default_val) {
     return default_val;
 }
 
+// Close every inherited descriptor without walking the whole RLIMIT_NOFILE
+// range (up to a million close() calls on some systems)
+static void close_all_fds(void) {
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, 0U, ~0U, 0U) == 0) {
+        return;
+    }
+#endif
+
+    // Older kernels: only the descriptors that are open
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            char *end;
+            long fd = strtol(entry->d_name, &end, 10);
+            if (end != entry->d_name && *end == '\0' && fd != dirfd(dir)) {
+                close((int)fd);
+            }
+        }
+        closedir(dir);
+        return;
+    }
+
+    for (int x = sysconf(_SC_OPEN_MAX); x>=0; x--) {
+        close(x);
+    }
+}
+
 void daemonize(void) {
     pid_t pid;
 
@@ -70,9 +120,9 @@ void daemonize(void) {
         exit(EXIT_FAILURE);
     }
 
-    for (int x = sysconf(_SC_OPEN_MAX); x>=0; x--) {
-        close(x);
-    }
+    double close_start = monotonic_ms();
+    close_all_fds();
+    close_fds_ms = monotonic_ms() - close_start;
 
     open("/dev/null", O_RDWR);
     if (dup(0) < 0) {
@@ -95,6 +145,9 @@ void handle_signal(int sig) {
             //DEBUG_LOG("[handle_signal] SIGTERM SIGNAL!!\n");
             is_terminate = true;
             break;
+        case SIGHUP:
+            reload_request();
+            break;
         case SIGUSR1:
             break;
         case SIGUSR2:
@@ -122,6 +175,7 @@ void setup_signal_handlers(void) {
     sa.sa_flags = 0;
 
     sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
     sigaction(SIGUSR1, &sa, NULL);
     sigaction(SIGUSR2, &sa, NULL);
 }
@@ -144,6 +198,98 @@ void* send_message_process(void* arg) {
     return NULL;
 }
 
+// usage: publish_phase(name) -- current phase, for shared state readers
+static int lua_publish_phase(lua_State *L) {
+    publish_phase(luaL_checkstring(L, 1));
+    return 0;
+}
+
+// usage: publish_result(func_name, value) -- last detector result as text
+static int lua_publish_result(lua_State *L) {
+    publish_result(luaL_checkstring(L, 1), luaL_checkstring(L, 2));
+    return 0;
+}
+
+// usage: config_generation() -- incremented on each change of /etc/config/spring
+static int lua_config_generation(lua_State *L) {
+    lua_pushnumber(L, reload_generation());
+    return 1;
+}
+
+// usage: monotonic_ms() -- milliseconds of CLOCK_MONOTONIC, the clock of judge timing (for/until)
+static int lua_monotonic_ms(lua_State *L) {
+    lua_pushnumber(L, monotonic_ms());
+    return 1;
+}
+
+static void push_capture_peers(lua_State *L, const capture_peer *peers, int count, bool dhcp) {
+    lua_newtable(L);
+    for (int i = 0; i < count; i++) {
+        char mac[18];
+        snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 peers[i].mac[0], peers[i].mac[1], peers[i].mac[2], peers[i].mac[3], peers[i].mac[4], peers[i].mac[5]);
+
+        lua_newtable(L);
+        lua_pushstring(L, peers[i].address);
+        lua_setfield(L, -2, "address");
+        lua_pushstring(L, mac);
+        lua_setfield(L, -2, "mac");
+        lua_pushnumber(L, peers[i].count);
+        lua_setfield(L, -2, "count");
+        lua_pushnumber(L, peers[i].last_seen);
+        lua_setfield(L, -2, "last_seen");
+        if (dhcp) {
+            lua_pushboolean(L, peers[i].rogue);
+            lua_setfield(L, -2, "rogue");
+        }
+        lua_rawseti(L, -2, i + 1);
+    }
+}
+
+// usage: get_capture_stats() -- control traffic counters of spring.capture.interface (nil when off)
+static int lua_get_capture_stats(lua_State *L) {
+    capture_stats st;
+
+    if (capture_get_stats(&st) != 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    lua_newtable(L);
+    lua_pushstring(L, st.ifname);
+    lua_setfield(L, -2, "interface");
+    lua_pushnumber(L, st.frames);
+    lua_setfield(L, -2, "frames");
+    lua_pushnumber(L, st.drops);
+    lua_setfield(L, -2, "drops");
+    lua_pushnumber(L, st.blocks);
+    lua_setfield(L, -2, "blocks");
+
+    for (int i = 0; i < CAPTURE_COUNTER_NUM; i++) {
+        lua_newtable(L);
+        lua_pushnumber(L, st.counters[i].total);
+        lua_setfield(L, -2, "total");
+        lua_pushnumber(L, st.counters[i].rate);
+        lua_setfield(L, -2, "rate");
+        lua_pushnumber(L, st.counters[i].peak);
+        lua_setfield(L, -2, "peak");
+        lua_setfield(L, -2, capture_counter_name(i));
+    }
+
+    bool rogue = false;
+    for (int i = 0; i < st.dhcp_server_count; i++) {
+        rogue = rogue || st.dhcp_servers[i].rogue;
+    }
+
+    push_capture_peers(L, st.dhcp_servers, st.dhcp_server_count, true);
+    lua_setfield(L, -2, "dhcp_servers");
+    lua_pushboolean(L, rogue);
+    lua_setfield(L, -2, "rogue_dhcp");
+    push_capture_peers(L, st.routers, st.router_count, false);
+    lua_setfield(L, -2, "routers");
+    return 1;
+}
+
 void register_lua_functions(lua_State *L) {
     lua_register(L, "add_route", add_route);
     lua_register(L, "delete_route", delete_route);
@@ -156,6 +302,19 @@ void register_lua_functions(lua_State *L) {
     lua_register(L, "get_if_ipv6", get_if_ipv6);
     lua_register(L, "get_if_ipv6_from_idx", get_if_ipv6_from_idx);
     lua_register(L, "get_if_ipv6_from_name", get_if_ipv6_from_name);
+    lua_register(L, "get_if_addrs", get_if_addrs);
+    lua_register(L, "get_all_interfaces", get_all_interfaces);
+    lua_register(L, "get_if_rate", get_if_rate);
+    lua_register(L, "get_if_error_rate", get_if_error_rate);
+    lua_register(L, "get_flow_stats", get_flow_stats);
+    lua_register(L, "get_capture_stats", lua_get_capture_stats);
+    lua_register(L, "get_neighbor", get_neighbor);
+    lua_register(L, "get_neighbors", get_neighbors);
+    lua_register(L, "get_new_neighbors", get_new_neighbors);
+    lua_register(L, "publish_phase", lua_publish_phase);
+    lua_register(L, "publish_result", lua_publish_result);
+    lua_register(L, "config_generation", lua_config_generation);
+    lua_register(L, "monotonic_ms", lua_monotonic_ms);
     lua_register(L, "set_interface_state", set_interface_state);
     lua_register(L, "rename_interface", rename_interface);
     lua_register(L, "set_interface_mtu", set_interface_mtu);
@@ -166,6 +325,10 @@ void register_lua_functions(lua_State *L) {
     lua_register(L, "set_broadcast_address", set_broadcast_address);
     lua_register(L, "set_subnet_mask", set_subnet_mask);
     lua_register(L, "add_arp_entry", add_arp_entry);
+    lua_register(L, "add_neighbor", add_neighbor);
+    lua_register(L, "delete_neighbor", delete_neighbor);
+    lua_register(L, "add_neighbors", add_neighbors);
+    lua_register(L, "flush_neighbors", flush_neighbors);
 }
 
 // Call register_lua_functions before loading phase.lua
@@ -176,33 +339,61 @@ void load_phase_lua(lua_State *L) {
     }
 }
 
+// One evaluation of the active phase (phase.lua); returns the phase to evaluate next
+static int evaluate_phase(lua_State *L, int phase_idx) {
+
+    lua_getglobal(L, "execute_target_phase");
+    if (!lua_isfunction(L, -1)) {
+        lua_pop(L, 1);
+        DEBUG_LOG("execute_target_phase is not a function\n");
+        return phase_idx;
+    }
+
+    lua_pushinteger(L, phase_idx);
+    if (lua_pcall(L, 1, 1, 0) != 0) {
+        const char *lua_err = lua_tostring(L, -1);
+        DEBUG_LOG("Error running execute_target_phase: %s\n", lua_err ? lua_err : "(no error message)");
+        fprintf(stderr, "Error running execute_target_phase: %s\n", lua_err ? lua_err : "(no error message)");
+        lua_pop(L, 1);
+        return phase_idx;
+    }
+
+    int next_idx = lua_isnumber(L, -1) ? (int)lua_tointeger(L, -1) : 0;
+    lua_pop(L, 1);
+
+    if ((next_idx > 0) && (next_idx != phase_idx)) {
+        DEBUG_LOG("[matrix_ctr_process] phase %d -> %d\n", phase_idx, next_idx);
+        return next_idx;
+    }
+
+    return phase_idx;
+}
+
 void* matrix_ctrl_process(void *arg) {
 
     DEBUG_LOG("[matrix_ctr_process] start\n");
 
+    double load_start = monotonic_ms();
+
     lua_State *L = luaL_newstate();
     luaL_openlibs(L);
+    luacache_install(L);
     register_lua_functions(L);
 
-    if (luaL_dofile(L, "/usr/lib/lua/spring/phase.lua") != 0) {
+    // phase.lua and the spring.* modules come from cached bytecode when unchanged
+    if (luacache_loadfile(L, "/usr/lib/lua/spring/phase.lua") != 0 || lua_pcall(L, 0, 0, 0) != 0) {
         DEBUG_LOG("Error loading phase.lua\n");
         fprintf(stderr, "Error loading phase.lua: %s\n", lua_tostring(L, -1));
         lua_pop(L, 1);
     }
 
-    lua_getglobal(L, "test_exec_allevents");
-    if (lua_isfunction(L, -1)) {
-        if (lua_pcall(L, 0, 0, 0) != 0) {
-            const char *lua_err = lua_tostring(L, -1);
-            DEBUG_LOG("Error running test_exec_allevents: %s\n", lua_err ? lua_err : "(no error message)");
-            fprintf(stderr, "Error running test_exec_allevents: %s\n", lua_err ? lua_err : "(no error message)");
-            lua_pop(L, 1);
-        }
-    } else {
-        lua_pop(L, 1);
-        DEBUG_LOG("test_exec_allevents is not a function\n");
-        fprintf(stderr, "test_exec_allevents is not a function\n");
-    }
+    double lua_ms = monotonic_ms() - load_start;
+    bool startup_published = false;
+
+    unsigned int generation = reload_generation();
+
+    // The first phase (phase_a) is active at start; judges move it on
+    int phase_idx = 1;
 
     int interval = get_thread_interval("matrix_ctrl_thread", 1);
     for (;;) {
@@ -214,6 +405,35 @@ void* matrix_ctrl_process(void *arg) {
         
         DEBUG_LOG("[matrix_ctr_process] loop ... \n");
 
+        // Between evaluations: phase.lua builds the new phases and swaps them in
+        if (generation != reload_generation()) {
+            generation = reload_generation();
+            lua_getglobal(L, "reload_phase_set");
+            if (lua_isfunction(L, -1)) {
+                if (lua_pcall(L, 0, 0, 0) != 0) {
+                    const char *lua_err = lua_tostring(L, -1);
+                    DEBUG_LOG("Error running reload_phase_set: %s\n", lua_err ? lua_err : "(no error message)");
+                    lua_pop(L, 1);
+                }
+            } else {
+                lua_pop(L, 1);
+            }
+        }
+
+        phase_idx = evaluate_phase(L, phase_idx);
+
+        // Once, after the first evaluation of phase_a
+        if (!startup_published) {
+            int hits, misses;
+            char startup[96];
+            luacache_get_counts(&hits, &misses);
+            snprintf(startup, sizeof(startup), "first_eval=%.1fms close_fds=%.2fms lua=%.1fms bytecode=%d/%d",
+                     monotonic_ms() - started_at, close_fds_ms, lua_ms, hits, hits + misses);
+            DEBUG_LOG("[matrix_ctr_process] startup: %s\n", startup);
+            publish_result("springd_startup", startup);
+            startup_published = true;
+        }
+
         sleep(interval);
     }
 
@@ -341,12 +561,24 @@ void create_terminate_file(void) {
 }
 
 int main(void) {
+    started_at = monotonic_ms();
     daemonize();
+    reload_init();
     setup_signal_handlers();
 
+    if (publish_open() != 0) {
+        DEBUG_LOG("[main] shared state is not available\n");
+    }
+
     DEBUG_LOG("[main] create threads\n");
 
-    pthread_t message_sender_thread, matrix_ctrl_thread, recv_cmd_thread, watchdog_thread;
+    pthread_t message_sender_thread, matrix_ctrl_thread, recv_cmd_thread, watchdog_thread, ifcache_monitor_thread, sampler_thread, reload_thread, conntrack_thread, capture_thread, neigh_monitor_thread;
+    pthread_create(&ifcache_monitor_thread, NULL, ifcache_monitor_process, &is_terminate);
+    pthread_create(&neigh_monitor_thread, NULL, neigh_monitor_process, &is_terminate);
+    pthread_create(&sampler_thread, NULL, sampler_process, &is_terminate);
+    pthread_create(&reload_thread, NULL, reload_process, &is_terminate);
+    pthread_create(&conntrack_thread, NULL, conntrack_process, &is_terminate);
+    pthread_create(&capture_thread, NULL, capture_process, &is_terminate);
     pthread_create(&message_sender_thread, NULL, send_message_process, NULL);
     pthread_create(&matrix_ctrl_thread, NULL, matrix_ctrl_process, NULL);
     pthread_create(&recv_cmd_thread, NULL, handle_unix_socket_communication, NULL);
@@ -367,6 +599,14 @@ int main(void) {
     pthread_join(matrix_ctrl_thread, NULL);
     pthread_join(recv_cmd_thread, NULL);
     pthread_join(watchdog_thread, NULL);
+    pthread_join(ifcache_monitor_thread, NULL);
+    pthread_join(neigh_monitor_thread, NULL);
+    pthread_join(sampler_thread, NULL);
+    pthread_join(reload_thread, NULL);
+    pthread_join(conntrack_thread, NULL);
+    pthread_join(capture_thread, NULL);
+
+    publish_close();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,614 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include "capture.h"
+#include "uci.h"
+#include "ifcache.h"
+#include "../../common/debug.h"
+
+#define CAPTURE_BLOCK_KB_DEFAULT        32
+#define CAPTURE_BLOCK_NR_DEFAULT        8
+#define CAPTURE_BLOCK_TIMEOUT_DEFAULT   100
+#define CAPTURE_RETRY_S                 5
+
+#define ETH_HDR_LEN                     14
+#define IP6_HDR_LEN                     40
+#define UDP_HDR_LEN                     8
+#define DHCP_COOKIE_AT                  236
+#define DHCP_OPTIONS_AT                 240
+#define DHCP_COOKIE                     0x63825363
+
+// Peers are matched on the raw address; the text form is made once
+typedef struct capture_peer_slot {
+    uint8_t family;
+    uint8_t key[16];
+    capture_peer peer;
+} capture_peer_slot;
+
+static const char *counter_names[CAPTURE_COUNTER_NUM] = {
+    "arp_request", "arp_reply", "dhcp_server", "dhcp_client",
+    "dns_query", "dns_response", "dns_nxdomain", "ra",
+};
+
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool running = false;
+static capture_stats stats;
+static capture_peer_slot dhcp_slots[CAPTURE_PEER_MAX];
+static capture_peer_slot router_slots[CAPTURE_PEER_MAX];
+
+// Capture thread only
+static unsigned long last_total[CAPTURE_COUNTER_NUM];
+static int allowed_count = 0;
+static struct in_addr allowed[CAPTURE_PEER_MAX * 2];
+
+const char *capture_counter_name(capture_counter_id id) {
+    return (id < CAPTURE_COUNTER_NUM) ? counter_names[id] : "";
+}
+
+bool capture_running(void) {
+    return __atomic_load_n(&running, __ATOMIC_ACQUIRE);
+}
+
+int capture_get_stats(capture_stats *out) {
+    pthread_mutex_lock(&capture_lock);
+
+    if (!running) {
+        pthread_mutex_unlock(&capture_lock);
+        return -1;
+    }
+
+    *out = stats;
+    for (int i = 0; i < stats.dhcp_server_count; i++) {
+        out->dhcp_servers[i] = dhcp_slots[i].peer;
+    }
+    for (int i = 0; i < stats.router_count; i++) {
+        out->routers[i] = router_slots[i].peer;
+    }
+
+    pthread_mutex_unlock(&capture_lock);
+    return 0;
+}
+
+/*
+ * Frame dissection (called with capture_lock held, once per block)
+ */
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void count(capture_counter_id id) {
+    stats.counters[id].total++;
+}
+
+// Slot of a peer; a new peer takes a free slot (NULL when all are taken)
+static capture_peer *peer_slot(capture_peer_slot *slots, int *slot_count, uint8_t family, const uint8_t *key, const uint8_t *mac) {
+    int len = (family == AF_INET) ? 4 : 16;
+
+    for (int i = 0; i < *slot_count; i++) {
+        if (slots[i].family == family && memcmp(slots[i].key, key, len) == 0) {
+            return &slots[i].peer;
+        }
+    }
+
+    if (*slot_count >= CAPTURE_PEER_MAX) {
+        return NULL;
+    }
+
+    capture_peer_slot *slot = &slots[(*slot_count)++];
+    memset(slot, 0, sizeof(*slot));
+    slot->family = family;
+    memcpy(slot->key, key, len);
+    inet_ntop(family, key, slot->peer.address, sizeof(slot->peer.address));
+    memcpy(slot->peer.mac, mac, sizeof(slot->peer.mac));
+    return &slot->peer;
+}
+
+static void seen(capture_peer *peer, const uint8_t *mac) {
+    if (peer) {
+        memcpy(peer->mac, mac, sizeof(peer->mac));
+        peer->count++;
+        peer->last_seen = (long long)time(NULL);
+    }
+}
+
+static bool is_allowed(const uint8_t *server) {
+    for (int i = 0; i < allowed_count; i++) {
+        if (memcmp(&allowed[i], server, 4) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void dissect_dns(const uint8_t *dns, int len, bool response) {
+    if (len < 4) {
+        return;
+    }
+
+    if (!response) {
+        count(CAPTURE_DNS_QUERY);
+        return;
+    }
+
+    count(CAPTURE_DNS_RESPONSE);
+    if ((dns[3] & 0x0f) == 3) {
+        count(CAPTURE_DNS_NXDOMAIN);
+    }
+}
+
+static void dissect_dhcp(const uint8_t *bootp, int len, const uint8_t *ip_src, const uint8_t *mac, bool from_server) {
+    if (!from_server) {
+        count(CAPTURE_DHCP_CLIENT);
+        return;
+    }
+
+    count(CAPTURE_DHCP_SERVER);
+
+    // Server identifier (option 54), else the source address
+    const uint8_t *server = ip_src;
+    if (len >= DHCP_OPTIONS_AT && get32(bootp + DHCP_COOKIE_AT) == DHCP_COOKIE) {
+        for (int at = DHCP_OPTIONS_AT; at + 1 < len; ) {
+            uint8_t code = bootp[at];
+            if (code == 255) {
+                break;
+            }
+            if (code == 0) {
+                at++;
+                continue;
+            }
+            uint8_t option_len = bootp[at + 1];
+            if (code == 54 && option_len == 4 && at + 6 <= len) {
+                server = bootp + at + 2;
+                break;
+            }
+            at += 2 + option_len;
+        }
+    }
+
+    capture_peer *peer = peer_slot(dhcp_slots, &stats.dhcp_server_count, AF_INET, server, mac);
+    if (peer) {
+        peer->rogue = !is_allowed(server);
+    }
+    seen(peer, mac);
+}
+
+static void dissect_udp(const uint8_t *udp, int len, const uint8_t *ip_src, const uint8_t *mac, bool ipv4) {
+    if (len < UDP_HDR_LEN) {
+        return;
+    }
+
+    uint16_t sport = get16(udp);
+    uint16_t dport = get16(udp + 2);
+    const uint8_t *payload = udp + UDP_HDR_LEN;
+    int payload_len = len - UDP_HDR_LEN;
+
+    if (sport == 53 || dport == 53) {
+        dissect_dns(payload, payload_len, sport == 53);
+    } else if (ipv4 && sport == 67 && dport == 68) {
+        dissect_dhcp(payload, payload_len, ip_src, mac, true);
+    } else if (ipv4 && sport == 68 && dport == 67) {
+        dissect_dhcp(payload, payload_len, ip_src, mac, false);
+    }
+}
+
+static void dissect(const uint8_t *frame, int len) {
+    if (len < ETH_HDR_LEN) {
+        return;
+    }
+
+    const uint8_t *mac = frame + 6;
+    const uint8_t *l3 = frame + ETH_HDR_LEN;
+    int l3_len = len - ETH_HDR_LEN;
+
+    switch (get16(frame + 12)) {
+        case ETH_P_ARP:
+            if (l3_len >= 8) {
+                uint16_t oper = get16(l3 + 6);
+                if (oper == 1) {
+                    count(CAPTURE_ARP_REQUEST);
+                } else if (oper == 2) {
+                    count(CAPTURE_ARP_REPLY);
+                }
+            }
+            break;
+
+        case ETH_P_IP: {
+            if (l3_len < 20) {
+                break;
+            }
+            int ihl = (l3[0] & 0x0f) * 4;
+            if (ihl < 20 || l3_len < ihl || l3[9] != IPPROTO_UDP) {
+                break;
+            }
+            dissect_udp(l3 + ihl, l3_len - ihl, l3 + 12, mac, true);
+            break;
+        }
+
+        case ETH_P_IPV6:
+            if (l3_len < IP6_HDR_LEN + 4) {
+                break;
+            }
+            if (l3[6] == IPPROTO_ICMPV6 && l3[IP6_HDR_LEN] == 134) {
+                count(CAPTURE_RA);
+                seen(peer_slot(router_slots, &stats.router_count, AF_INET6, l3 + 8, mac), mac);
+            } else if (l3[6] == IPPROTO_UDP) {
+                dissect_udp(l3 + IP6_HDR_LEN, l3_len - IP6_HDR_LEN, l3 + 8, mac, false);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*
+ * Socket and ring
+ */
+
+/*
+ * Kernel side filter: ARP; IPv4 UDP (unfragmented) and IPv6 UDP with port
+ * 53, 67 or 68 at either end; ICMPv6 router advertisements (no extension
+ * headers). Accepted frames are cut to CAPTURE_SNAPLEN.
+ */
+static int attach_filter(int fd) {
+    enum {
+        L_ETHERTYPE = 0, L_IS_ARP, L_IS_IP4, L_IS_IP6,
+        L_IP4_PROTO, L_IP4_UDP, L_IP4_FRAG, L_IP4_FRAG_TEST, L_IP4_HDR,
+        L_IP4_SPORT, L_IP4_SPORT_DNS, L_IP4_SPORT_BOOTPS, L_IP4_SPORT_BOOTPC,
+        L_IP4_DPORT, L_IP4_DPORT_DNS, L_IP4_DPORT_BOOTPS, L_IP4_DPORT_BOOTPC,
+        L_IP6_NEXT, L_IP6_IS_ICMP, L_IP6_IS_UDP,
+        L_IP6_ICMP_TYPE, L_IP6_IS_RA,
+        L_IP6_SPORT, L_IP6_SPORT_DNS, L_IP6_DPORT, L_IP6_DPORT_DNS,
+        L_ACCEPT, L_DROP
+    };
+
+#define TO(label, at)   ((label) - (at) - 1)
+#define JEQ(value, label_true, label_false, at) \
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (value), TO(label_true, at), TO(label_false, at))
+
+    const int ip6_payload = ETH_HDR_LEN + IP6_HDR_LEN;
+
+    struct sock_filter code[] = {
+        [L_ETHERTYPE]        = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+        [L_IS_ARP]           = JEQ(ETH_P_ARP, L_ACCEPT, L_IS_IP4, L_IS_ARP),
+        [L_IS_IP4]           = JEQ(ETH_P_IP, L_IP4_PROTO, L_IS_IP6, L_IS_IP4),
+        [L_IS_IP6]           = JEQ(ETH_P_IPV6, L_IP6_NEXT, L_DROP, L_IS_IP6),
+
+        [L_IP4_PROTO]        = BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ETH_HDR_LEN + 9),
+        [L_IP4_UDP]          = JEQ(IPPROTO_UDP, L_IP4_FRAG, L_DROP, L_IP4_UDP),
+        [L_IP4_FRAG]         = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, ETH_HDR_LEN + 6),
+        [L_IP4_FRAG_TEST]    = BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, TO(L_DROP, L_IP4_FRAG_TEST), 0),
+        [L_IP4_HDR]          = BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, ETH_HDR_LEN),
+        [L_IP4_SPORT]        = BPF_STMT(BPF_LD | BPF_H | BPF_IND, ETH_HDR_LEN),
+        [L_IP4_SPORT_DNS]    = JEQ(53, L_ACCEPT, L_IP4_SPORT_BOOTPS, L_IP4_SPORT_DNS),
+        [L_IP4_SPORT_BOOTPS] = JEQ(67, L_ACCEPT, L_IP4_SPORT_BOOTPC, L_IP4_SPORT_BOOTPS),
+        [L_IP4_SPORT_BOOTPC] = JEQ(68, L_ACCEPT, L_IP4_DPORT, L_IP4_SPORT_BOOTPC),
+        [L_IP4_DPORT]        = BPF_STMT(BPF_LD | BPF_H | BPF_IND, ETH_HDR_LEN + 2),
+        [L_IP4_DPORT_DNS]    = JEQ(53, L_ACCEPT, L_IP4_DPORT_BOOTPS, L_IP4_DPORT_DNS),
+        [L_IP4_DPORT_BOOTPS] = JEQ(67, L_ACCEPT, L_IP4_DPORT_BOOTPC, L_IP4_DPORT_BOOTPS),
+        [L_IP4_DPORT_BOOTPC] = JEQ(68, L_ACCEPT, L_DROP, L_IP4_DPORT_BOOTPC),
+
+        [L_IP6_NEXT]         = BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ETH_HDR_LEN + 6),
+        [L_IP6_IS_ICMP]      = JEQ(IPPROTO_ICMPV6, L_IP6_ICMP_TYPE, L_IP6_IS_UDP, L_IP6_IS_ICMP),
+        [L_IP6_IS_UDP]       = JEQ(IPPROTO_UDP, L_IP6_SPORT, L_DROP, L_IP6_IS_UDP),
+        [L_IP6_ICMP_TYPE]    = BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ip6_payload),
+        [L_IP6_IS_RA]        = JEQ(134, L_ACCEPT, L_DROP, L_IP6_IS_RA),
+        [L_IP6_SPORT]        = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, ip6_payload),
+        [L_IP6_SPORT_DNS]    = JEQ(53, L_ACCEPT, L_IP6_DPORT, L_IP6_SPORT_DNS),
+        [L_IP6_DPORT]        = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, ip6_payload + 2),
+        [L_IP6_DPORT_DNS]    = JEQ(53, L_ACCEPT, L_DROP, L_IP6_DPORT_DNS),
+
+        [L_ACCEPT]           = BPF_STMT(BPF_RET | BPF_K, CAPTURE_SNAPLEN),
+        [L_DROP]             = BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+
+#undef JEQ
+#undef TO
+
+    struct sock_fprog prog = {
+        .len = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+static int open_ring(const capture_config *config, int ifindex, uint8_t **ring, size_t *ring_size) {
+    // No protocol until the filter is in place: nothing unfiltered is queued
+    int fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        DEBUG_LOG("[capture] packet socket failed\n");
+        return -1;
+    }
+
+    int version = TPACKET_V3;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        DEBUG_LOG("[capture] TPACKET_V3 not supported\n");
+        close(fd);
+        return -1;
+    }
+
+    if (attach_filter(fd) < 0) {
+        DEBUG_LOG("[capture] filter not attached\n");
+        close(fd);
+        return -1;
+    }
+
+#ifdef PACKET_IGNORE_OUTGOING
+    int ignore = 1;
+    setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore, sizeof(ignore));
+#endif
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = config->block_size;
+    req.tp_block_nr = config->block_nr;
+    req.tp_frame_size = TPACKET_ALIGN(CAPTURE_SNAPLEN + TPACKET3_HDRLEN + ETH_HDR_LEN);
+    req.tp_frame_nr = (req.tp_block_size / req.tp_frame_size) * req.tp_block_nr;
+    req.tp_retire_blk_tov = config->block_timeout_ms;
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        DEBUG_LOG("[capture] PACKET_RX_RING failed\n");
+        close(fd);
+        return -1;
+    }
+
+    *ring_size = (size_t)req.tp_block_size * req.tp_block_nr;
+    *ring = mmap(NULL, *ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (*ring == MAP_FAILED) {
+        DEBUG_LOG("[capture] mmap failed\n");
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = ifindex;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        DEBUG_LOG("[capture] bind to %s failed\n", config->ifname);
+        munmap(*ring, *ring_size);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// All frames of a block, read in place; one lock per block
+static void process_block(struct tpacket_block_desc *block) {
+    uint32_t num = block->hdr.bh1.num_pkts;
+    struct tpacket3_hdr *ppd = (struct tpacket3_hdr *)((uint8_t *)block + block->hdr.bh1.offset_to_first_pkt);
+
+    pthread_mutex_lock(&capture_lock);
+
+    for (uint32_t i = 0; i < num; i++) {
+        dissect((const uint8_t *)ppd + ppd->tp_mac, (int)ppd->tp_snaplen);
+        ppd = (struct tpacket3_hdr *)((uint8_t *)ppd + ppd->tp_next_offset);
+    }
+
+    stats.frames += num;
+    stats.blocks++;
+
+    pthread_mutex_unlock(&capture_lock);
+}
+
+// Once a second: rates, kernel drops and the local addresses
+static void tick(int fd, int ifindex, const capture_config *config, double elapsed) {
+    struct tpacket_stats_v3 kstats;
+    socklen_t len = sizeof(kstats);
+    bool have_kstats = (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &kstats, &len) == 0);
+
+    // The interface's own addresses serve DHCP legitimately
+    ifcache_addr *addrs = NULL;
+    int count_addrs = ifcache_get_addrs(ifindex, AF_INET, &addrs);
+
+    allowed_count = 0;
+    for (int i = 0; i < config->allowed_count; i++) {
+        allowed[allowed_count++] = config->allowed[i];
+    }
+    for (int i = 0; i < count_addrs && allowed_count < (int)(sizeof(allowed) / sizeof(allowed[0])); i++) {
+        if (inet_pton(AF_INET, addrs[i].address, &allowed[allowed_count]) == 1) {
+            allowed_count++;
+        }
+    }
+    free(addrs);
+
+    pthread_mutex_lock(&capture_lock);
+
+    // PACKET_STATISTICS restarts from zero on every read
+    if (have_kstats) {
+        stats.drops += kstats.tp_drops;
+    }
+
+    for (int i = 0; i < CAPTURE_COUNTER_NUM; i++) {
+        capture_counter *c = &stats.counters[i];
+        c->rate = (float)((c->total - last_total[i]) / elapsed);
+        if (c->rate > c->peak) {
+            c->peak = c->rate;
+        }
+        last_total[i] = c->total;
+    }
+
+    for (int i = 0; i < stats.dhcp_server_count; i++) {
+        dhcp_slots[i].peer.rogue = !is_allowed(dhcp_slots[i].key);
+    }
+
+    pthread_mutex_unlock(&capture_lock);
+}
+
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int capture_run(const capture_config *config, volatile bool *terminate) {
+    int ifindex = ifcache_get_index(config->ifname);
+    if (ifindex == 0) {
+        ifindex = (int)if_nametoindex(config->ifname);
+    }
+    if (ifindex == 0) {
+        DEBUG_LOG("[capture] no interface %s\n", config->ifname);
+        return -1;
+    }
+
+    uint8_t *ring;
+    size_t ring_size;
+    int fd = open_ring(config, ifindex, &ring, &ring_size);
+    if (fd < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&capture_lock);
+    memset(&stats, 0, sizeof(stats));
+    memset(last_total, 0, sizeof(last_total));
+    snprintf(stats.ifname, sizeof(stats.ifname), "%s", config->ifname);
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&capture_lock);
+
+    DEBUG_LOG("[capture] start on %s (%d x %d bytes)\n", config->ifname, config->block_nr, config->block_size);
+
+    int current = 0;
+    int ret = 0;
+    double last_tick = monotonic_now();
+    tick(fd, ifindex, config, 1.0);
+
+    while (!*terminate) {
+        struct tpacket_block_desc *block = (struct tpacket_block_desc *)(ring + (size_t)current * config->block_size);
+
+        // Sleep until the kernel hands over a block (full, or timed out)
+        if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN | POLLERR };
+            if (poll(&pfd, 1, 1000) < 0 && errno != EINTR) {
+                ret = -1;
+                break;
+            }
+            if (pfd.revents & POLLERR) {
+                // Interface gone or down: open again later
+                DEBUG_LOG("[capture] %s: socket error\n", config->ifname);
+                ret = -1;
+                break;
+            }
+        }
+
+        while (__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) {
+            process_block(block);
+            __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            current = (current + 1) % config->block_nr;
+            block = (struct tpacket_block_desc *)(ring + (size_t)current * config->block_size);
+        }
+
+        double now = monotonic_now();
+        if (now - last_tick >= 1.0) {
+            tick(fd, ifindex, config, now - last_tick);
+            last_tick = now;
+        }
+    }
+
+    pthread_mutex_lock(&capture_lock);
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&capture_lock);
+
+    munmap(ring, ring_size);
+    close(fd);
+    return ret;
+}
+
+/*
+ * Configuration
+ */
+
+static void config_string(const char *option, char *value, size_t size) {
+    char uci_parameter[256];
+    char buffer[256] = {0};
+
+    snprintf(uci_parameter, sizeof(uci_parameter), "spring.capture.%s", option);
+    uci_get_option(uci_parameter, buffer);
+    snprintf(value, size, "%s", buffer);
+}
+
+static int config_int(const char *option, int default_val, int min, int max) {
+    char value[256];
+    char *endptr;
+
+    config_string(option, value, sizeof(value));
+    long val = strtol(value, &endptr, 10);
+    if (endptr == value || *endptr != '\0' || val < min || val > max) {
+        return default_val;
+    }
+    return (int)val;
+}
+
+static bool load_config(capture_config *config) {
+    char value[256];
+
+    config_string("enable", value, sizeof(value));
+    if (strcmp(value, "1") != 0 && strcmp(value, "on") != 0) {
+        return false;
+    }
+
+    memset(config, 0, sizeof(*config));
+
+    config_string("interface", value, sizeof(value));
+    snprintf(config->ifname, sizeof(config->ifname), "%.15s", value[0] ? value : "br-lan");
+
+    // Page multiple: the ring must map whole pages
+    long page = sysconf(_SC_PAGESIZE);
+    int block_kb = config_int("block_kb", CAPTURE_BLOCK_KB_DEFAULT, 4, 1024);
+    config->block_size = (int)(((long)block_kb * 1024 + page - 1) / page * page);
+    config->block_nr = config_int("block_nr", CAPTURE_BLOCK_NR_DEFAULT, 2, 256);
+    config->block_timeout_ms = config_int("block_timeout_ms", CAPTURE_BLOCK_TIMEOUT_DEFAULT, 1, 10000);
+
+    // Trusted DHCP servers besides this host: "192.168.1.2 192.168.1.3"
+    config_string("dhcp_server", value, sizeof(value));
+    char *saveptr = NULL;
+    for (char *token = strtok_r(value, " ,", &saveptr); token && config->allowed_count < CAPTURE_PEER_MAX;
+         token = strtok_r(NULL, " ,", &saveptr)) {
+        if (inet_pton(AF_INET, token, &config->allowed[config->allowed_count]) == 1) {
+            config->allowed_count++;
+        }
+    }
+
+    return true;
+}
+
+void *capture_process(void *arg) {
+    volatile bool *terminate = (volatile bool *)arg;
+    capture_config config;
+
+    if (!load_config(&config)) {
+        DEBUG_LOG("[capture_process] disabled\n");
+        return NULL;
+    }
+
+    // The interface may come up after springd (bridge at boot) or go away
+    while (!*terminate) {
+        if (capture_run(&config, terminate) == 0) {
+            break;
+        }
+        for (int i = 0; i < CAPTURE_RETRY_S && !*terminate; i++) {
+            sleep(1);
+        }
+    }
+
+    return NULL;
+}
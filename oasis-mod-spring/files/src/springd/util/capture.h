@@ -0,0 +1,95 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+/*
+ * [Packet Capture]
+ * An optional thread that watches the control traffic of one interface
+ * (spring.capture.interface) through an AF_PACKET socket with a TPACKET_V3
+ * ring. A classic BPF filter in the kernel lets only ARP, DHCP, DNS and
+ * router advertisements through (truncated to CAPTURE_SNAPLEN), so the rest
+ * of the traffic costs nothing in user space. The kernel fills whole blocks
+ * of frames; the thread wakes once per block (or block timeout), reads the
+ * frames in place in the shared mapping and hands the block back.
+ *
+ * It counts ARP requests/replies, DNS queries/responses/NXDOMAIN and router
+ * advertisements, and remembers the DHCP servers and IPv6 routers it has
+ * heard. A DHCP server is rogue when it is neither an address of the
+ * interface nor listed in spring.capture.dhcp_server.
+ * Frames sent by this host are not captured.
+ *
+ * Config: spring.capture.enable, interface, dhcp_server (addresses separated by
+ *         spaces), block_kb, block_nr, block_timeout_ms
+ */
+
+#define CAPTURE_SNAPLEN             1024
+#define CAPTURE_PEER_MAX            8
+
+typedef enum {
+    CAPTURE_ARP_REQUEST = 0,
+    CAPTURE_ARP_REPLY,
+    CAPTURE_DHCP_SERVER,            // OFFER/ACK/NAK from a server
+    CAPTURE_DHCP_CLIENT,            // DISCOVER/REQUEST/... from a client
+    CAPTURE_DNS_QUERY,
+    CAPTURE_DNS_RESPONSE,
+    CAPTURE_DNS_NXDOMAIN,
+    CAPTURE_RA,
+    CAPTURE_COUNTER_NUM
+} capture_counter_id;
+
+typedef struct capture_counter {
+    unsigned long total;            // since the capture started
+    float rate;                     // per second over the last second
+    float peak;                     // highest rate seen
+} capture_counter;
+
+// A DHCP server or IPv6 router heard on the link
+typedef struct capture_peer {
+    char address[INET6_ADDRSTRLEN]; // server identifier / router source
+    uint8_t mac[6];
+    bool rogue;                     // DHCP only
+    unsigned long count;
+    long long last_seen;            // unix time (s)
+} capture_peer;
+
+typedef struct capture_stats {
+    char ifname[IFNAMSIZ];
+    unsigned long frames;           // frames that passed the filter
+    unsigned long drops;            // dropped by the kernel (ring full)
+    unsigned long blocks;           // ring blocks processed
+    capture_counter counters[CAPTURE_COUNTER_NUM];
+    int dhcp_server_count;
+    capture_peer dhcp_servers[CAPTURE_PEER_MAX];
+    int router_count;
+    capture_peer routers[CAPTURE_PEER_MAX];
+} capture_stats;
+
+typedef struct capture_config {
+    char ifname[IFNAMSIZ];
+    int block_size;                 // bytes, multiple of the page size
+    int block_nr;
+    int block_timeout_ms;           // a partly filled block is handed over after this
+    int allowed_count;
+    struct in_addr allowed[CAPTURE_PEER_MAX];   // trusted DHCP servers
+} capture_config;
+
+// True while the capture runs
+bool capture_running(void);
+
+// Copy the current statistics; -1 when the capture does not run
+int capture_get_stats(capture_stats *out);
+
+// Name of a counter ("arp_request", ...)
+const char *capture_counter_name(capture_counter_id id);
+
+// Capture with an explicit configuration until *terminate (bench, tests)
+int capture_run(const capture_config *config, volatile bool *terminate);
+
+// Capture thread (reads spring.capture.*); arg points to the terminate flag
+void *capture_process(void *arg);
+
+#endif // CAPTURE_H
@@ -0,0 +1,643 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/filter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nfnetlink_conntrack.h>
+#include "conntrack.h"
+#include "uci.h"
+#include "ifcache.h"
+#include "../../common/debug.h"
+
+#define CT_MSG(msg)                 ((NFNL_SUBSYS_CTNETLINK << 8) | (msg))
+#define CT_RECV_BUFFER_SIZE         65536
+#define CT_SUBNET_MAX               64
+#define CT_RCVBUF_KB_DEFAULT        1024
+#define CT_RESYNC_S_DEFAULT         60
+
+// Counters are native words: no 64-bit atomics (libatomic) on 32-bit targets
+typedef struct ct_counter {
+    int key;                        // ifindex / zone + 1; 0 = free slot
+    long flows;
+    unsigned long new_total;
+    unsigned long destroy_total;
+    float new_rate;
+    unsigned long last_new;         // thread only: new_total at the last tick
+} ct_counter;
+
+typedef struct ct_subnet {
+    int ifindex;
+    unsigned char family;
+    unsigned char prefixlen;
+    unsigned char addr[16];
+} ct_subnet;
+
+typedef struct ct_flow {
+    unsigned char family;
+    int zone;
+    bool orig;                      // orig_src/orig_dst are set
+    bool reply;                     // reply_dst is set
+    unsigned char orig_src[16];
+    unsigned char orig_dst[16];
+    unsigned char reply_dst[16];
+} ct_flow;
+
+static bool running = false;
+static ct_counter total;
+static ct_counter if_counters[CONNTRACK_IF_MAX];
+static ct_counter zone_counters[CONNTRACK_ZONE_MAX];
+
+// Thread only
+static ct_subnet subnets[CT_SUBNET_MAX];
+static int subnet_count = 0;
+
+/*
+ * Counters (writer: the conntrack thread)
+ */
+
+// Slot of a key; a free slot is claimed (NULL when the table is full)
+static ct_counter *counter_slot(ct_counter *table, int max, int key) {
+    for (int i = 0; i < max; i++) {
+        int slot_key = __atomic_load_n(&table[i].key, __ATOMIC_RELAXED);
+        if (slot_key == key) {
+            return &table[i];
+        }
+        if (slot_key == 0) {
+            // Counters of a free slot are zero: publishing the key is enough
+            __atomic_store_n(&table[i].key, key, __ATOMIC_RELEASE);
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+static void counter_count(ct_counter *c, bool is_new) {
+    if (!c) {
+        return;
+    }
+
+    // Single writer: plain reads, atomic stores for the readers
+    if (is_new) {
+        __atomic_store_n(&c->new_total, c->new_total + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->flows, c->flows + 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(&c->destroy_total, c->destroy_total + 1, __ATOMIC_RELAXED);
+        // A flow opened before the last resync may end without having been seen
+        if (c->flows > 0) {
+            __atomic_store_n(&c->flows, c->flows - 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void counter_tick(ct_counter *c, double elapsed) {
+    float rate = (float)((c->new_total - c->last_new) / elapsed);
+    c->last_new = c->new_total;
+    __atomic_store(&c->new_rate, &rate, __ATOMIC_RELAXED);
+}
+
+/*
+ * Counters (readers)
+ */
+
+static void counter_read(const ct_counter *c, conntrack_stats *out) {
+    float rate;
+
+    out->flows = __atomic_load_n(&c->flows, __ATOMIC_RELAXED);
+    out->new_total = __atomic_load_n(&c->new_total, __ATOMIC_RELAXED);
+    out->destroy_total = __atomic_load_n(&c->destroy_total, __ATOMIC_RELAXED);
+    __atomic_load(&c->new_rate, &rate, __ATOMIC_RELAXED);
+    out->new_rate = rate;
+}
+
+static int counter_list(const ct_counter *table, int table_max, int *keys, conntrack_stats *out, int max) {
+    int count = 0;
+
+    for (int i = 0; i < table_max && count < max; i++) {
+        int key = __atomic_load_n(&table[i].key, __ATOMIC_ACQUIRE);
+        if (key == 0) {
+            break;
+        }
+        keys[count] = key - 1;
+        counter_read(&table[i], &out[count]);
+        count++;
+    }
+
+    return count;
+}
+
+bool conntrack_running(void) {
+    return __atomic_load_n(&running, __ATOMIC_ACQUIRE);
+}
+
+void conntrack_get_total(conntrack_stats *out) {
+    counter_read(&total, out);
+}
+
+int conntrack_get_if(int ifindex, conntrack_stats *out) {
+    for (int i = 0; i < CONNTRACK_IF_MAX; i++) {
+        int key = __atomic_load_n(&if_counters[i].key, __ATOMIC_ACQUIRE);
+        if (key == 0) {
+            break;
+        }
+        if (key == ifindex + 1) {
+            counter_read(&if_counters[i], out);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int conntrack_list_ifs(int *keys, conntrack_stats *out, int max) {
+    return counter_list(if_counters, CONNTRACK_IF_MAX, keys, out, max);
+}
+
+int conntrack_list_zones(int *keys, conntrack_stats *out, int max) {
+    return counter_list(zone_counters, CONNTRACK_ZONE_MAX, keys, out, max);
+}
+
+/*
+ * Flow to interface
+ */
+
+static void load_subnets(void) {
+    ifcache_addr *addrs = NULL;
+    int count = ifcache_get_addrs(0, AF_UNSPEC, &addrs);
+
+    subnet_count = 0;
+
+    for (int i = 0; i < count && subnet_count < CT_SUBNET_MAX; i++) {
+        ct_subnet *s = &subnets[subnet_count];
+        memset(s, 0, sizeof(*s));
+        if (inet_pton(addrs[i].family, addrs[i].address, s->addr) != 1) {
+            continue;
+        }
+        s->ifindex = addrs[i].ifindex;
+        s->family = addrs[i].family;
+        s->prefixlen = addrs[i].prefixlen;
+        subnet_count++;
+    }
+
+    free(addrs);
+}
+
+static bool in_subnet(const ct_subnet *s, const unsigned char *addr) {
+    int bytes = s->prefixlen / 8;
+    int bits = s->prefixlen % 8;
+
+    if (memcmp(s->addr, addr, bytes) != 0) {
+        return false;
+    }
+    if (bits == 0) {
+        return true;
+    }
+
+    unsigned char mask = (unsigned char)(0xff << (8 - bits));
+    return ((s->addr[bytes] ^ addr[bytes]) & mask) == 0;
+}
+
+// Interface of the longest matching prefix; 0 when no subnet holds addr
+static int subnet_ifindex(unsigned char family, const unsigned char *addr) {
+    int ifindex = 0;
+    int best = -1;
+
+    for (int i = 0; i < subnet_count; i++) {
+        if (subnets[i].family == family && subnets[i].prefixlen > best && in_subnet(&subnets[i], addr)) {
+            ifindex = subnets[i].ifindex;
+            best = subnets[i].prefixlen;
+        }
+    }
+
+    return ifindex;
+}
+
+/*
+ * LAN client: the original source is on a local subnet.
+ * Connection to the router: the original destination is.
+ * Forwarded after SNAT: the reply comes back to the WAN address.
+ */
+static int flow_ifindex(const ct_flow *flow) {
+    int ifindex = 0;
+
+    if (flow->orig) {
+        ifindex = subnet_ifindex(flow->family, flow->orig_src);
+        if (ifindex == 0) {
+            ifindex = subnet_ifindex(flow->family, flow->orig_dst);
+        }
+    }
+    if (ifindex == 0 && flow->reply) {
+        ifindex = subnet_ifindex(flow->family, flow->reply_dst);
+    }
+
+    return ifindex;
+}
+
+/*
+ * Message parsing
+ */
+
+static void parse_nla(struct nlattr *tb[], int max, void *data, int len) {
+    memset(tb, 0, sizeof(struct nlattr *) * (max + 1));
+
+    struct nlattr *nla = data;
+    while (len >= (int)sizeof(*nla) && nla->nla_len >= sizeof(*nla) && nla->nla_len <= len) {
+        int type = nla->nla_type & NLA_TYPE_MASK;
+        if (type <= max && !tb[type]) {
+            tb[type] = nla;
+        }
+        len -= NLA_ALIGN(nla->nla_len);
+        nla = (struct nlattr *)((char *)nla + NLA_ALIGN(nla->nla_len));
+    }
+}
+
+#define NLA_DATA(nla)       ((void *)((char *)(nla) + NLA_HDRLEN))
+#define NLA_PAYLOAD(nla)    ((int)(nla)->nla_len - NLA_HDRLEN)
+
+static bool parse_tuple(struct nlattr *tuple, unsigned char family, unsigned char *src, unsigned char *dst) {
+    struct nlattr *tb[CTA_TUPLE_MAX + 1];
+    struct nlattr *ip[CTA_IP_MAX + 1];
+
+    parse_nla(tb, CTA_TUPLE_MAX, NLA_DATA(tuple), NLA_PAYLOAD(tuple));
+    if (!tb[CTA_TUPLE_IP]) {
+        return false;
+    }
+
+    parse_nla(ip, CTA_IP_MAX, NLA_DATA(tb[CTA_TUPLE_IP]), NLA_PAYLOAD(tb[CTA_TUPLE_IP]));
+
+    int src_type = (family == AF_INET) ? CTA_IP_V4_SRC : CTA_IP_V6_SRC;
+    int dst_type = (family == AF_INET) ? CTA_IP_V4_DST : CTA_IP_V6_DST;
+    int len = (family == AF_INET) ? 4 : 16;
+
+    if (!ip[src_type] || !ip[dst_type] || NLA_PAYLOAD(ip[src_type]) < len || NLA_PAYLOAD(ip[dst_type]) < len) {
+        return false;
+    }
+
+    memcpy(src, NLA_DATA(ip[src_type]), len);
+    memcpy(dst, NLA_DATA(ip[dst_type]), len);
+    return true;
+}
+
+static bool parse_flow(struct nlmsghdr *nlh, ct_flow *flow) {
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct nfgenmsg))) {
+        return false;
+    }
+
+    struct nfgenmsg *gen = NLMSG_DATA(nlh);
+    struct nlattr *tb[CTA_MAX + 1];
+    unsigned char unused[16];
+
+    memset(flow, 0, sizeof(*flow));
+    flow->family = gen->nfgen_family;
+    if (flow->family != AF_INET && flow->family != AF_INET6) {
+        return false;
+    }
+
+    parse_nla(tb, CTA_MAX, (char *)gen + NLMSG_ALIGN(sizeof(*gen)),
+        nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*gen)));
+
+    if (tb[CTA_TUPLE_ORIG]) {
+        flow->orig = parse_tuple(tb[CTA_TUPLE_ORIG], flow->family, flow->orig_src, flow->orig_dst);
+    }
+    if (tb[CTA_TUPLE_REPLY]) {
+        flow->reply = parse_tuple(tb[CTA_TUPLE_REPLY], flow->family, unused, flow->reply_dst);
+    }
+    if (tb[CTA_ZONE] && NLA_PAYLOAD(tb[CTA_ZONE]) >= 2) {
+        uint16_t zone;
+        memcpy(&zone, NLA_DATA(tb[CTA_ZONE]), sizeof(zone));
+        flow->zone = ntohs(zone);
+    }
+
+    return true;
+}
+
+static void count_message(struct nlmsghdr *nlh) {
+    bool is_new;
+    ct_flow flow;
+
+    if (nlh->nlmsg_type == CT_MSG(IPCTNL_MSG_CT_NEW)) {
+        is_new = true;
+    } else if (nlh->nlmsg_type == CT_MSG(IPCTNL_MSG_CT_DELETE)) {
+        is_new = false;
+    } else {
+        return;
+    }
+
+    if (!parse_flow(nlh, &flow)) {
+        return;
+    }
+
+    counter_count(&total, is_new);
+    counter_count(counter_slot(if_counters, CONNTRACK_IF_MAX, flow_ifindex(&flow) + 1), is_new);
+    counter_count(counter_slot(zone_counters, CONNTRACK_ZONE_MAX, flow.zone + 1), is_new);
+}
+
+/*
+ * Sockets
+ */
+
+/*
+ * Kernel side filter: only IPv4/IPv6 NEW and DESTROY events pass, and IPv4
+ * flows from 127.0.0.0/8 (ubus/rpcd/uhttpd talk over loopback all the time)
+ * are dropped. The loopback test reads the first source address at its
+ * fixed place (CTA_TUPLE_ORIG > CTA_TUPLE_IP > CTA_IP_V4_SRC come first);
+ * a message laid out otherwise is passed.
+ */
+static int attach_filter(int fd) {
+    enum {
+        L_TYPE = 0, L_TYPE_NEW, L_TYPE_DEL,
+        L_FAMILY, L_FAMILY_V4, L_FAMILY_V6,
+        L_ORIG, L_ORIG_PLAIN, L_ORIG_NESTED,
+        L_IP, L_IP_PLAIN, L_IP_NESTED,
+        L_SRC, L_SRC_TYPE,
+        L_SRC_NET, L_SRC_LOOPBACK,
+        L_ACCEPT, L_DROP
+    };
+
+#define TO(label, at)   ((label) - (at) - 1)
+
+    // Fixed places: nlmsghdr, nfgenmsg, then three nested attribute headers
+    const int attr_type = offsetof(struct nlattr, nla_type);
+    const int orig_at = NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(struct nfgenmsg));
+    const int ip_at = orig_at + NLA_HDRLEN;
+    const int src_at = ip_at + NLA_HDRLEN;
+
+    // Absolute loads are big endian: compare with the wire form of host values
+    struct sock_filter code[] = {
+        [L_TYPE]         = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, offsetof(struct nlmsghdr, nlmsg_type)),
+        [L_TYPE_NEW]     = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(CT_MSG(IPCTNL_MSG_CT_NEW)), TO(L_FAMILY, L_TYPE_NEW), 0),
+        [L_TYPE_DEL]     = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(CT_MSG(IPCTNL_MSG_CT_DELETE)), 0, TO(L_DROP, L_TYPE_DEL)),
+
+        [L_FAMILY]       = BPF_STMT(BPF_LD | BPF_B | BPF_ABS, NLMSG_HDRLEN + offsetof(struct nfgenmsg, nfgen_family)),
+        [L_FAMILY_V4]    = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AF_INET, TO(L_ORIG, L_FAMILY_V4), 0),
+        [L_FAMILY_V6]    = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AF_INET6, TO(L_ACCEPT, L_FAMILY_V6), TO(L_DROP, L_FAMILY_V6)),
+
+        [L_ORIG]         = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, orig_at + attr_type),
+        [L_ORIG_PLAIN]   = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(CTA_TUPLE_ORIG), TO(L_IP, L_ORIG_PLAIN), 0),
+        [L_ORIG_NESTED]  = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(CTA_TUPLE_ORIG | NLA_F_NESTED), 0, TO(L_ACCEPT, L_ORIG_NESTED)),
+
+        [L_IP]           = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, ip_at + attr_type),
+        [L_IP_PLAIN]     = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(CTA_TUPLE_IP), TO(L_SRC, L_IP_PLAIN), 0),
+        [L_IP_NESTED]    = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(CTA_TUPLE_IP | NLA_F_NESTED), 0, TO(L_ACCEPT, L_IP_NESTED)),
+
+        [L_SRC]          = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, src_at + attr_type),
+        [L_SRC_TYPE]     = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(CTA_IP_V4_SRC), 0, TO(L_ACCEPT, L_SRC_TYPE)),
+
+        [L_SRC_NET]      = BPF_STMT(BPF_LD | BPF_B | BPF_ABS, src_at + NLA_HDRLEN),
+        [L_SRC_LOOPBACK] = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 127, TO(L_DROP, L_SRC_LOOPBACK), TO(L_ACCEPT, L_SRC_LOOPBACK)),
+
+        [L_ACCEPT]       = BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+        [L_DROP]         = BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+
+#undef TO
+
+    struct sock_fprog prog = {
+        .len = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+static int nfnl_open(unsigned int groups) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_NETFILTER);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = groups;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Count the open flows with a table dump and make them the flow counts.
+ * new/destroy totals are not touched (they count events).
+ */
+static int resync(void) {
+    int fd = nfnl_open(0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct {
+        struct nlmsghdr nlh;
+        struct nfgenmsg gen;
+    } request;
+
+    unsigned int seq = (unsigned int)time(NULL);
+
+    memset(&request, 0, sizeof(request));
+    request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+    request.nlh.nlmsg_type = CT_MSG(IPCTNL_MSG_CT_GET);
+    request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.nlh.nlmsg_seq = seq;
+    request.gen.nfgen_family = AF_UNSPEC;
+    request.gen.version = NFNETLINK_V0;
+
+    if (send(fd, &request, request.nlh.nlmsg_len, 0) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    long all = 0;
+    long per_if[CONNTRACK_IF_MAX] = {0};
+    long per_zone[CONNTRACK_ZONE_MAX] = {0};
+    static long buffer[CT_RECV_BUFFER_SIZE / sizeof(long)];
+    int ret = -1;
+
+    for (;;) {
+        ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            break;
+        }
+
+        struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+        for (; NLMSG_OK(nlh, (unsigned int)len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_seq != seq) {
+                continue;
+            }
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                ret = 0;
+                goto done;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                goto done;
+            }
+
+            ct_flow flow;
+            if (!parse_flow(nlh, &flow)) {
+                continue;
+            }
+            // Same rule as the kernel filter
+            if (flow.family == AF_INET && flow.orig && flow.orig_src[0] == 127) {
+                continue;
+            }
+
+            all++;
+            ct_counter *c = counter_slot(if_counters, CONNTRACK_IF_MAX, flow_ifindex(&flow) + 1);
+            if (c) {
+                per_if[c - if_counters]++;
+            }
+            c = counter_slot(zone_counters, CONNTRACK_ZONE_MAX, flow.zone + 1);
+            if (c) {
+                per_zone[c - zone_counters]++;
+            }
+        }
+    }
+
+done:
+    close(fd);
+
+    if (ret == 0) {
+        __atomic_store_n(&total.flows, all, __ATOMIC_RELAXED);
+        for (int i = 0; i < CONNTRACK_IF_MAX; i++) {
+            __atomic_store_n(&if_counters[i].flows, per_if[i], __ATOMIC_RELAXED);
+        }
+        for (int i = 0; i < CONNTRACK_ZONE_MAX; i++) {
+            __atomic_store_n(&zone_counters[i].flows, per_zone[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    return ret;
+}
+
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool config_enabled(void) {
+    char value[256] = {0};
+
+    uci_get_option("spring.conntrack.enable", value);
+    return (strcmp(value, "1") == 0) || (strcmp(value, "on") == 0);
+}
+
+static int config_int(const char *option, int default_val, int min, int max) {
+    char uci_parameter[256];
+    char value[256] = {0};
+    char *endptr;
+
+    snprintf(uci_parameter, sizeof(uci_parameter), "spring.conntrack.%s", option);
+    uci_get_option(uci_parameter, value);
+
+    long val = strtol(value, &endptr, 10);
+    if (endptr == value || *endptr != '\0' || val < min || val > max) {
+        return default_val;
+    }
+    return (int)val;
+}
+
+void *conntrack_process(void *arg) {
+    volatile bool *terminate = (volatile bool *)arg;
+
+    if (!config_enabled()) {
+        DEBUG_LOG("[conntrack_process] disabled\n");
+        return NULL;
+    }
+
+    int fd = nfnl_open((1 << (NFNLGRP_CONNTRACK_NEW - 1)) | (1 << (NFNLGRP_CONNTRACK_DESTROY - 1)));
+    if (fd < 0) {
+        DEBUG_LOG("[conntrack_process] netfilter socket failed\n");
+        return NULL;
+    }
+
+    // Bursts of short flows (DNS) arrive faster than one wakeup handles
+    int rcvbuf = config_int("rcvbuf_kb", CT_RCVBUF_KB_DEFAULT, 64, 65536) * 1024;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    if (attach_filter(fd) < 0) {
+        DEBUG_LOG("[conntrack_process] socket filter not attached\n");
+    }
+
+    /*
+     * Flows created while nobody listened carry no event cache and end
+     * silently (nf_conntrack_events=2): a periodic dump keeps the open flow
+     * counts from drifting. 0 disables it.
+     */
+    int resync_s = config_int("resync_s", CT_RESYNC_S_DEFAULT, 0, 86400);
+
+    load_subnets();
+    if (resync() != 0) {
+        DEBUG_LOG("[conntrack_process] conntrack dump failed\n");
+    }
+
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+    DEBUG_LOG("[conntrack_process] start\n");
+
+    static long buffer[CT_RECV_BUFFER_SIZE / sizeof(long)];
+    double last_tick = monotonic_now();
+    double last_resync = last_tick;
+
+    while (!*terminate) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, 1000);
+
+        // Drain everything queued: one wakeup per burst, not per flow
+        while (ready > 0) {
+            ssize_t len = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (len < 0) {
+                if (errno == ENOBUFS) {
+                    // Events were lost: the open flows are counted again
+                    DEBUG_LOG("[conntrack_process] overrun, resync\n");
+                    resync();
+                    continue;
+                }
+                break;
+            }
+
+            struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+            for (; NLMSG_OK(nlh, (unsigned int)len); nlh = NLMSG_NEXT(nlh, len)) {
+                count_message(nlh);
+            }
+        }
+
+        double now = monotonic_now();
+        if (now - last_tick >= 1.0) {
+            double elapsed = now - last_tick;
+            last_tick = now;
+
+            counter_tick(&total, elapsed);
+            for (int i = 0; i < CONNTRACK_IF_MAX && if_counters[i].key; i++) {
+                counter_tick(&if_counters[i], elapsed);
+            }
+            for (int i = 0; i < CONNTRACK_ZONE_MAX && zone_counters[i].key; i++) {
+                counter_tick(&zone_counters[i], elapsed);
+            }
+
+            // Addresses come from the interface cache (no syscall while warm)
+            load_subnets();
+
+            if (resync_s > 0 && now - last_resync >= resync_s) {
+                last_resync = now;
+                resync();
+            }
+        }
+    }
+
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    close(fd);
+    return NULL;
+}
@@ -0,0 +1,50 @@
+#ifndef CONNTRACK_H
+#define CONNTRACK_H
+
+#include <stdbool.h>
+
+/*
+ * [Conntrack Events]
+ * A thread subscribed to the conntrack NEW and DESTROY groups of
+ * NETLINK_NETFILTER. Every flow is counted under an interface (the one whose
+ * subnet holds the original source, else the original destination, else the
+ * reply destination) and under its conntrack zone. Open flows are counted
+ * again from a table dump at start, after the socket overflowed and every
+ * spring.conntrack.resync_s seconds.
+ * A socket filter in the kernel drops everything but IPv4/IPv6 NEW/DESTROY
+ * events and flows of the loopback network before they are queued.
+ * The thread is the only writer; readers load the counters atomically and
+ * never wait for it.
+ * Config: spring.conntrack.enable, rcvbuf_kb, resync_s
+ */
+
+#define CONNTRACK_IF_MAX            32
+#define CONNTRACK_ZONE_MAX          16
+
+typedef struct conntrack_stats {
+    long long flows;                    // open flows
+    unsigned long long new_total;       // since springd started
+    unsigned long long destroy_total;
+    double new_rate;                    // new flows/s over the last second
+} conntrack_stats;
+
+// True while the subscriber runs (the counters are meaningful)
+bool conntrack_running(void);
+
+// All flows
+void conntrack_get_total(conntrack_stats *out);
+
+// Flows of one interface; -1 when the interface has seen no flow
+int conntrack_get_if(int ifindex, conntrack_stats *out);
+
+/*
+ * Copy the counted interfaces (ifindex 0: flows of no local subnet) or
+ * conntrack zones into keys/out (max entries). Returns the count.
+ */
+int conntrack_list_ifs(int *keys, conntrack_stats *out, int max);
+int conntrack_list_zones(int *keys, conntrack_stats *out, int max);
+
+// Subscriber thread; arg points to the daemon's terminate flag (bool)
+void *conntrack_process(void *arg);
+
+#endif // CONNTRACK_H
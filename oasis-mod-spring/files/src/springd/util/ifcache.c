@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <linux/if_addr.h>
+#include "ifcache.h"
+#include "./netlink/rtnl.h"
+#include "../../common/debug.h"
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static ifcache_link *links = NULL;
+static int link_count = 0;
+static int link_cap = 0;
+
+static ifcache_addr *addrs = NULL;
+static int addr_count = 0;
+static int addr_cap = 0;
+
+static bool warm = false;
+static time_t dumped_at = 0;
+static volatile bool monitor_running = false;
+
+// Append one zeroed element to a growable array; NULL when out of memory
+static void *grow(void **array, int *count, int *cap, size_t size) {
+    if (*count >= *cap) {
+        int new_cap = (*cap > 0) ? (*cap * 2) : 16;
+        void *p = realloc(*array, (size_t)new_cap * size);
+        if (!p) {
+            return NULL;
+        }
+        *array = p;
+        *cap = new_cap;
+    }
+    void *item = (char *)*array + (size_t)(*count) * size;
+    memset(item, 0, size);
+    (*count)++;
+    return item;
+}
+
+static int link_cb(struct nlmsghdr *nlh, void *ctx) {
+    (void)ctx;
+
+    if (nlh->nlmsg_type != RTM_NEWLINK) {
+        return 0;
+    }
+
+    struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+    struct rtattr *tb[IFLA_MAX + 1];
+    rtnl_parse_attrs(tb, IFLA_MAX, IFLA_RTA(ifi), IFLA_PAYLOAD(nlh));
+
+    if (!tb[IFLA_IFNAME]) {
+        return 0;
+    }
+
+    ifcache_link *link = grow((void **)&links, &link_count, &link_cap, sizeof(ifcache_link));
+    if (!link) {
+        return 1;
+    }
+
+    link->index = ifi->ifi_index;
+    snprintf(link->ifname, sizeof(link->ifname), "%.*s",
+             (int)RTA_PAYLOAD(tb[IFLA_IFNAME]), (const char *)RTA_DATA(tb[IFLA_IFNAME]));
+    return 0;
+}
+
+static time_t monotonic_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static long long lifetime(unsigned int value) {
+    return (value == 0xFFFFFFFFU) ? -1 : (long long)value;
+}
+
+// Lifetimes count down without any event: age the dumped value on read
+static long long aged(long long value, time_t elapsed) {
+    if (value < 0) {
+        return value;
+    }
+    return (value > elapsed) ? (value - elapsed) : 0;
+}
+
+static int addr_cb(struct nlmsghdr *nlh, void *ctx) {
+    (void)ctx;
+
+    if (nlh->nlmsg_type != RTM_NEWADDR) {
+        return 0;
+    }
+
+    struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+    struct rtattr *tb[IFA_MAX + 1];
+    rtnl_parse_attrs(tb, IFA_MAX, IFA_RTA(ifa), IFA_PAYLOAD(nlh));
+
+    if (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6) {
+        return 0;
+    }
+
+    // IPv4: IFA_LOCAL is the own address (IFA_ADDRESS is the peer on p-t-p links)
+    struct rtattr *a = tb[IFA_LOCAL] ? tb[IFA_LOCAL] : tb[IFA_ADDRESS];
+    if (!a) {
+        return 0;
+    }
+
+    ifcache_addr *addr = grow((void **)&addrs, &addr_count, &addr_cap, sizeof(ifcache_addr));
+    if (!addr) {
+        return 1;
+    }
+
+    addr->ifindex = ifa->ifa_index;
+    addr->family = ifa->ifa_family;
+    addr->prefixlen = ifa->ifa_prefixlen;
+    addr->scope = ifa->ifa_scope;
+    addr->flags = tb[IFA_FLAGS] ? *(unsigned int *)RTA_DATA(tb[IFA_FLAGS]) : ifa->ifa_flags;
+    addr->valid_lft = -1;
+    addr->preferred_lft = -1;
+
+    if (tb[IFA_CACHEINFO]) {
+        struct ifa_cacheinfo *ci = RTA_DATA(tb[IFA_CACHEINFO]);
+        addr->valid_lft = lifetime(ci->ifa_valid);
+        addr->preferred_lft = lifetime(ci->ifa_prefered);
+    }
+
+    if (!inet_ntop(ifa->ifa_family, RTA_DATA(a), addr->address, sizeof(addr->address))) {
+        addr_count--;
+    }
+
+    return 0;
+}
+
+// Dump links and addresses into the cache (cache_lock held)
+static int refresh_locked(void) {
+    int fd = rtnl_open(0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    link_count = 0;
+    addr_count = 0;
+    warm = false;
+
+    int ret = rtnl_dump(fd, RTM_GETLINK, AF_UNSPEC, link_cb, NULL);
+    if (ret == 0) {
+        ret = rtnl_dump(fd, RTM_GETADDR, AF_UNSPEC, addr_cb, NULL);
+    }
+
+    close(fd);
+
+    if (ret != 0) {
+        link_count = 0;
+        addr_count = 0;
+        return -1;
+    }
+
+    // Only an event listener can tell when the cache goes stale
+    warm = monitor_running;
+    dumped_at = monotonic_sec();
+    return 0;
+}
+
+static int ensure_warm_locked(void) {
+    if (warm && monitor_running) {
+        return 0;
+    }
+    return refresh_locked();
+}
+
+int ifcache_get_addrs(int ifindex, int family, ifcache_addr **out) {
+    *out = NULL;
+
+    pthread_mutex_lock(&cache_lock);
+
+    if (ensure_warm_locked() != 0) {
+        pthread_mutex_unlock(&cache_lock);
+        return -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < addr_count; i++) {
+        if ((ifindex == 0 || addrs[i].ifindex == ifindex) &&
+            (family == AF_UNSPEC || addrs[i].family == family)) {
+            count++;
+        }
+    }
+
+    if (count > 0) {
+        *out = malloc((size_t)count * sizeof(ifcache_addr));
+        if (!*out) {
+            pthread_mutex_unlock(&cache_lock);
+            return -1;
+        }
+        int n = 0;
+        time_t elapsed = monotonic_sec() - dumped_at;
+        for (int i = 0; i < addr_count; i++) {
+            if ((ifindex == 0 || addrs[i].ifindex == ifindex) &&
+                (family == AF_UNSPEC || addrs[i].family == family)) {
+                (*out)[n] = addrs[i];
+                (*out)[n].valid_lft = aged(addrs[i].valid_lft, elapsed);
+                (*out)[n].preferred_lft = aged(addrs[i].preferred_lft, elapsed);
+                n++;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+    return count;
+}
+
+int ifcache_get_index(const char *ifname) {
+    int index = 0;
+
+    pthread_mutex_lock(&cache_lock);
+
+    if (ensure_warm_locked() == 0) {
+        for (int i = 0; i < link_count; i++) {
+            if (strcmp(links[i].ifname, ifname) == 0) {
+                index = links[i].index;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+    return index;
+}
+
+bool ifcache_get_name(int index, char *ifname) {
+    bool found = false;
+
+    pthread_mutex_lock(&cache_lock);
+
+    if (ensure_warm_locked() == 0) {
+        for (int i = 0; i < link_count; i++) {
+            if (links[i].index == index) {
+                memcpy(ifname, links[i].ifname, IFNAMSIZ);
+                found = true;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+    return found;
+}
+
+void ifcache_invalidate(void) {
+    pthread_mutex_lock(&cache_lock);
+    warm = false;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+const char *ifcache_scope_name(unsigned char scope) {
+    switch (scope) {
+        case RT_SCOPE_UNIVERSE:
+            return "global";
+        case RT_SCOPE_SITE:
+            return "site";
+        case RT_SCOPE_LINK:
+            return "link";
+        case RT_SCOPE_HOST:
+            return "host";
+        case RT_SCOPE_NOWHERE:
+            return "nowhere";
+        default:
+            return "other";
+    }
+}
+
+void *ifcache_monitor_process(void *arg) {
+    volatile bool *terminate = (volatile bool *)arg;
+
+    int fd = rtnl_open(RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR);
+    if (fd < 0) {
+        DEBUG_LOG("[ifcache_monitor_process] netlink socket failed\n");
+        return NULL;
+    }
+
+    monitor_running = true;
+    ifcache_invalidate();
+
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    static long buffer[8192 / sizeof(long)];
+
+    while (!*terminate) {
+
+        // Wake up once a second to see the terminate flag
+        if (poll(&pfd, 1, 1000) <= 0) {
+            continue;
+        }
+
+        ssize_t len = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (len < 0) {
+            // Events were dropped: nothing tells what changed
+            if (errno == ENOBUFS) {
+                ifcache_invalidate();
+            }
+            continue;
+        }
+
+        bool changed = false;
+        struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+        for (; NLMSG_OK(nlh, (unsigned int)len); nlh = NLMSG_NEXT(nlh, len)) {
+            switch (nlh->nlmsg_type) {
+                case RTM_NEWLINK:
+                case RTM_DELLINK:
+                case RTM_NEWADDR:
+                case RTM_DELADDR:
+                    changed = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (changed) {
+            ifcache_invalidate();
+        }
+    }
+
+    monitor_running = false;
+    close(fd);
+    return NULL;
+}
@@ -0,0 +1,58 @@
+#ifndef IFCACHE_H
+#define IFCACHE_H
+
+#include <stdbool.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+/*
+ * [Interface Cache]
+ * Links and addresses of the system, read with one RTM_GETLINK and one
+ * RTM_GETADDR dump. The monitor thread (ifcache_monitor_process) listens to
+ * link/address events and marks the cache cold on any change; the next query
+ * dumps again. While the cache is warm, queries make no syscall at all.
+ * Without a running monitor every query dumps (nothing could tell that the
+ * cache went stale).
+ */
+
+#define IFCACHE_SCOPE_LEN   8
+
+typedef struct ifcache_link {
+    int index;
+    char ifname[IFNAMSIZ];
+} ifcache_link;
+
+typedef struct ifcache_addr {
+    int ifindex;
+    unsigned char family;               // AF_INET / AF_INET6
+    unsigned char prefixlen;
+    unsigned char scope;                // RT_SCOPE_*
+    unsigned int flags;                 // IFA_F_*
+    long long valid_lft;                // seconds, -1 = forever
+    long long preferred_lft;            // seconds, -1 = forever
+    char address[INET6_ADDRSTRLEN];
+} ifcache_addr;
+
+/*
+ * Copy the addresses of one interface (ifindex 0: all interfaces) and family
+ * (AF_UNSPEC: both) into a malloc'ed array. Returns the count (-1 on error);
+ * the caller frees *out.
+ */
+int ifcache_get_addrs(int ifindex, int family, ifcache_addr **out);
+
+// Interface index of a name (0 when unknown)
+int ifcache_get_index(const char *ifname);
+
+// Name of an interface index into ifname[IFNAMSIZ]; false when unknown
+bool ifcache_get_name(int index, char *ifname);
+
+// Mark the cache cold (the next query dumps again)
+void ifcache_invalidate(void);
+
+// Human readable scope ("global", "link", ...)
+const char *ifcache_scope_name(unsigned char scope);
+
+// Event listener thread; arg points to the daemon's terminate flag (bool)
+void *ifcache_monitor_process(void *arg);
+
+#endif // IFCACHE_H
@@ -1,5 +1,8 @@
 #include "events.h"
 #include "../errors.h"
+#include "../ifcache.h"
+#include <linux/if_addr.h>
+#include <linux/rtnetlink.h>
 
 int get_ifname_from_idx(lua_State *L) {
     int if_idx = luaL_checkinteger(L, 1);
@@ -180,34 +183,44 @@ int get_interface_flags(lua_State *L) {
     return 0;
 }
 
-int get_if_ipv6_from_name(lua_State *L) {
-    const char *ifname = luaL_checkstring(L, 1);
-    const char *ipv6_addr = luaL_checkstring(L, 2);
-    size_t addr_len = luaL_checkinteger(L, 3);
-
-    int sockfd;
-    struct ifreq ifr;
-
-    memset((char *)ipv6_addr, '\0', addr_len);
+/*
+ * Push the preferred IPv6 address of an interface (nil when it has none):
+ * a usable global address first, then any other one. Served from the
+ * interface cache (one RTM_GETADDR dump, not an ioctl per call).
+ */
+static int push_if_ipv6(lua_State *L, int ifindex) {
+    ifcache_addr *addrs = NULL;
+    int count = (ifindex > 0) ? ifcache_get_addrs(ifindex, AF_INET6, &addrs) : 0;
 
-    sockfd = socket(AF_INET6, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
-        return luaL_error(L, "Socket creation failed");
+    if (count < 0) {
+        return luaL_error(L, "Failed to get IPv6 address");
     }
 
-    memset(&ifr, 0, sizeof(ifr));
-    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    int best = -1;
+    for (int i = 0; i < count; i++) {
+        bool usable = !(addrs[i].flags & (IFA_F_TENTATIVE | IFA_F_DEPRECATED | IFA_F_DADFAILED));
+        if (addrs[i].scope == RT_SCOPE_UNIVERSE && usable) {
+            best = i;
+            break;
+        }
+        if (best < 0) {
+            best = i;
+        }
+    }
 
-    if (ioctl(sockfd, SIOCGIFADDR, &ifr) < 0) {
-        close(sockfd);
-        return luaL_error(L, "Failed to get IPv6 address");
+    if (best < 0) {
+        lua_pushnil(L);
+    } else {
+        lua_pushstring(L, addrs[best].address);
     }
 
-    strncpy((char *)ipv6_addr, ifr.ifr_addr.sa_data, addr_len - 1);
-    ((char *)ipv6_addr)[addr_len - 1] = '\0';
+    free(addrs);
+    return 1;
+}
 
-    close(sockfd);
-    return 0;
+int get_if_ipv6_from_name(lua_State *L) {
+    const char *ifname = luaL_checkstring(L, 1);
+    return push_if_ipv6(L, ifcache_get_index(ifname));
 }
 
 int get_mtu(lua_State *L) {
@@ -288,56 +301,10 @@ int get_if_idx(lua_State *L) {
 
 int get_if_ipv6(lua_State *L) {
     const char *ifname = luaL_checkstring(L, 1);
-    struct ifaddrs *ifaddr, *ifa;
-    char addr[INET6_ADDRSTRLEN] = {0};
-
-    if (getifaddrs(&ifaddr) == -1) {
-        return luaL_error(L, "getifaddrs failed");
-    }
-
-    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
-        if (ifa->ifa_addr &&
-            ifa->ifa_addr->sa_family == AF_INET6 &&
-            strcmp(ifa->ifa_name, ifname) == 0) {
-            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ifa->ifa_addr;
-            if (inet_ntop(AF_INET6, &sin6->sin6_addr, addr, sizeof(addr))) {
-                lua_pushstring(L, addr);
-                freeifaddrs(ifaddr);
-                return 1;
-            }
-        }
-    }
-    freeifaddrs(ifaddr);
-    lua_pushnil(L);
-    return 1;
+    return push_if_ipv6(L, ifcache_get_index(ifname));
 }
 
 int get_if_ipv6_from_idx(lua_State *L) {
     int if_idx = luaL_checkinteger(L, 1);
-    const char *ipv6_addr = luaL_checkstring(L, 2);
-    size_t addr_len = luaL_checkinteger(L, 3);
-
-    int sockfd;
-    struct ifreq ifr;
-
-    memset((char *)ipv6_addr, '\0', addr_len);
-
-    sockfd = socket(AF_INET6, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
-        return luaL_error(L, "Socket creation failed");
-    }
-
-    memset(&ifr, 0, sizeof(ifr));
-    ifr.ifr_ifindex = if_idx;
-
-    if (ioctl(sockfd, SIOCGIFADDR, &ifr) < 0) {
-        close(sockfd);
-        return luaL_error(L, "Failed to get IPv6 address");
-    }
-
-    strncpy((char *)ipv6_addr, ifr.ifr_addr.sa_data, addr_len - 1);
-    ((char *)ipv6_addr)[addr_len - 1] = '\0';
-
-    close(sockfd);
-    return 0;
-}
\ No newline at end of file
+    return push_if_ipv6(L, if_idx);
+}
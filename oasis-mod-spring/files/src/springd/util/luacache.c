@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <lauxlib.h>
+#include "luacache.h"
+#include "../../common/debug.h"
+
+#define LUACACHE_MODULE_PREFIX      "spring."
+#define LUACACHE_NAME_MAX           256
+
+typedef struct luacache_buffer {
+    char *data;
+    size_t len;
+    size_t cap;
+} luacache_buffer;
+
+static int hits = 0;
+static int misses = 0;
+
+void luacache_get_counts(int *out_hits, int *out_misses) {
+    *out_hits = __atomic_load_n(&hits, __ATOMIC_RELAXED);
+    *out_misses = __atomic_load_n(&misses, __ATOMIC_RELAXED);
+}
+
+// Whole file into a malloc'ed buffer; NULL when it cannot be read
+static char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+
+    char *data = NULL;
+    long size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        size = ftell(fp);
+        rewind(fp);
+    }
+
+    if (size >= 0) {
+        data = malloc((size_t)size + 1);
+        if (data && fread(data, 1, (size_t)size, fp) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(fp);
+    if (data) {
+        *len = (size_t)size;
+    }
+    return data;
+}
+
+// FNV-1a (64 bit)
+static uint64_t source_hash(const char *data, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// "/usr/lib/lua/spring/matrix/judge.lua" -> "usr_lib_lua_spring_matrix_judge.lua-"
+static void cache_prefix(const char *path, char *prefix, size_t size) {
+    size_t n = 0;
+    for (const char *p = (path[0] == '/') ? path + 1 : path; *p && n + 2 < size; p++) {
+        prefix[n++] = (*p == '/') ? '_' : *p;
+    }
+    prefix[n++] = '-';
+    prefix[n] = '\0';
+}
+
+static int dump_writer(lua_State *L, const void *p, size_t size, void *ud) {
+    luacache_buffer *b = ud;
+    (void)L;
+
+    if (b->len + size > b->cap) {
+        size_t cap = (b->cap > 0) ? b->cap : 4096;
+        while (cap < b->len + size) {
+            cap *= 2;
+        }
+        char *data = realloc(b->data, cap);
+        if (!data) {
+            return 1;
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+
+    memcpy(b->data + b->len, p, size);
+    b->len += size;
+    return 0;
+}
+
+// Bytecode of older sources of the same file is never read again
+static void remove_stale(const char *prefix, const char *keep) {
+    DIR *dir = opendir(LUACACHE_DIR);
+    if (!dir) {
+        return;
+    }
+
+    struct dirent *entry;
+    size_t prefix_len = strlen(prefix);
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, prefix, prefix_len) == 0 && strcmp(entry->d_name, keep) != 0) {
+            char path[LUACACHE_NAME_MAX + sizeof(LUACACHE_DIR) + 1];
+            snprintf(path, sizeof(path), "%s/%s", LUACACHE_DIR, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+// Write the function on top of the stack to cache_path (atomically)
+static void store(lua_State *L, const char *cache_path, const char *prefix, const char *name) {
+    luacache_buffer b = { NULL, 0, 0 };
+
+    if (lua_dump(L, dump_writer, &b) != 0 || b.len == 0) {
+        free(b.data);
+        return;
+    }
+
+    char tmp_path[LUACACHE_NAME_MAX + sizeof(LUACACHE_DIR) + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", cache_path, (int)getpid());
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp) {
+        bool ok = (fwrite(b.data, 1, b.len, fp) == b.len);
+        ok = (fclose(fp) == 0) && ok;
+        if (ok && rename(tmp_path, cache_path) == 0) {
+            remove_stale(prefix, name);
+        } else {
+            unlink(tmp_path);
+        }
+    }
+
+    free(b.data);
+}
+
+// Bytecode is trusted only from a directory no one else can write to
+static bool cache_dir_trusted(void) {
+    struct stat st;
+
+    if (lstat(LUACACHE_DIR, &st) != 0) {
+        mkdir("/tmp/spring", 0755);
+        if (mkdir(LUACACHE_DIR, 0700) != 0 || lstat(LUACACHE_DIR, &st) != 0) {
+            return false;
+        }
+    }
+    return S_ISDIR(st.st_mode) && st.st_uid == geteuid() && (st.st_mode & 022) == 0;
+}
+
+int luacache_loadfile(lua_State *L, const char *path) {
+    size_t len = 0;
+    char *source = cache_dir_trusted() ? read_file(path, &len) : NULL;
+    if (!source) {
+        return luaL_loadfile(L, path);
+    }
+
+    char chunkname[LUACACHE_NAME_MAX];
+    snprintf(chunkname, sizeof(chunkname), "@%s", path);
+
+    char prefix[LUACACHE_NAME_MAX - 24];
+    char name[LUACACHE_NAME_MAX];
+    char cache_path[LUACACHE_NAME_MAX + sizeof(LUACACHE_DIR) + 1];
+    cache_prefix(path, prefix, sizeof(prefix));
+    snprintf(name, sizeof(name), "%s%016llx.luac", prefix, (unsigned long long)source_hash(source, len));
+    snprintf(cache_path, sizeof(cache_path), "%s/%s", LUACACHE_DIR, name);
+
+    size_t code_len = 0;
+    char *code = read_file(cache_path, &code_len);
+    if (code) {
+        int ret = luaL_loadbuffer(L, code, code_len, chunkname);
+        free(code);
+        if (ret == 0) {
+            free(source);
+            __atomic_add_fetch(&hits, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        DEBUG_LOG("[luacache] unusable bytecode %s: %s\n", cache_path, lua_tostring(L, -1));
+        lua_pop(L, 1);
+        unlink(cache_path);
+    }
+
+    // Like luaL_loadfile: a first line starting with '#' is skipped (line numbers stay)
+    const char *text = source;
+    size_t text_len = len;
+    if (text_len > 0 && text[0] == '#') {
+        while (text_len > 0 && text[0] != '\n') {
+            text++;
+            text_len--;
+        }
+    }
+
+    int ret = luaL_loadbuffer(L, text, text_len, chunkname);
+    free(source);
+    if (ret != 0) {
+        return ret;
+    }
+
+    __atomic_add_fetch(&misses, 1, __ATOMIC_RELAXED);
+    store(L, cache_path, prefix, name);
+    return 0;
+}
+
+/*
+ * package.loaders entry: "spring.matrix.judge" is looked up in package.path
+ * like the standard Lua searcher, then loaded through the cache. Other
+ * modules are left to the standard searchers.
+ */
+static int searcher(lua_State *L) {
+    const char *module = luaL_checkstring(L, 1);
+
+    if (strncmp(module, LUACACHE_MODULE_PREFIX, strlen(LUACACHE_MODULE_PREFIX)) != 0) {
+        lua_pushstring(L, "");
+        return 1;
+    }
+
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "path");
+    const char *templates = lua_tostring(L, -1);
+    if (!templates) {
+        lua_pushstring(L, "");
+        return 1;
+    }
+
+    const char *file = luaL_gsub(L, module, ".", "/");
+    const char *at = templates;
+
+    while (*at) {
+        const char *end = strchr(at, ';');
+        size_t n = end ? (size_t)(end - at) : strlen(at);
+
+        if (n > 0) {
+            lua_pushlstring(L, at, n);
+            const char *path = luaL_gsub(L, lua_tostring(L, -1), "?", file);
+            if (access(path, R_OK) == 0) {
+                if (luacache_loadfile(L, path) != 0) {
+                    return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+                                      module, path, lua_tostring(L, -1));
+                }
+                return 1;
+            }
+            lua_pop(L, 2);
+        }
+
+        at += n;
+        if (*at == ';') {
+            at++;
+        }
+    }
+
+    lua_pushfstring(L, "\n\tno cached module '%s'", module);
+    return 1;
+}
+
+void luacache_install(lua_State *L) {
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "loaders");
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 2);
+        return;
+    }
+
+    // Second place: package.preload keeps precedence
+    int n = (int)lua_objlen(L, -1);
+    for (int i = n; i >= 2; i--) {
+        lua_rawgeti(L, -1, i);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_pushcfunction(L, searcher);
+    lua_rawseti(L, -2, 2);
+    lua_pop(L, 2);
+}
@@ -0,0 +1,32 @@
+#ifndef LUACACHE_H
+#define LUACACHE_H
+
+#include <lua.h>
+
+/*
+ * [Lua Bytecode Cache]
+ * springd's Lua states load phase.lua and the spring.* modules through this
+ * cache instead of parsing the sources every start. The bytecode of a file
+ * (lua_dump) is kept in LUACACHE_DIR under a name made of the file name and
+ * a hash of its source, so an edited or upgraded source never loads stale
+ * bytecode: its hash names another file, which is compiled once. Bytecode
+ * that does not load (other Lua build, truncated write) is compiled again.
+ * When the directory cannot be written, or could be written by another
+ * user, the sources are simply parsed.
+ */
+
+#define LUACACHE_DIR                "/tmp/spring/luac"
+
+/*
+ * Load a Lua file as a chunk, like luaL_loadfile: the chunk (or an error
+ * message) is pushed and 0 (or a LUA_ERR* code) returned.
+ */
+int luacache_loadfile(lua_State *L, const char *path);
+
+// Put a searcher for the "spring.*" modules in front of package.loaders
+void luacache_install(lua_State *L);
+
+// Loads served from bytecode / compiled from source since springd started
+void luacache_get_counts(int *hits, int *misses);
+
+#endif // LUACACHE_H
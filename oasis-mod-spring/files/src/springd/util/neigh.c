@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <linux/rtnetlink.h>
+#include <linux/neighbour.h>
+#include "neigh.h"
+#include "./netlink/rtnl.h"
+#include "../../common/debug.h"
+
+#define NEIGH_BUCKETS           256     // power of two
+#define NEIGH_RCVBUF            (256 * 1024)
+
+// Kernel-internal (include/net/neighbour.h): the entry has a usable address
+#define NUD_VALID               (NUD_PERMANENT | NUD_NOARP | NUD_REACHABLE | NUD_PROBE | NUD_STALE | NUD_DELAY)
+
+typedef struct neigh_slot {
+    neigh_entry entry;
+    unsigned int generation;            // dump that last saw the entry
+    int next;                           // bucket chain / free list, -1 = end
+} neigh_slot;
+
+typedef struct neigh_mac_slot {
+    unsigned char mac[6];
+    int next;
+} neigh_mac_slot;
+
+static pthread_mutex_t neigh_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool running = false;
+
+static neigh_slot slots[NEIGH_ENTRY_MAX];
+static int buckets[NEIGH_BUCKETS];
+static int free_head = -1;
+static int entry_count = 0;
+static unsigned int generation = 0;
+
+static neigh_mac_slot macs[NEIGH_MAC_MAX];
+static int mac_buckets[NEIGH_BUCKETS];
+static int mac_count = 0;
+
+static neigh_new_mac recent[NEIGH_RECENT_MAX];
+static int recent_head = 0;             // next slot to write
+static int recent_count = 0;
+
+// The initial dump learns the MACs already there without reporting them
+static bool learning = true;
+
+static int addr_len(unsigned char family) {
+    return (family == AF_INET) ? 4 : 16;
+}
+
+// FNV-1a
+static unsigned int hash_bytes(unsigned int h, const unsigned char *p, int len) {
+    for (int i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+static unsigned int addr_bucket(unsigned char family, const unsigned char *addr) {
+    return hash_bytes(2166136261U ^ family, addr, addr_len(family)) & (NEIGH_BUCKETS - 1);
+}
+
+static unsigned int mac_bucket(const unsigned char *mac) {
+    return hash_bytes(2166136261U, mac, 6) & (NEIGH_BUCKETS - 1);
+}
+
+static void reset_locked(void) {
+    for (int i = 0; i < NEIGH_BUCKETS; i++) {
+        buckets[i] = -1;
+        mac_buckets[i] = -1;
+    }
+    for (int i = 0; i < NEIGH_ENTRY_MAX; i++) {
+        slots[i].next = (i + 1 < NEIGH_ENTRY_MAX) ? (i + 1) : -1;
+    }
+    free_head = 0;
+    entry_count = 0;
+    mac_count = 0;
+    recent_head = 0;
+    recent_count = 0;
+    learning = true;
+}
+
+// Slot of an address on one interface (ifindex 0: any); -1 when unknown
+static int find_locked(unsigned char family, const unsigned char *addr, int ifindex) {
+    int len = addr_len(family);
+
+    for (int i = buckets[addr_bucket(family, addr)]; i >= 0; i = slots[i].next) {
+        const neigh_entry *e = &slots[i].entry;
+        if (e->family == family && memcmp(e->addr, addr, len) == 0 &&
+            (ifindex == 0 || e->ifindex == ifindex)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void remove_locked(int slot) {
+    const neigh_entry *e = &slots[slot].entry;
+    int *link = &buckets[addr_bucket(e->family, e->addr)];
+
+    while (*link >= 0 && *link != slot) {
+        link = &slots[*link].next;
+    }
+    if (*link == slot) {
+        *link = slots[slot].next;
+        slots[slot].next = free_head;
+        free_head = slot;
+        entry_count--;
+    }
+}
+
+// Remember a MAC; the first sighting after the initial dump is reported
+static void learn_mac_locked(const neigh_entry *e) {
+    unsigned int b = mac_bucket(e->mac);
+
+    for (int i = mac_buckets[b]; i >= 0; i = macs[i].next) {
+        if (memcmp(macs[i].mac, e->mac, 6) == 0) {
+            return;
+        }
+    }
+
+    // Full: stop learning rather than report known MACs as new later
+    if (mac_count >= NEIGH_MAC_MAX) {
+        return;
+    }
+
+    neigh_mac_slot *m = &macs[mac_count];
+    memcpy(m->mac, e->mac, 6);
+    m->next = mac_buckets[b];
+    mac_buckets[b] = mac_count++;
+
+    if (learning) {
+        return;
+    }
+
+    neigh_new_mac *n = &recent[recent_head];
+    n->ifindex = e->ifindex;
+    n->family = e->family;
+    memcpy(n->addr, e->addr, sizeof(n->addr));
+    memcpy(n->mac, e->mac, 6);
+    n->first_seen = e->first_seen;
+    recent_head = (recent_head + 1) % NEIGH_RECENT_MAX;
+    if (recent_count < NEIGH_RECENT_MAX) {
+        recent_count++;
+    }
+}
+
+static void update_locked(const neigh_entry *in) {
+    int slot = find_locked(in->family, in->addr, in->ifindex);
+    long long now = (long long)time(NULL);
+
+    if (slot < 0) {
+        if (free_head < 0) {
+            return;
+        }
+        slot = free_head;
+        free_head = slots[slot].next;
+        entry_count++;
+
+        unsigned int b = addr_bucket(in->family, in->addr);
+        slots[slot].entry = *in;
+        slots[slot].entry.first_seen = now;
+        slots[slot].next = buckets[b];
+        buckets[b] = slot;
+    } else {
+        long long first_seen = slots[slot].entry.first_seen;
+        slots[slot].entry = *in;
+        slots[slot].entry.first_seen = first_seen;
+    }
+
+    neigh_entry *e = &slots[slot].entry;
+    e->updated = now;
+    slots[slot].generation = generation;
+
+    if (e->has_mac && (e->state & NUD_VALID)) {
+        learn_mac_locked(e);
+    }
+}
+
+bool neigh_parse(struct nlmsghdr *nlh, neigh_entry *out) {
+    if (nlh->nlmsg_type != RTM_NEWNEIGH && nlh->nlmsg_type != RTM_DELNEIGH) {
+        return false;
+    }
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct ndmsg))) {
+        return false;
+    }
+
+    struct ndmsg *ndm = NLMSG_DATA(nlh);
+    struct rtattr *tb[NDA_MAX + 1];
+
+    // AF_BRIDGE shares the message types (fdb); only ARP/NDP are neighbors here
+    if (ndm->ndm_family != AF_INET && ndm->ndm_family != AF_INET6) {
+        return false;
+    }
+
+    rtnl_parse_attrs(tb, NDA_MAX, (struct rtattr *)((char *)ndm + NLMSG_ALIGN(sizeof(struct ndmsg))),
+                     (int)(nlh->nlmsg_len - NLMSG_LENGTH(sizeof(struct ndmsg))));
+
+    int len = addr_len(ndm->ndm_family);
+    if (!tb[NDA_DST] || (int)RTA_PAYLOAD(tb[NDA_DST]) < len) {
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->ifindex = ndm->ndm_ifindex;
+    out->family = ndm->ndm_family;
+    out->state = ndm->ndm_state;
+    out->flags = ndm->ndm_flags;
+    memcpy(out->addr, RTA_DATA(tb[NDA_DST]), len);
+
+    if (tb[NDA_LLADDR] && RTA_PAYLOAD(tb[NDA_LLADDR]) == 6) {
+        memcpy(out->mac, RTA_DATA(tb[NDA_LLADDR]), 6);
+        out->has_mac = true;
+    }
+
+    return true;
+}
+
+static void apply_message(struct nlmsghdr *nlh) {
+    neigh_entry e;
+
+    if (!neigh_parse(nlh, &e)) {
+        return;
+    }
+
+    // NOARP entries (multicast mappings) are created without an event: leave them out
+    pthread_mutex_lock(&neigh_lock);
+    if (nlh->nlmsg_type == RTM_DELNEIGH || (e.state & NUD_NOARP)) {
+        int slot = find_locked(e.family, e.addr, e.ifindex);
+        if (slot >= 0) {
+            remove_locked(slot);
+        }
+    } else {
+        update_locked(&e);
+    }
+    pthread_mutex_unlock(&neigh_lock);
+}
+
+static int dump_cb(struct nlmsghdr *nlh, void *ctx) {
+    (void)ctx;
+    apply_message(nlh);
+    return 0;
+}
+
+// Dump both tables; entries the dump did not report are gone
+static int resync(void) {
+    int fd = rtnl_open(0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&neigh_lock);
+    generation++;
+    pthread_mutex_unlock(&neigh_lock);
+
+    int ret = rtnl_dump(fd, RTM_GETNEIGH, AF_UNSPEC, dump_cb, NULL);
+    close(fd);
+
+    if (ret != 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&neigh_lock);
+    for (int i = 0; i < NEIGH_BUCKETS; i++) {
+        for (int slot = buckets[i]; slot >= 0; ) {
+            int next = slots[slot].next;
+            if (slots[slot].generation != generation) {
+                remove_locked(slot);
+            }
+            slot = next;
+        }
+    }
+    learning = false;
+    pthread_mutex_unlock(&neigh_lock);
+    return 0;
+}
+
+bool neigh_running(void) {
+    return running;
+}
+
+int neigh_lookup(unsigned char family, const void *addr, int ifindex, neigh_entry *out) {
+    int ret = -1;
+
+    if (family != AF_INET && family != AF_INET6) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&neigh_lock);
+    if (running) {
+        int slot = find_locked(family, addr, ifindex);
+        if (slot >= 0) {
+            *out = slots[slot].entry;
+            ret = 0;
+        }
+    }
+    pthread_mutex_unlock(&neigh_lock);
+    return ret;
+}
+
+typedef struct neigh_list_ctx {
+    int ifindex;
+    int family;
+    neigh_entry *entries;
+    int count;
+    int cap;
+} neigh_list_ctx;
+
+static bool list_match(const neigh_entry *e, int ifindex, int family) {
+    return (ifindex == 0 || e->ifindex == ifindex) && (family == AF_UNSPEC || e->family == family);
+}
+
+static int list_append(neigh_list_ctx *ctx, const neigh_entry *e) {
+    if (ctx->count >= ctx->cap) {
+        int new_cap = (ctx->cap > 0) ? (ctx->cap * 2) : 16;
+        neigh_entry *p = realloc(ctx->entries, (size_t)new_cap * sizeof(neigh_entry));
+        if (!p) {
+            return -1;
+        }
+        ctx->entries = p;
+        ctx->cap = new_cap;
+    }
+    ctx->entries[ctx->count++] = *e;
+    return 0;
+}
+
+static int list_dump_cb(struct nlmsghdr *nlh, void *arg) {
+    neigh_list_ctx *ctx = arg;
+    neigh_entry e;
+
+    if (nlh->nlmsg_type != RTM_NEWNEIGH || !neigh_parse(nlh, &e) || (e.state & NUD_NOARP)) {
+        return 0;
+    }
+    if (!list_match(&e, ctx->ifindex, ctx->family)) {
+        return 0;
+    }
+    return (list_append(ctx, &e) != 0) ? 1 : 0;
+}
+
+int neigh_list(int ifindex, int family, neigh_entry **out) {
+    neigh_list_ctx ctx = { .ifindex = ifindex, .family = family };
+
+    *out = NULL;
+
+    pthread_mutex_lock(&neigh_lock);
+    if (running) {
+        for (int i = 0; i < NEIGH_BUCKETS; i++) {
+            for (int slot = buckets[i]; slot >= 0; slot = slots[slot].next) {
+                if (list_match(&slots[slot].entry, ifindex, family) &&
+                    list_append(&ctx, &slots[slot].entry) != 0) {
+                    pthread_mutex_unlock(&neigh_lock);
+                    free(ctx.entries);
+                    return -1;
+                }
+            }
+        }
+        pthread_mutex_unlock(&neigh_lock);
+        *out = ctx.entries;
+        return ctx.count;
+    }
+    pthread_mutex_unlock(&neigh_lock);
+
+    // No monitor: read the kernel tables directly
+    int fd = rtnl_open(0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int ret = rtnl_dump(fd, RTM_GETNEIGH, (unsigned char)family, list_dump_cb, &ctx);
+    close(fd);
+
+    if (ret != 0) {
+        free(ctx.entries);
+        return -1;
+    }
+
+    *out = ctx.entries;
+    return ctx.count;
+}
+
+int neigh_new_macs(long long since, neigh_new_mac *out, int max) {
+    int count = 0;
+
+    pthread_mutex_lock(&neigh_lock);
+    for (int i = 0; i < recent_count && count < max; i++) {
+        int at = (recent_head - 1 - i + NEIGH_RECENT_MAX) % NEIGH_RECENT_MAX;
+        if (recent[at].first_seen < since) {
+            break;
+        }
+        out[count++] = recent[at];
+    }
+    pthread_mutex_unlock(&neigh_lock);
+    return count;
+}
+
+bool neigh_is_reachable(const neigh_entry *entry) {
+    return (entry->state & (NUD_REACHABLE | NUD_STALE | NUD_DELAY | NUD_PROBE | NUD_PERMANENT)) != 0;
+}
+
+const char *neigh_state_name(unsigned short state) {
+    if (state & NUD_PERMANENT) {
+        return "permanent";
+    }
+    if (state & NUD_NOARP) {
+        return "noarp";
+    }
+    if (state & NUD_REACHABLE) {
+        return "reachable";
+    }
+    if (state & NUD_STALE) {
+        return "stale";
+    }
+    if (state & NUD_DELAY) {
+        return "delay";
+    }
+    if (state & NUD_PROBE) {
+        return "probe";
+    }
+    if (state & NUD_INCOMPLETE) {
+        return "incomplete";
+    }
+    if (state & NUD_FAILED) {
+        return "failed";
+    }
+    return "none";
+}
+
+void neigh_format_mac(const unsigned char *mac, char *buf) {
+    snprintf(buf, 18, "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+void *neigh_monitor_process(void *arg) {
+    volatile bool *terminate = (volatile bool *)arg;
+
+    int fd = rtnl_open(RTMGRP_NEIGH);
+    if (fd < 0) {
+        DEBUG_LOG("[neigh_monitor_process] netlink socket failed\n");
+        return NULL;
+    }
+
+    // A burst of ARP activity (scan, many clients at once) must not overflow
+    int rcvbuf = NEIGH_RCVBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    pthread_mutex_lock(&neigh_lock);
+    reset_locked();
+    pthread_mutex_unlock(&neigh_lock);
+
+    // Events queued on fd during the dump are applied after it (newer state)
+    bool synced = (resync() == 0);
+    if (!synced) {
+        DEBUG_LOG("[neigh_monitor_process] neighbor dump failed\n");
+    }
+    running = synced;
+
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    static long buffer[8192 / sizeof(long)];
+
+    while (!*terminate) {
+
+        // Wake up once a second to see the terminate flag (and retry a failed dump)
+        if (poll(&pfd, 1, 1000) <= 0) {
+            if (!synced) {
+                synced = (resync() == 0);
+                running = synced;
+            }
+            continue;
+        }
+
+        ssize_t len = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (len < 0) {
+            // Events were dropped: nothing tells what changed
+            if (errno == ENOBUFS) {
+                synced = (resync() == 0);
+                running = synced;
+            }
+            continue;
+        }
+
+        struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+        for (; NLMSG_OK(nlh, (unsigned int)len); nlh = NLMSG_NEXT(nlh, len)) {
+            apply_message(nlh);
+        }
+    }
+
+    running = false;
+    close(fd);
+    return NULL;
+}
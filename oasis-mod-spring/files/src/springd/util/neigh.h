@@ -0,0 +1,83 @@
+#ifndef NEIGH_H
+#define NEIGH_H
+
+#include <stdbool.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+
+/*
+ * [Neighbor Cache]
+ * The IPv4 (ARP) and IPv6 (NDP) neighbor tables of the system, dumped once
+ * with RTM_GETNEIGH and then kept current by the monitor thread
+ * (neigh_monitor_process) from RTMGRP_NEIGH events. Entries are hashed by
+ * address, so "is host X reachable" is one bucket walk; every link-layer
+ * address ever seen is hashed as well, and the first appearance of a MAC
+ * after the initial dump goes to a small ring of new neighbors.
+ * When the socket overflows the tables are dumped again; entries the dump
+ * no longer has are dropped. NOARP entries (multicast mappings) are left
+ * out: the kernel creates them without any event.
+ * Without a running monitor the lookups fail (nothing keeps the cache
+ * current); get_neighbors falls back to a dump of its own.
+ */
+
+#define NEIGH_ENTRY_MAX         1024
+#define NEIGH_MAC_MAX           1024
+#define NEIGH_RECENT_MAX        64
+
+typedef struct neigh_entry {
+    int ifindex;
+    unsigned char family;               // AF_INET / AF_INET6
+    unsigned char addr[16];
+    unsigned char mac[6];
+    bool has_mac;
+    unsigned short state;               // NUD_*
+    unsigned char flags;                // NTF_*
+    long long first_seen;               // unix time (s)
+    long long updated;
+} neigh_entry;
+
+// A link-layer address seen for the first time after the initial dump
+typedef struct neigh_new_mac {
+    int ifindex;
+    unsigned char family;
+    unsigned char addr[16];             // the address it first answered for
+    unsigned char mac[6];
+    long long first_seen;
+} neigh_new_mac;
+
+// True while the monitor keeps the cache current
+bool neigh_running(void);
+
+/*
+ * Find the entry of an address (family AF_INET/AF_INET6, addr in network
+ * order) on one interface (ifindex 0: any). Returns 0 or -1 when unknown.
+ */
+int neigh_lookup(unsigned char family, const void *addr, int ifindex, neigh_entry *out);
+
+/*
+ * Copy the entries of one interface (ifindex 0: all) and family
+ * (AF_UNSPEC: both) into a malloc'ed array. Returns the count (-1 on error);
+ * the caller frees *out.
+ */
+int neigh_list(int ifindex, int family, neigh_entry **out);
+
+// Copy the new MACs first seen at or after since (unix time), newest first
+int neigh_new_macs(long long since, neigh_new_mac *out, int max);
+
+// Parse one RTM_NEWNEIGH/RTM_DELNEIGH message; false for other families
+bool neigh_parse(struct nlmsghdr *nlh, neigh_entry *out);
+
+// The entry answers (or answered recently / is static)
+bool neigh_is_reachable(const neigh_entry *entry);
+
+// Human readable NUD state ("reachable", "stale", ...)
+const char *neigh_state_name(unsigned short state);
+
+// "aa:bb:cc:dd:ee:ff" into buf[18]
+void neigh_format_mac(const unsigned char *mac, char *buf);
+
+// Event listener thread; arg points to the daemon's terminate flag (bool)
+void *neigh_monitor_process(void *arg);
+
+#endif // NEIGH_H
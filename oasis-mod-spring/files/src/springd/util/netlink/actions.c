@@ -13,6 +13,11 @@
 
 #include "./actions.h"
 #include "../errors.h"
+#include "./rtnl.h"
+#include "../neigh.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <arpa/inet.h>
 #include <lua.h>
 #include <lauxlib.h>
 
@@ -364,6 +369,131 @@ int set_subnet_mask(lua_State *L) {
     return 0;
 }
 
+/*
+ * Neighbor (ARP / NDP) entries
+ */
+
+#define NEIGH_REQUEST_SIZE      128
+#define NEIGH_BATCH_SIZE        16384
+
+static bool parse_mac(const char *text, unsigned char *mac) {
+    unsigned int b[6];
+    char tail;
+
+    if (sscanf(text, "%x%*[:-]%x%*[:-]%x%*[:-]%x%*[:-]%x%*[:-]%x%c",
+               &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &tail) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (b[i] > 0xff) {
+            return false;
+        }
+        mac[i] = (unsigned char)b[i];
+    }
+    return true;
+}
+
+// IPv4 or IPv6 address; family 0 when it is neither
+static int parse_neigh_addr(const char *text, unsigned char *addr) {
+    if (inet_pton(AF_INET, text, addr) == 1) {
+        return AF_INET;
+    }
+    if (inet_pton(AF_INET6, text, addr) == 1) {
+        return AF_INET6;
+    }
+    return 0;
+}
+
+static unsigned short parse_nud_state(const char *text) {
+    if (!text || strcmp(text, "permanent") == 0) {
+        return NUD_PERMANENT;
+    }
+    if (strcmp(text, "reachable") == 0) {
+        return NUD_REACHABLE;
+    }
+    if (strcmp(text, "stale") == 0) {
+        return NUD_STALE;
+    }
+    return 0;
+}
+
+/*
+ * Build one RTM_NEWNEIGH/RTM_DELNEIGH request at nlh (maxlen bytes free).
+ * mac is NULL for a delete. Returns the aligned length, 0 when it does not fit.
+ */
+static size_t build_neigh_request(struct nlmsghdr *nlh, size_t maxlen, int type, int ifindex, int family,
+                                  const unsigned char *addr, const unsigned char *mac, unsigned short state) {
+    if (maxlen < NLMSG_LENGTH(sizeof(struct ndmsg))) {
+        return 0;
+    }
+
+    memset(nlh, 0, NLMSG_LENGTH(sizeof(struct ndmsg)));
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct ndmsg));
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = NLM_F_REQUEST;
+    if (type == RTM_NEWNEIGH) {
+        nlh->nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+    }
+
+    struct ndmsg *ndm = NLMSG_DATA(nlh);
+    ndm->ndm_family = family;
+    ndm->ndm_ifindex = ifindex;
+    ndm->ndm_state = state;
+
+    if (rtnl_add_attr(nlh, maxlen, NDA_DST, addr, (family == AF_INET) ? 4 : 16) != 0) {
+        return 0;
+    }
+    if (mac && rtnl_add_attr(nlh, maxlen, NDA_LLADDR, mac, 6) != 0) {
+        return 0;
+    }
+
+    return NLMSG_ALIGN(nlh->nlmsg_len);
+}
+
+// Send one request and wait for the kernel's answer; 0 or an errno
+static int neigh_transact_one(struct nlmsghdr *nlh) {
+    int fd = rtnl_open(0);
+    if (fd < 0) {
+        return errno ? errno : EIO;
+    }
+
+    int error = 0;
+    int accepted = rtnl_transact(fd, nlh, nlh->nlmsg_len, 1, &error);
+    close(fd);
+
+    if (accepted < 0) {
+        return errno ? errno : EIO;
+    }
+    return (accepted == 1) ? 0 : error;
+}
+
+static int set_neighbor(lua_State *L, const char *ifname, const char *ip_addr, const char *mac_addr, unsigned short state) {
+    unsigned char addr[16];
+    unsigned char mac[6];
+
+    int ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) {
+        return luaL_error(L, "Unknown interface: %s", ifname);
+    }
+    int family = parse_neigh_addr(ip_addr, addr);
+    if (family == 0) {
+        return luaL_error(L, "Invalid IP address: %s", ip_addr);
+    }
+    if (!parse_mac(mac_addr, mac)) {
+        return luaL_error(L, "Invalid MAC address: %s", mac_addr);
+    }
+
+    long buffer[NEIGH_REQUEST_SIZE / sizeof(long)];
+    struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+    build_neigh_request(nlh, sizeof(buffer), RTM_NEWNEIGH, ifindex, family, addr, mac, state);
+
+    int error = neigh_transact_one(nlh);
+    if (error != 0) {
+        return luaL_error(L, "Failed to add neighbor %s: %s", ip_addr, strerror(error));
+    }
+    return 0;
+}
+
 /*
  * Add a static ARP entry to a network interface.
  *
@@ -375,32 +505,235 @@ int add_arp_entry(lua_State *L) {
     const char *ip_addr = luaL_checkstring(L, 2);
     const char *mac_addr = luaL_checkstring(L, 3);
 
-    int sock_fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
-    if (sock_fd < 0) {
-        return luaL_error(L, "Socket creation failed");
-    }
+    return set_neighbor(L, ifname, ip_addr, mac_addr, NUD_PERMANENT);
+}
 
-    struct {
-        struct nlmsghdr nlh;
-        struct ndmsg ndm;
-        char buffer[256];
-    } request;
+/*
+ * Add or replace an IPv4 (ARP) or IPv6 (NDP) neighbor entry.
+ * state: "permanent" (default), "reachable" or "stale"
+ *
+ * usage:
+ * add_neighbor("br-lan", "192.168.1.10", "aa:bb:cc:dd:ee:ff");
+ * add_neighbor("br-lan", "fd00::10", "aa:bb:cc:dd:ee:ff", "reachable");
+ */
+int add_neighbor(lua_State *L) {
+    const char *ifname = luaL_checkstring(L, 1);
+    const char *ip_addr = luaL_checkstring(L, 2);
+    const char *mac_addr = luaL_checkstring(L, 3);
+    const char *state_name = luaL_optstring(L, 4, NULL);
 
-    memset(&request, 0, sizeof(request));
-    request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ndmsg) + strlen(ip_addr) + strlen(mac_addr) + 2);
-    request.nlh.nlmsg_type = RTM_NEWNEIGH;
-    request.nlh.nlmsg_flags = NLM_F_REQUEST;
-    request.ndm.ndm_family = AF_INET;
-    request.ndm.ndm_ifindex = if_nametoindex(ifname);
-    request.ndm.ndm_state = NUD_PERMANENT;
+    unsigned short state = parse_nud_state(state_name);
+    if (state == 0) {
+        return luaL_error(L, "Invalid neighbor state: %s", state_name);
+    }
 
-    snprintf(request.buffer, sizeof(request.buffer), "%s %s", ip_addr, mac_addr);
+    return set_neighbor(L, ifname, ip_addr, mac_addr, state);
+}
 
-    if (send(sock_fd, &request, request.nlh.nlmsg_len, 0) < 0) {
-        close(sock_fd);
-        return luaL_error(L, "Failed to send netlink message");
+/*
+ * Delete an IPv4 or IPv6 neighbor entry.
+ *
+ * usage:
+ * delete_neighbor("br-lan", "192.168.1.10");
+ */
+int delete_neighbor(lua_State *L) {
+    const char *ifname = luaL_checkstring(L, 1);
+    const char *ip_addr = luaL_checkstring(L, 2);
+    unsigned char addr[16];
+
+    int ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) {
+        return luaL_error(L, "Unknown interface: %s", ifname);
+    }
+    int family = parse_neigh_addr(ip_addr, addr);
+    if (family == 0) {
+        return luaL_error(L, "Invalid IP address: %s", ip_addr);
     }
 
-    close(sock_fd);
+    long buffer[NEIGH_REQUEST_SIZE / sizeof(long)];
+    struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+    build_neigh_request(nlh, sizeof(buffer), RTM_DELNEIGH, ifindex, family, addr, NULL, 0);
+
+    int error = neigh_transact_one(nlh);
+    if (error != 0) {
+        return luaL_error(L, "Failed to delete neighbor %s: %s", ip_addr, strerror(error));
+    }
     return 0;
 }
+
+// Requests packed into one buffer, sent with one send() when full
+typedef struct neigh_batch {
+    int fd;
+    long buffer[NEIGH_BATCH_SIZE / sizeof(long)];
+    size_t len;
+    int count;
+    int accepted;
+    int failed;
+    int error;                          // first errno
+} neigh_batch;
+
+static void batch_flush(neigh_batch *batch) {
+    if (batch->count == 0) {
+        return;
+    }
+
+    int error = 0;
+    int accepted = rtnl_transact(batch->fd, batch->buffer, batch->len, batch->count, &error);
+    if (accepted < 0) {
+        accepted = 0;
+        error = errno ? errno : EIO;
+    }
+
+    batch->accepted += accepted;
+    batch->failed += batch->count - accepted;
+    if (batch->error == 0) {
+        batch->error = error;
+    }
+    batch->len = 0;
+    batch->count = 0;
+}
+
+static void batch_add(neigh_batch *batch, int type, int ifindex, int family,
+                      const unsigned char *addr, const unsigned char *mac, unsigned short state) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        struct nlmsghdr *nlh = (struct nlmsghdr *)((char *)batch->buffer + batch->len);
+        size_t len = build_neigh_request(nlh, sizeof(batch->buffer) - batch->len, type, ifindex, family, addr, mac, state);
+        if (len > 0) {
+            batch->len += len;
+            batch->count++;
+            return;
+        }
+        batch_flush(batch);
+    }
+}
+
+// luaL_error does not return
+static neigh_batch *batch_open(lua_State *L) {
+    neigh_batch *batch = calloc(1, sizeof(neigh_batch));
+    if (!batch) {
+        luaL_error(L, "Out of memory");
+    }
+
+    batch->fd = rtnl_open(0);
+    if (batch->fd < 0) {
+        free(batch);
+        luaL_error(L, "Socket creation failed");
+    }
+    return batch;
+}
+
+// Push accepted, failed, first error (nil when none) and release the batch
+static int batch_close(lua_State *L, neigh_batch *batch) {
+    batch_flush(batch);
+    close(batch->fd);
+
+    lua_pushinteger(L, batch->accepted);
+    lua_pushinteger(L, batch->failed);
+    if (batch->error != 0) {
+        lua_pushstring(L, strerror(batch->error));
+    } else {
+        lua_pushnil(L);
+    }
+
+    free(batch);
+    return 3;
+}
+
+/*
+ * Add or replace many neighbor entries with one netlink round trip per
+ * batch of requests. Entries with an invalid address or MAC count as failed.
+ *
+ * usage:
+ * local added, failed, err = add_neighbors("br-lan", {
+ *     ["192.168.1.10"] = "aa:bb:cc:dd:ee:01",
+ *     ["fd00::10"]     = "aa:bb:cc:dd:ee:01",
+ * }, "permanent")
+ */
+int add_neighbors(lua_State *L) {
+    const char *ifname = luaL_checkstring(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    const char *state_name = luaL_optstring(L, 3, NULL);
+
+    int ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) {
+        return luaL_error(L, "Unknown interface: %s", ifname);
+    }
+    unsigned short state = parse_nud_state(state_name);
+    if (state == 0) {
+        return luaL_error(L, "Invalid neighbor state: %s", state_name);
+    }
+
+    neigh_batch *batch = batch_open(L);
+    int invalid = 0;
+
+    lua_pushnil(L);
+    while (lua_next(L, 2) != 0) {
+        unsigned char addr[16];
+        unsigned char mac[6];
+        int family = 0;
+
+        if (lua_type(L, -2) == LUA_TSTRING && lua_type(L, -1) == LUA_TSTRING) {
+            family = parse_neigh_addr(lua_tostring(L, -2), addr);
+        }
+        if (family != 0 && parse_mac(lua_tostring(L, -1), mac)) {
+            batch_add(batch, RTM_NEWNEIGH, ifindex, family, addr, mac, state);
+        } else {
+            invalid++;
+        }
+        lua_pop(L, 1);
+    }
+
+    batch->failed += invalid;
+    if (invalid > 0 && batch->error == 0) {
+        batch->error = EINVAL;
+    }
+    return batch_close(L, batch);
+}
+
+/*
+ * Delete the dynamic neighbor entries of an interface, like
+ * "ip neigh flush dev <ifname>" (permanent entries stay).
+ * family: "inet", "inet6" or nil for both
+ *
+ * usage:
+ * local deleted, failed, err = flush_neighbors("br-lan")
+ * flush_neighbors("br-lan", "inet6")
+ */
+int flush_neighbors(lua_State *L) {
+    const char *ifname = luaL_checkstring(L, 1);
+    const char *family_name = luaL_optstring(L, 2, NULL);
+
+    int ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) {
+        return luaL_error(L, "Unknown interface: %s", ifname);
+    }
+
+    int family = AF_UNSPEC;
+    if (family_name && strcmp(family_name, "inet") == 0) {
+        family = AF_INET;
+    } else if (family_name && strcmp(family_name, "inet6") == 0) {
+        family = AF_INET6;
+    } else if (family_name) {
+        return luaL_error(L, "Invalid family: %s", family_name);
+    }
+
+    neigh_batch *batch = batch_open(L);
+
+    neigh_entry *entries = NULL;
+    int count = neigh_list(ifindex, family, &entries);
+    if (count < 0) {
+        close(batch->fd);
+        free(batch);
+        return luaL_error(L, "Failed to read the neighbor table");
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (entries[i].state & NUD_PERMANENT) {
+            continue;
+        }
+        batch_add(batch, RTM_DELNEIGH, ifindex, entries[i].family, entries[i].addr, NULL, 0);
+    }
+
+    free(entries);
+    return batch_close(L, batch);
+}
@@ -41,5 +41,9 @@ int set_link_state(lua_State *);
 int set_broadcast_address(lua_State *);
 int set_subnet_mask(lua_State *);
 int add_arp_entry(lua_State *);
+int add_neighbor(lua_State *);
+int delete_neighbor(lua_State *);
+int add_neighbors(lua_State *);
+int flush_neighbors(lua_State *);
 
 #endif // NETLINK_ACTIONS_H
@@ -13,11 +13,20 @@
 
 #include "events.h"
 #include "../errors.h"
+#include "../ifcache.h"
+#include "../sampler.h"
+#include "../conntrack.h"
+#include "../neigh.h"
+#include "rtnl.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <lua.h>
 #include <lauxlib.h>
 #include <net/if.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <linux/neighbour.h>
 
 
 #ifndef IFNAMSIZ
@@ -112,4 +121,678 @@ int netlink_list_if(lua_State *L) {
 
     close(sock_fd);
     return item;
-}
\ No newline at end of file
+}
+
+static int family_from_name(const char *name) {
+    if (!name || strcmp(name, "all") == 0) {
+        return AF_UNSPEC;
+    }
+    if (strcmp(name, "inet") == 0 || strcmp(name, "ipv4") == 0) {
+        return AF_INET;
+    }
+    if (strcmp(name, "inet6") == 0 || strcmp(name, "ipv6") == 0) {
+        return AF_INET6;
+    }
+    return -1;
+}
+
+/*
+ * usage: local addrs = get_if_addrs([ifname], ["inet"|"inet6"])
+ *        local addrs = get_if_addrs({ ifname, family })   (phase detector)
+ * Every address of one interface (all interfaces when ifname is nil/""),
+ * served from the interface cache:
+ * { { ifname, ifindex, family, address, prefixlen, scope, flags,
+ *     valid_lft, preferred_lft }, ... }   (lifetimes: -1 = forever)
+ */
+int get_if_addrs(lua_State *L) {
+    // Phase detectors pass their args as one table: { ifname, family }
+    if (lua_istable(L, 1)) {
+        lua_rawgeti(L, 1, 1);
+        lua_rawgeti(L, 1, 2);
+        lua_remove(L, 1);
+    }
+
+    const char *ifname = luaL_optstring(L, 1, "");
+    int family = family_from_name(luaL_optstring(L, 2, NULL));
+    int ifindex = 0;
+
+    if (family < 0) {
+        return luaL_error(L, "Unknown address family");
+    }
+
+    if (ifname[0] != '\0') {
+        ifindex = ifcache_get_index(ifname);
+        if (ifindex == 0) {
+            lua_newtable(L);
+            return 1;
+        }
+    }
+
+    ifcache_addr *addrs;
+    int count = ifcache_get_addrs(ifindex, family, &addrs);
+    if (count < 0) {
+        return luaL_error(L, "Failed to dump interface addresses");
+    }
+
+    lua_createtable(L, count, 0);
+
+    char name[IFNAMSIZ];
+    int name_index = 0;
+
+    for (int i = 0; i < count; i++) {
+        // Addresses of one interface come in a row: look the name up once
+        if (addrs[i].ifindex != name_index) {
+            if (!ifcache_get_name(addrs[i].ifindex, name)) {
+                snprintf(name, sizeof(name), "if%d", addrs[i].ifindex);
+            }
+            name_index = addrs[i].ifindex;
+        }
+
+        lua_createtable(L, 0, 9);
+        lua_pushstring(L, name);
+        lua_setfield(L, -2, "ifname");
+        lua_pushinteger(L, addrs[i].ifindex);
+        lua_setfield(L, -2, "ifindex");
+        lua_pushstring(L, (addrs[i].family == AF_INET6) ? "inet6" : "inet");
+        lua_setfield(L, -2, "family");
+        lua_pushstring(L, addrs[i].address);
+        lua_setfield(L, -2, "address");
+        lua_pushinteger(L, addrs[i].prefixlen);
+        lua_setfield(L, -2, "prefixlen");
+        lua_pushstring(L, ifcache_scope_name(addrs[i].scope));
+        lua_setfield(L, -2, "scope");
+        lua_pushinteger(L, addrs[i].flags);
+        lua_setfield(L, -2, "flags");
+        lua_pushnumber(L, (lua_Number)addrs[i].valid_lft);
+        lua_setfield(L, -2, "valid_lft");
+        lua_pushnumber(L, (lua_Number)addrs[i].preferred_lft);
+        lua_setfield(L, -2, "preferred_lft");
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    free(addrs);
+    return 1;
+}
+
+#define LINK_ADDR_MAX 32
+
+// glibc's net/if.h stops at IFF_DYNAMIC
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP 0x10000
+#endif
+
+typedef struct link_info {
+    int index;
+    char ifname[IFNAMSIZ];
+    unsigned int flags;             // IFF_*
+    unsigned char operstate;        // IF_OPER_*
+    int carrier;
+    unsigned int mtu;
+    int master;                     // ifindex, 0 = none
+    char mac[LINK_ADDR_MAX * 3];
+    bool has_stats;
+    struct rtnl_link_stats64 stats;
+} link_info;
+
+typedef struct link_list {
+    link_info *items;
+    int count;
+    int cap;
+} link_list;
+
+static int link_info_cb(struct nlmsghdr *nlh, void *ctx) {
+    link_list *list = ctx;
+
+    if (nlh->nlmsg_type != RTM_NEWLINK) {
+        return 0;
+    }
+
+    struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+    struct rtattr *tb[IFLA_MAX + 1];
+    rtnl_parse_attrs(tb, IFLA_MAX, IFLA_RTA(ifi), IFLA_PAYLOAD(nlh));
+
+    if (!tb[IFLA_IFNAME]) {
+        return 0;
+    }
+
+    if (list->count >= list->cap) {
+        int cap = (list->cap > 0) ? (list->cap * 2) : 32;
+        link_info *p = realloc(list->items, (size_t)cap * sizeof(link_info));
+        if (!p) {
+            return 1;
+        }
+        list->items = p;
+        list->cap = cap;
+    }
+
+    link_info *link = &list->items[list->count++];
+    memset(link, 0, sizeof(*link));
+
+    link->index = ifi->ifi_index;
+    link->flags = ifi->ifi_flags;
+    snprintf(link->ifname, sizeof(link->ifname), "%.*s",
+             (int)RTA_PAYLOAD(tb[IFLA_IFNAME]), (const char *)RTA_DATA(tb[IFLA_IFNAME]));
+
+    link->operstate = tb[IFLA_OPERSTATE] ? *(unsigned char *)RTA_DATA(tb[IFLA_OPERSTATE]) : 0;
+    link->carrier = tb[IFLA_CARRIER] ? *(unsigned char *)RTA_DATA(tb[IFLA_CARRIER])
+                                     : ((ifi->ifi_flags & IFF_LOWER_UP) != 0);
+    link->mtu = tb[IFLA_MTU] ? *(unsigned int *)RTA_DATA(tb[IFLA_MTU]) : 0;
+    link->master = tb[IFLA_MASTER] ? *(int *)RTA_DATA(tb[IFLA_MASTER]) : 0;
+
+    if (tb[IFLA_ADDRESS]) {
+        const unsigned char *hw = RTA_DATA(tb[IFLA_ADDRESS]);
+        int hw_len = RTA_PAYLOAD(tb[IFLA_ADDRESS]);
+        char *p = link->mac;
+        if (hw_len > LINK_ADDR_MAX) {
+            hw_len = LINK_ADDR_MAX;
+        }
+        for (int i = 0; i < hw_len; i++) {
+            p += sprintf(p, (i == 0) ? "%02x" : ":%02x", hw[i]);
+        }
+    }
+
+    if (tb[IFLA_STATS64] && RTA_PAYLOAD(tb[IFLA_STATS64]) >= sizeof(struct rtnl_link_stats64)) {
+        // The attribute is only 4-byte aligned: copy instead of casting
+        memcpy(&link->stats, RTA_DATA(tb[IFLA_STATS64]), sizeof(link->stats));
+        link->has_stats = true;
+    }
+
+    return 0;
+}
+
+// RFC 2863 operational states, indexed by IF_OPER_* (linux/if.h)
+static const char *operstate_names[] = {
+    "unknown", "notpresent", "down", "lowerlayerdown", "testing", "dormant", "up"
+};
+
+static const char *operstate_name(unsigned char operstate) {
+    if (operstate >= sizeof(operstate_names) / sizeof(operstate_names[0])) {
+        return "unknown";
+    }
+    return operstate_names[operstate];
+}
+
+static void push_counter(lua_State *L, const char *key, unsigned long long value) {
+    lua_pushnumber(L, (lua_Number)value);
+    lua_setfield(L, -2, key);
+}
+
+static void push_link_stats(lua_State *L, const struct rtnl_link_stats64 *st) {
+    lua_createtable(L, 0, 12);
+    push_counter(L, "rx_bytes", st->rx_bytes);
+    push_counter(L, "tx_bytes", st->tx_bytes);
+    push_counter(L, "rx_packets", st->rx_packets);
+    push_counter(L, "tx_packets", st->tx_packets);
+    push_counter(L, "rx_errors", st->rx_errors);
+    push_counter(L, "tx_errors", st->tx_errors);
+    push_counter(L, "rx_dropped", st->rx_dropped);
+    push_counter(L, "tx_dropped", st->tx_dropped);
+    push_counter(L, "multicast", st->multicast);
+    push_counter(L, "collisions", st->collisions);
+    push_counter(L, "rx_crc_errors", st->rx_crc_errors);
+    push_counter(L, "tx_carrier_errors", st->tx_carrier_errors);
+}
+
+static void push_link_addrs(lua_State *L, const ifcache_addr *addrs, int count, int ifindex) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (addrs[i].ifindex == ifindex) {
+            n++;
+        }
+    }
+
+    lua_createtable(L, n, 0);
+
+    n = 0;
+    for (int i = 0; i < count; i++) {
+        if (addrs[i].ifindex != ifindex) {
+            continue;
+        }
+        lua_createtable(L, 0, 4);
+        lua_pushstring(L, (addrs[i].family == AF_INET6) ? "inet6" : "inet");
+        lua_setfield(L, -2, "family");
+        lua_pushstring(L, addrs[i].address);
+        lua_setfield(L, -2, "address");
+        lua_pushinteger(L, addrs[i].prefixlen);
+        lua_setfield(L, -2, "prefixlen");
+        lua_pushstring(L, ifcache_scope_name(addrs[i].scope));
+        lua_setfield(L, -2, "scope");
+        lua_rawseti(L, -2, ++n);
+    }
+}
+
+/*
+ * usage: local ifs = get_all_interfaces()
+ * Snapshot of every link from one RTM_GETLINK dump (addresses from the
+ * interface cache), keyed by interface name:
+ * { ["br-lan"] = { ifname, index, flags, up, operstate, carrier, mtu, mac,
+ *                  master, stats = { rx_bytes, ... }, addrs = { ... } }, ... }
+ * Counters are IFLA_STATS64 (64-bit, no 4 GiB wrap).
+ */
+int get_all_interfaces(lua_State *L) {
+    link_list list = { NULL, 0, 0 };
+
+    int fd = rtnl_open(0);
+    if (fd < 0) {
+        return luaL_error(L, "Socket creation failed");
+    }
+
+    // Counters change all the time: the links are always dumped fresh
+    int ret = rtnl_dump(fd, RTM_GETLINK, AF_UNSPEC, link_info_cb, &list);
+    close(fd);
+
+    if (ret != 0) {
+        free(list.items);
+        return luaL_error(L, "Failed to dump links");
+    }
+
+    ifcache_addr *addrs;
+    int addr_count = ifcache_get_addrs(0, AF_UNSPEC, &addrs);
+    if (addr_count < 0) {
+        addr_count = 0;
+    }
+
+    lua_createtable(L, 0, list.count);
+
+    for (int i = 0; i < list.count; i++) {
+        const link_info *link = &list.items[i];
+
+        lua_createtable(L, 0, 11);
+        lua_pushstring(L, link->ifname);
+        lua_setfield(L, -2, "ifname");
+        lua_pushinteger(L, link->index);
+        lua_setfield(L, -2, "index");
+        lua_pushinteger(L, link->flags);
+        lua_setfield(L, -2, "flags");
+        lua_pushboolean(L, (link->flags & IFF_UP) != 0);
+        lua_setfield(L, -2, "up");
+        lua_pushstring(L, operstate_name(link->operstate));
+        lua_setfield(L, -2, "operstate");
+        lua_pushboolean(L, link->carrier);
+        lua_setfield(L, -2, "carrier");
+        lua_pushinteger(L, link->mtu);
+        lua_setfield(L, -2, "mtu");
+        lua_pushstring(L, link->mac);
+        lua_setfield(L, -2, "mac");
+
+        // Masters (bridge, bond) may come later in the dump: resolve at the end
+        for (int j = 0; link->master && j < list.count; j++) {
+            if (list.items[j].index == link->master) {
+                lua_pushstring(L, list.items[j].ifname);
+                lua_setfield(L, -2, "master");
+                break;
+            }
+        }
+
+        if (link->has_stats) {
+            push_link_stats(L, &link->stats);
+            lua_setfield(L, -2, "stats");
+        }
+
+        push_link_addrs(L, addrs, addr_count, link->index);
+        lua_setfield(L, -2, "addrs");
+
+        lua_setfield(L, -2, link->ifname);
+    }
+
+    free(addrs);
+    free(list.items);
+    return 1;
+}
+
+// Interface name of a detector call: get_x(ifname) or get_x({ ifname })
+static const char *check_ifname_arg(lua_State *L) {
+    if (lua_istable(L, 1)) {
+        lua_rawgeti(L, 1, 1);
+        lua_replace(L, 1);
+    }
+    return luaL_checkstring(L, 1);
+}
+
+static void push_rate_fields(lua_State *L, const char *prefix, const sampler_rate *rate) {
+    char key[32];
+
+    snprintf(key, sizeof(key), "%s", prefix[0] ? prefix : "rate");
+    lua_pushnumber(L, rate->current);
+    lua_setfield(L, -2, key);
+
+    static const char *names[] = { "ewma", "min", "max", "p50", "p95" };
+    const double values[] = { rate->ewma, rate->min, rate->max, rate->p50, rate->p95 };
+
+    for (int i = 0; i < 5; i++) {
+        snprintf(key, sizeof(key), "%s%s%s", prefix, prefix[0] ? "_" : "", names[i]);
+        lua_pushnumber(L, values[i]);
+        lua_setfield(L, -2, key);
+    }
+}
+
+/*
+ * usage: local r = get_if_rate("br-lan")
+ * Throughput of a sampled interface in bytes/s (nil until the sampler has
+ * two readings; an unknown interface is sampled from then on):
+ * { rx, rx_ewma, rx_min, rx_max, rx_p50, rx_p95, tx, tx_ewma, ...,
+ *   samples, window }   (min/max/percentiles over the last window seconds)
+ */
+int get_if_rate(lua_State *L) {
+    const char *ifname = check_ifname_arg(L);
+    sampler_rate rx, tx;
+
+    if (sampler_get_rate(ifname, SAMPLER_RX, &rx) != 0 ||
+        sampler_get_rate(ifname, SAMPLER_TX, &tx) != 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    lua_createtable(L, 0, 14);
+    push_rate_fields(L, "rx", &rx);
+    push_rate_fields(L, "tx", &tx);
+    lua_pushinteger(L, rx.samples);
+    lua_setfield(L, -2, "samples");
+    lua_pushnumber(L, rx.window);
+    lua_setfield(L, -2, "window");
+    return 1;
+}
+
+/*
+ * usage: local r = get_if_error_rate("br-lan")
+ * Errors + drops per second of a sampled interface (nil until sampled):
+ * { rate, ewma, min, max, p50, p95, samples, window }
+ */
+int get_if_error_rate(lua_State *L) {
+    const char *ifname = check_ifname_arg(L);
+    sampler_rate err;
+
+    if (sampler_get_rate(ifname, SAMPLER_ERR, &err) != 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    lua_createtable(L, 0, 8);
+    push_rate_fields(L, "", &err);
+    lua_pushinteger(L, err.samples);
+    lua_setfield(L, -2, "samples");
+    lua_pushnumber(L, err.window);
+    lua_setfield(L, -2, "window");
+    return 1;
+}
+
+static void push_flow_fields(lua_State *L, const conntrack_stats *st) {
+    lua_pushnumber(L, (lua_Number)st->flows);
+    lua_setfield(L, -2, "flows");
+    lua_pushnumber(L, st->new_rate);
+    lua_setfield(L, -2, "new_rate");
+    lua_pushnumber(L, (lua_Number)st->new_total);
+    lua_setfield(L, -2, "new_total");
+    lua_pushnumber(L, (lua_Number)st->destroy_total);
+    lua_setfield(L, -2, "destroy_total");
+}
+
+/*
+ * usage: local f = get_flow_stats("eth0.2")
+ *        local all = get_flow_stats()
+ * Conntrack flows counted by springd (nil while spring.conntrack is off):
+ * one interface: { flows, new_rate, new_total, destroy_total }
+ * no interface:  the same for all flows, plus
+ *                interfaces = { [ifname] = {...}, ["*"] = flows of no local subnet }
+ *                zones = { [conntrack zone] = {...} }
+ */
+int get_flow_stats(lua_State *L) {
+    if (lua_istable(L, 1)) {
+        lua_rawgeti(L, 1, 1);
+        lua_replace(L, 1);
+    }
+
+    if (!conntrack_running()) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    conntrack_stats st;
+
+    if (!lua_isnoneornil(L, 1)) {
+        int ifindex = ifcache_get_index(luaL_checkstring(L, 1));
+        if (ifindex == 0) {
+            lua_pushnil(L);
+            return 1;
+        }
+        // Known interface without any flow so far: zeros
+        if (conntrack_get_if(ifindex, &st) != 0) {
+            memset(&st, 0, sizeof(st));
+        }
+        lua_createtable(L, 0, 4);
+        push_flow_fields(L, &st);
+        return 1;
+    }
+
+    int max = (CONNTRACK_IF_MAX > CONNTRACK_ZONE_MAX) ? CONNTRACK_IF_MAX : CONNTRACK_ZONE_MAX;
+    int keys[max];
+    conntrack_stats list[max];
+
+    conntrack_get_total(&st);
+    lua_createtable(L, 0, 6);
+    push_flow_fields(L, &st);
+
+    int count = conntrack_list_ifs(keys, list, CONNTRACK_IF_MAX);
+    lua_createtable(L, 0, count);
+    for (int i = 0; i < count; i++) {
+        char ifname[IFNAMSIZ];
+        if (keys[i] == 0) {
+            snprintf(ifname, sizeof(ifname), "*");
+        } else if (!ifcache_get_name(keys[i], ifname)) {
+            continue;
+        }
+        lua_createtable(L, 0, 4);
+        push_flow_fields(L, &list[i]);
+        lua_setfield(L, -2, ifname);
+    }
+    lua_setfield(L, -2, "interfaces");
+
+    count = conntrack_list_zones(keys, list, CONNTRACK_ZONE_MAX);
+    lua_createtable(L, count, 0);
+    for (int i = 0; i < count; i++) {
+        lua_createtable(L, 0, 4);
+        push_flow_fields(L, &list[i]);
+        lua_rawseti(L, -2, keys[i]);
+    }
+    lua_setfield(L, -2, "zones");
+
+    return 1;
+}
+
+static void push_neigh_fields(lua_State *L, const neigh_entry *e) {
+    char ifname[IFNAMSIZ];
+    char address[INET6_ADDRSTRLEN];
+    char mac[18];
+
+    if (!ifcache_get_name(e->ifindex, ifname)) {
+        snprintf(ifname, sizeof(ifname), "if%d", e->ifindex);
+    }
+    inet_ntop(e->family, e->addr, address, sizeof(address));
+
+    lua_pushstring(L, address);
+    lua_setfield(L, -2, "address");
+    lua_pushstring(L, (e->family == AF_INET6) ? "inet6" : "inet");
+    lua_setfield(L, -2, "family");
+    lua_pushstring(L, ifname);
+    lua_setfield(L, -2, "ifname");
+    if (e->has_mac) {
+        neigh_format_mac(e->mac, mac);
+        lua_pushstring(L, mac);
+        lua_setfield(L, -2, "mac");
+    }
+    lua_pushstring(L, neigh_state_name(e->state));
+    lua_setfield(L, -2, "state");
+    lua_pushboolean(L, neigh_is_reachable(e));
+    lua_setfield(L, -2, "reachable");
+    lua_pushboolean(L, (e->flags & NTF_ROUTER) != 0);
+    lua_setfield(L, -2, "router");
+}
+
+/*
+ * usage: local n = get_neighbor("192.168.1.10", ["br-lan"])
+ *        local n = get_neighbor({ address, ifname })   (phase detector)
+ * One neighbor from the cache, found by hash (nil when unknown or while the
+ * neighbor monitor is not running):
+ * { address, family, ifname, mac, state, reachable, router, first_seen, updated }
+ */
+int get_neighbor(lua_State *L) {
+    if (lua_istable(L, 1)) {
+        lua_rawgeti(L, 1, 1);
+        lua_rawgeti(L, 1, 2);
+        lua_remove(L, 1);
+    }
+
+    const char *address = luaL_checkstring(L, 1);
+    const char *ifname = luaL_optstring(L, 2, "");
+    unsigned char addr[16];
+    unsigned char family = AF_INET;
+    int ifindex = 0;
+
+    if (inet_pton(AF_INET, address, addr) != 1) {
+        family = AF_INET6;
+        if (inet_pton(AF_INET6, address, addr) != 1) {
+            return luaL_error(L, "Invalid IP address: %s", address);
+        }
+    }
+
+    if (ifname[0] != '\0') {
+        ifindex = ifcache_get_index(ifname);
+        if (ifindex == 0) {
+            lua_pushnil(L);
+            return 1;
+        }
+    }
+
+    neigh_entry e;
+    if (neigh_lookup(family, addr, ifindex, &e) != 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    lua_createtable(L, 0, 9);
+    push_neigh_fields(L, &e);
+    lua_pushnumber(L, (lua_Number)e.first_seen);
+    lua_setfield(L, -2, "first_seen");
+    lua_pushnumber(L, (lua_Number)e.updated);
+    lua_setfield(L, -2, "updated");
+    return 1;
+}
+
+/*
+ * usage: local list = get_neighbors([ifname], ["inet"|"inet6"])
+ *        local list = get_neighbors({ ifname, family })   (phase detector)
+ * The ARP/NDP entries of one interface (all when ifname is nil/""):
+ * { { address, family, ifname, mac, state, reachable, router }, ... }
+ */
+int get_neighbors(lua_State *L) {
+    if (lua_istable(L, 1)) {
+        lua_rawgeti(L, 1, 1);
+        lua_rawgeti(L, 1, 2);
+        lua_remove(L, 1);
+    }
+
+    const char *ifname = luaL_optstring(L, 1, "");
+    int family = family_from_name(luaL_optstring(L, 2, NULL));
+    int ifindex = 0;
+
+    if (family < 0) {
+        return luaL_error(L, "Unknown address family");
+    }
+
+    if (ifname[0] != '\0') {
+        ifindex = ifcache_get_index(ifname);
+        if (ifindex == 0) {
+            lua_newtable(L);
+            return 1;
+        }
+    }
+
+    neigh_entry *entries;
+    int count = neigh_list(ifindex, family, &entries);
+    if (count < 0) {
+        return luaL_error(L, "Failed to dump the neighbor table");
+    }
+
+    lua_createtable(L, count, 0);
+    for (int i = 0; i < count; i++) {
+        lua_createtable(L, 0, 7);
+        push_neigh_fields(L, &entries[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    free(entries);
+    return 1;
+}
+
+/*
+ * usage: local n = get_new_neighbors([seconds], [ifname])
+ *        local n = get_new_neighbors({ seconds, ifname })   (phase detector)
+ * MAC addresses that appeared on the LAN for the first time since springd
+ * started, within the last seconds (default 60), newest first
+ * (nil while the neighbor monitor is not running):
+ * { count, macs = { mac, ... }, neighbors = { { mac, address, ifname, first_seen }, ... } }
+ */
+int get_new_neighbors(lua_State *L) {
+    if (lua_istable(L, 1)) {
+        lua_rawgeti(L, 1, 1);
+        lua_rawgeti(L, 1, 2);
+        lua_remove(L, 1);
+    }
+
+    long long seconds = (long long)luaL_optnumber(L, 1, 60);
+    const char *ifname = luaL_optstring(L, 2, "");
+    int ifindex = 0;
+
+    if (!neigh_running()) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    if (ifname[0] != '\0') {
+        ifindex = ifcache_get_index(ifname);
+    }
+
+    neigh_new_mac list[NEIGH_RECENT_MAX];
+    int count = neigh_new_macs((long long)time(NULL) - seconds, list, NEIGH_RECENT_MAX);
+    int n = 0;
+
+    lua_createtable(L, 0, 3);
+    lua_newtable(L);            // macs
+    lua_newtable(L);            // neighbors
+
+    for (int i = 0; i < count; i++) {
+        if (ifname[0] != '\0' && list[i].ifindex != ifindex) {
+            continue;
+        }
+
+        char mac[18];
+        char address[INET6_ADDRSTRLEN];
+        char name[IFNAMSIZ];
+        neigh_format_mac(list[i].mac, mac);
+        inet_ntop(list[i].family, list[i].addr, address, sizeof(address));
+        if (!ifcache_get_name(list[i].ifindex, name)) {
+            snprintf(name, sizeof(name), "if%d", list[i].ifindex);
+        }
+
+        n++;
+        lua_pushstring(L, mac);
+        lua_rawseti(L, -3, n);
+
+        lua_createtable(L, 0, 4);
+        lua_pushstring(L, mac);
+        lua_setfield(L, -2, "mac");
+        lua_pushstring(L, address);
+        lua_setfield(L, -2, "address");
+        lua_pushstring(L, name);
+        lua_setfield(L, -2, "ifname");
+        lua_pushnumber(L, (lua_Number)list[i].first_seen);
+        lua_setfield(L, -2, "first_seen");
+        lua_rawseti(L, -2, n);
+    }
+
+    lua_setfield(L, -3, "neighbors");
+    lua_setfield(L, -2, "macs");
+    lua_pushinteger(L, n);
+    lua_setfield(L, -2, "count");
+    return 1;
+}
@@ -19,6 +19,7 @@
 #include <sys/socket.h> 
 #include <net/if.h>
 #include <string.h>
+#include <stdbool.h>
 #include <lua.h>
 
 #define BUFFER_SIZE 8192
@@ -31,5 +32,13 @@ typedef struct netlink_if_list {
 // Function prototypes for netlink events
 void parse_rtattr(lua_State *L);
 int netlink_list_if(lua_State *L);
+int get_if_addrs(lua_State *L);
+int get_all_interfaces(lua_State *L);
+int get_if_rate(lua_State *L);
+int get_if_error_rate(lua_State *L);
+int get_flow_stats(lua_State *L);
+int get_neighbor(lua_State *L);
+int get_neighbors(lua_State *L);
+int get_new_neighbors(lua_State *L);
 
 #endif // NETLINK_EVENTS_H
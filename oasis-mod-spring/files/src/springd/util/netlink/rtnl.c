@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2024 utakamo <contact@utakamo.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "rtnl.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+int rtnl_open(unsigned int groups) {
+    int sock_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock_fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = groups;
+
+    if (bind(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock_fd);
+        return -1;
+    }
+
+    return sock_fd;
+}
+
+int rtnl_dump(int fd, int type, unsigned char family, rtnl_msg_cb cb, void *ctx) {
+    struct {
+        struct nlmsghdr nlh;
+        struct rtgenmsg gen;
+    } request;
+
+    unsigned int seq = (unsigned int)time(NULL);
+
+    memset(&request, 0, sizeof(request));
+    request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+    request.nlh.nlmsg_type = type;
+    request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.nlh.nlmsg_seq = seq;
+    request.gen.rtgen_family = family;
+
+    if (send(fd, &request, request.nlh.nlmsg_len, 0) < 0) {
+        return -1;
+    }
+
+    // Aligned for the nlmsghdr/ifinfomsg/ifaddrmsg casts below
+    static __thread long buffer[RTNL_RECV_BUFFER_SIZE / sizeof(long)];
+    int stop = 0;
+
+    for (;;) {
+        ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (len == 0) {
+            return -1;
+        }
+
+        struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+        for (; NLMSG_OK(nlh, (unsigned int)len); nlh = NLMSG_NEXT(nlh, len)) {
+            // Multicast events on a shared socket are not part of this dump
+            if (nlh->nlmsg_seq != seq) {
+                continue;
+            }
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                return 0;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                return -1;
+            }
+            // Keep reading to the end of the dump even when the caller stopped
+            if (!stop && cb(nlh, ctx) != 0) {
+                stop = 1;
+            }
+        }
+    }
+}
+
+void rtnl_parse_attrs(struct rtattr *tb[], int max, struct rtattr *rta, int len) {
+    memset(tb, 0, sizeof(struct rtattr *) * (max + 1));
+
+    while (RTA_OK(rta, len)) {
+        unsigned short type = rta->rta_type & ~NLA_F_NESTED;
+        if (type <= max && !tb[type]) {
+            tb[type] = rta;
+        }
+        rta = RTA_NEXT(rta, len);
+    }
+}
+
+int rtnl_add_attr(struct nlmsghdr *nlh, size_t maxlen, int type, const void *data, int len) {
+    size_t rta_len = RTA_LENGTH(len);
+
+    if (NLMSG_ALIGN(nlh->nlmsg_len) + RTA_ALIGN(rta_len) > maxlen) {
+        return -1;
+    }
+
+    struct rtattr *rta = (struct rtattr *)((char *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+    rta->rta_type = type;
+    rta->rta_len = rta_len;
+    if (len > 0) {
+        memcpy(RTA_DATA(rta), data, len);
+    }
+    nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + RTA_ALIGN(rta_len);
+    return 0;
+}
+
+int rtnl_transact(int fd, void *buf, size_t len, int count, int *error) {
+    static unsigned int next_seq = 0;
+    unsigned int seq = __atomic_add_fetch(&next_seq, (unsigned int)count, __ATOMIC_RELAXED) - (unsigned int)count;
+
+    *error = 0;
+
+    // Number the requests so that each acknowledgement can be matched
+    int n = 0;
+    int remaining = (int)len;
+    for (struct nlmsghdr *nlh = buf; NLMSG_OK(nlh, (unsigned int)remaining) && n < count;
+         nlh = NLMSG_NEXT(nlh, remaining)) {
+        nlh->nlmsg_seq = seq + n++;
+        nlh->nlmsg_flags |= NLM_F_ACK;
+    }
+
+    if (send(fd, buf, len, 0) < 0) {
+        return -1;
+    }
+
+    long buffer[8192 / sizeof(long)];
+    int acked = 0;
+    int accepted = 0;
+
+    while (acked < n) {
+        ssize_t rlen = recv(fd, buffer, sizeof(buffer), 0);
+        if (rlen < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (rlen == 0) {
+            return -1;
+        }
+
+        struct nlmsghdr *nlh = (struct nlmsghdr *)buffer;
+        for (; NLMSG_OK(nlh, (unsigned int)rlen); nlh = NLMSG_NEXT(nlh, rlen)) {
+            if (nlh->nlmsg_type != NLMSG_ERROR || nlh->nlmsg_seq - seq >= (unsigned int)n) {
+                continue;
+            }
+            struct nlmsgerr *err = NLMSG_DATA(nlh);
+            acked++;
+            if (err->error == 0) {
+                accepted++;
+            } else if (*error == 0) {
+                *error = -err->error;
+            }
+        }
+    }
+
+    return accepted;
+}
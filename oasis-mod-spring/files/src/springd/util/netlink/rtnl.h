@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 utakamo <contact@utakamo.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef NETLINK_RTNL_H
+#define NETLINK_RTNL_H
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+
+#define RTNL_RECV_BUFFER_SIZE   32768
+
+// Called for every message of a dump; a non-zero return stops the dump
+typedef int (*rtnl_msg_cb)(struct nlmsghdr *nlh, void *ctx);
+
+/*
+ * Open a NETLINK_ROUTE socket.
+ * groups: RTMGRP_* multicast groups to join (0 for request/dump only)
+ * Returns the socket or -1.
+ */
+int rtnl_open(unsigned int groups);
+
+/*
+ * Send a dump request (RTM_GETLINK, RTM_GETADDR, ...) and pass every reply
+ * message to cb until NLMSG_DONE. The reply may span any number of recv().
+ * Returns 0, or -1 on a socket/netlink error.
+ */
+int rtnl_dump(int fd, int type, unsigned char family, rtnl_msg_cb cb, void *ctx);
+
+/*
+ * Index the attributes of a message by type (tb must have max + 1 entries).
+ */
+void rtnl_parse_attrs(struct rtattr *tb[], int max, struct rtattr *rta, int len);
+
+/*
+ * Append an attribute to a request of maxlen bytes at most.
+ * Returns 0, or -1 when it does not fit.
+ */
+int rtnl_add_attr(struct nlmsghdr *nlh, size_t maxlen, int type, const void *data, int len);
+
+/*
+ * Send count requests packed back to back in buf with one send() and wait
+ * for the acknowledgement of each (sequence numbers and NLM_F_ACK are set
+ * here). Returns the number of requests the kernel accepted (-1 on a socket
+ * error); *error gets the errno of the first rejected one, 0 if none.
+ */
+int rtnl_transact(int fd, void *buf, size_t len, int count, int *error);
+
+#endif // NETLINK_RTNL_H
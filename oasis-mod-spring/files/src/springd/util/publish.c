@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "publish.h"
+#include "../../common/debug.h"
+
+static pthread_mutex_t publish_lock = PTHREAD_MUTEX_INITIALIZER;
+static spring_state *state = NULL;
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Writes between write_begin and write_end are seen by readers all or nothing
+static void write_begin(void) {
+    __atomic_store_n(&state->seq, state->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(void) {
+    state->updated = now_ms();
+    __atomic_store_n(&state->seq, state->seq + 1, __ATOMIC_RELEASE);
+}
+
+int publish_open(void) {
+    mkdir("/tmp/spring", 0755);
+
+    // No O_TRUNC: readers that mapped the file before a restart keep working
+    int fd = open(SPRING_STATE_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        DEBUG_LOG("[publish_open] open failed\n");
+        return -1;
+    }
+
+    if (ftruncate(fd, sizeof(spring_state)) < 0) {
+        close(fd);
+        DEBUG_LOG("[publish_open] ftruncate failed\n");
+        return -1;
+    }
+
+    void *p = mmap(NULL, sizeof(spring_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        DEBUG_LOG("[publish_open] mmap failed\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&publish_lock);
+
+    state = p;
+
+    // A previous instance may have died mid-write (odd seq): continue from even
+    if (state->seq & 1) {
+        state->seq++;
+    }
+
+    write_begin();
+
+    // Everything but seq, which readers keep watching
+    size_t seq_end = offsetof(spring_state, seq) + sizeof(state->seq);
+    memset(state, 0, offsetof(spring_state, seq));
+    memset((char *)state + seq_end, 0, sizeof(spring_state) - seq_end);
+
+    state->magic = SPRING_STATE_MAGIC;
+    state->version = SPRING_STATE_VERSION;
+    state->size = sizeof(spring_state);
+    state->pid = getpid();
+
+    write_end();
+
+    pthread_mutex_unlock(&publish_lock);
+    return 0;
+}
+
+void publish_close(void) {
+    pthread_mutex_lock(&publish_lock);
+
+    if (state) {
+        write_begin();
+        state->pid = 0;
+        write_end();
+        munmap(state, sizeof(spring_state));
+        state = NULL;
+    }
+
+    pthread_mutex_unlock(&publish_lock);
+}
+
+void publish_phase(const char *name) {
+    pthread_mutex_lock(&publish_lock);
+
+    if (state && strncmp(state->phase, name, sizeof(state->phase) - 1) != 0) {
+        write_begin();
+        snprintf(state->phase, sizeof(state->phase), "%s", name);
+        state->phase_since = now_ms();
+        write_end();
+    }
+
+    pthread_mutex_unlock(&publish_lock);
+}
+
+void publish_result(const char *name, const char *value) {
+    pthread_mutex_lock(&publish_lock);
+
+    if (!state) {
+        pthread_mutex_unlock(&publish_lock);
+        return;
+    }
+
+    // Same detector: same slot. Table full: the oldest result makes room
+    spring_state_result *slot = NULL;
+    for (uint32_t i = 0; i < state->result_count; i++) {
+        if (strncmp(state->results[i].name, name, SPRING_STATE_NAME_LEN - 1) == 0) {
+            slot = &state->results[i];
+            break;
+        }
+    }
+
+    write_begin();
+
+    if (!slot) {
+        if (state->result_count < SPRING_STATE_RESULT_MAX) {
+            slot = &state->results[state->result_count++];
+        } else {
+            slot = &state->results[0];
+            for (uint32_t i = 1; i < state->result_count; i++) {
+                if (state->results[i].updated < slot->updated) {
+                    slot = &state->results[i];
+                }
+            }
+        }
+        snprintf(slot->name, sizeof(slot->name), "%s", name);
+    }
+
+    snprintf(slot->value, sizeof(slot->value), "%s", value);
+    slot->updated = now_ms();
+
+    write_end();
+
+    pthread_mutex_unlock(&publish_lock);
+}
+
+void publish_interfaces(const spring_state_if *ifs, int count) {
+    if (count > SPRING_STATE_IF_MAX) {
+        count = SPRING_STATE_IF_MAX;
+    }
+
+    pthread_mutex_lock(&publish_lock);
+
+    if (state) {
+        write_begin();
+        memcpy(state->ifs, ifs, (size_t)count * sizeof(spring_state_if));
+        memset(&state->ifs[count], 0, (size_t)(SPRING_STATE_IF_MAX - count) * sizeof(spring_state_if));
+        state->if_count = count;
+        write_end();
+    }
+
+    pthread_mutex_unlock(&publish_lock);
+}
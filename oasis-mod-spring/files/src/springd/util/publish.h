@@ -0,0 +1,25 @@
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include "../../common/state.h"
+
+/*
+ * Writer side of the shared state (see common/state.h). Every call is one
+ * seqlock write section; calls from different threads are serialized.
+ * Before publish_open (or when it failed) every call is a no-op.
+ */
+
+// Create/map SPRING_STATE_PATH; 0 or -1
+int publish_open(void);
+
+void publish_close(void);
+
+void publish_phase(const char *name);
+
+// Insert or update the result of one detector function
+void publish_result(const char *name, const char *value);
+
+// Replace the interface table
+void publish_interfaces(const spring_state_if *ifs, int count);
+
+#endif // PUBLISH_H
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include "reload.h"
+#include "../../common/debug.h"
+
+static int wake_pipe[2] = { -1, -1 };
+static unsigned int generation = 0;
+
+int reload_init(void) {
+    if (pipe(wake_pipe) < 0) {
+        wake_pipe[0] = wake_pipe[1] = -1;
+        DEBUG_LOG("[reload_init] pipe failed\n");
+        return -1;
+    }
+
+    // The signal handler must never block on a full pipe
+    for (int i = 0; i < 2; i++) {
+        fcntl(wake_pipe[i], F_SETFL, fcntl(wake_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(wake_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    return 0;
+}
+
+void reload_request(void) {
+    if (wake_pipe[1] >= 0) {
+        char c = 1;
+        if (write(wake_pipe[1], &c, 1) < 0) {
+            // EAGAIN: the pipe already holds pending requests
+        }
+    }
+}
+
+unsigned int reload_generation(void) {
+    return __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+}
+
+// FNV-1a of the config file; 0 when it cannot be read
+static uint64_t config_hash(void) {
+    char buf[4096];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    int fd = open(RELOAD_CONFIG_DIR "/" RELOAD_CONFIG_NAME, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < len; i++) {
+            hash ^= (unsigned char)buf[i];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+
+    close(fd);
+    return hash;
+}
+
+// Drain the inotify queue; true when one of the events concerns the config file
+static bool read_events(int fd) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool hit = false;
+    ssize_t len;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            if (ev->len > 0 && strcmp(ev->name, RELOAD_CONFIG_NAME) == 0) {
+                hit = true;
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    return hit;
+}
+
+static void drain_pipe(void) {
+    char buf[64];
+    while (read(wake_pipe[0], buf, sizeof(buf)) > 0) {
+    }
+}
+
+void *reload_process(void *arg) {
+    volatile bool *terminate = (volatile bool *)arg;
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        DEBUG_LOG("[reload_process] inotify failed (SIGHUP only)\n");
+    } else if (inotify_add_watch(fd, RELOAD_CONFIG_DIR, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        DEBUG_LOG("[reload_process] cannot watch %s (SIGHUP only)\n", RELOAD_CONFIG_DIR);
+        close(fd);
+        fd = -1;
+    }
+
+    uint64_t last_hash = config_hash();
+
+    DEBUG_LOG("[reload_process] start\n");
+
+    while (!*terminate) {
+        struct pollfd pfd[2] = {
+            { .fd = wake_pipe[0], .events = POLLIN },
+            { .fd = fd, .events = POLLIN },
+        };
+
+        // The timeout only bounds the terminate check
+        if (poll(pfd, 2, 1000) <= 0) {
+            continue;
+        }
+
+        bool forced = false;
+        bool changed = false;
+
+        // Settle: a commit is a burst of events, reload once after it
+        do {
+            if (pfd[0].revents & POLLIN) {
+                drain_pipe();
+                forced = true;
+            }
+            if ((pfd[1].revents & POLLIN) && read_events(fd)) {
+                changed = true;
+            }
+            pfd[0].revents = pfd[1].revents = 0;
+        } while (poll(pfd, 2, RELOAD_SETTLE_MS) > 0);
+
+        if (!forced && !changed) {
+            continue;
+        }
+
+        uint64_t hash = config_hash();
+        if (!forced && hash == last_hash) {
+            DEBUG_LOG("[reload_process] config rewritten without change\n");
+            continue;
+        }
+        last_hash = hash;
+
+        unsigned int gen = __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+        DEBUG_LOG("[reload_process] config generation %u (%s)\n", gen, forced ? "SIGHUP" : "inotify");
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
@@ -0,0 +1,29 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+
+/*
+ * [Config Reload]
+ * A thread that watches /etc/config/spring with inotify (uci commit renames a
+ * new file into place, an editor rewrites it) and takes SIGHUP as an explicit
+ * request. Bursts of events are coalesced, and a rewrite that leaves the file
+ * unchanged is ignored. Each real change bumps the config generation; the
+ * matrix thread compares it between evaluations and rebuilds its phases.
+ */
+
+#define RELOAD_CONFIG_DIR           "/etc/config"
+#define RELOAD_CONFIG_NAME          "spring"
+#define RELOAD_SETTLE_MS            50
+
+// Call once before the signal handlers are installed
+int reload_init(void);
+
+// Ask for a reload even if the file did not change (async-signal-safe)
+void reload_request(void);
+
+// Incremented on each configuration change
+unsigned int reload_generation(void);
+
+// Reload thread; arg points to the daemon's terminate flag (bool)
+void *reload_process(void *arg);
+
+#endif // RELOAD_H
@@ -0,0 +1,408 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <linux/rtnetlink.h>
+#include "sampler.h"
+#include "uci.h"
+#include "ifcache.h"
+#include "publish.h"
+#include "./netlink/rtnl.h"
+#include "../../common/debug.h"
+
+typedef struct sampler_series {
+    float *ring;
+    double ewma;
+    sampler_rate stat;
+} sampler_series;
+
+typedef struct sampler_if {
+    char ifname[IFNAMSIZ];
+    bool configured;                                // spring.sampler.interfaces: never evicted
+    double last_read;                               // monotonic time of the last sampler_get_rate
+    bool primed;                                    // counters read once
+    unsigned long long last[SAMPLER_SERIES_NUM];
+    double last_time;
+    int capacity;
+    int head;
+    int count;
+    sampler_series series[SAMPLER_SERIES_NUM];
+} sampler_if;
+
+static pthread_mutex_t sampler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t config_once = PTHREAD_ONCE_INIT;
+static sampler_if *sampled[SAMPLER_IF_MAX];
+static int sampled_count = 0;
+
+static int interval_ms = 1000;
+static int history = 60;
+static double ewma_seconds = 10.0;
+
+// Sort buffer for the percentiles (sampler thread only)
+static float scratch[SAMPLER_HISTORY_MAX];
+
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int config_int(const char *option, int default_val, int min, int max) {
+    char uci_parameter[256];
+    char value[256] = {0};
+    char *endptr;
+
+    snprintf(uci_parameter, sizeof(uci_parameter), "spring.sampler.%s", option);
+    uci_get_option(uci_parameter, value);
+
+    long val = strtol(value, &endptr, 10);
+    if (endptr == value || *endptr != '\0') {
+        return default_val;
+    }
+    if (val < min) {
+        return min;
+    }
+    return (val > max) ? max : (int)val;
+}
+
+static sampler_if *find_locked(const char *ifname) {
+    for (int i = 0; i < sampled_count; i++) {
+        if (strcmp(sampled[i]->ifname, ifname) == 0) {
+            return sampled[i];
+        }
+    }
+    return NULL;
+}
+
+static void free_if(sampler_if *sif) {
+    for (int s = 0; s < SAMPLER_SERIES_NUM; s++) {
+        free(sif->series[s].ring);
+    }
+    free(sif);
+}
+
+// Make room: drop the detector-requested interface read least recently, if idle long enough
+static bool evict_idle_locked(double now) {
+    int victim = -1;
+
+    for (int i = 0; i < sampled_count; i++) {
+        if (!sampled[i]->configured && now - sampled[i]->last_read >= SAMPLER_IDLE_S &&
+            (victim < 0 || sampled[i]->last_read < sampled[victim]->last_read)) {
+            victim = i;
+        }
+    }
+
+    if (victim < 0) {
+        return false;
+    }
+
+    DEBUG_LOG("[sampler] %s not read for %.0f s, no longer sampled\n",
+              sampled[victim]->ifname, now - sampled[victim]->last_read);
+    free_if(sampled[victim]);
+    memmove(&sampled[victim], &sampled[victim + 1], (sampled_count - victim - 1) * sizeof(sampled[0]));
+    sampled_count--;
+    return true;
+}
+
+static sampler_if *add_locked(const char *ifname, bool configured) {
+    if (strlen(ifname) >= IFNAMSIZ) {
+        return NULL;
+    }
+
+    double now = monotonic_now();
+    if (sampled_count >= SAMPLER_IF_MAX && !evict_idle_locked(now)) {
+        return NULL;
+    }
+
+    sampler_if *sif = calloc(1, sizeof(sampler_if));
+    if (!sif) {
+        return NULL;
+    }
+
+    strcpy(sif->ifname, ifname);
+    sif->configured = configured;
+    sif->last_read = now;
+    sif->capacity = history;
+
+    for (int s = 0; s < SAMPLER_SERIES_NUM; s++) {
+        sif->series[s].ring = calloc(history, sizeof(float));
+        if (!sif->series[s].ring) {
+            while (s-- > 0) {
+                free(sif->series[s].ring);
+            }
+            free(sif);
+            return NULL;
+        }
+    }
+
+    sampled[sampled_count++] = sif;
+    return sif;
+}
+
+static int compare_float(const void *a, const void *b) {
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted window
+static double percentile(const float *sorted, int n, double p) {
+    int rank = (int)ceil(p * n);
+    return sorted[(rank > 0) ? (rank - 1) : 0];
+}
+
+static void update_series(sampler_if *sif, sampler_series *series, double rate, double dt) {
+    series->ring[sif->head] = (float)rate;
+
+    if (sif->count == 0) {
+        series->ewma = rate;
+    } else {
+        // Time-based smoothing: the same time constant at any interval
+        double alpha = 1.0 - exp(-dt / ewma_seconds);
+        series->ewma += alpha * (rate - series->ewma);
+    }
+
+    // The window is ring[0 .. n), whatever the write position
+    int n = (sif->count < sif->capacity) ? (sif->count + 1) : sif->capacity;
+    memcpy(scratch, series->ring, n * sizeof(float));
+    qsort(scratch, n, sizeof(float), compare_float);
+
+    series->stat.current = rate;
+    series->stat.ewma = series->ewma;
+    series->stat.min = scratch[0];
+    series->stat.max = scratch[n - 1];
+    series->stat.p50 = percentile(scratch, n, 0.50);
+    series->stat.p95 = percentile(scratch, n, 0.95);
+    series->stat.samples = n;
+    series->stat.window = n * (interval_ms / 1000.0);
+}
+
+static void add_sample(sampler_if *sif, const unsigned long long *counter, double now) {
+    double dt = now - sif->last_time;
+
+    if (!sif->primed || dt <= 0) {
+        memcpy(sif->last, counter, sizeof(sif->last));
+        sif->last_time = now;
+        sif->primed = true;
+        return;
+    }
+
+    // A counter went backwards (driver reset): restart from here
+    for (int s = 0; s < SAMPLER_SERIES_NUM; s++) {
+        if (counter[s] < sif->last[s]) {
+            sif->primed = false;
+            add_sample(sif, counter, now);
+            return;
+        }
+    }
+
+    for (int s = 0; s < SAMPLER_SERIES_NUM; s++) {
+        update_series(sif, &sif->series[s], (counter[s] - sif->last[s]) / dt, dt);
+    }
+
+    sif->head = (sif->head + 1) % sif->capacity;
+    if (sif->count < sif->capacity) {
+        sif->count++;
+    }
+
+    memcpy(sif->last, counter, sizeof(sif->last));
+    sif->last_time = now;
+}
+
+static int sample_cb(struct nlmsghdr *nlh, void *ctx) {
+    double now = *(double *)ctx;
+
+    if (nlh->nlmsg_type != RTM_NEWLINK) {
+        return 0;
+    }
+
+    struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+    struct rtattr *tb[IFLA_MAX + 1];
+    rtnl_parse_attrs(tb, IFLA_MAX, IFLA_RTA(ifi), IFLA_PAYLOAD(nlh));
+
+    if (!tb[IFLA_IFNAME] || !tb[IFLA_STATS64] ||
+        RTA_PAYLOAD(tb[IFLA_STATS64]) < sizeof(struct rtnl_link_stats64)) {
+        return 0;
+    }
+
+    char ifname[IFNAMSIZ];
+    snprintf(ifname, sizeof(ifname), "%.*s",
+             (int)RTA_PAYLOAD(tb[IFLA_IFNAME]), (const char *)RTA_DATA(tb[IFLA_IFNAME]));
+
+    pthread_mutex_lock(&sampler_lock);
+
+    sampler_if *sif = find_locked(ifname);
+    if (sif) {
+        struct rtnl_link_stats64 st;
+        memcpy(&st, RTA_DATA(tb[IFLA_STATS64]), sizeof(st));
+
+        unsigned long long counter[SAMPLER_SERIES_NUM];
+        counter[SAMPLER_RX] = st.rx_bytes;
+        counter[SAMPLER_TX] = st.tx_bytes;
+        counter[SAMPLER_ERR] = st.rx_errors + st.tx_errors + st.rx_dropped + st.tx_dropped;
+        add_sample(sif, counter, now);
+    }
+
+    pthread_mutex_unlock(&sampler_lock);
+    return 0;
+}
+
+static void load_config(void) {
+    char value[256] = {0};
+
+    pthread_mutex_lock(&sampler_lock);
+
+    interval_ms = config_int("interval_ms", 1000, SAMPLER_INTERVAL_MIN_MS, 3600 * 1000);
+    history = config_int("history", 60, 2, SAMPLER_HISTORY_MAX);
+    ewma_seconds = config_int("ewma_seconds", 10, 1, 3600);
+
+    uci_get_option("spring.sampler.interfaces", value);
+
+    char *saveptr;
+    for (char *name = strtok_r(value, " ,", &saveptr); name; name = strtok_r(NULL, " ,", &saveptr)) {
+        sampler_if *sif = find_locked(name);
+        if (sif) {
+            sif->configured = true;
+        } else {
+            add_locked(name, true);
+        }
+    }
+
+    pthread_mutex_unlock(&sampler_lock);
+}
+
+int sampler_get_rate(const char *ifname, sampler_series_id series, sampler_rate *out) {
+    int ret = -1;
+
+    // A detector may ask before the thread is up: same ring sizes either way
+    pthread_once(&config_once, load_config);
+
+    pthread_mutex_lock(&sampler_lock);
+
+    sampler_if *sif = find_locked(ifname);
+    if (!sif) {
+        // Sampled from the next tick on; a name that is no interface takes no slot
+        if (ifcache_get_index(ifname) > 0) {
+            add_locked(ifname, false);
+        }
+    } else {
+        sif->last_read = monotonic_now();
+        if (sif->count > 0) {
+            *out = sif->series[series].stat;
+            ret = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&sampler_lock);
+    return ret;
+}
+
+// Copy the sampled interfaces (EWMA rates, first addresses) to the shared state
+static void publish_sampled(void) {
+    spring_state_if ifs[SAMPLER_IF_MAX];
+    int count = 0;
+
+    pthread_mutex_lock(&sampler_lock);
+
+    for (int i = 0; i < sampled_count && i < SPRING_STATE_IF_MAX; i++) {
+        const sampler_if *sif = sampled[i];
+        spring_state_if *sif_out = &ifs[count++];
+
+        memset(sif_out, 0, sizeof(*sif_out));
+        snprintf(sif_out->ifname, sizeof(sif_out->ifname), "%s", sif->ifname);
+        if (sif->count > 0) {
+            sif_out->rx_rate = sif->series[SAMPLER_RX].stat.ewma;
+            sif_out->tx_rate = sif->series[SAMPLER_TX].stat.ewma;
+            sif_out->err_rate = sif->series[SAMPLER_ERR].stat.ewma;
+        }
+    }
+
+    pthread_mutex_unlock(&sampler_lock);
+
+    // Addresses: warm interface cache, outside the sampler lock
+    for (int i = 0; i < count; i++) {
+        ifcache_addr *addrs;
+        int index = ifcache_get_index(ifs[i].ifname);
+        int n = (index > 0) ? ifcache_get_addrs(index, AF_UNSPEC, &addrs) : 0;
+
+        ifs[i].index = index;
+        bool global6 = false;
+        for (int j = 0; j < n; j++) {
+            if (addrs[j].family == AF_INET && !ifs[i].ipv4[0]) {
+                snprintf(ifs[i].ipv4, sizeof(ifs[i].ipv4), "%.15s", addrs[j].address);
+            } else if (addrs[j].family == AF_INET6 && !global6) {
+                // First global address, else the first one (link-local)
+                if (!ifs[i].ipv6[0] || addrs[j].scope == RT_SCOPE_UNIVERSE) {
+                    snprintf(ifs[i].ipv6, sizeof(ifs[i].ipv6), "%s", addrs[j].address);
+                    global6 = (addrs[j].scope == RT_SCOPE_UNIVERSE);
+                }
+            }
+        }
+        if (n > 0) {
+            free(addrs);
+        }
+    }
+
+    publish_interfaces(ifs, count);
+}
+
+void *sampler_process(void *arg) {
+    volatile bool *terminate = (volatile bool *)arg;
+
+    pthread_once(&config_once, load_config);
+
+    int fd = rtnl_open(0);
+    if (fd < 0) {
+        DEBUG_LOG("[sampler_process] netlink socket failed\n");
+        return NULL;
+    }
+
+    DEBUG_LOG("[sampler_process] start (interval %d ms)\n", interval_ms);
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!*terminate) {
+
+        pthread_mutex_lock(&sampler_lock);
+        int count = sampled_count;
+        pthread_mutex_unlock(&sampler_lock);
+
+        if (count > 0) {
+            double now = monotonic_now();
+            if (rtnl_dump(fd, RTM_GETLINK, AF_UNSPEC, sample_cb, &now) != 0) {
+                // A broken dump may leave replies queued: start on a clean socket
+                close(fd);
+                fd = rtnl_open(0);
+                if (fd < 0) {
+                    DEBUG_LOG("[sampler_process] netlink socket failed\n");
+                    return NULL;
+                }
+            }
+            publish_sampled();
+        }
+
+        // Absolute deadlines: the dump time does not shift the sampling grid
+        next.tv_sec += interval_ms / 1000;
+        next.tv_nsec += (long)(interval_ms % 1000) * 1000000L;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec)) {
+            next = now;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+
+    close(fd);
+    return NULL;
+}
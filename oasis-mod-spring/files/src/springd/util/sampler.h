@@ -0,0 +1,53 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdbool.h>
+#include <net/if.h>
+
+/*
+ * [Traffic Sampler]
+ * A thread that reads IFLA_STATS64 of the sampled interfaces every
+ * spring.sampler.interval_ms (>= 100 ms) with one RTM_GETLINK dump and keeps,
+ * per interface, a ring of the last spring.sampler.history rates for rx
+ * bytes/s, tx bytes/s and errors/s (errors + drops of both directions).
+ * EWMA, min/max and percentiles of the window are computed when a sample is
+ * written, so a read is a copy under the lock.
+ * Sampled interfaces: spring.sampler.interfaces (space separated) plus every
+ * existing interface a detector asks for (up to SAMPLER_IF_MAX). When the
+ * table is full, a requested interface not read for SAMPLER_IDLE_S gives
+ * its slot to the new one.
+ */
+
+#define SAMPLER_IF_MAX              32
+#define SAMPLER_IDLE_S              300
+#define SAMPLER_INTERVAL_MIN_MS     100
+#define SAMPLER_HISTORY_MAX         600
+
+typedef enum {
+    SAMPLER_RX = 0,
+    SAMPLER_TX,
+    SAMPLER_ERR,
+    SAMPLER_SERIES_NUM
+} sampler_series_id;
+
+typedef struct sampler_rate {
+    double current;         // latest sample (per second)
+    double ewma;
+    double min;             // over the window
+    double max;
+    double p50;
+    double p95;
+    int samples;            // samples in the window
+    double window;          // seconds covered by the window
+} sampler_rate;
+
+/*
+ * Read the statistics of one series. Returns 0, or -1 when the interface has
+ * no sample yet (an existing interface that is not sampled yet is added).
+ */
+int sampler_get_rate(const char *ifname, sampler_series_id series, sampler_rate *out);
+
+// Sampler thread; arg points to the daemon's terminate flag (bool)
+void *sampler_process(void *arg);
+
+#endif // SAMPLER_H
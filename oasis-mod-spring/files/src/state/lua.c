@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include "../common/state.h"
+
+/*
+ * [spring.state]
+ * Lua binding of the shared state reader:
+ *   local state = require("spring.state")
+ *   local s, err = state.snapshot()
+ * The file is mapped on the first successful call and kept mapped, so a
+ * snapshot is a memory copy (no syscall, no request to springd).
+ */
+
+static const spring_state *map = NULL;
+static char map_path[256];
+static spring_state snapshot;
+
+static const spring_state *get_map(const char *path) {
+    if (map && strcmp(map_path, path) == 0) {
+        return map;
+    }
+
+    const spring_state *p = spring_state_map(path);
+    if (p) {
+        spring_state_unmap(map);
+        map = p;
+        snprintf(map_path, sizeof(map_path), "%s", path);
+    }
+    return p;
+}
+
+static void push_results(lua_State *L, const spring_state *s) {
+    lua_createtable(L, 0, s->result_count);
+
+    for (uint32_t i = 0; i < s->result_count && i < SPRING_STATE_RESULT_MAX; i++) {
+        const spring_state_result *r = &s->results[i];
+        lua_createtable(L, 0, 2);
+        lua_pushstring(L, r->value);
+        lua_setfield(L, -2, "value");
+        lua_pushnumber(L, (lua_Number)r->updated);
+        lua_setfield(L, -2, "updated");
+        lua_setfield(L, -2, r->name);
+    }
+}
+
+static void push_interfaces(lua_State *L, const spring_state *s) {
+    lua_createtable(L, 0, s->if_count);
+
+    for (uint32_t i = 0; i < s->if_count && i < SPRING_STATE_IF_MAX; i++) {
+        const spring_state_if *sif = &s->ifs[i];
+        lua_createtable(L, 0, 6);
+        lua_pushinteger(L, sif->index);
+        lua_setfield(L, -2, "index");
+        lua_pushstring(L, sif->ipv4);
+        lua_setfield(L, -2, "ipv4");
+        lua_pushstring(L, sif->ipv6);
+        lua_setfield(L, -2, "ipv6");
+        lua_pushnumber(L, sif->rx_rate);
+        lua_setfield(L, -2, "rx_rate");
+        lua_pushnumber(L, sif->tx_rate);
+        lua_setfield(L, -2, "tx_rate");
+        lua_pushnumber(L, sif->err_rate);
+        lua_setfield(L, -2, "err_rate");
+        lua_setfield(L, -2, sif->ifname);
+    }
+}
+
+/*
+ * usage: local s, err = state.snapshot([path])
+ * { pid, updated, phase, phase_since, seq,
+ *   results = { [func] = { value, updated } },
+ *   interfaces = { [ifname] = { index, ipv4, ipv6, rx_rate, tx_rate, err_rate } } }
+ * Times are unix milliseconds; pid is 0 after springd stopped.
+ */
+static int l_snapshot(lua_State *L) {
+    const char *path = luaL_optstring(L, 1, SPRING_STATE_PATH);
+
+    const spring_state *m = get_map(path);
+    if (!m) {
+        lua_pushnil(L);
+        lua_pushstring(L, "state file is not available");
+        return 2;
+    }
+
+    if (spring_state_snapshot(m, &snapshot) != 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, "state is busy or has an unknown layout");
+        return 2;
+    }
+
+    lua_createtable(L, 0, 7);
+    lua_pushinteger(L, snapshot.pid);
+    lua_setfield(L, -2, "pid");
+    lua_pushnumber(L, (lua_Number)snapshot.updated);
+    lua_setfield(L, -2, "updated");
+    lua_pushstring(L, snapshot.phase);
+    lua_setfield(L, -2, "phase");
+    lua_pushnumber(L, (lua_Number)snapshot.phase_since);
+    lua_setfield(L, -2, "phase_since");
+    lua_pushnumber(L, snapshot.seq);
+    lua_setfield(L, -2, "seq");
+    push_results(L, &snapshot);
+    lua_setfield(L, -2, "results");
+    push_interfaces(L, &snapshot);
+    lua_setfield(L, -2, "interfaces");
+    return 1;
+}
+
+static const luaL_Reg state_funcs[] = {
+    { "snapshot", l_snapshot },
+    { NULL, NULL }
+};
+
+int luaopen_spring_state(lua_State *L) {
+    lua_newtable(L);
+    luaL_register(L, NULL, state_funcs);
+    return 1;
+}
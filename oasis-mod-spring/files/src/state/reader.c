@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "../common/state.h"
+
+// A writer section is a few hundred bytes of stores: a busy record is rare
+#define SNAPSHOT_RETRY_MAX 1000
+
+const spring_state *spring_state_map(const char *path) {
+    int fd = open(path ? path : SPRING_STATE_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // The header tells whether this file has the layout this library knows
+    spring_state header;
+    ssize_t len = pread(fd, &header, offsetof(spring_state, pid), 0);
+    if (len != (ssize_t)offsetof(spring_state, pid) ||
+        header.magic != SPRING_STATE_MAGIC || header.version != SPRING_STATE_VERSION ||
+        header.size < sizeof(spring_state)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *p = mmap(NULL, sizeof(spring_state), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return (p == MAP_FAILED) ? NULL : (const spring_state *)p;
+}
+
+int spring_state_snapshot(const spring_state *map, spring_state *out) {
+    for (int i = 0; i < SNAPSHOT_RETRY_MAX; i++) {
+        uint32_t seq = __atomic_load_n(&map->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+
+        memcpy(out, map, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&map->seq, __ATOMIC_RELAXED) != seq) {
+            continue;
+        }
+
+        if (out->magic != SPRING_STATE_MAGIC || out->version != SPRING_STATE_VERSION) {
+            return -1;
+        }
+        return 0;
+    }
+
+    return -1;
+}
+
+void spring_state_unmap(const spring_state *map) {
+    if (map) {
+        munmap((void *)map, sizeof(spring_state));
+    }
+}
@@ -0,0 +1,624 @@
+--[[ [Judge Expressions]
+A judge (list judge '...' of a phase_*_event section) is compiled once, when
+the phase is created: the parser emits one small Lua function per condition
+and loadstring turns the whole judge into bytecode. Evaluating it per sample
+runs that bytecode: no parsing, no string building, no interpretation of a
+tree.
+
+  value > 100                       comparison: == != < <= > >=
+  rx_p95 >= 10M                     field of a table result (value.rx_p95), k/M/G suffix
+  value["br-lan"].mtu == 1500       field with any name
+  #value > 3                        length of a list / string
+  mtu in [1280, 1500]               range, inclusive ([ ]) or exclusive (( ))
+  operstate in {'up', 'unknown'}    set membership
+  value contains 'lan'              list element / substring
+  ifname startswith 'wl'            prefix (also endswith)
+  version matches '^6%.%d+'         Lua pattern
+  a > 1 and (b or not c)            and / or / not (also && || !)
+  err_rate > 10 for 30s             debounce: true for the whole duration (ms/s/m/h)
+  rx > 80M until rx < 60M           hysteresis: on at the first, off at the second
+
+A judge that is not an expression (e.g. '5.4.1', 'lan') keeps its old meaning:
+the result equals it, or a list result contains it. A judge that does not
+parse but has operators in it ('rx > 10 &&') is a broken expression, not a
+literal: it is dropped and reported by compile. Several judges of one event
+match when any of them matches.
+
+for/until measure time on the now (ms) the caller passes: springd's
+monotonic_ms(), so a wall clock step (NTP sync at boot) neither fires nor
+holds back a debounce. Without it (outside springd) os.time() is used, which
+only counts whole seconds.
+]]
+
+local KEYWORDS = {
+    ["and"] = true, ["or"] = true, ["not"] = true, ["in"] = true, ["for"] = true,
+    ["until"] = true, ["contains"] = true, ["matches"] = true, ["startswith"] = true,
+    ["endswith"] = true, ["true"] = true, ["false"] = true, ["nil"] = true,
+}
+
+local SCALE = { k = 1e3, K = 1e3, M = 1e6, G = 1e9 }
+local DURATION = { ms = 1, s = 1000, m = 60000, h = 3600000 }
+
+------------------------------
+-- Tokenizer               --
+------------------------------
+local tokenize = function(src)
+    local tokens = {}
+    local pos = 1
+    local len = #src
+
+    while pos <= len do
+        local c = src:sub(pos, pos)
+
+        if c:match("%s") then
+            pos = pos + 1
+        elseif c:match("%d") or (c == "." and src:sub(pos + 1, pos + 1):match("%d")) then
+            local num, unit = src:match("^(%d*%.?%d+[eE][%+%-]?%d+)(%a*)", pos)
+            if not num then
+                num, unit = src:match("^(%d*%.?%d*)(%a*)", pos)
+            end
+            -- "5.4.1" and the like are not numbers (legacy literal judges)
+            if src:sub(pos + #num + #unit, pos + #num + #unit):match("[%.%w_]") then
+                return nil, "bad number at " .. pos
+            end
+            tokens[#tokens + 1] = { t = "num", v = tonumber(num), unit = unit }
+            pos = pos + #num + #unit
+        elseif (c == ".") and src:sub(pos + 1, pos + 1):match("[%a_]") then
+            -- path after a bracket: value["br-lan"].mtu
+            tokens[#tokens + 1] = { t = "op", v = "." }
+            pos = pos + 1
+        elseif (c == "'") or (c == '"') then
+            local close = src:find(c, pos + 1, true)
+            if not close then
+                return nil, "unterminated string at " .. pos
+            end
+            tokens[#tokens + 1] = { t = "str", v = src:sub(pos + 1, close - 1) }
+            pos = close + 1
+        elseif c:match("[%a_]") then
+            local word = src:match("^[%a_][%w_]*", pos)
+            -- a.b.1 paths
+            local rest = src:match("^[%.%w_]*", pos + #word)
+            word = word .. rest:gsub("%.$", "")
+            if KEYWORDS[word] then
+                tokens[#tokens + 1] = { t = "kw", v = word }
+            else
+                tokens[#tokens + 1] = { t = "id", v = word }
+            end
+            pos = pos + #word
+        else
+            local two = src:sub(pos, pos + 1)
+            if (two == "==") or (two == "!=") or (two == "~=") or (two == "<=") or (two == ">=")
+                or (two == "&&") or (two == "||") then
+                tokens[#tokens + 1] = { t = "op", v = two }
+                pos = pos + 2
+            elseif c:match("[<>%(%)%[%]{},!#]") then
+                tokens[#tokens + 1] = { t = "op", v = c }
+                pos = pos + 1
+            else
+                return nil, "unexpected '" .. c .. "' at " .. pos
+            end
+        end
+    end
+
+    return tokens
+end
+
+------------------------------
+-- Code Generation         --
+------------------------------
+--[[
+Each condition becomes a local function L<i>(v, now) of the generated chunk;
+and/or/not are plain Lua operators between their calls. Conditions are
+referenced as @<i>@ while parsing and bound at the end: as locals, or through
+one table when there are more than a Lua 5.1 function can take as upvalues.
+]]
+
+local MAX_DIRECT_LEAVES = 50
+
+local quote = function(lit)
+    if type(lit) == "string" then
+        return string.format("%q", lit)
+    elseif type(lit) == "number" then
+        return string.format("%.17g", lit)
+    end
+    return tostring(lit)
+end
+
+local new_codegen = function()
+    return { decls = {}, leaves = 0, sets = {} }
+end
+
+-- Add a condition function; body sees v (sample) and now (ms)
+local add_leaf = function(cg, body, state)
+    cg.leaves = cg.leaves + 1
+    local i = cg.leaves
+    if state then
+        cg.decls[#cg.decls + 1] = "local " .. state:gsub("#", i)
+    end
+    cg.decls[#cg.decls + 1] = "local L" .. i .. " = function(v, now)\n" .. body:gsub("#", i) .. "\nend"
+    return "@" .. i .. "@(v, now)"
+end
+
+-- Statements that leave the operand in x
+local fetch = function(operand)
+    local lines = { "local x = v" }
+    for _, seg in ipairs(operand.segments) do
+        lines[#lines + 1] = "if type(x) == \"table\" then x = x[" .. quote(seg) .. "] else x = nil end"
+    end
+    if operand.length then
+        lines[#lines + 1] = "x = length(x)"
+    end
+    return table.concat(lines, "\n")
+end
+
+local NUMBER_OPS = { ["<"] = true, ["<="] = true, [">"] = true, [">="] = true }
+
+local gen_compare = function(cg, operand, op, lit)
+    local lua_op = (op == "!=") and "~=" or op
+
+    if type(lit) == "number" then
+        -- Detectors often return numbers as text: coerce the sample, not the literal
+        local coerce = "if type(x) ~= \"number\" then x = tonumber(x) end\n"
+        if NUMBER_OPS[op] then
+            return add_leaf(cg, fetch(operand) .. "\n" .. coerce .. "return x ~= nil and x " .. lua_op .. " " .. quote(lit))
+        end
+        return add_leaf(cg, fetch(operand) .. "\n" .. coerce .. "return x " .. lua_op .. " " .. quote(lit))
+    end
+
+    if NUMBER_OPS[op] then
+        -- Ordering of strings (e.g. "2024-01-01" style values)
+        return add_leaf(cg, fetch(operand) .. "\nreturn type(x) == \"string\" and x " .. lua_op .. " " .. quote(lit))
+    end
+
+    return add_leaf(cg, fetch(operand) .. "\nreturn x " .. lua_op .. " " .. quote(lit))
+end
+
+local gen_range = function(cg, operand, low, high, inclusive)
+    local lo, hi = inclusive and ">=" or ">", inclusive and "<=" or "<"
+    return add_leaf(cg, fetch(operand) .. "\nif type(x) ~= \"number\" then x = tonumber(x) end\n"
+        .. "return x ~= nil and x " .. lo .. " " .. quote(low) .. " and x " .. hi .. " " .. quote(high))
+end
+
+local gen_set = function(cg, operand, items)
+    -- Numbers and their text form both hit (1500 and "1500")
+    local set = {}
+    for _, item in ipairs(items) do
+        set[item] = true
+        if type(item) == "number" then
+            set[tostring(item)] = true
+        elseif tonumber(item) then
+            set[tonumber(item)] = true
+        end
+    end
+    cg.sets[#cg.sets + 1] = set
+    return add_leaf(cg, fetch(operand) .. "\nreturn x ~= nil and S[" .. #cg.sets .. "][x] == true")
+end
+
+local gen_contains = function(cg, operand, lit)
+    return add_leaf(cg, fetch(operand) .. "\nreturn contains(x, " .. quote(lit) .. ")")
+end
+
+local gen_affix = function(cg, operand, lit, suffix)
+    if #lit == 0 then
+        return add_leaf(cg, fetch(operand) .. "\nreturn type(x) == \"string\"")
+    end
+    local range = suffix and ("-" .. #lit) or ("1, " .. #lit)
+    return add_leaf(cg, fetch(operand) .. "\nreturn type(x) == \"string\" and sub(x, " .. range .. ") == " .. quote(lit))
+end
+
+local gen_matches = function(cg, operand, pattern)
+    return add_leaf(cg, fetch(operand) .. "\nreturn type(x) == \"string\" and find(x, " .. quote(pattern) .. ") ~= nil")
+end
+
+local gen_truthy = function(cg, operand)
+    return add_leaf(cg, fetch(operand) .. "\nreturn x ~= nil and x ~= false")
+end
+
+-- True once cond held on every sample for at least ms
+local gen_for = function(cg, cond, ms)
+    return add_leaf(cg, "if not (" .. cond .. ") then since# = nil return false end\n"
+        .. "since# = since# or now\nreturn now - since# >= " .. quote(ms), "since#")
+end
+
+-- Latched: switches on with on_cond, off with off_cond
+local gen_until = function(cg, on_cond, off_cond)
+    return add_leaf(cg, "if on# then\nif " .. off_cond .. " then on# = false end\n"
+        .. "elseif " .. on_cond .. " then on# = true end\nreturn on#", "on# = false")
+end
+
+local length = function(x)
+    if type(x) == "string" then
+        return #x
+    elseif type(x) == "table" then
+        local count = #x
+        if count == 0 then
+            for _ in pairs(x) do count = count + 1 end
+        end
+        return count
+    end
+end
+
+local contains = function(x, lit)
+    if type(x) == "string" then
+        return x:find(tostring(lit), 1, true) ~= nil
+    elseif type(x) == "table" then
+        for _, item in pairs(x) do
+            if item == lit then return true end
+        end
+    end
+    return false
+end
+
+-- Bind the condition references and load the chunk
+local link = function(cg, expr)
+    local ref = (cg.leaves <= MAX_DIRECT_LEAVES) and "L%1" or "F[%1]"
+    local bind = function(code) return (code:gsub("@(%d+)@", ref)) end
+
+    local lines = { "local type, tonumber, sub, find, time, length, contains, S = ..." }
+    for _, decl in ipairs(cg.decls) do
+        lines[#lines + 1] = bind(decl)
+    end
+    if cg.leaves > MAX_DIRECT_LEAVES then
+        local names = {}
+        for i = 1, cg.leaves do names[i] = "L" .. i end
+        lines[#lines + 1] = "local F = { " .. table.concat(names, ", ") .. " }"
+    end
+
+    -- A lone condition without timing is returned as is (one call per sample)
+    if expr == "@1@(v, now)" and cg.leaves == 1 then
+        lines[#lines + 1] = "return L1"
+    else
+        lines[#lines + 1] = "return function(v, now)\nnow = now or time() * 1000\nreturn " .. bind(expr) .. "\nend"
+    end
+
+    local chunk, err = (loadstring or load)(table.concat(lines, "\n"), "=judge")
+    if not chunk then
+        return nil, err
+    end
+    return chunk(type, tonumber, string.sub, string.find, os.time, length, contains, cg.sets)
+end
+
+------------------------------
+-- Parser                  --
+------------------------------
+local parse = function(tokens)
+    local pos = 1
+    local bare = false      -- the whole expression is one operand (legacy literal)
+    local cg = new_codegen()
+
+    local peek = function() return tokens[pos] end
+    local is = function(t, v)
+        local tok = tokens[pos]
+        return tok and (tok.t == t) and ((v == nil) or (tok.v == v))
+    end
+    local expect = function(t, v)
+        if not is(t, v) then
+            error("expected " .. (v or t), 0)
+        end
+        pos = pos + 1
+        return tokens[pos - 1]
+    end
+
+    local parse_expr
+
+    local parse_number = function()
+        local tok = expect("num")
+        if tok.unit == "" then return tok.v end
+        if not SCALE[tok.unit] then error("bad unit '" .. tok.unit .. "'", 0) end
+        return tok.v * SCALE[tok.unit]
+    end
+
+    local parse_duration = function()
+        local tok = expect("num")
+        local scale = (tok.unit == "") and 1000 or DURATION[tok.unit]
+        if not scale then error("bad duration unit '" .. tok.unit .. "'", 0) end
+        return tok.v * scale
+    end
+
+    local parse_literal = function()
+        local tok = peek()
+        if not tok then error("value expected", 0) end
+        if tok.t == "num" then return parse_number() end
+        if tok.t == "str" then pos = pos + 1 return tok.v end
+        if tok.t == "kw" and tok.v == "nil" then
+            pos = pos + 1
+            return nil
+        end
+        if tok.t == "kw" and (tok.v == "true" or tok.v == "false") then
+            pos = pos + 1
+            return tok.v == "true"
+        end
+        if tok.t == "id" then
+            -- bare word on the right: a string (mode == up)
+            pos = pos + 1
+            return tok.v
+        end
+        error("value expected", 0)
+    end
+
+    local parse_operand = function()
+        local operand = { segments = {} }
+        local segments = operand.segments
+        local add = function(word)
+            for seg in word:gmatch("[^%.]+") do
+                segments[#segments + 1] = tonumber(seg) or seg
+            end
+        end
+
+        if is("op", "#") then
+            pos = pos + 1
+            operand.length = true
+        end
+
+        add(expect("id").v)
+        if segments[1] == "value" then
+            table.remove(segments, 1)
+        end
+
+        while is("op", "[") or is("op", ".") do
+            if is("op", ".") then
+                pos = pos + 1
+                add(expect("id").v)
+            else
+                pos = pos + 1
+                if is("num") then
+                    segments[#segments + 1] = parse_number()
+                else
+                    segments[#segments + 1] = expect("str").v
+                end
+                expect("op", "]")
+            end
+        end
+
+        return operand
+    end
+
+    local parse_condition = function()
+        if is("op", "(") then
+            pos = pos + 1
+            local e = parse_expr()
+            expect("op", ")")
+            return e
+        end
+
+        local start = pos
+        local operand = parse_operand()
+        local tok = peek()
+
+        if not tok or (tok.t == "kw" and (tok.v == "and" or tok.v == "or" or tok.v == "for" or tok.v == "until"))
+            or (tok.t == "op" and (tok.v == ")" or tok.v == "&&" or tok.v == "||")) then
+            bare = (start == 1) and (tok == nil)
+            return gen_truthy(cg, operand)
+        end
+
+        if tok.t == "op" and (tok.v == "==" or tok.v == "!=" or tok.v == "~=" or
+            tok.v == "<" or tok.v == "<=" or tok.v == ">" or tok.v == ">=") then
+            pos = pos + 1
+            local op = (tok.v == "~=") and "!=" or tok.v
+            local lit = parse_literal()
+            if (lit == nil or type(lit) == "boolean") and NUMBER_OPS[op] then
+                error("nil and booleans only compare with == and !=", 0)
+            end
+            return gen_compare(cg, operand, op, lit)
+        end
+
+        if tok.t == "kw" and tok.v == "in" then
+            pos = pos + 1
+            if is("op", "[") or is("op", "(") then
+                local inclusive = is("op", "[")
+                pos = pos + 1
+                local low = parse_number()
+                expect("op", ",")
+                local high = parse_number()
+                expect("op", inclusive and "]" or ")")
+                return gen_range(cg, operand, low, high, inclusive)
+            end
+            expect("op", "{")
+            local items = {}
+            if not is("op", "}") then
+                items[1] = parse_literal()
+                while is("op", ",") do
+                    pos = pos + 1
+                    items[#items + 1] = parse_literal()
+                end
+            end
+            expect("op", "}")
+            return gen_set(cg, operand, items)
+        end
+
+        if tok.t == "kw" and tok.v == "contains" then
+            pos = pos + 1
+            return gen_contains(cg, operand, parse_literal())
+        end
+
+        if tok.t == "kw" and (tok.v == "startswith" or tok.v == "endswith") then
+            pos = pos + 1
+            return gen_affix(cg, operand, tostring(parse_literal()), tok.v == "endswith")
+        end
+
+        if tok.t == "kw" and tok.v == "matches" then
+            pos = pos + 1
+            local pattern = expect("str").v
+            local ok, err = pcall(string.find, "", pattern)
+            if not ok then error("bad pattern: " .. tostring(err), 0) end
+            return gen_matches(cg, operand, pattern)
+        end
+
+        error("operator expected", 0)
+    end
+
+    local parse_temporal = function()
+        local cond = parse_condition()
+
+        if is("kw", "for") then
+            pos = pos + 1
+            cond = gen_for(cg, cond, parse_duration())
+        end
+
+        if is("kw", "until") then
+            pos = pos + 1
+            local off = parse_condition()
+            if is("kw", "for") then
+                pos = pos + 1
+                off = gen_for(cg, off, parse_duration())
+            end
+            cond = gen_until(cg, cond, off)
+        end
+
+        return cond
+    end
+
+    local parse_unary
+    parse_unary = function()
+        if is("kw", "not") or is("op", "!") then
+            pos = pos + 1
+            return "not " .. parse_unary()
+        end
+        return parse_temporal()
+    end
+
+    local parse_and = function()
+        local left = parse_unary()
+        while is("kw", "and") or is("op", "&&") do
+            pos = pos + 1
+            left = "(" .. left .. " and " .. parse_unary() .. ")"
+        end
+        return left
+    end
+
+    parse_expr = function()
+        local left = parse_and()
+        while is("kw", "or") or is("op", "||") do
+            pos = pos + 1
+            left = "(" .. left .. " or " .. parse_and() .. ")"
+        end
+        return left
+    end
+
+    local ok, result = pcall(parse_expr)
+    if not ok then
+        return nil, result
+    end
+    if pos <= #tokens then
+        return nil, "unexpected '" .. tostring(tokens[pos].v) .. "'"
+    end
+    if bare then
+        return nil, "bare operand"
+    end
+    return link(cg, result)
+end
+
+------------------------------
+-- Function Defines  [START] --
+------------------------------
+
+-- Legacy judge: the result is the literal, or a list result contains it
+local compile_literal = function(lit)
+    local num = tonumber(lit)
+    return function(v)
+        if type(v) == "table" then
+            for _, item in pairs(v) do
+                if (item == lit) or ((num ~= nil) and (item == num)) then return true end
+            end
+            return false
+        end
+        return (v == lit) or ((num ~= nil) and (v == num))
+    end
+end
+
+-- Operators or keywords: meant as an expression, never as a legacy literal
+local looks_like_expression = function(src)
+    if src:find("[<>=!~&|%(%)%[%]{}#]") then
+        return true
+    end
+    for word in src:gmatch("%S+") do
+        if KEYWORDS[word] and (word ~= src) then
+            return true
+        end
+    end
+    return false
+end
+
+--- Compile one judge string.
+-- @param src string
+-- @return function(value, now_ms) -> boolean, and whether src was an expression;
+--         nil, false and the parse error for a broken expression
+local compile_one = function(src)
+    local tokens, err = tokenize(src)
+    local fn
+    if tokens then
+        fn, err = parse(tokens)
+    end
+    if fn then
+        return fn, true
+    end
+    if looks_like_expression(src) then
+        return nil, false, err
+    end
+    return compile_literal(src), false
+end
+
+--- Compile the judge list of an event into one condition (any judge matches).
+-- @param judges string or list of strings
+-- @return function(value, now_ms) -> boolean, or nil for an empty list;
+--         and the list of dropped judges ("'<judge>': <reason>"), if any
+local compile = function(judges)
+    if type(judges) == "string" then
+        judges = { judges }
+    end
+    if type(judges) ~= "table" or #judges == 0 then
+        return nil
+    end
+
+    local conds = {}
+    local errors
+    for _, src in ipairs(judges) do
+        local fn, _, err = compile_one(src)
+        if fn then
+            conds[#conds + 1] = fn
+        else
+            errors = errors or {}
+            errors[#errors + 1] = "'" .. src .. "': " .. tostring(err)
+        end
+    end
+
+    if #conds == 0 then
+        return nil, errors
+    end
+
+    if #conds == 1 then
+        return conds[1], errors
+    end
+
+    local n = #conds
+    return function(v, now)
+        now = now or os.time() * 1000
+        -- Every judge sees every sample: for/until keep their own timing
+        local matched = false
+        for i = 1, n do
+            if conds[i](v, now) then matched = true end
+        end
+        return matched
+    end, errors
+end
+
+--- Syntax check for UIs: nil when src is an expression, else the reason.
+-- @param src string
+-- @return string|nil
+local check = function(src)
+    local tokens, err = tokenize(src)
+    if not tokens then return err end
+    local fn, perr = parse(tokens)
+    if fn then return nil end
+    return perr
+end
+
+------------------------------
+-- Function Defines  [END] --
+------------------------------
+
+return {
+    compile     = compile,
+    compile_one = compile_one,
+    check       = check,
+}
@@ -1,6 +1,6 @@
 -- local uci = require("luci.model.uci").cursor()
-local misc = require("oasis.chat.misc")
 local debug = require("oasis.chat.debug")
+local judge = require("spring.matrix.judge")
 
 local LUA                       = {}
 LUA.TYPE                        = {}
@@ -71,6 +71,8 @@ db.list.param.name.call         = "call"
 db.list.param.name.cmdline      = "cmdline"
 db.list.param.name.args         = "args"
 db.list.param.name.script       = "script"
+db.list.param.name.judge        = "judge"
+db.list.param.name.next_phase   = "next_phase"
 
 db.define                       = {}
 db.define.param                 = {}
@@ -150,6 +152,16 @@ local register_ccode_action_func = function(defines, cmdline, name)
     defines[#defines].name[name] = _G[name]
 end
 
+-- Compile the judges of one event; broken expressions are dropped and reported
+local compile_judge = function(name, judges)
+    local cond, errors = judge.compile(judges)
+    for _, err in ipairs(errors or {}) do
+        debug:log("oasis.log", "create_phase", "[" .. tostring(name) .. "] invalid judge " .. err)
+        io.stderr:write("spring: [" .. tostring(name) .. "] invalid judge " .. err .. "\n")
+    end
+    return cond
+end
+
 -- Define func process
 local create_phase = function(defines, event_base_tbl, action_base_tbl, interval)
 
@@ -182,6 +194,8 @@ local create_phase = function(defines, event_base_tbl, action_base_tbl, interval
                     list[bvr][#list[bvr]][db.list.param.name.call] = df[defidx][db.define.param.name.name][inf[idx].name]
                     list[bvr][#list[bvr]][db.list.param.name.cmdline] = df[defidx][db.define.param.name.cmdline]
                     list[bvr][#list[bvr]][db.list.param.name.args] = inf[idx].args
+                    list[bvr][#list[bvr]][db.list.param.name.judge] = compile_judge(inf[idx].name, inf[idx].judge)
+                    list[bvr][#list[bvr]][db.list.param.name.next_phase] = inf[idx].next_phase
                 end
 
             elseif inf[idx].type == db.func.type.lua.script then
@@ -194,6 +208,8 @@ local create_phase = function(defines, event_base_tbl, action_base_tbl, interval
                     return result
                 end
                 list[bvr][#list[bvr]][db.list.param.name.script] = inf[idx].name
+                list[bvr][#list[bvr]][db.list.param.name.judge] = compile_judge(inf[idx].name, inf[idx].judge)
+                list[bvr][#list[bvr]][db.list.param.name.next_phase] = inf[idx].next_phase
             end
         end
     end
@@ -204,6 +220,29 @@ local create_phase = function(defines, event_base_tbl, action_base_tbl, interval
     return target_phase_func_list
 end
 
+-- Detector result as one line of text (shared state)
+local result_to_text = function(result)
+    if type(result) ~= LUA.TYPE.TABLE then
+        return tostring(result)
+    end
+
+    local parts = {}
+    for key, value in pairs(result) do
+        parts[#parts + 1] = tostring(key) .. "=" .. tostring(value)
+    end
+    return table.concat(parts, ",")
+end
+
+-- springd stopping (oasis.chat.misc and the luci modules it pulls in are not needed for this)
+local terminate_requested = function()
+    local f = io.open("/tmp/spring/terminate", "r")
+    if f then
+        f:close()
+        return true
+    end
+    return false
+end
+
 -- Execute func Process
 local execute_phase = function(target_phase_func_list)
 
@@ -215,7 +254,7 @@ local execute_phase = function(target_phase_func_list)
     debug:log("oasis.log", "execute_phase", "Func name: " .. func.name)
     debug:dump("oasis.log", func)
 
-        if misc.check_file_exist("/tmp/spring/terminate") then
+        if terminate_requested() then
             return PHASE.NONE
         end
 
@@ -237,6 +276,11 @@ local execute_phase = function(target_phase_func_list)
             result = func.call(func.script)
         end
 
+        -- springd only: readers of /tmp/spring/state.shm see the last result
+        if result and publish_result then
+            publish_result(func.name, result_to_text(result))
+        end
+
         -- judge exec action function
         if result then
             -- print("result type = " .. type(result))
@@ -246,10 +290,18 @@ local execute_phase = function(target_phase_func_list)
                 debug:log("oasis.log", "execute_phase", "value:" .. result)
             elseif type(result) == LUA.TYPE.TABLE then
                 for idx, value in pairs(result) do
-                    print(idx .. ": " .. value)
-                    debug:log("oasis.log", "execute_phase", "key:" .. idx .. ", value:" .. value)
+                    print(idx .. ": " .. tostring(value))
+                    debug:log("oasis.log", "execute_phase", "key:" .. idx .. ", value:" .. tostring(value))
                 end
             end
+
+            -- judge list compiled by create_phase (any judge matches);
+            -- for/until time on springd's monotonic clock, not the wall clock
+            local now = monotonic_ms and monotonic_ms() or os.time() * 1000
+            if func.judge and func.next_phase and func.judge(result, now) then
+                debug:log("oasis.log", "execute_phase", "judge matched, next phase: " .. func.next_phase)
+                next_phase = func.next_phase
+            end
         end
 
         if next_phase ~= PHASE.NONE then
@@ -271,4 +323,5 @@ return {
     register_ccode_action_func              = register_ccode_action_func,
     create_phase                            = create_phase,
     execute_phase                           = execute_phase,
+    PHASE                                   = PHASE,
 }
\ No newline at end of file
@@ -1,11 +1,17 @@
 local matrix    = require("spring.matrix.master")
-local util      = require("luci.util")
-local uci       = require("luci.model.uci").cursor()
+local uci_model = require("luci.model.uci")
+
+-- luci.util is needed by the ubus detectors only: loaded on their first call
+local util = setmetatable({}, { __index = function(proxy, key)
+    local module = require("luci.util")
+    setmetatable(proxy, { __index = module })
+    return module[key]
+end })
 
 -- How to activate debug: uci set oasis.chat.debug=1
 local debug     = require("oasis.chat.debug")
 
-local register_phase_base_tbl = function(utype)
+local register_phase_base_tbl = function(uci, utype)
 
     local phase_base_tbl = {}
 
@@ -136,14 +142,37 @@ matrix.register_ccode_event_detecter_func(defines, true, "get_if_ipv4")
 matrix.register_ccode_event_detecter_func(defines, true, "get_netmask")
 matrix.register_ccode_event_detecter_func(defines, true, "get_mtu")
 matrix.register_ccode_event_detecter_func(defines, true, "get_mac_addr")
+matrix.register_ccode_event_detecter_func(defines, true, "get_if_addrs")
+matrix.register_ccode_event_detecter_func(defines, false, "get_all_interfaces")
+matrix.register_ccode_event_detecter_func(defines, true, "get_if_rate")
+matrix.register_ccode_event_detecter_func(defines, true, "get_if_error_rate")
+matrix.register_ccode_event_detecter_func(defines, true, "get_flow_stats")
+matrix.register_ccode_event_detecter_func(defines, false, "get_capture_stats")
+matrix.register_ccode_event_detecter_func(defines, true, "get_neighbor")
+matrix.register_ccode_event_detecter_func(defines, true, "get_neighbors")
+matrix.register_ccode_event_detecter_func(defines, true, "get_new_neighbors")
+
+-- IPv4 and IPv6 address of one interface from a single cached address query
+matrix.register_luacode_event_detecter_func(defines, true, "get_if_dual_stack", function(args)
+    local ifname = (args and args[1]) or "br-lan"
+    local addrs = get_if_addrs and get_if_addrs(ifname) or {}
+    local result = {}
+
+    for _, addr in ipairs(addrs) do
+        if (addr.family == "inet") and (not result.ipv4) then
+            result.ipv4 = addr.address
+        elseif (addr.family == "inet6") and (addr.scope == "global") and (not result.ipv6) then
+            result.ipv6 = addr.address
+        end
+    end
+
+    return result
+end)
 -- Type Code Only
 -------------------------------------------------------
 --                   [PHASE 1]                       --
 -------------------------------------------------------
 
-local evt_base_tbl = {}
-local act_base_tbl = {}
-
 local phase_event_type_list = {
     "phase_a_event",
     "phase_b_event",
@@ -154,19 +183,11 @@ local phase_action_type_list = {
     "phase_b_action",
 }
 
-for _, uci_phase_type in ipairs(phase_event_type_list) do
-    evt_base_tbl[#evt_base_tbl + 1] = register_phase_base_tbl(uci_phase_type)
-end
-
-for _, uci_phase_type in ipairs(phase_action_type_list) do
-    act_base_tbl[#act_base_tbl + 1] = register_phase_base_tbl(uci_phase_type)
-end
-
-debug:log("oasis.log", "init", "Event")
-debug:dump("oasis.log", evt_base_tbl)
-
-debug:log("oasis.log", "init", "Action")
-debug:dump("oasis.log", act_base_tbl)
+-- Interval (sec) between the event functions of each phase
+local phase_interval_list = {
+    nil,
+    1,
+}
 
 -- #1 func config
 -- uci add spring
@@ -223,23 +244,117 @@ phase2_evt_base_tbl[#phase2_evt_base_tbl].type     = "luacode"
 phase2_evt_base_tbl[#phase2_evt_base_tbl].name     = "get_os_name"
 ]]
 
-local matrix_phase_tbl = {}
-matrix_phase_tbl[#matrix_phase_tbl + 1] = matrix.create_phase(defines, evt_base_tbl[1], act_base_tbl[1]) -- phase1
-matrix_phase_tbl[#matrix_phase_tbl + 1] = matrix.create_phase(defines, evt_base_tbl[2], act_base_tbl[2], 1) -- phase2
+-- Stable text of a base table: equal text, equal phase
+local signature
+signature = function(value)
+    if type(value) ~= "table" then
+        return type(value) .. ":" .. tostring(value)
+    end
+
+    local keys = {}
+    for key, _ in pairs(value) do
+        keys[#keys + 1] = key
+    end
+    table.sort(keys, function(a, b) return tostring(a) < tostring(b) end)
+
+    local parts = {}
+    for _, key in ipairs(keys) do
+        parts[#parts + 1] = tostring(key) .. "=" .. signature(value[key])
+    end
+    return "{" .. table.concat(parts, ",") .. "}"
+end
+
+-- Read the phase sections with a fresh cursor and compile every phase
+local build_phase_set = function()
+    local uci = uci_model.cursor()
+    local set = { phases = {}, signatures = {} }
+
+    for idx, uci_phase_type in ipairs(phase_event_type_list) do
+        local evt_base_tbl = register_phase_base_tbl(uci, uci_phase_type)
+        local act_base_tbl = register_phase_base_tbl(uci, phase_action_type_list[idx])
+
+        debug:log("oasis.log", "build_phase_set", uci_phase_type)
+        debug:dump("oasis.log", evt_base_tbl)
+        debug:dump("oasis.log", act_base_tbl)
+
+        set.signatures[idx] = signature({ evt_base_tbl, act_base_tbl, phase_interval_list[idx] })
+        set.phases[idx] = matrix.create_phase(defines, evt_base_tbl, act_base_tbl, phase_interval_list[idx])
+    end
+
+    return set
+end
+
+local phase_set = build_phase_set()
+
+-- Called by springd between evaluations when /etc/config/spring changed (inotify or SIGHUP)
+function reload_phase_set()
+    local started = os.clock()
+
+    local ok, set = pcall(build_phase_set)
+    if not ok then
+        debug:log("oasis.log", "reload_phase_set", "kept the running phases: " .. tostring(set))
+        return false
+    end
+
+    -- Unchanged phases keep their compiled judges (for/until timers run on)
+    local kept = 0
+    for idx, sig in ipairs(set.signatures) do
+        if phase_set.signatures[idx] == sig then
+            set.phases[idx] = phase_set.phases[idx]
+            kept = kept + 1
+        end
+    end
+
+    phase_set = set
+
+    debug:log("oasis.log", "reload_phase_set", string.format("%d phase(s), %d unchanged, %.1f ms",
+        #set.phases, kept, (os.clock() - started) * 1000))
+    return true
+end
 
+-- Current phase for the shared state (publish_phase exists in springd only)
+local publish_current_phase = function(idx)
+    if publish_phase and phase_event_type_list[idx] then
+        publish_phase((phase_event_type_list[idx]:gsub("_event$", "")))
+    end
+end
+
+-- Every phase once, in order (manual test; springd drives execute_target_phase)
 function test_exec_allevents()
-    debug:log("oasis.log", "test_exec_allevents", "called by springd")
-    for idx, phase in ipairs(matrix_phase_tbl) do
+    debug:log("oasis.log", "test_exec_allevents", "called")
+    for idx, phase in ipairs(phase_set.phases) do
         print("---- " .. "[PHASE " .. idx .. "] ----")
+        publish_current_phase(idx)
         matrix.execute_phase(phase)
     end
 end
 
 function get_phase_max_idx()
-    return #matrix_phase_tbl
+    return #phase_set.phases
 end
 
+-- next_phase option ("phase_b") -> index in phase_event_type_list
+local phase_index = function(name)
+    for idx, uci_phase_type in ipairs(phase_event_type_list) do
+        if (uci_phase_type == name) or (uci_phase_type == name .. "_event") then
+            return idx
+        end
+    end
+    return nil
+end
+
+-- Called by springd every matrix_ctrl_thread interval with the active phase.
+-- Returns the index of the phase to switch to (nil: stay).
 function execute_target_phase(idx)
-    local next_phase = matrix.execute_phase(matrix_phase_tbl[idx])
-    return next_phase
+    publish_current_phase(idx)
+    local next_phase = matrix.execute_phase(phase_set.phases[idx])
+    if next_phase == matrix.PHASE.NONE then
+        return nil
+    end
+
+    local next_idx = phase_index(next_phase)
+    if not next_idx then
+        debug:log("oasis.log", "execute_target_phase", "unknown next_phase: " .. tostring(next_phase))
+    end
+    return next_idx
 end
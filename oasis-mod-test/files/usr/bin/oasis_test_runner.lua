@@ -57,6 +57,7 @@ local function to_route_value(route)
     if route == "1" or route == "ubus" then return "1" end
     if route == "2" or route == "cli" then return "2" end
     if route == "3" or route == "local" then return "3" end
+    if route == "4" or route == "bench" then return "4" end
     return nil
 end
 
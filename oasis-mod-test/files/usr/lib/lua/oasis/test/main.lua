@@ -161,14 +161,68 @@ local function read_file_or_err(path)
     return content
 end
 
+-- Pieces that reach every branch of the UTF-8/spoof check: ASCII, controls,
+-- lead/continuation/invalid bytes, flagged code points, overlong forms
+local SPOOF_PIECES = {
+    "a", " ", "~", "\127", "\0", "\n", "\128", "\191", "\192", "\193", "\194", "\223",
+    "\224", "\237", "\239", "\240", "\244", "\245", "\255",
+    "\226\128\174", "\226\128\139", "\239\187\191", "\204\129", "\239\184\143",
+    "\240\159\152\128", "\230\151\165", "\195\169",
+    "\224\140\129", "\237\160\128", "\244\144\128\128", "\240\128\128\128",
+}
+
+local function spoof_sample()
+    local mode = math.random()
+    local out = {}
+    if mode < 0.4 then
+        for i = 1, math.random(0, 40) do
+            out[i] = string.char(math.random(0, 255))
+        end
+    elseif mode < 0.8 then
+        for i = 1, math.random(0, 12) do
+            out[i] = SPOOF_PIECES[math.random(#SPOOF_PIECES)]
+        end
+    else
+        -- long ASCII runs around one piece (vector/SWAR block boundaries)
+        out[1] = string.rep("x", math.random(0, 70))
+        out[2] = SPOOF_PIECES[math.random(#SPOOF_PIECES)]
+        out[3] = string.rep("y", math.random(0, 40))
+    end
+    return table.concat(out)
+end
+
+local function guard_fuzz(a)
+    local guard = require("oasis.security.guard")
+    if not guard.native then
+        println("oasis.security.native is not installed")
+        return
+    end
+    local count = tonumber(a.count) or 100000
+    local seed = tonumber(a.seed) or os.time()
+    local diffs = 0
+    math.randomseed(seed)
+    for _ = 1, count do
+        local s = spoof_sample()
+        local l1, l2 = guard.detect_encoding_spoof_lua(s)
+        local n1, n2 = guard.native.detect_encoding_spoof(s)
+        if (l1 ~= n1) or (l2 ~= n2) then
+            diffs = diffs + 1
+            if diffs <= 10 then
+                println(string.format("diff: %q lua=%s,%s native=%s,%s", s, tostring(l1), tostring(l2), tostring(n1), tostring(n2)))
+            end
+        end
+    end
+    println(string.format("seed=%d cases=%d diffs=%d", seed, count, diffs))
+end
+
 local local_menu = {
     -- oasis.chat.misc
     { key = "1", title = "misc.normalize_path", desc = "Ensure trailing slash", args = { {name="path"} }, run = function(a)
         println(misc.normalize_path(a.path or ""))
     end },
-    { key = "2", title = "misc.markdown", desc = "ANSI style convert (code/bold)", args = { {name="mark_mode"}, {name="message"} }, run = function(a)
+    { key = "2", title = "misc.markdown", desc = "ANSI style convert (code/bold/heading/list)", args = { {name="mark_mode"}, {name="message"} }, run = function(a)
         local mark = (a.mark_mode == "stateful") and {} or nil
-        println(misc.markdown(mark, a.message or ""))
+        println(misc.markdown(mark, a.message or "") .. misc.markdown_flush(mark))
     end },
     { key = "3", title = "misc.touch", desc = "Create empty file if not exists (/tmp)", args = { {name="path"} }, run = function(a)
         local p = a.path or "/tmp/oasis_test.touch"
@@ -245,6 +299,332 @@ local local_menu = {
         println("result=" .. tostring(res))
         println(pretty(chat))
     end },
+
+    -- oasis.security.guard
+    { key = "16", title = "guard native vs lua (fuzz)", desc = "Differential fuzz of detect_encoding_spoof (C module vs Lua)", args = { {name="count"}, {name="seed"} }, run = function(a)
+        guard_fuzz(a)
+    end },
+}
+
+-- ============ Benchmarks ============
+local function now_ms()
+    local nixio = require("nixio")
+    local sec, usec = nixio.gettimeofday()
+    return sec * 1000 + usec / 1000
+end
+
+-- Run fn count times; returns avg/min/max in milliseconds
+local function measure(count, fn)
+    count = tonumber(count) or 10
+    if count < 1 then count = 1 end
+    local total, min, max = 0, nil, 0
+    for _ = 1, count do
+        local t0 = now_ms()
+        fn()
+        local dt = now_ms() - t0
+        total = total + dt
+        if (not min) or (dt < min) then min = dt end
+        if dt > max then max = dt end
+    end
+    return { avg = total / count, min = min, max = max, count = count }
+end
+
+local function print_measure(label, m)
+    println(string.format("%-28s n=%-4d avg=%9.2fms min=%9.2fms max=%9.2fms", label, m.count, m.avg, m.min, m.max))
+end
+
+local function exec_rpcd(object, method, args)
+    local cmd = string.format("echo %s | /usr/libexec/rpcd/%s call %s",
+        util.shellquote(jsonc.stringify(args or {})), object, method)
+    return sys.exec(cmd)
+end
+
+local function bench_resident(a)
+    local resident = require("oasis.ubus.resident")
+    local count = tonumber(a.count) or 20
+    local id = a.id or ""
+    local mode = resident.is_enabled() and "resident (oasis_ubusd)" or "rpcd exec plugin"
+    local targets = {
+        { object = "oasis.chat", method = "list", args = {} },
+        { object = "oasis.chat", method = "load", args = { id = id } },
+        { object = "oasis", method = "base_info", args = {} },
+    }
+
+    println("ubus objects served by: " .. mode)
+
+    for _, t in ipairs(targets) do
+        if (t.method ~= "load") or (#id > 0) then
+            local name = t.object .. " " .. t.method
+            -- exec-per-call: what rpcd does for every call (interpreter start + module load)
+            print_measure(name .. " [exec]", measure(count, function() exec_rpcd(t.object, t.method, t.args) end))
+            -- ubus round trip to whoever owns the object
+            print_measure(name .. " [ubus]", measure(count, function() util.ubus(t.object, t.method, t.args) end))
+        end
+    end
+end
+
+local function bench_tool_host(a)
+    local ok, host = pcall(require, "oasis.local.tool.host")
+    if not ok then
+        println("oasis-mod-tool is not installed")
+        return
+    end
+    local count = tonumber(a.count) or 20
+    local targets = {
+        { object = "oasis.system", method = "get_memory_info", args = {} },
+        { object = "oasis.network", method = "get_lan_ipaddr", args = {} },
+    }
+
+    for _, t in ipairs(targets) do
+        local name = t.object .. " " .. t.method
+        local mode = host.is_served(t.object) and "tool host" or "rpcd exec plugin"
+        println(name .. " served by: " .. mode)
+        -- exec-per-call: interpreter start + script load + stdin parse
+        print_measure(name .. " [exec]", measure(count, function() exec_rpcd(t.object, t.method, t.args) end))
+        print_measure(name .. " [ubus]", measure(count, function() util.ubus(t.object, t.method, t.args) end))
+    end
+end
+
+-- Restart sequence used by apply.lua before the reload planner (one restart per set command)
+local function legacy_restart(configs)
+    local network_done = false
+    for _, config in ipairs(configs) do
+        if ((config == "network") or (config == "wireless")) and (not network_done) then
+            sys.exec("/etc/init.d/network restart")
+            network_done = true
+        end
+    end
+    for _, config in ipairs(configs) do
+        if (config ~= "network") and (config ~= "wireless") and misc.check_file_exist("/etc/init.d/" .. config) then
+            sys.exec("/etc/init.d/" .. config .. " restart")
+        end
+    end
+end
+
+local function bench_reload(a)
+    local apply = require("oasis.chat.apply")
+    local configs = {}
+    local uci_list = { set = {} }
+    for config in tostring(a.configs or ""):gmatch("[%w_%-]+") do
+        configs[#configs + 1] = config
+        uci_list.set[#uci_list.set + 1] = { class = { config = config } }
+    end
+
+    local plan = apply.plan_reload(uci_list)
+    for i, stage in ipairs(plan) do
+        println(string.format("stage %d: configs=%s netifd=%s", i, table.concat(stage.configs, ","), bool_str(stage.netifd)))
+        for _, script in ipairs(stage.scripts) do
+            println("    " .. script)
+        end
+    end
+
+    if a.mode ~= "run" then
+        println("(plan only; mode=run restarts/reloads the services and measures both)")
+        return
+    end
+
+    print_measure("legacy restart per command", measure(1, function() legacy_restart(configs) end))
+    print_measure("reload planner", measure(1, function() apply.run_reload(plan) end))
+end
+
+-- Marker replacement used by misc.markdown before the streaming renderer (find + gsub per marker)
+local function legacy_markdown(counters, msg)
+    while msg:find("```", 1, true) do
+        counters.code_block = counters.code_block + 1
+        msg = msg:gsub("```", ((counters.code_block % 2) == 1) and "\27[1;32;47m" or "\27[0m", 1)
+    end
+    while msg:find("%*%*") do
+        counters.bold_text = counters.bold_text + 1
+        msg = msg:gsub("%*%*", ((counters.bold_text % 2) == 1) and "\27[1;33m" or "\27[0m", 1)
+    end
+    return msg
+end
+
+local function bench_markdown(a)
+    local items = tonumber(a.items) or 2000
+    local chunk = tonumber(a.chunk) or 16
+    local count = tonumber(a.count) or 5
+
+    local lines = { "# Result", "" }
+    for i = 1, items do
+        lines[#lines + 1] = string.format("- item **%d** uses `opt_%d` and **bold** text", i, i)
+        if (i % 20) == 0 then
+            lines[#lines + 1] = "```sh\nuci set network.lan.ipaddr='192.168.1." .. (i % 250) .. "'\n```"
+        end
+    end
+    local reply = table.concat(lines, "\n")
+
+    -- Streamed in fixed-size pieces, like the chunks of an AI service
+    local pieces = {}
+    for i = 1, #reply, chunk do
+        pieces[#pieces + 1] = reply:sub(i, i + chunk - 1)
+    end
+
+    println(string.format("reply: %d bytes, %d pieces of %d bytes", #reply, #pieces, chunk))
+
+    print_measure("legacy, whole reply", measure(count, function()
+        legacy_markdown({ code_block = 0, bold_text = 0 }, reply)
+    end))
+    print_measure("legacy, streamed", measure(count, function()
+        local counters = { code_block = 0, bold_text = 0 }
+        for _, piece in ipairs(pieces) do
+            legacy_markdown(counters, piece)
+        end
+    end))
+    print_measure("renderer, whole reply", measure(count, function()
+        misc.markdown(nil, reply)
+    end))
+    print_measure("renderer, streamed", measure(count, function()
+        local mark = {}
+        for _, piece in ipairs(pieces) do
+            misc.markdown(mark, piece)
+        end
+        misc.markdown_flush(mark)
+    end))
+end
+
+local function bench_guard(a)
+    local guard = require("oasis.security.guard")
+    local count = tonumber(a.count) or 20
+    local size = tonumber(a.size) or 65536
+
+    -- Typical tool/UCI inputs: ASCII, and mixed text with non-ASCII characters
+    local inputs = {
+        { name = "ascii", text = string.rep("network.lan.ipaddr=192.168.1.1 ", math.ceil(size / 31)):sub(1, size) },
+        { name = "mixed", text = string.rep("wifi ssid \230\151\165\230\156\172 caf\195\169 ", math.ceil(size / 23)):sub(1, size) },
+    }
+
+    println("native module: " .. (guard.native and ("yes (" .. tostring(guard.native.ascii_path) .. ")") or "not installed"))
+
+    for _, input in ipairs(inputs) do
+        local mb = #input.text / (1024 * 1024)
+        local function report(label, fn)
+            local m = measure(count, fn)
+            print_measure(label, m)
+            println(string.format("%-28s %.1f MB/s", "", mb / (m.avg / 1000)))
+        end
+        report(input.name .. " [lua]", function() guard.detect_encoding_spoof_lua(input.text) end)
+        if guard.native then
+            report(input.name .. " [native]", function() guard.native.detect_encoding_spoof(input.text) end)
+        end
+    end
+end
+
+local function bench_judge(a)
+    local ok, judge = pcall(require, "spring.matrix.judge")
+    if not ok then
+        println("spring.matrix.judge not installed (oasis-mod-spring)")
+        return
+    end
+
+    local conditions = tonumber(a.conditions) or 5000
+    local count = tonumber(a.count) or 20
+
+    local sources = {
+        "rx_p95 >= 10M",
+        "rx_p95 >= 10M for 30s",
+        "operstate in {'up','unknown'} and mtu in [1280,1500]",
+        "ifname startswith 'wl' or err_rate > 5",
+        "rx > 80M until rx < 60M",
+        "#addrs > 0 and not master == nil",
+    }
+    local sample = { rx_p95 = 1.5e7, operstate = "up", mtu = 1500, ifname = "wlan0", err_rate = 1, rx = 9e7, addrs = { 1 }, master = "br0" }
+
+    local compiled = {}
+    print_measure(string.format("compile %d", conditions), measure(1, function()
+        for i = 1, conditions do
+            compiled[i] = judge.compile(sources[(i % #sources) + 1])
+        end
+    end))
+
+    local now = 0
+    print_measure(string.format("evaluate %d", conditions), measure(count, function()
+        now = now + 1000
+        for i = 1, conditions do
+            compiled[i](sample, now)
+        end
+    end))
+end
+
+-- Fresh springd: time from process start to the first phase evaluation (published by springd)
+local springd_startup = function(old_pid)
+    local ok, state = pcall(require, "spring.state")
+    if not ok then
+        return nil
+    end
+    for _ = 1, 100 do
+        local s = state.snapshot()
+        if s and (s.pid ~= 0) and (s.pid ~= old_pid) and s.results.springd_startup then
+            return s.results.springd_startup.value
+        end
+        sys.exec("sleep 0.1")
+    end
+    return nil
+end
+
+local function bench_startup(a)
+    local count = tonumber(a.count) or 20
+    local modules = {
+        "/usr/lib/lua/spring/matrix/master.lua",
+        "/usr/lib/lua/spring/matrix/judge.lua",
+    }
+
+    -- What springd does per Lua state: parse the source, or load the cached bytecode
+    for _, path in ipairs(modules) do
+        local fn = loadfile(path)
+        if not fn then
+            println(path .. " not installed (oasis-mod-spring)")
+            return
+        end
+        local bytecode = string.dump(fn)
+        local name = path:match("([^/]+)$")
+        print_measure(name .. " [source]", measure(count, function() loadfile(path) end))
+        print_measure(name .. " [bytecode]", measure(count, function() loadstring(bytecode, "=" .. name) end))
+    end
+
+    -- Modules phase.lua no longer loads up front, each in a fresh interpreter
+    local base = measure(count, function() sys.exec("lua -e ''") end)
+    print_measure("lua start", base)
+    for _, module in ipairs({ "luci.util", "oasis.chat.misc" }) do
+        local m = measure(count, function() sys.exec("lua -e 'require(\"" .. module .. "\")'") end)
+        println(string.format("%-28s +%.2fms", "require " .. module, m.avg - base.avg))
+    end
+
+    if a.mode ~= "run" then
+        println("(mode=run restarts springd and reports its time to the first phase evaluation)")
+        return
+    end
+
+    local ok, state = pcall(require, "spring.state")
+    local before = ok and state.snapshot()
+    sys.exec("/etc/init.d/spring restart")
+    local startup = springd_startup(before and before.pid or 0)
+    println("springd: " .. (startup or "no startup result (is spring.ctrl.bootstart=1 and springd running?)"))
+    println("(first start after boot compiles the bytecode cache; run again for the cached start)")
+end
+
+local bench_menu = {
+    { key = "1", title = "resident vs exec", desc = "Latency of list/load/base_info (exec-per-call vs ubus)", args = { {name="id"}, {name="count"} }, run = function(a)
+        bench_resident(a)
+    end },
+    { key = "2", title = "reload planner", desc = "Apply-to-ready time: per-command restart vs planned reload (configs e.g. dhcp,dhcp,network,firewall; mode plan|run)", args = { {name="configs"}, {name="mode"} }, run = function(a)
+        bench_reload(a)
+    end },
+    { key = "3", title = "tool host vs exec", desc = "Latency of Lua local tool calls (exec-per-call vs ubus; enable oasis.tool_host to compare)", args = { {name="count"} }, run = function(a)
+        bench_tool_host(a)
+    end },
+    { key = "4", title = "markdown renderer", desc = "Console markdown conversion of a large reply (find/gsub vs streaming renderer)", args = { {name="items"}, {name="chunk"}, {name="count"} }, run = function(a)
+        bench_markdown(a)
+    end },
+    { key = "5", title = "guard spoof check", desc = "Throughput of detect_encoding_spoof (Lua vs C module)", args = { {name="size"}, {name="count"} }, run = function(a)
+        bench_guard(a)
+    end },
+    { key = "6", title = "judge expressions", desc = "Compile and per-sample evaluation time of spring phase judges", args = { {name="conditions"}, {name="count"} }, run = function(a)
+        bench_judge(a)
+    end },
+    { key = "7", title = "springd startup", desc = "Spring module load (source vs bytecode), deferred luci modules, springd time to first phase evaluation (mode plan|run)", args = { {name="count"}, {name="mode"} }, run = function(a)
+        bench_startup(a)
+    end },
 }
 
 local function read_line(prompt)
@@ -290,6 +670,7 @@ while true do
     println("[1] ubus (oasis.chat)")
     println("[2] CLI  (/usr/bin/oasis)")
     println("[3] Local (Lua modules)")
+    println("[4] Bench")
     println("[q] quit")
     -- Optional: environment readiness hint (non-blocking)
     local ok_prepare = true
@@ -304,6 +685,7 @@ while true do
     if r == "1" then run_menu(ubus_menu) end
     if r == "2" then run_menu(cli_menu) end
     if r == "3" then run_menu(local_menu) end
+    if r == "4" then run_menu(bench_menu) end
 end
 
 println("terminate")
\ No newline at end of file
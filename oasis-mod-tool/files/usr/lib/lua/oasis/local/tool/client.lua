@@ -81,32 +81,80 @@ local function script_kind_from_source_type(source_type)
     return nil
 end
 
+local DEFAULT_TOOL_TIMEOUT = 60000   -- ms
+local UBUS_STATUS_CONNECTION_FAILED = 10
+
+-- ubus connections kept for the life of the process, one per timeout
+-- (libubus-lua applies the timeout given at connect time to every call)
+local ubus_conns = {}
+
+local function tool_timeout(timeout)
+    local t = tonumber(timeout)
+    if t and t > 0 then
+        return t
+    end
+    return DEFAULT_TOOL_TIMEOUT
+end
+
 local ubus_call = function(path, method, param, timeout)
 
     local ubus = require("ubus")
-    local conn
 
-    if timeout and type(timeout) == "string" and #timeout > 0 then
-        conn = ubus.connect(nil, tonumber(timeout))
-    elseif timeout and type(timeout) == "number" and timeout > 0 then
-        conn = ubus.connect(nil, timeout)
-    else
-        -- default: 60s
-        conn = ubus.connect(nil, 60000)
-    end
+    timeout = tool_timeout(timeout)
 
-    if not conn then
-        return { error = "Failed to connect to ubus" }
-    end
+    for attempt = 1, 2 do
+        local conn = ubus_conns[timeout] or ubus.connect(nil, timeout)
+
+        if not conn then
+            return { error = "Failed to connect to ubus" }
+        end
+
+        ubus_conns[timeout] = conn
 
-    local result, err = conn:call(path, method, param)
-    conn:close()
+        local result, err = conn:call(path, method, param)
 
-    if not result then
-        return { error = err or "Failed to execute ubus call" }
+        if result then
+            return result
+        end
+
+        -- ubusd restarted since the connection was made: reconnect once
+        if (err ~= UBUS_STATUS_CONNECTION_FAILED) or (attempt == 2) then
+            return { error = err or "Failed to execute ubus call" }
+        end
+
+        conn:close()
+        ubus_conns[timeout] = nil
     end
+end
 
-    return result
+-- Start a ubus call in a child process (ubus CLI, bounded by the tool timeout).
+-- Returns a function that waits for the child and returns its result.
+local ubus_call_spawn = function(path, method, param, timeout)
+
+    local seconds = math.max(1, math.ceil(tool_timeout(timeout) / 1000))
+    local msg = (next(param or {}) == nil) and "{}" or jsonc.stringify(param, false)
+    local cmd = string.format("ubus -t %d call %s %s %s 2>&1",
+        seconds, shell_quote(path), shell_quote(method), shell_quote(msg))
+
+    local pipe = io.popen(cmd, "r")
+
+    return function()
+        if not pipe then
+            return { error = "Failed to execute ubus call" }
+        end
+
+        local out = pipe:read("*a") or ""
+        pipe:close()
+
+        local result = jsonc.parse(out)
+
+        if type(result) ~= "table" then
+            out = out:gsub("%s+$", "")
+            return { error = (#out > 0) and out or "Failed to execute ubus call" }
+        end
+
+        return result
+    end
 end
 
 local function build_param_lists(args, args_desc, type_resolver)
@@ -155,6 +203,19 @@ local function build_tool_def(script, server, name, desc, exec_msg, download_msg
     }
 end
 
+-- Result cache hints declared by a tool (cacheable = true, ttl = <seconds>)
+local function set_cache_hint(def, cacheable, ttl)
+    ttl = tonumber(ttl)
+    if (cacheable == true) and ttl and (ttl > 0) then
+        def.cacheable = "1"
+        def.ttl = tostring(math.floor(ttl))
+    else
+        def.cacheable = "0"
+        def.ttl = ""
+    end
+    return def
+end
+
 local function scan_lua_script_defs(script_path, server_name)
     if not is_regular_file(script_path) then
         return nil, "lua tool script not found: " .. script_path
@@ -187,7 +248,7 @@ local function scan_lua_script_defs(script_path, server_name)
             return type_map[v] or "string"
         end)
 
-        defs[#defs + 1] = build_tool_def(
+        defs[#defs + 1] = set_cache_hint(build_tool_def(
             "lua",
             server_name,
             tool_name,
@@ -197,7 +258,7 @@ local function scan_lua_script_defs(script_path, server_name)
             tool.timeout,
             required,
             property
-        )
+        ), tool.cacheable, tool.ttl)
     end
 
     return defs, nil
@@ -235,7 +296,7 @@ local function scan_ucode_script_defs(script_path)
     for server, tbl in pairs(data) do
         for tool, def in pairs(tbl) do
             local required, property = build_param_lists(def.args, def.args_desc, detect_type)
-            defs[#defs + 1] = build_tool_def(
+            defs[#defs + 1] = set_cache_hint(build_tool_def(
                 "ucode",
                 server,
                 tool,
@@ -245,13 +306,119 @@ local function scan_ucode_script_defs(script_path)
                 def.timeout,
                 required,
                 property
-            )
+            ), def.cacheable, def.ttl)
         end
     end
 
     return defs, nil
 end
 
+--[[
+[Tool Scan Cache]
+Scanning a tool script runs it (lua: "<script> meta", ucode: "ucode <script>"),
+which dominates rebuilding the manifests on routers with many plugins.
+The definitions found in each script are kept in scan_cache_file together with
+the script's mtime, size and content hash:
+ - same mtime and size      -> cached definitions, the script is not read
+ - same hash (file touched) -> cached definitions, mtime/size updated
+ - otherwise                -> the script is scanned again
+The whole cache is dropped when the tool server library changes, since it
+shapes the scanned definitions. The file is only written when an entry changed.
+]]
+local scan_cache_file = "/etc/oasis/tool_scan_cache.json"
+local scan_cache_libs = {
+    "/usr/lib/lua/oasis/local/tool/server.lua",
+    "/usr/share/ucode/oasis/local/tool/server.uc",
+}
+local scan_cache = nil
+local scan_cache_dirty = false
+
+local function scan_cache_lib_key()
+    local parts = {}
+    for _, path in ipairs(scan_cache_libs) do
+        local st = fs.stat(path)
+        parts[#parts + 1] = st and string.format("%s:%s", tostring(st.mtime), tostring(st.size)) or "-"
+    end
+    return table.concat(parts, "|")
+end
+
+local function load_scan_cache()
+    if scan_cache then
+        return scan_cache
+    end
+
+    local lib_key = scan_cache_lib_key()
+    local cache = jsonc.parse(fs.readfile(scan_cache_file) or "")
+
+    if (type(cache) ~= "table") or (cache.version ~= 1) or (cache.lib ~= lib_key) or (type(cache.scripts) ~= "table") then
+        cache = { version = 1, lib = lib_key, scripts = {} }
+    end
+
+    scan_cache = cache
+    return scan_cache
+end
+
+local function save_scan_cache(present)
+    if not scan_cache then
+        return
+    end
+
+    -- Forget scripts that are gone
+    if present then
+        for path, _ in pairs(scan_cache.scripts) do
+            if not present[path] then
+                scan_cache.scripts[path] = nil
+                scan_cache_dirty = true
+            end
+        end
+    end
+
+    if not scan_cache_dirty then
+        return
+    end
+
+    local tmp = scan_cache_file .. ".tmp"
+    if fs.writefile(tmp, jsonc.stringify(scan_cache, false)) then
+        fs.rename(tmp, scan_cache_file)
+        scan_cache_dirty = false
+    end
+end
+
+-- Definitions of a script through the scan cache
+local function cached_scan(path, scan)
+    local st = fs.stat(path)
+    if not st then
+        return scan()
+    end
+
+    local cache = load_scan_cache()
+    local entry = cache.scripts[path]
+
+    if entry and (entry.mtime == st.mtime) and (entry.size == st.size) then
+        return entry.defs, nil
+    end
+
+    local content = fs.readfile(path)
+    local hash = content and misc.hash(content)
+
+    if entry and hash and (entry.hash == hash) then
+        entry.mtime = st.mtime
+        entry.size = st.size
+        scan_cache_dirty = true
+        return entry.defs, nil
+    end
+
+    local defs, err = scan()
+    if defs and hash then
+        cache.scripts[path] = { mtime = st.mtime, size = st.size, hash = hash, defs = defs }
+        scan_cache_dirty = true
+    end
+
+    debug:log("oasis.log", "cached_scan", "scanned: " .. path)
+
+    return defs, err
+end
+
 local function scan_lua_server_defs(server_name)
     local server_path = lua_ubus_server_app_dir .. server_name
 
@@ -265,7 +432,14 @@ local function scan_lua_server_defs(server_name)
         return {}, nil
     end
 
-    return scan_lua_script_defs(server_path, server_name)
+    -- Other rpcd plugins are cached as scripts without tools
+    return cached_scan(server_path, function()
+        if not is_oasis_tool_server(server_path) then
+            debug:log("oasis.log", "scan_lua_server_defs", "skip non-oasis server file: " .. server_name)
+            return {}, nil
+        end
+        return scan_lua_script_defs(server_path, server_name)
+    end)
 end
 
 local function scan_ucode_server_defs(server_name)
@@ -276,12 +450,13 @@ local function scan_ucode_server_defs(server_name)
         return {}, nil
     end
 
-    if not is_oasis_tool_server(server_path) then
-        debug:log("oasis.log", "scan_ucode_server_defs", "skip non-oasis server file: " .. server_name)
-        return {}, nil
-    end
-
-    return scan_ucode_script_defs(server_path)
+    return cached_scan(server_path, function()
+        if not is_oasis_tool_server(server_path) then
+            debug:log("oasis.log", "scan_ucode_server_defs", "skip non-oasis server file: " .. server_name)
+            return {}, nil
+        end
+        return scan_ucode_script_defs(server_path)
+    end)
 end
 
 local function to_list(v)
@@ -422,6 +597,10 @@ local function build_manifest(script_kind, script_path, defs)
             properties = property_list_to_manifest_properties(normalized.property),
             additional_properties = (normalized.additionalProperties == "1"),
         }
+        if def.cacheable == "1" then
+            manifest.tools[#manifest.tools].cacheable = true
+            manifest.tools[#manifest.tools].ttl = tonumber(def.ttl)
+        end
     end
 
     table.sort(manifest.tools, function(a, b)
@@ -457,11 +636,15 @@ local function write_manifest_file(manifest)
         return false, "failed to stringify manifest"
     end
 
+    if fs.readfile(path) == content .. "\n" then
+        return true, path, false
+    end
+
     if not fs.writefile(path, content .. "\n") then
         return false, "failed to write manifest: " .. path
     end
 
-    return true, path
+    return true, path, true
 end
 
 local function manifest_tool_to_def(script_kind, tool)
@@ -503,6 +686,12 @@ local function manifest_tool_to_def(script_kind, tool)
     if additional_properties ~= nil and type(additional_properties) ~= "boolean" then
         return nil, "invalid additional_properties"
     end
+    if tool.cacheable ~= nil and type(tool.cacheable) ~= "boolean" then
+        return nil, "invalid cacheable"
+    end
+    if tool.cacheable and not ((tonumber(tool.ttl) or 0) > 0) then
+        return nil, "cacheable tool requires a positive ttl"
+    end
 
     if tool.required ~= nil then
         if type(tool.required) ~= "table" then
@@ -534,6 +723,7 @@ local function manifest_tool_to_def(script_kind, tool)
     )
     def.type = type_name
     def.additionalProperties = (additional_properties == true) and "1" or "0"
+    set_cache_hint(def, tool.cacheable, tool.ttl)
 
     return def, nil
 end
@@ -675,34 +865,92 @@ local function scan_all_tool_defs()
     return defs, nil
 end
 
+-- Options of a tool section, in the order they are written
+local TOOL_SECTION_OPTIONS = {
+    "name", "script", "server", "type", "description", "execution_message",
+    "download_message", "timeout", "required", "property", "additionalProperties",
+    "cacheable", "ttl", "source_type", "source_path", "manifest_path",
+}
+
+local function non_empty(v)
+    v = tostring(v or "")
+    return (#v > 0) and v or nil
+end
+
+-- Option values a tool section holds for a definition (nil: option not set).
+-- enable and conflict are managed separately.
+local function tool_section_values(def)
+    local cacheable = (def.cacheable == "1")
+    return {
+        name                    = def.name,
+        script                  = def.script,
+        server                  = def.server,
+        type                    = def.type or "function",
+        description             = def.description or "",
+        execution_message       = def.execution_message or "",
+        download_message        = def.download_message or "",
+        timeout                 = tostring(def.timeout or ""),
+        required                = (def.required and #def.required > 0) and def.required or nil,
+        property                = (def.property and #def.property > 0) and def.property or nil,
+        additionalProperties    = def.additionalProperties or "0",
+        cacheable               = cacheable and "1" or nil,
+        ttl                     = cacheable and def.ttl or nil,
+        source_type             = non_empty(def.source_type),
+        source_path             = non_empty(def.source_path),
+        manifest_path           = non_empty(def.manifest_path),
+    }
+end
+
+local function option_equal(current, value)
+    if type(value) == "table" then
+        if type(current) ~= "table" or #current ~= #value then
+            return false
+        end
+        for i = 1, #value do
+            if current[i] ~= value[i] then
+                return false
+            end
+        end
+        return true
+    end
+    return current == value
+end
+
+-- Check whether a section (table from uci:foreach) already holds the values
+local function tool_section_matches(s, values)
+    for _, opt in ipairs(TOOL_SECTION_OPTIONS) do
+        if not option_equal(s[opt], values[opt]) then
+            return false
+        end
+    end
+    return true
+end
+
+-- Write the values into a section; only differing options are touched.
+-- @return boolean true when something changed
+local function set_tool_section(uci, section, values)
+    local changed = false
+    for _, opt in ipairs(TOOL_SECTION_OPTIONS) do
+        local value = values[opt]
+        if not option_equal(uci:get(common.db.uci.cfg, section, opt), value) then
+            if value == nil then
+                uci:delete(common.db.uci.cfg, section, opt)
+            elseif type(value) == "table" then
+                uci:set_list(common.db.uci.cfg, section, opt, value)
+            else
+                uci:set(common.db.uci.cfg, section, opt, value)
+            end
+            changed = true
+        end
+    end
+    return changed
+end
+
 local function add_tool_section(uci, def, enable)
     local s = uci:section(common.db.uci.cfg, common.db.uci.sect.tool)
-    uci:set(common.db.uci.cfg, s, "name", def.name)
-    uci:set(common.db.uci.cfg, s, "script", def.script)
-    uci:set(common.db.uci.cfg, s, "server", def.server)
     uci:set(common.db.uci.cfg, s, "enable", enable or "0")
-    uci:set(common.db.uci.cfg, s, "type", def.type or "function")
-    uci:set(common.db.uci.cfg, s, "description", def.description or "")
-    uci:set(common.db.uci.cfg, s, "execution_message", def.execution_message or "")
-    uci:set(common.db.uci.cfg, s, "download_message", def.download_message or "")
-    uci:set(common.db.uci.cfg, s, "timeout", def.timeout or "")
     uci:set(common.db.uci.cfg, s, "conflict", def.conflict or "0")
-    if def.required and #def.required > 0 then
-        uci:set_list(common.db.uci.cfg, s, "required", def.required)
-    end
-    if def.property and #def.property > 0 then
-        uci:set_list(common.db.uci.cfg, s, "property", def.property)
-    end
-    uci:set(common.db.uci.cfg, s, "additionalProperties", def.additionalProperties or "0")
-    if def.source_type and #tostring(def.source_type) > 0 then
-        uci:set(common.db.uci.cfg, s, "source_type", def.source_type)
-    end
-    if def.source_path and #tostring(def.source_path) > 0 then
-        uci:set(common.db.uci.cfg, s, "source_path", def.source_path)
-    end
-    if def.manifest_path and #tostring(def.manifest_path) > 0 then
-        uci:set(common.db.uci.cfg, s, "manifest_path", def.manifest_path)
-    end
+    set_tool_section(uci, s, tool_section_values(def))
 end
 
 local function count_tool_sections(uci)
@@ -721,6 +969,7 @@ local function list_manifest_tool_sections(uci, manifest_path)
                 section = s[".name"],
                 name = s.name or "",
                 server = s.server or "",
+                values = s,
             }
         end
     end)
@@ -768,6 +1017,10 @@ local function render_manifest_apply_commands(plan)
         add_list("required", def.required or {})
         add_list("property", def.property or {})
         add_set("additionalProperties", def.additionalProperties or "0")
+        if def.cacheable == "1" then
+            add_set("cacheable", "1")
+            add_set("ttl", def.ttl)
+        end
     end
 
     if plan.support_value ~= nil and plan.current_support_value ~= plan.support_value then
@@ -805,24 +1058,47 @@ function M.build_manifest_apply_plan(manifest_path)
     local current_tool_count = count_tool_sections(plan_uci)
     local current_support_value = plan_uci:get(common.db.uci.cfg, common.db.uci.sect.support, "local_tool") or "0"
     local add_entries = {}
+    local kept = {}
 
     for _, def in ipairs(defs) do
         def.manifest_path = manifest_path
 
-        local normalized = normalize_tool_def(def)
-        local key = make_tool_key(normalized)
-        local old = old_map[key]
-        local enable = "0"
-        if old and defs_equal(old.def, normalized) then
-            enable = old.enable or "0"
+        -- A section of this manifest that already holds the tool stays as it is
+        local values = tool_section_values(def)
+        local keep = nil
+        for _, item in ipairs(delete_sections) do
+            if (not kept[item.section]) and tool_section_matches(item.values, values) then
+                keep = item.section
+                break
+            end
         end
 
-        add_entries[#add_entries + 1] = {
-            def = def,
-            enable = enable,
-        }
+        if keep then
+            kept[keep] = true
+        else
+            local normalized = normalize_tool_def(def)
+            local key = make_tool_key(normalized)
+            local old = old_map[key]
+            local enable = "0"
+            if old and defs_equal(old.def, normalized) then
+                enable = old.enable or "0"
+            end
+
+            add_entries[#add_entries + 1] = {
+                def = def,
+                enable = enable,
+            }
+        end
     end
 
+    local changed_sections = {}
+    for _, item in ipairs(delete_sections) do
+        if not kept[item.section] then
+            changed_sections[#changed_sections + 1] = item
+        end
+    end
+    delete_sections = changed_sections
+
     local final_tool_count = current_tool_count - #delete_sections + #add_entries
     local support_value = (final_tool_count > 0) and "1" or "0"
     local plan = {
@@ -845,6 +1121,7 @@ function M.apply_manifest_plan(plan)
     end
 
     local apply_uci = require("luci.model.uci").cursor()
+    local changed = (#(plan.delete_sections or {}) > 0) or (#(plan.add_entries or {}) > 0)
 
     for _, item in ipairs(plan.delete_sections or {}) do
         apply_uci:delete(common.db.uci.cfg, item.section)
@@ -854,13 +1131,24 @@ function M.apply_manifest_plan(plan)
         add_tool_section(apply_uci, item.def, item.enable)
     end
 
-    apply_uci:set(common.db.uci.cfg, common.db.uci.sect.support, "local_tool", plan.support_value)
-    check_tool_name_conflict(apply_uci)
+    if plan.current_support_value ~= plan.support_value then
+        apply_uci:set(common.db.uci.cfg, common.db.uci.sect.support, "local_tool", plan.support_value)
+        changed = true
+    end
+
+    if check_tool_name_conflict(apply_uci) then
+        changed = true
+    end
+
+    if not changed then
+        return true, { added = 0, removed = 0, manifest_path = plan.manifest_path }
+    end
 
     local commit_ok = apply_uci:commit(common.db.uci.cfg)
     if commit_ok == false then
         return false, "failed to commit manifest apply changes"
     end
+    M.invalidate_tool_schema_cache()
 
     return true, {
         added = #(plan.add_entries or {}),
@@ -878,35 +1166,81 @@ function M.apply_manifest_file(manifest_path)
     return M.apply_manifest_plan(plan_or_err)
 end
 
+-- Bring the tool sections in line with defs, touching only what differs,
+-- and commit once (nothing is written when the registry is already current).
 local function apply_tool_defs(defs)
     local apply_uci = require("luci.model.uci").cursor()
-    local old_map = load_current_tool_map(apply_uci)
+    local current = {}
+    local stale = {}
+
+    apply_uci:foreach(common.db.uci.cfg, common.db.uci.sect.tool, function(s)
+        local key = (s.name and s.server and s.script) and make_tool_key(normalize_tool_def(s)) or nil
+        if key and (not current[key]) then
+            current[key] = s
+        else
+            stale[#stale + 1] = s[".name"]
+        end
+    end)
 
-    apply_uci:delete_all(common.db.uci.cfg, common.db.uci.sect.tool)
+    local changed = false
+    local wanted = {}
 
     for _, def in ipairs(defs or {}) do
         local normalized = normalize_tool_def(def)
         local key = make_tool_key(normalized)
-        local old = old_map[key]
-        local enable = "0"
-        if old and defs_equal(old.def, normalized) then
-            enable = old.enable or "0"
+        local s = current[key]
+        wanted[key] = true
+
+        if not s then
+            add_tool_section(apply_uci, def, "0")
+            changed = true
+        elseif not tool_section_matches(s, tool_section_values(def)) then
+            -- A tool whose definition changed has to be enabled again
+            if (not defs_equal(normalize_tool_def(s), normalized)) and (s.enable ~= "0") then
+                apply_uci:set(common.db.uci.cfg, s[".name"], "enable", "0")
+            end
+            set_tool_section(apply_uci, s[".name"], tool_section_values(def))
+            changed = true
         end
-        add_tool_section(apply_uci, def, enable)
     end
 
-    apply_uci:set(common.db.uci.cfg, common.db.uci.sect.support, "local_tool", (#(defs or {}) > 0) and "1" or "0")
-    check_tool_name_conflict(apply_uci)
+    for key, s in pairs(current) do
+        if not wanted[key] then
+            stale[#stale + 1] = s[".name"]
+        end
+    end
+
+    for _, section in ipairs(stale) do
+        apply_uci:delete(common.db.uci.cfg, section)
+        changed = true
+    end
+
+    local support_value = (#(defs or {}) > 0) and "1" or "0"
+    if apply_uci:get(common.db.uci.cfg, common.db.uci.sect.support, "local_tool") ~= support_value then
+        apply_uci:set(common.db.uci.cfg, common.db.uci.sect.support, "local_tool", support_value)
+        changed = true
+    end
+
+    if check_tool_name_conflict(apply_uci) then
+        changed = true
+    end
+
+    if not changed then
+        debug:log("oasis.log", "apply_tool_defs", "tool registry is up to date")
+        return true, { count = #(defs or {}), changed = false }
+    end
 
     local ok = apply_uci:commit(common.db.uci.cfg)
     if ok == false then
         return false, "failed to commit tool registry"
     end
-    return true, { count = #(defs or {}) }
+    M.invalidate_tool_schema_cache()
+    return true, { count = #(defs or {}), changed = true }
 end
 
 function M.setup_lua_server_config(server_name)
     local defs, err = scan_lua_server_defs(server_name)
+    save_scan_cache()
     if not defs then
         debug:log("oasis.log", "setup_lua_server_config", err or "failed to scan lua server")
         return false, err
@@ -917,12 +1251,14 @@ function M.setup_lua_server_config(server_name)
     if #defs > 0 then
         uci:set(common.db.uci.cfg, common.db.uci.sect.support, "local_tool", "1")
         uci:commit(common.db.uci.cfg)
+        M.invalidate_tool_schema_cache()
     end
     return true, { count = #defs }
 end
 
 function M.setup_ucode_server_config(server_name)
     local defs, err = scan_ucode_server_defs(server_name)
+    save_scan_cache()
     if not defs then
         debug:log("oasis.log", "setup_ucode_server_config", err or "failed to scan ucode server")
         return false, err
@@ -933,6 +1269,7 @@ function M.setup_ucode_server_config(server_name)
     if #defs > 0 then
         uci:set(common.db.uci.cfg, common.db.uci.sect.support, "local_tool", "1")
         uci:commit(common.db.uci.cfg)
+        M.invalidate_tool_schema_cache()
     end
     return true, { count = #defs }
 end
@@ -994,6 +1331,7 @@ end
 
 local function collect_all_manifests()
     local manifests = {}
+    local present = {}
 
     local lua_servers = listup_server_candidate(lua_ubus_server_app_dir)
     if lua_servers then
@@ -1002,6 +1340,7 @@ local function collect_all_manifests()
             if not defs then
                 return nil, err
             end
+            present[lua_ubus_server_app_dir .. server_name] = true
             if #defs > 0 then
                 manifests[#manifests + 1] = build_manifest("lua", lua_ubus_server_app_dir .. server_name, defs)
             end
@@ -1015,6 +1354,7 @@ local function collect_all_manifests()
             if not defs then
                 return nil, err
             end
+            present[ucode_ubus_server_app_dir .. server_name] = true
             if #defs > 0 then
                 manifests[#manifests + 1] = build_manifest("ucode", ucode_ubus_server_app_dir .. server_name, defs)
             end
@@ -1025,6 +1365,8 @@ local function collect_all_manifests()
         return manifest_filename(a.source_type, a.source_path) < manifest_filename(b.source_type, b.source_path)
     end)
 
+    save_scan_cache(present)
+
     return manifests, nil
 end
 
@@ -1039,21 +1381,32 @@ function M.rebuild_manifest_store()
         return false, "failed to create manifest dir"
     end
 
-    for _, file in ipairs(listup_manifest_candidate(manifest_dir)) do
-        if not fs.remove(manifest_dir .. file) then
-            return false, "failed to remove old manifest: " .. file
-        end
-    end
-
+    -- Only manifests whose content changed are written
+    local keep = {}
+    local written = 0
     for _, manifest in ipairs(manifests) do
-        local ok, path_or_err = write_manifest_file(manifest)
+        local ok, path_or_err, changed = write_manifest_file(manifest)
         if not ok then
             debug:log("oasis.log", "rebuild_manifest_store", path_or_err or "failed to write manifest")
             return false, path_or_err or "failed to write manifest"
         end
+        keep[basename(path_or_err)] = true
+        if changed then
+            written = written + 1
+        end
+    end
+
+    local removed = 0
+    for _, file in ipairs(listup_manifest_candidate(manifest_dir)) do
+        if not keep[file] then
+            if not fs.remove(manifest_dir .. file) then
+                return false, "failed to remove old manifest: " .. file
+            end
+            removed = removed + 1
+        end
     end
 
-    return true, { count = #manifests }
+    return true, { count = #manifests, written = written, removed = removed }
 end
 
 function M.build_manifest_for_script(script_path)
@@ -1137,21 +1490,24 @@ end
 check_tool_name_conflict = function(uci)
     -- Check Conflict Tool Name
     -- If the value of the conflict option is set to 1, usage will be prohibited.
-    local name_to_sections = {}
+    -- Returns true when a conflict flag was changed.
+    local name_count = {}
+    local sections = {}
     uci:foreach(common.db.uci.cfg, common.db.uci.sect.tool, function(s)
-        uci:set(common.db.uci.cfg, s[".name"], "conflict", "0")
+        sections[#sections + 1] = { section = s[".name"], name = s.name, conflict = s.conflict }
         if s.name then
-            name_to_sections[s.name] = name_to_sections[s.name] or {}
-            table.insert(name_to_sections[s.name], s[".name"])
+            name_count[s.name] = (name_count[s.name] or 0) + 1
         end
     end)
-    for _, sections in pairs(name_to_sections) do
-        if #sections > 1 then
-            for _, sec in ipairs(sections) do
-                uci:set(common.db.uci.cfg, sec, "conflict", "1")
-            end
+    local changed = false
+    for _, item in ipairs(sections) do
+        local conflict = (item.name and name_count[item.name] > 1) and "1" or "0"
+        if item.conflict ~= conflict then
+            uci:set(common.db.uci.cfg, item.section, "conflict", conflict)
+            changed = true
         end
     end
+    return changed
 end
 
 function M.update_server_info()
@@ -1222,6 +1578,235 @@ function M.get_function_call_schema()
     return tools
 end
 
+--[[
+[Tool Schema Cache]
+get_function_call_schema() walks every tool section and parses its property
+strings, and each provider then rebuilds its own tools array. The result only
+changes when the tool sections or the manifests change, so each provider's tool
+entries are serialized once and kept (in memory and under
+/tmp/oasis/tool_schema/<provider>) together with their selection index terms.
+
+ key  = hash of the enabled tool sections + name/mtime/size of every manifest
+ file = "<key> <tool count>\n" + one "<name>\t<name terms>\t<text terms>\t<JSON>\n" per tool
+
+A key mismatch rebuilds the entry, so edits from LuCI are picked up as well;
+oasis_tool_setup and the registry updates below also drop the cache explicitly.
+The request's tools array is the cached entries joined as-is (all of them, or the
+subset chosen by oasis.local.tool.select); the calling modules splice it into the
+request body (misc.json_splice).
+]]
+
+local schema_cache_dir = "/tmp/oasis/tool_schema/"
+local schema_cache = {}
+
+local function flatten_option(v)
+    if type(v) == "table" then
+        return table.concat(v, "\1")
+    end
+    return tostring(v or "")
+end
+
+local function tool_schema_key()
+    local parts = {}
+
+    uci:foreach(common.db.uci.cfg, common.db.uci.sect.tool, function(s)
+        if s.enable == "1" then
+            parts[#parts + 1] = table.concat({
+                flatten_option(s.name),
+                flatten_option(s.type),
+                flatten_option(s.description),
+                flatten_option(s.property),
+                flatten_option(s.required),
+                flatten_option(s.additionalProperties),
+            }, "\2")
+        end
+    end)
+
+    local files = {}
+    for name in (fs.dir(manifest_dir) or function() return nil end) do
+        files[#files + 1] = name
+    end
+    table.sort(files)
+
+    for _, name in ipairs(files) do
+        local st = fs.stat(manifest_dir .. name)
+        if st then
+            parts[#parts + 1] = string.format("%s\2%d\2%d", name, st.mtime or 0, st.size or 0)
+        end
+    end
+
+    return misc.hash(table.concat(parts, "\3"))
+end
+
+local function openai_style_tool(tool_def)
+    return {
+        type = "function",
+        ["function"] = {
+            name = tool_def.name,
+            description = tool_def.description or "",
+            parameters = tool_def.parameters
+        }
+    }
+end
+
+-- Provider-specific entry of the tools array for one get_function_call_schema() item
+local schema_builders = {
+    openai = openai_style_tool,
+    ollama = openai_style_tool,
+    anthropic = function(tool_def)
+        local params = tool_def.parameters or {}
+        return {
+            type = "custom",
+            name = tool_def.name,
+            description = tool_def.description or "",
+            input_schema = {
+                type = params.type or "object",
+                properties = params.properties or {},
+                required = params.required or {}
+            }
+        }
+    end,
+    gemini = function(tool_def)
+        local params = tool_def.parameters or {}
+        return {
+            name = tool_def.name,
+            description = tool_def.description or "",
+            parameters = {
+                type = params.type or "object",
+                properties = params.properties or {},
+                required = params.required or {}
+            }
+        }
+    end,
+}
+
+-- Text around the joined entries (Gemini: a single functionDeclarations entry of body.tools)
+local schema_wrappers = {
+    gemini = { '{"functionDeclarations":[', ']}' },
+}
+local default_wrapper = { "[", "]" }
+
+local function read_schema_cache_file(provider, key)
+    local data = misc.read_file(schema_cache_dir .. provider)
+    if not data then
+        return nil
+    end
+    local file_key, count, body = data:match("^(%S+) (%d+)\n(.*)$")
+    if file_key ~= key then
+        return nil
+    end
+    local tools = {}
+    for name, name_terms, text_terms, json in body:gmatch("([^\t\n]*)\t([^\t\n]*)\t([^\t\n]*)\t([^\n]*)\n") do
+        tools[#tools + 1] = { name = name, name_terms = name_terms, text_terms = text_terms, json = json }
+    end
+    if #tools ~= tonumber(count) then
+        return nil
+    end
+    return { key = key, tools = tools }
+end
+
+local function write_schema_cache_file(provider, entry)
+    local path = schema_cache_dir .. provider
+    local lines = { entry.key .. " " .. #entry.tools }
+    for _, t in ipairs(entry.tools) do
+        lines[#lines + 1] = table.concat({ t.name, t.name_terms, t.text_terms, t.json }, "\t")
+    end
+    fs.mkdirr(schema_cache_dir)
+    if misc.write_file(path .. ".tmp", table.concat(lines, "\n") .. "\n") then
+        os.rename(path .. ".tmp", path)
+    end
+end
+
+local function build_schema_cache_entry(provider, key)
+    local build = schema_builders[provider]
+    local tool_select = require("oasis.local.tool.select")
+    local tools = {}
+
+    for _, tool_def in ipairs(M.get_function_call_schema()) do
+        local json = jsonc.stringify(build(tool_def), false) or "{}"
+        -- jsonc writes an empty table as [], but a schema's properties must be an object
+        json = json:gsub('"properties"%s*:%s*%[%]', '"properties":{}')
+        local name_terms, text_terms = tool_select.index_terms(tool_def)
+        tools[#tools + 1] = {
+            name = tostring(tool_def.name or ""):gsub("[\t\n]", " "),
+            name_terms = name_terms,
+            text_terms = text_terms,
+            json = json,
+        }
+    end
+
+    return { key = key, tools = tools }
+end
+
+local function join_tools(provider, tools, picked)
+    local wrap = schema_wrappers[provider] or default_wrapper
+    local parts = {}
+    if picked then
+        for _, pos in ipairs(picked) do
+            parts[#parts + 1] = tools[pos].json
+        end
+    else
+        for i, t in ipairs(tools) do
+            parts[i] = t.json
+        end
+    end
+    return wrap[1] .. table.concat(parts, ",") .. wrap[2], #parts
+end
+
+--- Serialized tools schema of a provider, rebuilt only when the tools change.
+-- With a chat and tool selection enabled (oasis.tool_select), only the tools
+-- chosen by oasis.local.tool.select are included.
+-- @param provider string "openai" | "ollama" | "anthropic" | "gemini"
+-- @param chat table|nil unified chat the request is built from
+-- @return string|nil json, number tool count
+function M.get_tool_schema_json(provider, chat)
+    if not schema_builders[provider] then
+        return nil, 0
+    end
+
+    local key = tool_schema_key()
+    local entry = schema_cache[provider]
+
+    if (not entry) or (entry.key ~= key) then
+        entry = read_schema_cache_file(provider, key)
+    end
+
+    if not entry then
+        entry = build_schema_cache_entry(provider, key)
+        write_schema_cache_file(provider, entry)
+        debug:log("oasis.log", "get_tool_schema_json",
+            string.format("rebuilt %s: tools=%d", provider, #entry.tools))
+    end
+
+    schema_cache[provider] = entry
+
+    if not entry.full then
+        entry.full = join_tools(provider, entry.tools)
+    end
+
+    local tool_select = require("oasis.local.tool.select")
+
+    if chat and tool_select.is_enabled() then
+        entry.index = entry.index or tool_select.build_index(entry.tools)
+        local picked = tool_select.select(entry.index, chat)
+        if picked then
+            local json, count = join_tools(provider, entry.tools, picked)
+            tool_select.record(#entry.full, #json)
+            return json, count
+        end
+    end
+
+    return entry.full, #entry.tools
+end
+
+--- Drop every cached tools schema (after the tool registry changes).
+function M.invalidate_tool_schema_cache()
+    schema_cache = {}
+    for name in (fs.dir(schema_cache_dir) or function() return nil end) do
+        os.remove(schema_cache_dir .. name)
+    end
+end
+
 local function handle_option_message(msg, msg_type, format)
     if not msg then return end
 
@@ -1241,147 +1826,383 @@ local function handle_option_message(msg, msg_type, format)
     end
 end
 
-function M.exec_server_tool(format, tool, data)
+local function merge_parsed_result(tbl)
+    if type(tbl) ~= "table" then
+        return tbl
+    end
 
-    local nixio = require("nixio")
-    local found = false
-    local result = {}
+    local raw = tbl.result
+    if type(raw) == "string" then
+        local parsed = jsonc.parse(raw)
+        if type(parsed) == "table" then
+            for k, v in pairs(parsed) do
+                if tbl[k] == nil then
+                    tbl[k] = v
+                end
+            end
+        end
+    end
+    return tbl
+end
+
+local function find_tool_section(tool)
+    local found = nil
 
-    local function merge_parsed_result(tbl)
-        if type(tbl) ~= "table" then
-            return tbl
+    uci:foreach(common.db.uci.cfg, common.db.uci.sect.tool, function(s)
+        debug:log("oasis.log", "exec_server_tool", "config: s.server = " .. tostring(s.server))
+        debug:log("oasis.log", "exec_server_tool", "config: s.name   = " .. tostring(s.name))
+        debug:log("oasis.log", "exec_server_tool", "config: s.enable = " .. tostring(s.enable))
+
+        if s.name == tool and s.enable == "1" then
+            found = s
+            return false
         end
+    end)
 
-        local raw = tbl.result
-        if type(raw) == "string" then
-            local parsed = jsonc.parse(raw)
-            if type(parsed) == "table" then
-                for k, v in pairs(parsed) do
-                    if tbl[k] == nil then
-                        tbl[k] = v
-                    end
+    return found
+end
+
+local function tool_not_found_result(tool)
+    debug:log("oasis.log", "exec_server_tool", string.format("Tool '%s' not found or not enabled.", tool))
+
+    -- Handles cases where the AI requests a non-existent tool.
+    -- This typically indicates hallucination. The system notifies the AI accordingly.
+    -- This does not fix LLM-level issues, but helps prevent JSON or communication errors between AI and system.
+    return {
+        error = "tool_not_recognized",
+        message ="The requested tool is not recognized on this system.",
+        cause = "hallucination"
+    }
+end
+
+-- Post-processing of a tool result (package install monitoring, restart flags)
+local function finish_tool_result(s, result)
+    result = merge_parsed_result(result)
+    debug:log("oasis.log", "exec_server_tool", function()
+        return string.format("Result for tool '%s' (response) = %s", s.name, tostring(jsonc.stringify(result, false)))
+    end)
+
+    local nixio = require("nixio")
+
+    -- [Control install package]
+    -- The following code monitors the installation of packages triggered by the AI tool
+    -- (UBUS server application). Once the installation process is complete, it verifies
+    -- whether the package was successfully installed. If a failure is detected,
+    -- it overrides the AI tool’s standard response and notifies the AI with the message
+    -- : "Failed to install <pkg> package."
+    --
+    -- Note (Tips):
+    -- The UBUS server application cannot monitor the package installation process.
+    -- This is because the UBUS server application experiences a deadlock immediately
+    -- after the package manager software begins unpacking the package. Therefore,
+    -- the UBUS process is terminated before the deadlock occurs, and the monitoring and installation
+    -- completion verification are performed at this point.
+    if misc.check_file_exist(common.file.pkg.install) then
+        local install_pkg_info = misc.read_file(common.file.pkg.install)
+        os.remove(common.file.pkg.install)
+        debug:log("oasis.log", "exec_server_tool", "pid = " .. install_pkg_info)
+
+        local pkg, pid = install_pkg_info:match("([^|]+)|([^|]+)")
+
+        local timeout = tonumber(uci:get("rpcd", "@rpcd[0]", "timeout")) or 30
+        local elapsed = 0
+
+        local is_install_success = false
+
+        while elapsed < timeout do
+            debug:log("oasis.log", "install_pkg", "elapsed = " .. elapsed)
+            if not mgr.check_process_alive(pid) then
+                debug:log("oasis.log", "install_pkg", "child exited")
+
+                if mgr.check_installed_pkg(pkg) then
+                    debug:log("oasis.log", "install_pkg", "Check Installed Package OK (" .. pkg .. ")")
+                    is_install_success = true
+                    break
+                else
+                    debug:log("oasis.log", "install_pkg", "Check Installed Package FAILED (" .. pkg .. ")")
+                    is_install_success = false
+                    break
                 end
             end
+
+            nixio.nanosleep(1, 0)
+            elapsed = elapsed + 1
+        end
+
+        if not is_install_success then
+            debug:log("oasis.log", "exec_server_tool", "Failed to install package.")
+            -- Overwrite UBUS Result
+            result = { error = "Failed to install " .. pkg .. " package." }
+        end
+
+        -- After a package is successfully installed, the system checks whether a reboot is required.
+        -- If a reboot is necessary, a file named after the corresponding package is placed in
+        -- /tmp/oasis/pkg_reboot_required. Normally, when reboot = true, the WebUI displays a popup
+        -- prompting the user to reboot the system.
+
+        -- However, this flag is designed with the assumption that the user may ignore the prompt and later ask
+        -- the AI to execute tools that function correctly only after a reboot.
+        -- Tools that need to run post-reboot can use the check_pkg_reboot_required function to verify whether
+        -- the system has been rebooted. If no <pkg> file exists in /tmp/oasis/pkg_reboot_required, it is considered
+        -- that the reboot has been completed.
+        if result.reboot then
+            misc.touch(common.file.pkg.reboot_required_path  .. pkg)
+        end
+
+        -- restart_service handling moved outside this block to run regardless of package install
+    end
+
+    -- Always handle restart_service regardless of package install monitoring
+    if result.prepare_service_restart then
+        -- The variable restart_service stores the name of the service to be restarted (e.g., "network").
+        -- It checks whether the service exists directly under /etc/init.d; if it does not exist, restart_service is deleted.
+        -- If the service exists, a restart request flag is created under /tmp/oasis.
+        local svc = tostring(result.prepare_service_restart or "")
+        debug:log("oasis.log", "exec_server_tool", "svc = " .. svc)
+        if not misc.check_init_script_exists(svc) then
+            debug:log("oasis.log", "exec_server_tool", svc .. " not found under /etc/init.d; skip creating restart flag")
+            result.prepare_service_restart = nil
+        else
+            debug:log("oasis.log", "exec_server_tool", "create file: " .. common.file.service.restart_required)
+            misc.write_file(common.file.service.restart_required, svc)
         end
-        return tbl
     end
 
-    uci:foreach(common.db.uci.cfg, common.db.uci.sect.tool, function(s)
+    return result
+end
 
-        debug:log("oasis.log", "exec_server_tool", "config: s.server = " .. s.server)
-        debug:log("oasis.log", "exec_server_tool", "config: s.name   = " .. s.name)
-        debug:log("oasis.log", "exec_server_tool", "config: s.enable = " .. s.enable)
+--[[
+[Tool Result Cache]
+Read-only tools declared cacheable in their manifest ("cacheable": true,
+"ttl": <seconds>) answer a repeated call with the same arguments from a cache
+instead of a new ubus/rpcd round trip. This mostly helps agent loops, where the
+AI asks for the same status (interfaces, clients, memory) several times in a row.
+
+ - key: server + tool name + arguments serialized with sorted keys
+ - entries live in memory and in common.file.tool.cache/<hash>
+   ("<expiry uptime>\n<result json>"), so later requests of a chat hit them too
+ - expiry uses the system uptime, which does not jump with NTP time sync
+ - error results are never stored
+ - running any tool that is not cacheable (a write, or one whose effect is
+   unknown) drops every entry, as does a UCI apply (oasis.chat.apply)
+]]
+local result_cache = {}
+
+local function canonical_json(v)
+    if type(v) ~= "table" then
+        return jsonc.stringify(v, false) or "null"
+    end
+
+    if (#v > 0) or (next(v) == nil) then
+        local items = {}
+        for i, item in ipairs(v) do
+            items[i] = canonical_json(item)
+        end
+        return "[" .. table.concat(items, ",") .. "]"
+    end
 
-        if s.name == tool and s.enable == "1" then
-            handle_option_message(s.execution_message, "execution", format)
-            handle_option_message(s.download_message,  "download",  format)
-
-            found = true
-            debug:log("oasis.log", "exec_server_tool", "request payload = " .. jsonc.stringify(data, false))
-            result = ubus_call(s.server, s.name, data, s.timeout)
-            result = merge_parsed_result(result)
-            debug:log("oasis.log", "exec_server_tool", string.format("Result for tool '%s' (response) = %s", s.name, tostring(jsonc.stringify(result, false))))
-
-            -- [Control install package]
-            -- The following code monitors the installation of packages triggered by the AI tool
-            -- (UBUS server application). Once the installation process is complete, it verifies
-            -- whether the package was successfully installed. If a failure is detected,
-            -- it overrides the AI tool’s standard response and notifies the AI with the message
-            -- : "Failed to install <pkg> package."
-            --
-            -- Note (Tips):
-            -- The UBUS server application cannot monitor the package installation process.
-            -- This is because the UBUS server application experiences a deadlock immediately
-            -- after the package manager software begins unpacking the package. Therefore,
-            -- the UBUS process is terminated before the deadlock occurs, and the monitoring and installation
-            -- completion verification are performed at this point.
-            if misc.check_file_exist(common.file.pkg.install) then
-                local install_pkg_info = misc.read_file(common.file.pkg.install)
-                os.remove(common.file.pkg.install)
-                debug:log("oasis.log", "exec_server_tool", "pid = " .. install_pkg_info)
-
-                local pkg, pid = install_pkg_info:match("([^|]+)|([^|]+)")
-
-                local timeout = tonumber(uci:get("rpcd", "@rpcd[0]", "timeout")) or 30
-                local elapsed = 0
-
-                local is_install_success = false
-
-                while elapsed < timeout do
-                    debug:log("oasis.log", "install_pkg", "elapsed = " .. elapsed)
-                    if not mgr.check_process_alive(pid) then
-                        debug:log("oasis.log", "install_pkg", "child exited")
-
-                        if mgr.check_installed_pkg(pkg) then
-                            debug:log("oasis.log", "install_pkg", "Check Installed Package OK (" .. pkg .. ")")
-                            is_install_success = true
-                            break
-                        else
-                            debug:log("oasis.log", "install_pkg", "Check Installed Package FAILED (" .. pkg .. ")")
-                            is_install_success = false
-                            break
-                        end
-                    end
+    local keys = {}
+    for k, _ in pairs(v) do
+        keys[#keys + 1] = tostring(k)
+    end
+    table.sort(keys)
 
-                    nixio.nanosleep(1, 0)
-                    elapsed = elapsed + 1
-                end
+    local items = {}
+    for i, k in ipairs(keys) do
+        items[i] = jsonc.stringify(k, false) .. ":" .. canonical_json(v[k])
+    end
+    return "{" .. table.concat(items, ",") .. "}"
+end
 
-                if not is_install_success then
-                    debug:log("oasis.log", "exec_server_tool", "Failed to install package.")
-                    -- Overwrite UBUS Result
-                    result = { error = "Failed to install " .. pkg .. " package." }
-                end
+local function uptime()
+    local text = misc.read_file("/proc/uptime") or ""
+    return tonumber(text:match("^(%d+)")) or os.time()
+end
 
-                -- After a package is successfully installed, the system checks whether a reboot is required.
-                -- If a reboot is necessary, a file named after the corresponding package is placed in
-                -- /tmp/oasis/pkg_reboot_required. Normally, when reboot = true, the WebUI displays a popup
-                -- prompting the user to reboot the system.
-
-                -- However, this flag is designed with the assumption that the user may ignore the prompt and later ask
-                -- the AI to execute tools that function correctly only after a reboot.
-                -- Tools that need to run post-reboot can use the check_pkg_reboot_required function to verify whether
-                -- the system has been rebooted. If no <pkg> file exists in /tmp/oasis/pkg_reboot_required, it is considered
-                -- that the reboot has been completed.
-                if result.reboot then
-                    misc.touch(common.file.pkg.reboot_required_path  .. pkg)
-                end
+local function is_cacheable(s)
+    return (s.cacheable == "1") and ((tonumber(s.ttl) or 0) > 0)
+end
 
-                -- restart_service handling moved outside this block to run regardless of package install
-            end
+local function result_cache_path(s, args)
+    return common.file.tool.cache .. misc.hash(s.server .. "\n" .. s.name .. "\n" .. canonical_json(args or {}))
+end
+
+local function result_cache_get(s, args)
+
+    local path = result_cache_path(s, args)
+    local entry = result_cache[path]
+
+    if not entry then
+        local text = misc.read_file(path)
+        local expires, json = (text or ""):match("^(%d+)\n(.*)$")
+        if expires then
+            entry = { expires = tonumber(expires), json = json }
+            result_cache[path] = entry
         end
+    end
 
-        -- Always handle restart_service regardless of package install monitoring
-        if result.prepare_service_restart then
-            -- The variable restart_service stores the name of the service to be restarted (e.g., "network").
-            -- It checks whether the service exists directly under /etc/init.d; if it does not exist, restart_service is deleted.
-            -- If the service exists, a restart request flag is created under /tmp/oasis.
-            local svc = tostring(result.prepare_service_restart or "")
-            debug:log("oasis.log", "exec_server_tool", "svc = " .. svc)
-            if not misc.check_init_script_exists(svc) then
-                debug:log("oasis.log", "exec_server_tool", svc .. " not found under /etc/init.d; skip creating restart flag")
-                result.prepare_service_restart = nil
-            else
-                debug:log("oasis.log", "exec_server_tool", "create file: " .. common.file.service.restart_required)
-                misc.write_file(common.file.service.restart_required, svc)
-            end
+    if (not entry) or (entry.expires <= uptime()) then
+        return nil
+    end
+
+    -- Parse on every hit: callers modify the result table
+    return jsonc.parse(entry.json)
+end
+
+local function result_cache_put(s, args, result)
+
+    if (type(result) ~= "table") or (result.error ~= nil) then
+        return
+    end
+
+    local json = jsonc.stringify(result, false)
+
+    if not json then
+        return
+    end
+
+    local path = result_cache_path(s, args)
+    local entry = { expires = uptime() + tonumber(s.ttl), json = json }
+
+    result_cache[path] = entry
+
+    fs.mkdirr(common.file.tool.cache)
+    misc.write_file(path, tostring(entry.expires) .. "\n" .. json)
+end
+
+--- Drop every cached tool result (after a tool or an apply may have changed the system).
+function M.invalidate_result_cache()
+    result_cache = {}
+    for name in (fs.dir(common.file.tool.cache) or function() return nil end) do
+        os.remove(common.file.tool.cache .. name)
+    end
+end
+
+local function run_tool(format, s, data)
+
+    handle_option_message(s.execution_message, "execution", format)
+    handle_option_message(s.download_message,  "download",  format)
+
+    debug:log("oasis.log", "exec_server_tool", function() return "request payload = " .. (jsonc.stringify(data, false) or "") end)
+
+    return finish_tool_result(s, ubus_call(s.server, s.name, data, s.timeout))
+end
+
+-- Record a finished call in the cache info of exec_server_tools
+local function count_cache(info, i, state)
+    info[i] = state
+    if state == "hit" then
+        info.hits = info.hits + 1
+    else
+        info.misses = info.misses + 1
+    end
+end
+
+-- Store or invalidate after a tool ran (store: false when a write ran in the same turn)
+local function settle_result(s, args, result, info, i, store)
+    if is_cacheable(s) then
+        if store then
+            result_cache_put(s, args, result)
         end
-    end)
+        count_cache(info, i, "miss")
+    else
+        M.invalidate_result_cache()
+    end
+end
 
-    if not found then
-        -- Handles cases where the AI requests a non-existent tool.
-        -- This typically indicates hallucination. The system notifies the AI accordingly.
-        -- This does not fix LLM-level issues, but helps prevent JSON or communication errors between AI and system.
-        result = {
-            error = "tool_not_recognized",
-            message ="The requested tool is not recognized on this system.",
-            cause = "hallucination"
-        }
+local function run_tool_cached(format, s, data, info, i)
 
-        debug:log("oasis.log", "exec_server_tool", string.format("Tool '%s' not found or not enabled.", tool))
+    if is_cacheable(s) then
+        local cached = result_cache_get(s, data)
+        if cached then
+            debug:log("oasis.log", "exec_server_tool", "cache hit: " .. s.name)
+            count_cache(info, i, "hit")
+            return cached
+        end
     end
 
+    local result = run_tool(format, s, data)
+    settle_result(s, data, result, info, i, true)
+
     return result
 end
 
+function M.exec_server_tool(format, tool, data)
+
+    local s = find_tool_section(tool)
+
+    if not s then
+        return tool_not_found_result(tool)
+    end
+
+    return run_tool_cached(format, s, data, { hits = 0, misses = 0 }, 1)
+end
+
+--- Run the tool calls of one turn and return their results in call order.
+-- Reads (cacheable tools) are independent of each other and run concurrently,
+-- each in a "ubus call" child bounded by its tool's timeout. Every other call may
+-- change state (e.g. set an option, then restart the service): those run one after
+-- another in call order once the reads are done, as do the tools that install
+-- packages (download_message set, they share the install monitor file).
+-- Cacheable tools are answered from the result cache when possible.
+-- @param format string
+-- @param calls table array of { name = string, args = table }
+-- @return table array of results
+-- @return table cache info: [i] = "hit"|"miss" for cacheable calls, hits, misses
+function M.exec_server_tools(format, calls)
+
+    local results = {}
+    local info = { hits = 0, misses = 0 }
+
+    if #calls <= 1 then
+        for i, call in ipairs(calls) do
+            local s = find_tool_section(call.name)
+            results[i] = s and run_tool_cached(format, s, call.args, info, i) or tool_not_found_result(call.name)
+        end
+        return results, info
+    end
+
+    local sections = {}
+    local running = {}
+
+    for i, call in ipairs(calls) do
+        local s = find_tool_section(call.name)
+        sections[i] = s
+        if s and is_cacheable(s) then
+            local cached = result_cache_get(s, call.args)
+            if cached then
+                debug:log("oasis.log", "exec_server_tools", "cache hit: " .. s.name)
+                results[i] = cached
+                count_cache(info, i, "hit")
+            elseif (s.download_message or "") == "" then
+                handle_option_message(s.execution_message, "execution", format)
+                debug:log("oasis.log", "exec_server_tools", function() return string.format("start [%d] %s payload = %s",
+                    i, s.name, jsonc.stringify(call.args or {}, false)) end)
+                running[i] = ubus_call_spawn(s.server, s.name, call.args, s.timeout)
+            end
+        end
+    end
+
+    -- Reads first: no write of this turn has run yet, so their results can be kept
+    for i, call in ipairs(calls) do
+        if running[i] then
+            results[i] = finish_tool_result(sections[i], running[i]())
+            settle_result(sections[i], call.args, results[i], info, i, true)
+        end
+    end
+
+    -- Then the rest, one at a time in call order (a write invalidates the cache)
+    for i, call in ipairs(calls) do
+        local s = sections[i]
+        if not s then
+            results[i] = tool_not_found_result(call.name)
+        elseif results[i] == nil then
+            results[i] = run_tool(format, s, call.args)
+            settle_result(s, call.args, results[i], info, i, true)
+        end
+    end
+
+    return results, info
+end
+
 return M
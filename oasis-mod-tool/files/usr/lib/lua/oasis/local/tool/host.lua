@@ -0,0 +1,429 @@
+#!/usr/bin/env lua
+
+local jsonc     = require("luci.jsonc")
+local fs        = require("nixio.fs")
+local common    = require("oasis.common")
+local misc      = require("oasis.chat.misc")
+local debug     = require("oasis.chat.debug")
+
+--[[
+[Resident Tool Host]
+rpcd runs every Lua tool server (/usr/libexec/rpcd/oasis.system, oasis.network, ...)
+as an exec plugin: each tool call starts a Lua interpreter, loads the script and
+its modules and parses the arguments from stdin.
+
+When oasis.tool_host.enable is '1', /usr/bin/oasis_tool_hostd loads every Lua
+tool server once and registers the same ubus objects itself (the ucode servers
+are resident in rpcd already):
+ - object, method and argument names are taken from the scripts, so the tool
+   client and the manifests see no difference
+ - each call runs in a forked child of the warm process: a tool that raises,
+   exits or hangs only ends its own call (a hang is killed at the tool timeout),
+   and the calls of one turn still run concurrently
+ - a script that fails to load is skipped and stays with rpcd
+ - the scripts it serves are listed in common.file.tool.host/served; their
+   "list" prints nothing there, so rpcd does not register them
+ - when a tool script or a manifest changes (install/remove of a tool package),
+   the scripts are loaded again and the objects registered anew
+
+Switching the host on or off requires rpcd to re-list its plugins
+(service rpcd restart); the host and its init script take care of it.
+]]
+
+local M = {}
+
+local SCRIPT_DIR        = "/usr/libexec/rpcd/"
+local MANIFEST_DIR      = "/etc/oasis/tool-manifest.d/"
+local SERVER_MODULE     = "oasis.local.tool.server"
+local SERVED_FILE       = "served"
+local DEFAULT_TIMEOUT   = 60000     -- ms, same as the tool client
+local WATCH_INTERVAL    = 5000      -- ms
+local RPCD_WAIT_MAX     = 20
+
+local inflight = 0
+
+--- Check whether the tool host is enabled.
+-- @return boolean
+function M.is_enabled()
+    local uci = require("luci.model.uci").cursor()
+    return uci:get(common.db.uci.cfg, common.db.uci.sect.tool_host, "enable") == "1"
+end
+
+--- Check whether the tool host serves an object (asked by the scripts on "list").
+-- @param object string ubus object name (script file name)
+-- @return boolean
+function M.is_served(object)
+
+    if not M.is_enabled() then
+        return false
+    end
+
+    local served = misc.read_file(common.file.tool.host .. SERVED_FILE) or ""
+
+    for name in served:gmatch("[^\n]+") do
+        if name == object then
+            return true
+        end
+    end
+
+    return false
+end
+
+local function is_tool_script(path)
+    local st = fs.stat(path)
+    if (not st) or (st.type ~= "reg") then
+        return false
+    end
+    local content = fs.readfile(path)
+    return (content ~= nil) and (content:find(SERVER_MODULE, 1, true) ~= nil)
+end
+
+--- Names of the Lua tool server scripts.
+-- @return table sorted array
+function M.list_scripts()
+
+    local names = {}
+
+    for name in (fs.dir(SCRIPT_DIR) or function() return nil end) do
+        if is_tool_script(SCRIPT_DIR .. name) then
+            names[#names + 1] = name
+        end
+    end
+
+    table.sort(names)
+
+    return names
+end
+
+--- Load the tools of one script.
+-- @param object string script file name
+-- @return table|nil name -> definition, string|nil error, table|nil server module of the script
+function M.load_tools(object)
+
+    local chunk, err = loadfile(SCRIPT_DIR .. object)
+
+    if not chunk then
+        return nil, err
+    end
+
+    -- Each script registers its tools in a fresh server module;
+    -- without arg[1], server.run() neither lists nor calls
+    package.loaded[SERVER_MODULE] = nil
+
+    local saved = arg
+    arg = {}
+    local ok, run_err = pcall(chunk)
+    arg = saved
+
+    local server = package.loaded[SERVER_MODULE]
+    package.loaded[SERVER_MODULE] = nil
+
+    if not ok then
+        return nil, tostring(run_err)
+    end
+
+    if (type(server) ~= "table") or (not server.getMethods) then
+        return nil, "no tools defined"
+    end
+
+    local tools = {}
+    for name, def in pairs(server.getMethods()) do
+        if (type(def) == "table") and (type(def.call) == "function") then
+            tools[name] = def
+        end
+    end
+
+    return tools, nil, server
+end
+
+--- Signature of the tool scripts and manifests (changes when a tool package is installed or removed).
+-- @return string
+function M.signature()
+
+    local parts = {}
+
+    for _, dir in ipairs({ SCRIPT_DIR, MANIFEST_DIR }) do
+        local names = {}
+        for name in (fs.dir(dir) or function() return nil end) do
+            names[#names + 1] = name
+        end
+        table.sort(names)
+        for _, name in ipairs(names) do
+            local st = fs.stat(dir .. name)
+            if st then
+                parts[#parts + 1] = string.format("%s%s:%s:%s", dir, name, tostring(st.mtime), tostring(st.size))
+            end
+        end
+    end
+
+    return table.concat(parts, "\n")
+end
+
+local function to_reply(result)
+
+    local reply = jsonc.parse(result or "")
+
+    if type(reply) ~= "table" then
+        return { error = "Invalid response" }
+    end
+
+    return reply
+end
+
+--- Run one tool in this process and return its reply table.
+-- @param server table server module of the script
+-- @param func string tool name
+-- @param def table tool definition
+-- @param args table
+-- @return table
+function M.call_tool(server, func, def, args)
+
+    args = args or {}
+
+    local err = server.checkArgs(func, def, args)
+
+    if err then
+        return { error = err }
+    end
+
+    local ok, run = pcall(def.call, args)
+
+    if not ok then
+        return { error = tostring(run) }
+    end
+
+    return to_reply((type(run) == "table") and run.result or nil)
+end
+
+local function write_all(fd, data)
+    local pos = 1
+    while pos <= #data do
+        local n = fd:write(data:sub(pos))
+        if (not n) or (n <= 0) then
+            return
+        end
+        pos = pos + n
+    end
+end
+
+-- Run a tool in a forked child and answer when it has written its reply.
+local function dispatch(conn, req, server, func, def, args)
+
+    local nixio = require("nixio")
+    local uloop = require("uloop")
+
+    -- The child must not write out the parent's buffered log lines again
+    debug:flush()
+
+    local rfd, wfd = nixio.pipe()
+    local pid = rfd and nixio.fork()
+
+    if not pid then
+        -- No pipe or no fork: run in this process rather than fail the call
+        if rfd then
+            rfd:close()
+            wfd:close()
+        end
+        conn:reply(req, M.call_tool(server, func, def, args))
+        return
+    end
+
+    if pid == 0 then
+        rfd:close()
+        write_all(wfd, jsonc.stringify(M.call_tool(server, func, def, args)) or "{}")
+        wfd:close()
+        os.exit(0)
+    end
+
+    wfd:close()
+
+    local deferred = conn:defer_request(req)
+    inflight = inflight + 1
+    local chunks = {}
+    local done = false
+    local ufd, timer
+
+    local function finish(reply)
+        if done then
+            return
+        end
+        done = true
+        inflight = inflight - 1
+        if ufd then ufd:delete() end
+        if timer then timer:cancel() end
+        rfd:close()
+        conn:reply(deferred, reply)
+        conn:complete_deferred_request(deferred, 0)
+    end
+
+    ufd = uloop.fd_add(rfd:fileno(), function()
+        local chunk = rfd:read(4096)
+        if chunk and (#chunk > 0) then
+            chunks[#chunks + 1] = chunk
+            return
+        end
+        finish(to_reply(table.concat(chunks)))
+    end, uloop.ULOOP_READ)
+
+    timer = uloop.timer(function()
+        debug:log("oasis.log", "tool_host", "timeout: " .. func)
+        nixio.kill(pid, 9)
+        finish({ error = "Tool '" .. func .. "' timed out" })
+    end, tonumber(def.timeout) or DEFAULT_TIMEOUT)
+end
+
+local function build_object(conn, server, tools)
+
+    local ubus = require("ubus")
+    local obj = {}
+
+    for func, def in pairs(tools) do
+
+        local policy = {}
+        for k, v in pairs(def.args or {}) do
+            if type(v) == "number" then
+                policy[k] = ubus.INT32
+            elseif type(v) == "boolean" then
+                policy[k] = ubus.BOOLEAN
+            elseif type(v) == "table" then
+                policy[k] = ubus.TABLE
+            else
+                policy[k] = ubus.STRING
+            end
+        end
+
+        obj[func] = {
+            function(req, msg)
+                dispatch(conn, req, server, func, def, msg or {})
+            end,
+            policy
+        }
+    end
+
+    return obj
+end
+
+local function registered(conn, objects)
+    local names = {}
+    for _, name in ipairs(conn:objects() or {}) do
+        names[name] = true
+    end
+    for name, _ in pairs(objects) do
+        if names[name] then
+            return true
+        end
+    end
+    return false
+end
+
+-- rpcd registered some of the objects (host just enabled, or a new tool script
+-- was installed and rpcd reloaded): restart it so that it re-lists the scripts.
+local function take_over_from_rpcd(conn, objects)
+
+    if not registered(conn, objects) then
+        return true
+    end
+
+    os.execute("/etc/init.d/rpcd restart >/dev/null 2>&1")
+
+    local nixio = require("nixio")
+
+    for _ = 1, RPCD_WAIT_MAX do
+        if not registered(conn, objects) then
+            return true
+        end
+        nixio.nanosleep(0, 500000000)
+    end
+
+    return false
+end
+
+-- Load every script, publish the served list and register the objects.
+local function start()
+
+    local ubus = require("ubus")
+
+    local objects = {}
+    local served = {}
+
+    for _, name in ipairs(M.list_scripts()) do
+        local tools, err, server = M.load_tools(name)
+        if tools and next(tools) then
+            objects[name] = { server = server, tools = tools }
+            served[#served + 1] = name
+        else
+            debug:log("oasis.log", "tool_host", "skip " .. name .. ": " .. tostring(err or "no tools"))
+        end
+    end
+
+    fs.mkdirr(common.file.tool.host)
+    misc.write_file(common.file.tool.host .. SERVED_FILE, table.concat(served, "\n") .. "\n")
+
+    local conn = ubus.connect()
+
+    if not conn then
+        return nil, "Failed to connect to ubus"
+    end
+
+    if not take_over_from_rpcd(conn, objects) then
+        conn:close()
+        return nil, "tool objects are still owned by rpcd"
+    end
+
+    -- One object at a time, so that a bad one does not keep the others off ubus
+    for name, o in pairs(objects) do
+        conn:add({ [name] = build_object(conn, o.server, o.tools) })
+    end
+
+    debug:log("oasis.log", "tool_host", "serving: " .. table.concat(served, ", "))
+
+    return conn
+end
+
+--- Daemon entry point (/usr/bin/oasis_tool_hostd). Returns only on error.
+-- @return boolean, string
+function M.run()
+
+    local uloop = require("uloop")
+
+    if not M.is_enabled() then
+        return false, "tool host is disabled (oasis.tool_host.enable)"
+    end
+
+    uloop.init()
+
+    local signature = M.signature()
+    local conn, err = start()
+
+    if not conn then
+        return false, err
+    end
+
+    local watch
+    watch = uloop.timer(function()
+        local current = M.signature()
+        -- Calls in flight answer on the current connection: reload once they are done
+        if (current ~= signature) and (inflight == 0) then
+            debug:log("oasis.log", "tool_host", "tool scripts changed: reloading")
+            signature = current
+            conn:close()
+            conn, err = start()
+            if not conn then
+                uloop.cancel()
+                return
+            end
+        end
+        watch:set(WATCH_INTERVAL)
+    end, WATCH_INTERVAL)
+
+    uloop.run()
+
+    if conn then
+        conn:close()
+        return true
+    end
+
+    return false, err
+end
+
+return M
@@ -0,0 +1,345 @@
+#!/usr/bin/env lua
+
+local uci       = require("luci.model.uci").cursor()
+local jsonc     = require("luci.jsonc")
+local common    = require("oasis.common")
+local misc      = require("oasis.chat.misc")
+local debug     = require("oasis.chat.debug")
+
+--[[
+[Tool Selection]
+Sending the schema of every enabled tool costs prompt tokens in proportion to
+the installed manifests, while a turn usually needs only a few of them.
+select() picks the tools worth sending for the current chat:
+
+ 1. pinned tools (always sent)
+ 2. tools used in the recent turns (tool_calls / tool results)
+ 3. the best matches of the latest user message, up to top_k in total
+When neither a match nor a recently used tool is found (e.g. a message in a
+language the descriptions are not written in), every tool is sent as before.
+
+Matching uses a small index built from each tool's name, description and
+argument descriptions (args_desc):
+ - words (lowercase, split on non-alphanumerics, trailing plural "s" removed)
+ - character bigrams for non-ASCII text, which has no spaces to split on
+ - character trigrams of each word, for partial matches (reboot/rebooting)
+Word hits are weighted by rarity (idf); a hit in the tool name counts double.
+
+The index is built together with the cached tool schema (oasis.local.tool.client)
+and only rebuilt when the tool registry changes.
+
+UCI (oasis.tool_select):
+ - enable   '1' to send only the selected tools
+ - top_k    number of tools sent besides the pinned ones
+ - pinned   list of tool names that are always sent
+]]
+
+local M = {}
+
+local DEFAULT_TOP_K     = 10
+local NAME_WEIGHT       = 2.0
+local PARTIAL_WEIGHT    = 0.5
+local PARTIAL_MIN       = 0.6   -- share of the query word's trigrams that must match
+local RECENT_TURNS      = 2     -- user turns looked back for tool usage
+local STATS_FILE        = "/tmp/oasis/tool_select.stats"
+
+local STOPWORDS = {}
+for w in ([[a an and any are as at be but by can could do does for from have how i
+    if in into is it its me my of on or please show tell that the then this to us
+    want was we what when where which who why will with would you your]]):gmatch("%S+") do
+    STOPWORDS[w] = true
+end
+
+local function add_word(out, w)
+    if (#w > 3) and (w:sub(-1) == "s") and (w:sub(-2) ~= "ss") then
+        w = w:sub(1, -2)
+    end
+    if (#w >= 2) and (not STOPWORDS[w]) then
+        out[#out + 1] = w
+    end
+end
+
+--- Split a text into index terms.
+-- @param text string
+-- @return table array of terms (may contain duplicates)
+function M.tokenize(text)
+
+    local out = {}
+
+    text = tostring(text or ""):lower()
+
+    for run in text:gmatch("[%w\128-\255]+") do
+        -- ASCII words inside the run
+        for w in run:gmatch("%w+") do
+            add_word(out, w)
+        end
+        -- Non-ASCII text: UTF-8 character bigrams
+        local chars = {}
+        for ch in run:gmatch("[\192-\255][\128-\191]*") do
+            chars[#chars + 1] = ch
+        end
+        for i = 1, #chars - 1 do
+            out[#out + 1] = chars[i] .. chars[i + 1]
+        end
+    end
+
+    return out
+end
+
+local function trigrams(word, out)
+    out = out or {}
+    if word:byte(1) >= 128 then
+        return out
+    end
+    local padded = " " .. word .. " "
+    for i = 1, #padded - 2 do
+        out[padded:sub(i, i + 2)] = true
+    end
+    return out
+end
+
+local function to_set(list)
+    local set = {}
+    for _, w in ipairs(list) do
+        set[w] = true
+    end
+    return set
+end
+
+--- Index terms of one tool (stored with the schema cache).
+-- @param tool_def table entry of client.get_function_call_schema()
+-- @return string name terms, string text terms (space separated)
+function M.index_terms(tool_def)
+
+    local text = { tool_def.description or "" }
+    local params = tool_def.parameters or {}
+
+    for pname, prop in pairs(params.properties or {}) do
+        text[#text + 1] = pname
+        text[#text + 1] = (type(prop) == "table") and prop.description or ""
+    end
+
+    return table.concat(M.tokenize(tool_def.name), " "), table.concat(M.tokenize(table.concat(text, " ")), " ")
+end
+
+--- Build the in-memory index from stored terms.
+-- @param entries table array of { name = string, name_terms = string, text_terms = string }
+-- @return table index
+function M.build_index(entries)
+
+    local index = { tools = {}, df = {} }
+
+    for i, e in ipairs(entries) do
+        local name_set = {}
+        local text_set = {}
+        for w in (e.name_terms or ""):gmatch("%S+") do name_set[w] = true end
+        for w in (e.text_terms or ""):gmatch("%S+") do text_set[w] = true end
+
+        local grams = {}
+        local seen = {}
+        for _, set in ipairs({ name_set, text_set }) do
+            for w, _ in pairs(set) do
+                trigrams(w, grams)
+                if not seen[w] then
+                    seen[w] = true
+                    index.df[w] = (index.df[w] or 0) + 1
+                end
+            end
+        end
+
+        index.tools[i] = { name = e.name, name_set = name_set, text_set = text_set, grams = grams }
+    end
+
+    return index
+end
+
+local function get_conf()
+    local cfg = common.db.uci.cfg
+    local sect = common.db.uci.sect.tool_select
+
+    local pinned = uci:get(cfg, sect, "pinned") or {}
+    if type(pinned) == "string" then
+        pinned = { pinned }
+    end
+
+    return {
+        enable = (uci:get(cfg, sect, "enable") == "1"),
+        top_k  = tonumber(uci:get(cfg, sect, "top_k") or "") or DEFAULT_TOP_K,
+        pinned = to_set(pinned),
+    }
+end
+
+--- Check whether tool selection is enabled.
+-- @return boolean
+function M.is_enabled()
+    return get_conf().enable
+end
+
+local function latest_user_text(messages)
+    for i = #messages, 1, -1 do
+        local m = messages[i]
+        if (m.role == common.role.user) and (type(m.content) == "string") then
+            return m.content
+        end
+    end
+    return ""
+end
+
+-- Tool names used since the RECENT_TURNS-th last user message, newest weighted most
+local function recent_tools(messages)
+
+    local recent = {}
+    local turns = 0
+
+    for i = #messages, 1, -1 do
+        local m = messages[i]
+        if m.role == common.role.user then
+            turns = turns + 1
+            if turns > RECENT_TURNS then
+                break
+            end
+        end
+        local weight = 1 / (turns + 1)
+        if (m.role == "tool") and m.name then
+            recent[m.name] = math.max(recent[m.name] or 0, weight)
+        end
+        for _, tc in ipairs((type(m.tool_calls) == "table") and m.tool_calls or {}) do
+            local fn = (type(tc) == "table") and tc["function"]
+            if (type(fn) == "table") and fn.name then
+                recent[fn.name] = math.max(recent[fn.name] or 0, weight)
+            end
+        end
+    end
+
+    return recent
+end
+
+--- Score every tool of an index against a query text.
+-- @param index table from build_index()
+-- @param text string
+-- @return table array of scores (same order as index.tools)
+function M.score(index, text)
+
+    local n = #index.tools
+    local query = to_set(M.tokenize(text))
+    local scores = {}
+
+    for i, tool in ipairs(index.tools) do
+        local s = 0
+        for q, _ in pairs(query) do
+            local df = index.df[q]
+            if df then
+                local idf = math.log(1 + n / df)
+                if tool.name_set[q] then
+                    s = s + NAME_WEIGHT * idf
+                elseif tool.text_set[q] then
+                    s = s + idf
+                end
+            else
+                -- Unknown word: partial match on trigrams
+                local grams = trigrams(q)
+                local total, hit = 0, 0
+                for g, _ in pairs(grams) do
+                    total = total + 1
+                    if tool.grams[g] then
+                        hit = hit + 1
+                    end
+                end
+                if (total > 0) and (hit / total >= PARTIAL_MIN) then
+                    s = s + PARTIAL_WEIGHT * (hit / total)
+                end
+            end
+        end
+        scores[i] = s
+    end
+
+    return scores
+end
+
+--- Select the tools to send for a chat.
+-- @param index table from build_index()
+-- @param chat table unified chat ({ messages = { ... } })
+-- @return table|nil sorted array of tool positions, nil when every tool is to be sent
+function M.select(index, chat)
+
+    local conf = get_conf()
+    local n = #index.tools
+
+    if (not conf.enable) or (not chat) or (type(chat.messages) ~= "table") then
+        return nil
+    end
+
+    local pinned_count = 0
+    for _, tool in ipairs(index.tools) do
+        if conf.pinned[tool.name] then
+            pinned_count = pinned_count + 1
+        end
+    end
+
+    if n <= conf.top_k + pinned_count then
+        return nil
+    end
+
+    local scores = M.score(index, latest_user_text(chat.messages))
+    local recent = recent_tools(chat.messages)
+
+    local ranked = {}
+    local picked = {}
+
+    for i, tool in ipairs(index.tools) do
+        if conf.pinned[tool.name] then
+            picked[#picked + 1] = i
+        else
+            -- Recently used tools outrank any text match
+            local boost = recent[tool.name] and (1000 * recent[tool.name]) or 0
+            if scores[i] + boost > 0 then
+                ranked[#ranked + 1] = { pos = i, score = scores[i] + boost }
+            end
+        end
+    end
+
+    if #ranked == 0 then
+        return nil
+    end
+
+    table.sort(ranked, function(a, b)
+        if a.score ~= b.score then
+            return a.score > b.score
+        end
+        return a.pos < b.pos
+    end)
+
+    for k = 1, math.min(conf.top_k, #ranked) do
+        picked[#picked + 1] = ranked[k].pos
+    end
+
+    table.sort(picked)
+
+    return picked
+end
+
+--- Add one request to the saved-bytes statistics.
+-- @param full_bytes number size of the full tools schema
+-- @param sent_bytes number size of the schema actually sent
+function M.record(full_bytes, sent_bytes)
+
+    local stats = jsonc.parse(misc.read_file(STATS_FILE) or "") or {}
+
+    stats.requests    = (tonumber(stats.requests) or 0) + 1
+    stats.full_bytes  = (tonumber(stats.full_bytes) or 0) + full_bytes
+    stats.sent_bytes  = (tonumber(stats.sent_bytes) or 0) + sent_bytes
+    stats.saved_bytes = stats.full_bytes - stats.sent_bytes
+
+    misc.write_file(STATS_FILE, jsonc.stringify(stats, false))
+
+    debug:log("oasis.log", "tool_select", string.format(
+        "schema bytes: full=%d sent=%d saved=%d", full_bytes, sent_bytes, full_bytes - sent_bytes))
+end
+
+--- Accumulated statistics ({ requests, full_bytes, sent_bytes, saved_bytes }).
+-- @return table
+function M.stats()
+    return jsonc.parse(misc.read_file(STATS_FILE) or "") or {}
+end
+
+return M
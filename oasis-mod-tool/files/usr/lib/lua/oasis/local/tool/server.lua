@@ -39,36 +39,62 @@ function M.parseInput()
     return parse:get()
 end
 
-function M.validateArgs(func, uargs)
-    local tool = methods[func]
-    if not tool then
-        print(jsonc.stringify({error = "Tool not found in methods table"}))
-        os.exit(1)
-    end
+--- Check call arguments against a tool definition.
+-- @param func string tool name
+-- @param tool table tool definition
+-- @param uargs table call arguments (ubus_rpc_session is removed)
+-- @return string|nil error message
+function M.checkArgs(func, tool, uargs)
     local n = 0
     for _, _ in pairs(uargs) do n = n + 1 end
     if tool.args and n == 0 then
-        print(jsonc.stringify({
-            error = "Received empty arguments for " .. func ..
-                " but it requires " .. jsonc.stringify(tool.args)
-        }))
-        os.exit(1)
+        return "Received empty arguments for " .. func ..
+            " but it requires " .. jsonc.stringify(tool.args)
     end
     uargs.ubus_rpc_session = nil
     local margs = tool.args or {}
     for k, v in pairs(uargs) do
         if margs[k] == nil or (v ~= nil and type(v) ~= type(margs[k])) then
-            print(jsonc.stringify({
-                error = "Invalid argument '" .. k .. "' for " .. func ..
-                    " it requires " .. jsonc.stringify(tool.args)
-            }))
-            os.exit(1)
+            return "Invalid argument '" .. k .. "' for " .. func ..
+                " it requires " .. jsonc.stringify(tool.args)
         end
     end
+    return nil
+end
+
+function M.validateArgs(func, uargs)
+    local tool = methods[func]
+    if not tool then
+        print(jsonc.stringify({error = "Tool not found in methods table"}))
+        os.exit(1)
+    end
+    local err = M.checkArgs(func, tool, uargs)
+    if err then
+        print(jsonc.stringify({ error = err }))
+        os.exit(1)
+    end
     return tool
 end
 
+--- Tools defined by the script that loaded this module (used by the tool host).
+-- @return table name -> definition
+function M.getMethods()
+    return methods
+end
+
+-- The resident tool host (oasis_tool_hostd) registers this object itself
+local function served_by_host()
+    local name = tostring(arg and arg[0] or ""):match("([^/]+)$")
+    local ok, host = pcall(require, "oasis.local.tool.host")
+    return ok and name and host.is_served(name)
+end
+
 function M.run(arg)
+    -- Loaded by the tool host (no arg[1]): it calls the tools itself
+    if not (arg and arg[1]) then
+        return methods
+    end
+
     -- Export call_<tool> functions for ubus/rpcd compatibility
     for name, def in pairs(methods) do
         _G["call_" .. name] = function(session, args)
@@ -83,6 +109,10 @@ function M.run(arg)
     end
 
     if arg[1] == "list" then
+        -- Printing nothing keeps rpcd from registering the object
+        if served_by_host() then
+            return
+        end
         local _, rv = nil, {}
         for _, tl in pairs(methods) do rv[_] = tl.args or {} end
         print((jsonc.stringify(rv):gsub(":%[%]", ":{}")))
@@ -96,6 +126,8 @@ function M.run(arg)
                 exec_msg = tl.exec_msg or "",
                 download_msg = tl.download_msg or "",
                 timeout = tl.timeout or "",
+                cacheable = tl.cacheable or false,
+                ttl = tl.ttl or "",
             }
         end
         print((jsonc.stringify(rv):gsub(":%[%]", ":{}")))
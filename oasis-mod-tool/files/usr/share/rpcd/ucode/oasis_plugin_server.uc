@@ -19,6 +19,8 @@ let server = require('oasis.local.tool.server');
 
 server.tool("oasis.hw.status", "get_board_info", {
     tool_desc: "Get this device board information.",
+    cacheable: true,
+    ttl: 300,
     call: function() {
         const fs = require('fs');
         const file = fs.open('/etc/board.json', 'r');
@@ -31,6 +33,8 @@ server.tool("oasis.hw.status", "get_board_info", {
 
 server.tool("oasis.os.status", "get_os_info", {
     tool_desc: "Get this OpenWrt OS Information.",
+    cacheable: true,
+    ttl: 300,
     call: function() {
         const fs = require('fs');
         const file = fs.open('/etc/os-release', 'r');
@@ -49,6 +53,8 @@ server.tool("oasis.os.status", "get_os_info", {
 
 server.tool("oasis.os.status", "get_kernel_info", {
     tool_desc: "Get this OpenWrt OS Information.",
+    cacheable: true,
+    ttl: 300,
     call: function() {
         const fs = require('fs');
         const file = fs.open('/proc/version', 'r');
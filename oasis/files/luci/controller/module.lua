@@ -31,6 +31,7 @@ function index()
     entry({"admin", "network", "oasis", "import-chat-data"}, call("import_chat_data"), nil).leaf = true
     entry({"admin", "network", "oasis", "delete-chat-data"}, call("delete_chat_data"), nil).leaf = true
     entry({"admin", "network", "oasis", "rename-chat"}, call("rename"), nil).leaf = true
+    entry({"admin", "network", "oasis", "chat-title"}, call("chat_title"), nil).leaf = true
     entry({"admin", "network", "oasis", "apply-uci-cmd"}, call("apply_uci_cmd"), nil).leaf = true
     entry({"admin", "network", "oasis", "confirm"}, call("confirm"), nil).leaf = true
     entry({"admin", "network", "oasis", "finalize"}, call("finalize"), nil).leaf = true
@@ -282,6 +283,26 @@ function rename()
     luci_http.write_json(result)
 end
 
+function chat_title()
+
+    -- debug:log("oasis.log", "\n--- [module.lua][chat_title] ---")
+
+    local params = luci_http.formvalue("params")
+
+    if not params then
+        luci_http.prepare_content("application/json")
+        luci_http.write_json({ error = "Missing params" })
+        return
+    end
+
+    local json_param = { id = params }
+
+    local result = util.ubus("oasis.title", "status", json_param)
+
+    luci_http.prepare_content("application/json")
+    luci_http.write_json(result or { error = "No title status" })
+end
+
 function apply_uci_cmd()
 
     -- debug:log("oasis.log", "\n--- [module.lua][apply_uci_cmd] ---")
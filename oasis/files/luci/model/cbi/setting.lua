@@ -16,6 +16,12 @@ rpc_enable = rpc:option(Flag, "enable", "Enable")
 rpc_enable.enabled = "1"
 rpc_enable.disabled = "0"
 
+resident = m:section(TypedSection, "resident")
+resident_enable = resident:option(Flag, "enable", "Resident Server")
+resident_enable.enabled = "1"
+resident_enable.disabled = "0"
+resident_enable.description = "Serve the oasis ubus objects from a resident process (oasis_ubusd) instead of starting a Lua interpreter per call. Takes effect after: service oasis_ubusd restart"
+
 storage = m:section(TypedSection, "storage")
 storage.addremove = false
 storage.removable = false
@@ -27,6 +33,63 @@ for i = 10, 100, 10 do
     chat_max:value(tostring(i), tostring(i))
 end
 
+context = m:section(TypedSection, "context")
+context.addremove = false
+context.removable = false
+
+context_enable = context:option(Flag, "enable", "Context Window Limit")
+context_enable.enabled = "1"
+context_enable.disabled = "0"
+context_enable.description = "Send only the system message and the most recent turns that fit in the token budget."
+
+context_budget = context:option(Value, "budget", "Token Budget")
+context_budget.datatype = "uinteger"
+context_budget:depends("enable", "1")
+
+context_reserve = context:option(Value, "reserve", "Reply Reserve")
+context_reserve.datatype = "uinteger"
+context_reserve:depends("enable", "1")
+
+context_summary = context:option(Flag, "summary", "Summarize Older Turns")
+context_summary.enabled = "1"
+context_summary.disabled = "0"
+context_summary:depends("enable", "1")
+
+context_model_budget = context:option(DynamicList, "model_budget", "Model Budget")
+context_model_budget.description = "Per-model token budget as &lt;model prefix&gt;=&lt;tokens&gt; (e.g. gpt-4o=100000)"
+context_model_budget:depends("enable", "1")
+
+-- check install oasis-mod-tool package
+if misc.check_file_exist("/usr/lib/lua/oasis/local/tool/select.lua") then
+    tool_select = m:section(TypedSection, "tool_select")
+    tool_select.addremove = false
+    tool_select.removable = false
+
+    tool_select_enable = tool_select:option(Flag, "enable", "Tool Selection")
+    tool_select_enable.enabled = "1"
+    tool_select_enable.disabled = "0"
+    tool_select_enable.description = "Send only the local tools relevant to the latest message instead of every enabled tool."
+
+    tool_select_top_k = tool_select:option(Value, "top_k", "Tools per Request")
+    tool_select_top_k.datatype = "uinteger"
+    tool_select_top_k:depends("enable", "1")
+
+    tool_select_pinned = tool_select:option(DynamicList, "pinned", "Pinned Tools")
+    tool_select_pinned.description = "Tool names that are always sent"
+    tool_select_pinned:depends("enable", "1")
+end
+
+if misc.check_file_exist("/usr/lib/lua/oasis/local/tool/host.lua") then
+    tool_host = m:section(TypedSection, "tool_host")
+    tool_host.addremove = false
+    tool_host.removable = false
+
+    tool_host_enable = tool_host:option(Flag, "enable", "Resident Tool Host")
+    tool_host_enable.enabled = "1"
+    tool_host_enable.disabled = "0"
+    tool_host_enable.description = "Serve the Lua local tools from a resident process (oasis_tool_hostd) instead of starting a Lua interpreter per tool call. Takes effect after: service oasis_tool_hostd restart"
+end
+
 rollback = m:section(TypedSection, "rollback")
 monitor_time = rollback:option(ListValue, "time", "Monitor Time")
 for i = 60, 600, 60 do
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "spoof.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * [UTF-8 DFA]
+ * Accepts exactly what guard.lua accepts: a lead byte C2-DF, E0-EF or F0-F4
+ * followed by the right number of continuation bytes (80-BF). Like the Lua
+ * version it does not reject overlong 3/4-byte forms or surrogates, so that
+ * both implementations give the same verdict for every input.
+ */
+
+// Byte classes
+#define C_ASCII     0   // 20-7E
+#define C_CTRL      1   // 00-1F, 7F
+#define C_CONT      2   // 80-BF
+#define C_LEAD2     3   // C2-DF
+#define C_LEAD3     4   // E0-EF
+#define C_LEAD4     5   // F0-F4
+#define C_BAD       6   // C0, C1, F5-FF
+#define C_NUM       7
+
+// States
+#define S_ACCEPT    0
+#define S_NEED1     1
+#define S_NEED2     2
+#define S_NEED3     3
+#define S_INVALID   4
+#define S_CONTROL   5
+
+static unsigned char byte_class[256];
+static int byte_class_ready = 0;
+
+static const unsigned char transition[4][C_NUM] = {
+    //             ASCII     CTRL       CONT       LEAD2      LEAD3      LEAD4      BAD
+    [S_ACCEPT] = { S_ACCEPT, S_CONTROL, S_INVALID, S_NEED1,   S_NEED2,   S_NEED3,   S_INVALID },
+    [S_NEED1]  = { S_INVALID, S_INVALID, S_ACCEPT, S_INVALID, S_INVALID, S_INVALID, S_INVALID },
+    [S_NEED2]  = { S_INVALID, S_INVALID, S_NEED1,  S_INVALID, S_INVALID, S_INVALID, S_INVALID },
+    [S_NEED3]  = { S_INVALID, S_INVALID, S_NEED2,  S_INVALID, S_INVALID, S_INVALID, S_INVALID },
+};
+
+// Payload bits of a byte by class, and the sequence length a lead byte starts
+static const unsigned char payload_mask[C_NUM] = { 0x7F, 0x7F, 0x3F, 0x1F, 0x0F, 0x07, 0x00 };
+static const unsigned char seq_length[C_NUM]   = { 1, 1, 0, 2, 3, 4, 0 };
+
+static void init_byte_class(void) {
+    for (int b = 0; b < 256; b++) {
+        unsigned char c;
+        if (b < 0x20 || b == 0x7F) {
+            c = C_CTRL;
+        } else if (b < 0x80) {
+            c = C_ASCII;
+        } else if (b < 0xC0) {
+            c = C_CONT;
+        } else if (b >= 0xC2 && b <= 0xDF) {
+            c = C_LEAD2;
+        } else if (b >= 0xE0 && b <= 0xEF) {
+            c = C_LEAD3;
+        } else if (b >= 0xF0 && b <= 0xF4) {
+            c = C_LEAD4;
+        } else {
+            c = C_BAD;
+        }
+        byte_class[b] = c;
+    }
+    byte_class_ready = 1;
+}
+
+/*
+ * Number of leading bytes that are printable ASCII (20-7E), counted in whole
+ * blocks; the DFA checks the remaining bytes one by one.
+ */
+static size_t ascii_run(const unsigned char *s, size_t len) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7F);
+
+    while (len - i >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        // Signed compare: bytes 80-FF are negative, so "< 0x20" also catches them
+        __m128i bad = _mm_or_si128(_mm_cmplt_epi8(v, space), _mm_cmpeq_epi8(v, del));
+        if (_mm_movemask_epi8(bad) != 0) {
+            break;
+        }
+        i += 16;
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    const uint8x16_t del = vdupq_n_u8(0x7F);
+
+    while (len - i >= 16) {
+        uint8x16_t v = vld1q_u8(s + i);
+        // 7F and every byte 80-FF are ">= 0x7F"
+        uint64x2_t bad = vreinterpretq_u64_u8(vorrq_u8(vcltq_u8(v, space), vcgeq_u8(v, del)));
+        if ((vgetq_lane_u64(bad, 0) | vgetq_lane_u64(bad, 1)) != 0) {
+            break;
+        }
+        i += 16;
+    }
+#endif
+
+    // SWAR: 8 bytes per step (also the tail of the vector loops)
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    while (len - i >= 8) {
+        uint64_t x;
+        memcpy(&x, s + i, sizeof(x));
+        if (x & highs) {
+            break;
+        }
+        // With no high bit set: a byte < 0x20, or a byte equal to 0x7F
+        uint64_t lt_space = (x - ones * 0x20) & ~x & highs;
+        uint64_t y = x ^ (ones * 0x7F);
+        uint64_t is_del = (y - ones) & ~y & highs;
+        if (lt_space | is_del) {
+            break;
+        }
+        i += 8;
+    }
+
+    return i;
+}
+
+static int is_suspicious(unsigned int cp, int length) {
+    if (length == 4) {
+        return cp >= 0x1F000 && cp <= 0x1FFFF;
+    }
+
+    return (cp >= 0x202A && cp <= 0x202E)       // BIDI controls (RLO/LRO etc.)
+        || (cp >= 0x2066 && cp <= 0x2069)       // isolate controls
+        || (cp >= 0x200B && cp <= 0x200F)       // zero-width / marks
+        || (cp >= 0x0300 && cp <= 0x036F)       // combining diacritics
+        || (cp >= 0xFE00 && cp <= 0xFE0F)       // variation selectors
+        || cp == 0xFEFF;                        // BOM
+}
+
+int spoof_scan(const unsigned char *s, size_t len, unsigned int *cp) {
+    size_t i = 0;
+    int state = S_ACCEPT;
+    int length = 0;
+    unsigned int code = 0;
+
+    if (!byte_class_ready) {
+        init_byte_class();
+    }
+
+    while (i < len) {
+        if (state == S_ACCEPT) {
+            i += ascii_run(s + i, len - i);
+            if (i >= len) {
+                break;
+            }
+        }
+
+        unsigned char b = s[i++];
+        int cls = byte_class[b];
+
+        if (state == S_ACCEPT) {
+            code = b & payload_mask[cls];
+            length = seq_length[cls];
+        } else {
+            code = (code << 6) | (b & payload_mask[cls]);
+        }
+
+        int prev = state;
+        state = transition[state][cls];
+
+        if (state == S_CONTROL) {
+            return SPOOF_CONTROL_CHAR;
+        }
+        if (state == S_INVALID) {
+            return SPOOF_INVALID_UTF8;
+        }
+        if (state == S_ACCEPT && prev != S_ACCEPT && is_suspicious(code, length)) {
+            if (cp) {
+                *cp = code;
+            }
+            return SPOOF_SUSPICIOUS_CP;
+        }
+    }
+
+    // Truncated sequence at the end
+    return (state == S_ACCEPT) ? SPOOF_OK : SPOOF_INVALID_UTF8;
+}
+
+const char *spoof_reason(int verdict, unsigned int cp, char *buf, size_t buflen) {
+    switch (verdict) {
+        case SPOOF_CONTROL_CHAR:
+            return "control-char";
+        case SPOOF_INVALID_UTF8:
+            return "invalid-utf8";
+        case SPOOF_SUSPICIOUS_CP:
+            snprintf(buf, buflen, "suspicious-cp:U+%X", cp);
+            return buf;
+        default:
+            return NULL;
+    }
+}
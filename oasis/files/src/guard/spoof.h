@@ -0,0 +1,25 @@
+#ifndef SPOOF_H
+#define SPOOF_H
+
+#include <stddef.h>
+
+// Verdicts of spoof_scan (reason text: see spoof_reason)
+#define SPOOF_OK            0
+#define SPOOF_CONTROL_CHAR  1
+#define SPOOF_INVALID_UTF8  2
+#define SPOOF_SUSPICIOUS_CP 3
+
+/*
+ * Scan a string the same way as detect_encoding_spoof() in guard.lua and
+ * return the verdict of the first offending character (SPOOF_OK when none).
+ * For SPOOF_SUSPICIOUS_CP the code point is stored in *cp.
+ */
+int spoof_scan(const unsigned char *s, size_t len, unsigned int *cp);
+
+/*
+ * Reason text of a verdict ("control-char", "invalid-utf8",
+ * "suspicious-cp:U+XXXX"), NULL for SPOOF_OK.
+ */
+const char *spoof_reason(int verdict, unsigned int cp, char *buf, size_t buflen);
+
+#endif // SPOOF_H
@@ -7,108 +7,53 @@ local sys       = require("luci.sys")
 local common    = require("oasis.common")
 local misc      = require("oasis.chat.misc")
 local debug     = require("oasis.chat.debug")
+local snapshot  = require("oasis.chat.snapshot")
+local fs        = require("nixio.fs")
 
 local M = {}
 
-local enqueue_rollback_data_with_enviction = function(data)
+local function rollback_point_dir(name)
+    return common.rollback.dir .. name .. "/"
+end
+
+local enqueue_rollback_data_with_enviction = function(manifest)
 
     debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "\n--- [apply.lua][enqueue_rollback_data_with_enviction] ---")
 
     local enable = uci:get_bool(common.db.uci.cfg, common.db.uci.sect.rollback, "enable")
 
     if not enable then
-    debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "rollback func disabled...")
+        debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "rollback func disabled...")
         return
     end
 
-    local list_max_num = uci:get(common.db.uci.cfg, common.db.uci.sect.rollback, "list_max_num") or "0"
-    list_max_num = tonumber(list_max_num)
-    misc.write_file(common.rollback.dir .. common.rollback.uci_cmd_json, data)
-
-    debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "write: " .. common.rollback.dir .. common.rollback.uci_cmd_json)
-    debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "data: " .. data)
-
-    local target_uci_list = uci:get_list(common.db.uci.cfg, common.db.uci.sect.rollback, "targets")
-    local rollback_list = uci:get_list(common.db.uci.cfg, common.db.uci.sect.rollback, "list")
-
-    debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "<target uci list>")
-    debug:dump("oasis.log", target_uci_list)
-    debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "<rollback list>")
-    debug:dump("oasis.log", rollback_list)
-
-    local index = #rollback_list + 1
+    local list_max_num = tonumber(uci:get(common.db.uci.cfg, common.db.uci.sect.rollback, "list_max_num") or "0") or 0
 
-    local enqueue = function(idx)
-        for _, config in ipairs(target_uci_list) do
-            local src = common.rollback.dir .. config
-            local dest = common.rollback.dir .. rollback_list[idx] .. "/" .. config
-        debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "[Copy File 1] src: " .. src .. ", dest: " .. dest)
-            misc.copy_file(src, dest)
-        end
-
-        local src = common.rollback.dir .. common.rollback.uci_cmd_json
-        local dest = common.rollback.dir .. rollback_list[idx] .. "/" .. common.rollback.uci_cmd_json
-    debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "[Copy File 2] src: " .. src .. ", dest: " .. dest)
-        misc.copy_file(src, dest)
-
-        local backup_uci_list = jsonc.stringify(target_uci_list)
-        local filename = common.rollback.dir .. rollback_list[idx] .. "/" .. common.rollback.backup_uci_list
-    debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "backup_uci_list: " .. backup_uci_list)
-    debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "filename: " .. filename)
-        misc.write_file(filename, backup_uci_list)
+    if list_max_num <= 0 then
+        return
     end
 
-    local dequeue = function()
-    debug:log("oasis.log", "dequeue", "dequeue start")
-        for i = 2, list_max_num do
-            debug:log("oasis.log", "dequeue", "index = " .. i)
-            local list_path = common.rollback.dir .. rollback_list[i - 1] .. "/" .. common.rollback.backup_uci_list
-            debug:log("oasis.log", "dequeue", "list_path: " .. list_path)
-            local list_json = misc.read_file(list_path)
-            debug:log("oasis.log", "dequeue", "list_jso: " .. list_json)
-            local delete_uci_list = jsonc.parse(list_json)
-            debug:dump("oasis.log", delete_uci_list)
-
-            for _, cfg in ipairs(delete_uci_list) do
-                debug:log("oasis.log", "dequeue", "Remove: " .. common.rollback.dir .. rollback_list[i - 1] .. "/" .. cfg)
-                os.remove(common.rollback.dir .. rollback_list[i - 1] .. "/" .. cfg)
-            end
+    misc.write_file(common.rollback.dir .. common.rollback.uci_cmd_json, jsonc.stringify(manifest.uci_list))
 
-            local src = common.rollback.dir .. rollback_list[i] .. "/" .. common.rollback.uci_cmd_json
-            local dest = common.rollback.dir .. rollback_list[i - 1] .. "/" .. common.rollback.uci_cmd_json
-            debug:log("oasis.log", "dequeue", "[Copy File 3] src: " .. src .. ", dest: " .. dest)
-            misc.copy_file(src, dest)
-
-            src = common.rollback.dir .. rollback_list[i] .. "/" .. common.rollback.backup_uci_list
-            dest = common.rollback.dir .. rollback_list[i - 1] .. "/" .. common.rollback.backup_uci_list
-            debug:log("oasis.log", "dequeue", "[Copy File 4] src: " .. src .. ", dest: " .. dest)
-            misc.copy_file(src, dest)
-
-            local backup_uci_list_json = misc.read_file(src)
-            debug:log("oasis.log", "dequeue", "backup_uci_list_json: " .. backup_uci_list_json)
-            local backup_uci_list = jsonc.parse(backup_uci_list_json)
-            debug:dump("oasis.log", backup_uci_list)
-            for _, cfg in ipairs(backup_uci_list) do
-                src = common.rollback.dir .. rollback_list[i] .. "/" .. cfg
-                dest = common.rollback.dir .. rollback_list[i - 1] .. "/" ..cfg
-                debug:log("oasis.log", "dequeue", "[Copy File 5] src: " .. src .. ", dest: " .. dest)
-                misc.copy_file(src, dest)
-            end
-        end
-    end
+    local rollback_list = uci:get_list(common.db.uci.cfg, common.db.uci.sect.rollback, "list")
 
-    if (index <= list_max_num) then
+    if #rollback_list < list_max_num then
         debug:log("oasis.log", "enqueue_rollback_data_with_enviction", "First enqueue!!")
+        local index = #rollback_list + 1
         rollback_list[index] = common.rollback.list_item_name .. index
-
-        enqueue(index)
-
+        snapshot.save(rollback_point_dir(rollback_list[index]), manifest)
         uci:set_list(common.db.uci.cfg, common.db.uci.sect.rollback, "list", rollback_list)
         uci:commit(common.db.uci.cfg)
     else
-        dequeue()
-        enqueue(list_max_num)
+        -- Evict the oldest point and shift the others down (manifests only; blobs are shared)
+        snapshot.remove(rollback_point_dir(rollback_list[1]))
+        for i = 2, list_max_num do
+            snapshot.move(rollback_point_dir(rollback_list[i]), rollback_point_dir(rollback_list[i - 1]))
+        end
+        snapshot.save(rollback_point_dir(rollback_list[list_max_num]), manifest)
     end
+
+    snapshot.gc()
 end
 
 function M.rollback_target_data(index)
@@ -116,37 +61,22 @@ function M.rollback_target_data(index)
     debug:log("oasis.log", "\n--- [apply.lua][rollback_target_data] ---")
     debug:log("oasis.log", "rollback_target_data", "index: " .. index)
 
+    index = tonumber(index) or 1
+
     local rollback_list = uci:get_list(common.db.uci.cfg, common.db.uci.sect.rollback, "list")
     local restored_list = {}
 
-    debug:dump("oasis.log", rollback_list)
-
     -- Rollback data (core process)
+    -- The oldest point at or after index wins for each config.
     for i = index, #rollback_list do
-    debug:log("oasis.log", "rollback_target_data", "i = " .. i)
-    debug:log("oasis.log", "rollback_target_data", "#rollback_list = " .. #rollback_list)
-    local file = common.rollback.dir .. rollback_list[i] .. "/" .. common.rollback.backup_uci_list
-    debug:log("oasis.log", "rollback_target_data", "file: " .. file)
-    local rollback_target_json = misc.read_file(file)
-    debug:log("oasis.log", "rollback_target_data", "rollback_target_json: " .. rollback_target_json)
-        local rollback_target_tbl = jsonc.parse(rollback_target_json)
-    debug:dump("oasis.log", rollback_target_tbl)
-        for _, cfg in ipairs(rollback_target_tbl) do
-
-            local is_restored = false
-            for _, restored_cfg in ipairs(restored_list) do
-                if cfg == restored_cfg then
-                    debug:log("oasis.log", "rollback_target_data", "The following setting has been rolled back: " .. cfg)
-                    is_restored = true
-                    break
-                end
-            end
-
-            if not is_restored then
-                -- rollback uci config
-                sys.exec("uci -f " .. common.rollback.dir .. rollback_list[i] .. "/" .. cfg .. " import " .. cfg)
-                debug:log("oasis.log", "rollback ---> " .. cfg)
-                restored_list[#restored_list + 1] = cfg
+        local manifest = snapshot.load(rollback_point_dir(rollback_list[i]))
+        for _, entry in ipairs((manifest and manifest.configs) or {}) do
+            if not restored_list[entry.name] then
+                snapshot.restore(entry)
+                debug:log("oasis.log", "rollback ---> " .. entry.name)
+                restored_list[entry.name] = true
+            else
+                debug:log("oasis.log", "rollback_target_data", "The following setting has been rolled back: " .. entry.name)
             end
         end
     end
@@ -154,26 +84,16 @@ function M.rollback_target_data(index)
     -- Delete unnecessary rollback data (/etc/oasis/backup/list*)
     for i = index, #rollback_list do
         debug:log("oasis.log", "Delete unnecessary settings for rollback.")
-        local delete_uci_list_file = common.rollback.dir .. rollback_list[i] .. "/" .. common.rollback.backup_uci_list
-        local delete_uci_list_json = misc.read_file(delete_uci_list_file)
-        local delete_uci_list_tbl = jsonc.parse(delete_uci_list_json)
-        local delete_uci_cmd_json = common.rollback.dir .. rollback_list[i] .. "/" .. common.rollback.uci_cmd_json
-        for _, cfg in ipairs(delete_uci_list_tbl) do
-            os.remove(common.rollback.dir .. rollback_list[i] .. "/" .. cfg)
-            debug:log("oasis.log", "Delete ---> " .. common.rollback.dir .. rollback_list[i] .. "/" .. cfg)
-        end
-        os.remove(delete_uci_list_file)
-        os.remove(delete_uci_cmd_json)
-        debug:log("oasis.log", "Delete ---> " .. delete_uci_list_file)
-        debug:log("oasis.log", "Delete ---> " .. delete_uci_cmd_json)
+        snapshot.remove(rollback_point_dir(rollback_list[i]))
     end
 
+    snapshot.gc()
+
     -- Update uci config
     local update_rollback_dir_list = {}
 
     for i = 1, (index - 1) do
         update_rollback_dir_list[#update_rollback_dir_list + 1] = common.rollback.list_item_name .. i
-        debug:log("oasis.log", "update_rollback_dir_list[" .. (#update_rollback_dir_list + 1) .. "] = " .. common.rollback.list_item_name .. i)
     end
 
     uci:set_list(common.db.uci.cfg, common.db.uci.sect.rollback, "list", update_rollback_dir_list)
@@ -198,26 +118,12 @@ function M.get_rollback_data_list()
         end
 
         for _, list_dir in ipairs(rollback_child_dirs) do
-            debug:log("oasis.log", "Delete unnecessary settings for rollback.")
-            local delete_uci_list_file = common.rollback.dir .. list_dir .. "/" .. common.rollback.backup_uci_list
-            debug:log("oasis.log", "delete_uci_list: " .. delete_uci_list_file)
-            local delete_uci_list_json = misc.read_file(delete_uci_list_file)
-            debug:log("oasis.log", "delete_uci_list_json: " .. delete_uci_list_json)
-            local delete_uci_list_tbl = jsonc.parse(delete_uci_list_json)
-            local delete_uci_cmd_file = common.rollback.dir .. list_dir .. "/" .. common.rollback.uci_cmd_json
-            debug:log("oasis.log", "delete_uci_cmd_file: " .. delete_uci_cmd_file)
-
-            for _, cfg in ipairs(delete_uci_list_tbl) do
-                os.remove(common.rollback.dir .. list_dir .. "/" .. cfg)
-                debug:log("oasis.log", "Delete ---> " .. common.rollback.dir .. list_dir .. "/" .. cfg)
-            end
-
-            os.remove(delete_uci_list_file)
-            os.remove(delete_uci_cmd_file)
-            debug:log("oasis.log", "Delete ---> " .. delete_uci_list_file)
-            debug:log("oasis.log", "Delete ---> " .. delete_uci_cmd_file)
+            debug:log("oasis.log", "Delete unnecessary settings for rollback: " .. list_dir)
+            snapshot.remove(rollback_point_dir(list_dir))
         end
 
+        snapshot.gc()
+
         uci:delete(common.db.uci.cfg, common.db.uci.sect.rollback, "list")
         uci:commit(common.db.uci.cfg)
         debug:log("oasis.log", "[2] rollback func disabled...")
@@ -235,27 +141,10 @@ function M.get_rollback_data_list()
             break
         end
 
-        local base_path = common.rollback.dir .. rollback_child_dirs[i] .. "/"
-        local uci_file = base_path .. common.rollback.uci_cmd_json
-        local backup_uci_list = base_path .. common.rollback.backup_uci_list
-
-        debug:log("oasis.log", "uci_file: " .. uci_file)
-        debug:log("oasis.log", "backup_uci_list: " .. backup_uci_list)
-
-        local uci_stat = io.open(uci_file, "r")
-        local backup_stat = io.open(backup_uci_list, "r")
+        local manifest = snapshot.load(rollback_point_dir(rollback_child_dirs[i]))
 
-        if uci_stat and backup_stat then
-            uci_stat:close()
-            backup_stat:close()
-
-            local rollback_data_json = misc.read_file(uci_file)
-            local rollback_data_tbl = jsonc.parse(rollback_data_json)
-
-            rollback_data_list[#rollback_data_list + 1] = rollback_data_tbl
-        else
-            if uci_stat then uci_stat:close() end
-            if backup_stat then backup_stat:close() end
+        if manifest and manifest.uci_list then
+            rollback_data_list[#rollback_data_list + 1] = manifest.uci_list
         end
     end
 
@@ -265,20 +154,15 @@ end
 function M.create_new_backup_data(uci_list, id, backup_type)
 
     local list = {}
+    local app = util.ubus("uci", "configs", {}) or {}
 
     if backup_type == "normal" then
         local backup_target_cfg = {}
         for _, target_cmd_tbl in pairs(uci_list) do
-            -- for debug
-            -- sys.exec("echo " .. key .. " >> /tmp/oasis-backup.log")
-            -- sys.exec("echo " .. #target_cmd_tbl .. " >> /tmp/oasis-backup.log")
-            -- sys.exec("echo " .. type(target_cmd_tbl) .. " >> /tmp/oasis-backup.log")
             if (type(target_cmd_tbl) == "table") and (#target_cmd_tbl > 0) then
-                -- sys.exec("echo table >> /tmp/oasis-backup.log")
                 for _, cmd in ipairs(target_cmd_tbl) do
                     local is_exist = false
                     for _, config in ipairs(backup_target_cfg) do
-                        -- sys.exec("echo " .. cmd.class.config .. " >> /tmp/oasis-backup.log")
                         if cmd.class.config == config then
                             is_exist = true
                         end
@@ -291,30 +175,36 @@ function M.create_new_backup_data(uci_list, id, backup_type)
             end
         end
 
-        local app = util.ubus("uci", "configs", {})
         for _, config in ipairs(backup_target_cfg) do
-            for _, config_in_list in ipairs(app.configs) do
+            for _, config_in_list in ipairs(app.configs or {}) do
                 -- Verify whether the target config name matches the actual OpenWrt config name
                 if config_in_list == config then
-                    sys.exec("uci export " .. config .. " > /etc/oasis/backup/" .. config)
                     list[#list + 1] = config
                 end
             end
         end
     elseif backup_type == "full" then
-        sys.exec("uci export > /etc/oasis/backup/full_backup")
-        list[#list + 1] = "full_backup"
+        -- every config as its own blob (unchanged ones are shared with earlier snapshots)
+        for _, config in ipairs(app.configs or {}) do
+            list[#list + 1] = config
+        end
     else
         return false
     end
 
     if #list > 0 then
+        -- Snapshot of the configs about to change (/etc/oasis/backup/manifest.json + blobs)
+        local manifest = snapshot.create(common.rollback.dir, list, uci_list)
+
+        if not manifest then
+            return false
+        end
+
         uci:set(common.db.uci.cfg, common.db.uci.sect.rollback, "confirm", "1")
         uci:set(common.db.uci.cfg, common.db.uci.sect.rollback, "src_id", id)
         uci:set_list(common.db.uci.cfg, common.db.uci.sect.rollback, "targets", list)
 
-        local uci_list_json = jsonc.stringify(uci_list)
-        enqueue_rollback_data_with_enviction(uci_list_json)
+        enqueue_rollback_data_with_enviction(manifest)
 
         for _, config in ipairs(list) do
             uci:commit(config)
@@ -357,51 +247,30 @@ function M.rollback()
     end
 
     -- [Delete Target Rollback Data]
-    -- Rollback ---> /etc/backup/<previous uci configs>
-    for _, cfg in ipairs(target_uci_list) do
-        local rollback = "uci -f " .. common.rollback.dir .. cfg .. " import " .. cfg
-        debug:log("oasis.log", "uci cmd: " .. rollback)
-        sys.exec(rollback)
-    end
+    -- Rollback ---> /etc/oasis/backup/manifest.json (<previous uci configs>)
+    local manifest = snapshot.load(common.rollback.dir, target_uci_list)
 
-    -- Delete unnecessary current rollback data (/etc/backup/<previous uci configs>)
-    for _, cfg in ipairs(target_uci_list) do
-        debug:log("oasis.log", "Remove: " .. common.rollback.dir .. cfg)
-        os.remove(common.rollback.dir .. cfg)
+    for _, entry in ipairs((manifest and manifest.configs) or {}) do
+        snapshot.restore(entry)
     end
 
-    -- Delete unnecessary current rollback data (/etc/backup/<uci_cmd_json>)
-    debug:log("oasis.log", "Remove: " .. common.rollback.dir .. common.rollback.uci_cmd_json)
-    os.remove(common.rollback.dir .. common.rollback.uci_cmd_json)
+    -- Delete unnecessary current rollback data (manifest, uci_list.json)
+    snapshot.remove(common.rollback.dir, target_uci_list)
 
     uci:delete(common.db.uci.cfg, common.db.uci.sect.rollback, "targets")
 
-    -- Delete unnecessary rollback data in list (/etc/backup/list*/~)
+    -- Delete unnecessary rollback data in list (/etc/oasis/backup/list*/~)
     local rollback_list = uci:get_list(common.db.uci.cfg, common.db.uci.sect.rollback, "list")
-    local rollback_data_dir = common.rollback.dir .. rollback_list[#rollback_list] .."/"
-    local rollback_data_file = rollback_data_dir .. common.rollback.backup_uci_list
-    debug:log("oasis.log", "Read: " .. rollback_data_file)
-
-    local rollback_data_json = misc.read_file(rollback_data_file)
-    local rollback_data_tbl = jsonc.parse(rollback_data_json)
 
-    debug:dump("oasis.log", rollback_data_tbl)
-
-    for _, cfg in ipairs(rollback_data_tbl) do
-        debug:log("oasis.log", "Remove: " .. rollback_data_dir .. cfg)
-        os.remove(rollback_data_dir .. cfg)
+    if #rollback_list > 0 then
+        snapshot.remove(rollback_point_dir(rollback_list[#rollback_list]))
+        table.remove(rollback_list, #rollback_list)
     end
 
-    debug:log("oasis.log", "Remove: " .. rollback_data_dir .. common.rollback.uci_cmd_json)
-    os.remove(rollback_data_dir .. common.rollback.uci_cmd_json)
+    snapshot.gc()
 
-    debug:log("oasis.log", "[1][rollback_list]")
-    debug:dump("oasis.log", rollback_list)
-    table.remove(rollback_list, #rollback_list)
     uci:set_list(common.db.uci.cfg, common.db.uci.sect.rollback, "list", rollback_list)
     uci:commit(common.db.uci.cfg)
-    debug:log("oasis.log", "[2][rollback_list]")
-    debug:dump("oasis.log", rollback_list)
     sys.exec("reboot")
 end
 
@@ -416,10 +285,174 @@ function M.finalize()
     return false
 end
 
+--[[
+[Service Reload Planner]
+Every config touched by an apply is reloaded once, whatever the number of commands
+that changed it, in dependency order:
+
+ stage 1  network, wireless   netifd re-reads both ("ubus call network reload")
+ stage 2  firewall, dhcp
+ stage 3  everything else
+
+The init scripts behind a config come from the procd reload triggers
+("ubus call service list" -> config.change), e.g. dhcp -> dnsmasq and odhcpd,
+and run with the action the trigger names (normally "reload").
+Configs without a trigger fall back to /etc/init.d/<config> reload.
+The scripts of one stage run concurrently (one shell, "&" + "wait");
+the next stage starts when they are all done.
+]]
+
+local NETIFD_CONFIGS = { network = true, wireless = true }
+local RELOAD_STAGE = { network = 1, wireless = 1, firewall = 2, dhcp = 2 }
+local RELOAD_STAGE_DEFAULT = 3
+
+-- config name -> { "<script> <action>", ... } from the procd config.change triggers
+local function get_reload_triggers()
+
+    local triggers = {}
+    local services = util.ubus("service", "list", { verbose = true }) or {}
+
+    local function walk(node, pkgs, cmds)
+        if type(node) ~= "table" then
+            return
+        end
+        if (node[1] == "eq") and (node[2] == "package") and (type(node[3]) == "string") then
+            pkgs[#pkgs + 1] = node[3]
+        elseif (node[1] == "run_script") and (type(node[2]) == "string") then
+            cmds[#cmds + 1] = node[2] .. " " .. tostring(node[3] or "reload")
+        end
+        for _, child in ipairs(node) do
+            walk(child, pkgs, cmds)
+        end
+    end
+
+    for _, svc in pairs(services) do
+        for _, trigger in ipairs((type(svc) == "table" and svc.triggers) or {}) do
+            if trigger[1] == "config.change" then
+                local pkgs, cmds = {}, {}
+                walk(trigger[2], pkgs, cmds)
+                for _, pkg in ipairs(pkgs) do
+                    triggers[pkg] = triggers[pkg] or {}
+                    for _, cmd in ipairs(cmds) do
+                        table.insert(triggers[pkg], cmd)
+                    end
+                end
+            end
+        end
+    end
+
+    return triggers
+end
+
+--- Build the reload plan for an uci command list.
+-- @param uci_list table { set = {...}, add = {...}, ... }
+-- @return table array of stages { netifd = boolean, scripts = { string, ... }, configs = { string, ... } }
+function M.plan_reload(uci_list)
+
+    local configs = {}
+    local seen = {}
+
+    for _, cmds in pairs(uci_list or {}) do
+        if type(cmds) == "table" then
+            for _, cmd in ipairs(cmds) do
+                local config = (type(cmd) == "table") and cmd.class and cmd.class.config
+                if (type(config) == "string") and config:match("^[%w_%-]+$") and (not seen[config]) then
+                    seen[config] = true
+                    configs[#configs + 1] = config
+                end
+            end
+        end
+    end
+
+    table.sort(configs, function(a, b)
+        local sa = RELOAD_STAGE[a] or RELOAD_STAGE_DEFAULT
+        local sb = RELOAD_STAGE[b] or RELOAD_STAGE_DEFAULT
+        if sa ~= sb then
+            return sa < sb
+        end
+        return a < b
+    end)
+
+    local plan = {}
+    local stages = {}
+    local queued = {}
+    local triggers = nil
+
+    for _, config in ipairs(configs) do
+
+        local no = RELOAD_STAGE[config] or RELOAD_STAGE_DEFAULT
+        local stage = stages[no]
+
+        if not stage then
+            stage = { netifd = false, scripts = {}, configs = {} }
+            stages[no] = stage
+            plan[#plan + 1] = stage
+        end
+
+        stage.configs[#stage.configs + 1] = config
+
+        if NETIFD_CONFIGS[config] then
+            stage.netifd = true
+        else
+            triggers = triggers or get_reload_triggers()
+
+            local cmds = triggers[config]
+
+            if (not cmds) and misc.check_init_script_exists(config) then
+                cmds = { "/etc/init.d/" .. config .. " reload" }
+            end
+
+            for _, cmd in ipairs(cmds or {}) do
+                if not queued[cmd] then
+                    queued[cmd] = true
+                    stage.scripts[#stage.scripts + 1] = cmd
+                end
+            end
+        end
+    end
+
+    return plan
+end
+
+--- Run a reload plan (stage by stage, scripts of a stage concurrently).
+-- @param plan table from plan_reload()
+function M.run_reload(plan)
+
+    for _, stage in ipairs(plan or {}) do
+
+        debug:log("oasis.log", "run_reload", "configs: " .. table.concat(stage.configs, ", "))
+
+        if stage.netifd then
+            util.ubus("network", "reload", {})
+        end
+
+        if #stage.scripts > 0 then
+            local cmd = {}
+            for _, script in ipairs(stage.scripts) do
+                debug:log("oasis.log", "run_reload", "---> " .. script)
+                cmd[#cmd + 1] = "(" .. script .. " >/dev/null 2>&1) &"
+            end
+            cmd[#cmd + 1] = "wait"
+            os.execute(table.concat(cmd, " "))
+        end
+    end
+end
+
+-- Cached results of read-only tools (oasis.local.tool.client) describe the
+-- configuration before this apply.
+local function drop_tool_result_cache()
+    local dir = common.file.tool.cache
+    for name in (fs.dir(dir) or function() return nil end) do
+        os.remove(dir .. name)
+    end
+end
+
 function M.apply(uci_list, commit)
 
     debug:log("oasis.log", "\n--- [apply.lua][apply] ---")
 
+    drop_tool_result_cache()
+
     -- uci add command
     for _, cmd in ipairs(uci_list.add) do
         -- create unnamed section
@@ -611,38 +644,12 @@ function M.apply(uci_list, commit)
         end
     end
 
-    sys.exec("lua /usr/bin/oasisd &")
-
-    debug:log("oasis.log", "Check ---> /etc/init.d/xxxx")
-    debug:log("oasis.log", "<uci list>")
-    debug:dump("oasis.log", uci_list)
-    for key, target_cmd_tbl in pairs(uci_list) do
-        if (key == "set") and (type(target_cmd_tbl) == "table") then
-            debug:log("oasis.log", "<target_cmd_tbl>")
-            debug:dump("oasis.log", target_cmd_tbl)
-            for _, cmd in ipairs(target_cmd_tbl) do
-                if (cmd.class.config == "network") or (cmd.class.config == "wireless") then
-                    local is_init_script = misc.check_file_exist("/etc/init.d/network")
-                    if is_init_script then
-                        debug:log("oasis.log", "[1] trigger config: " .. cmd.class.config)
-                        sys.exec("/etc/init.d/network restart")
-                        break
-                    end
-                end
-            end
-
-            for _, cmd in ipairs(target_cmd_tbl) do
-                if (cmd.class.config ~= "network") and (cmd.class.config ~= "wireless") then
-                    local init_script = "/etc/init.d/" .. cmd.class.config
-                    local is_file_exist = misc.check_file_exist(init_script)
-                    if is_file_exist then
-                        debug:log("oasis.log", "[2] trigger config: " .. cmd.class.config)
-                        sys.exec(init_script .. " restart")
-                    end
-                end
-            end
-        end
+    -- Rollback monitor (oasis-mod-retired). Detached: sys.exec would wait for it to exit.
+    if misc.check_file_exist("/usr/bin/oasisd") then
+        os.execute("lua /usr/bin/oasisd >/dev/null 2>&1 &")
     end
+
+    M.run_reload(M.plan_reload(uci_list))
 end
 
 return M
@@ -0,0 +1,379 @@
+#!/usr/bin/env lua
+
+local uci       = require("luci.model.uci").cursor()
+local common    = require("oasis.common")
+local debug     = require("oasis.chat.debug")
+
+--[[
+[Context Window Manager]
+Bounds the message list sent to the AI service by an estimated token budget.
+
+The saved chat is never modified. build() returns a view of the chat that keeps:
+ 1. every system message
+ 2. the in-flight turn (last user message and any tool calls/results after it)
+ 3. as many recent turns as fit in the remaining budget
+ 4. pinned tool results: the newest tool results of the turns that did not fit,
+    each with the assistant message that called it (and that call's other
+    results) and the user message of its turn; the final answer of such a turn
+    is dropped
+Older turns that do not fit are dropped and, when enabled, replaced by a short
+summary system message built locally from the dropped messages (no extra AI request).
+
+Token counts are estimates (about 4 ASCII bytes or 1 multibyte character per token).
+Estimates are cached per message table and persisted by oasis.chat.storage
+(meta.tokens), so a saved message is measured once in its lifetime.
+
+UCI (oasis.context):
+ - enable        '1' (default) / '0'
+ - budget        default prompt budget in tokens
+ - reserve       tokens left free for the reply
+ - summary       '1' to summarize dropped turns
+ - summary_max   token cap for the summary message
+ - pin_tools     tool results of dropped turns to keep (0: none)
+ - model_budget  list of '<model prefix>=<tokens>' overriding budget per model
+]]
+
+local M = {}
+
+local MESSAGE_OVERHEAD      = 4
+local DEFAULT_BUDGET        = 8000
+local DEFAULT_RESERVE       = 1024
+local DEFAULT_SUMMARY_MAX   = 256
+local DEFAULT_PIN_TOOLS     = 4
+local SUMMARY_LINE_MAX      = 160
+
+-- not in common.role: tool results only exist in the unified schema
+local ROLE_TOOL             = "tool"
+
+local conf = nil
+local estimates = setmetatable({}, { __mode = "k" })
+
+local function get_conf()
+
+    if conf then
+        return conf
+    end
+
+    local cfg = common.db.uci.cfg
+    local sect = common.db.uci.sect.context
+
+    conf = {}
+    conf.enable         = (uci:get(cfg, sect, "enable") ~= "0")
+    conf.budget         = tonumber(uci:get(cfg, sect, "budget") or "") or DEFAULT_BUDGET
+    conf.reserve        = tonumber(uci:get(cfg, sect, "reserve") or "") or DEFAULT_RESERVE
+    conf.summary        = (uci:get(cfg, sect, "summary") ~= "0")
+    conf.summary_max    = tonumber(uci:get(cfg, sect, "summary_max") or "") or DEFAULT_SUMMARY_MAX
+    conf.pin_tools      = tonumber(uci:get(cfg, sect, "pin_tools") or "") or DEFAULT_PIN_TOOLS
+    conf.model_budget   = {}
+
+    local list = uci:get(cfg, sect, "model_budget")
+    if type(list) == "string" then
+        list = { list }
+    end
+
+    for _, entry in ipairs(list or {}) do
+        local prefix, value = tostring(entry):match("^%s*(.-)%s*=%s*(%d+)%s*$")
+        if prefix and (#prefix > 0) then
+            conf.model_budget[#conf.model_budget + 1] = { prefix = prefix, value = tonumber(value) }
+        end
+    end
+
+    return conf
+end
+
+--- Drop the cached UCI settings (for long-running processes).
+function M.refresh()
+    uci:unload(common.db.uci.cfg)
+    conf = nil
+end
+
+--- Estimate the token count of a text.
+-- @param text string
+-- @return number
+function M.estimate_text(text)
+
+    text = tostring(text or "")
+
+    if #text == 0 then
+        return 0
+    end
+
+    local _, lead = text:gsub("[\192-\255]", "")
+    local _, cont = text:gsub("[\128-\191]", "")
+    local ascii = #text - lead - cont
+
+    return math.ceil(ascii / 4) + lead
+end
+
+--- Estimate (and cache) the token count of a message.
+-- @param msg table unified schema message
+-- @return number
+function M.estimate(msg)
+
+    local n = estimates[msg]
+
+    if n then
+        return n
+    end
+
+    n = MESSAGE_OVERHEAD + M.estimate_text(msg.content)
+
+    if type(msg.tool_calls) == "table" then
+        for _, tc in ipairs(msg.tool_calls) do
+            local fn = (type(tc) == "table") and tc["function"] or nil
+            if type(fn) == "table" then
+                n = n + M.estimate_text(fn.name) + M.estimate_text(fn.arguments)
+            end
+        end
+    end
+
+    estimates[msg] = n
+
+    return n
+end
+
+--- Seed the cache with a previously stored estimate.
+-- @param msg table
+-- @param n number|nil
+function M.remember(msg, n)
+    n = tonumber(n)
+    if n then
+        estimates[msg] = n
+    end
+end
+
+--- Prompt token budget for a model (budget minus reply reserve).
+-- @param model string|nil
+-- @return number
+function M.get_budget(model)
+
+    local c = get_conf()
+    local budget = c.budget
+
+    model = tostring(model or "")
+
+    for _, entry in ipairs(c.model_budget) do
+        if model:sub(1, #entry.prefix) == entry.prefix then
+            budget = entry.value
+            break
+        end
+    end
+
+    return math.max(budget - c.reserve, 0)
+end
+
+local function one_line(text)
+    text = tostring(text or ""):gsub("%s+", " ")
+    if #text > SUMMARY_LINE_MAX then
+        -- cut on a UTF-8 character boundary
+        local cut = SUMMARY_LINE_MAX
+        while (cut > 1) and (text:byte(cut + 1) or 0) >= 128 and (text:byte(cut + 1) or 0) < 192 do
+            cut = cut - 1
+        end
+        text = text:sub(1, cut) .. "..."
+    end
+    return text
+end
+
+local function build_summary(msgs, keep, last_dropped, max_tokens)
+
+    local header = "Summary of earlier conversation (older turns were omitted to fit the context window):"
+    local lines = {}
+    local used = M.estimate_text(header)
+
+    -- newest dropped messages first, so the most recent context survives the cap
+    for i = last_dropped, 1, -1 do
+        local m = msgs[i]
+        if (not keep[i])
+                and ((m.role == common.role.user) or (m.role == common.role.assistant) or (m.role == ROLE_TOOL))
+                and (type(m.content) == "string") and (#m.content > 0) then
+            local line = "- " .. m.role .. ": " .. one_line(m.content)
+            local cost = M.estimate_text(line)
+            if used + cost > max_tokens then
+                break
+            end
+            table.insert(lines, 1, line)
+            used = used + cost
+        end
+    end
+
+    if #lines == 0 then
+        return nil
+    end
+
+    local msg = { role = common.role.system, content = header .. "\n" .. table.concat(lines, "\n") }
+    estimates[msg] = MESSAGE_OVERHEAD + used
+
+    return msg
+end
+
+--- Build the message view sent to the AI service.
+-- Returns chat itself when it already fits the budget.
+-- @param service table
+-- @param chat table
+-- @return table view, table stats { total, used, dropped }
+function M.build(service, chat)
+
+    local c = get_conf()
+    local msgs = (chat and chat.messages) or {}
+    local stats = { total = 0, used = 0, dropped = 0 }
+
+    for _, m in ipairs(msgs) do
+        stats.total = stats.total + M.estimate(m)
+    end
+
+    stats.used = stats.total
+
+    if (not c.enable) or (#msgs == 0) then
+        return chat, stats
+    end
+
+    local cfg = (service and service.get_config and service:get_config()) or {}
+    local budget = M.get_budget(cfg.model or chat.model)
+
+    if stats.total <= budget then
+        return chat, stats
+    end
+
+    -- 1) Mandatory: system messages and the in-flight turn
+    local last_user = #msgs
+    for i = #msgs, 1, -1 do
+        if msgs[i].role == common.role.user then
+            last_user = i
+            break
+        end
+    end
+
+    local keep = {}
+    local used = 0
+
+    for i, m in ipairs(msgs) do
+        if (m.role == common.role.system) or (i >= last_user) then
+            keep[i] = true
+            used = used + M.estimate(m)
+        end
+    end
+
+    -- 2) Recent turns, newest first, grouped from each user message so that
+    --    assistant tool_calls always travel with their tool results
+    local cut = last_user
+    local i = last_user - 1
+
+    if c.summary then
+        used = used + math.min(c.summary_max, budget - used) + MESSAGE_OVERHEAD
+    end
+
+    while i >= 1 do
+        local start = i
+        while (start > 1) and (msgs[start].role ~= common.role.user) do
+            start = start - 1
+        end
+
+        local cost = 0
+        for j = start, i do
+            if not keep[j] then
+                cost = cost + M.estimate(msgs[j])
+            end
+        end
+
+        if used + cost > budget then
+            break
+        end
+
+        for j = start, i do
+            keep[j] = true
+        end
+
+        used = used + cost
+        cut = start
+        i = start - 1
+    end
+
+    -- 3) Pinned tool results of the dropped turns, newest first. A result
+    --    travels with its assistant tool_calls message and that call's other
+    --    results (APIs reject a half-answered call) and its turn's user message.
+    local pinned = 0
+    i = cut - 1
+
+    while (i >= 1) and (pinned < c.pin_tools) do
+
+        local call = i
+        while (call >= 1) and (msgs[call].role == ROLE_TOOL) do
+            call = call - 1
+        end
+
+        if (call < i) and (call >= 1) and (msgs[call].role == common.role.assistant)
+                and (type(msgs[call].tool_calls) == "table") then
+
+            local last = call + 1
+            while (last < cut - 1) and (msgs[last + 1].role == ROLE_TOOL) do
+                last = last + 1
+            end
+
+            local start = call
+            while (start > 1) and (msgs[start].role ~= common.role.user) do
+                start = start - 1
+            end
+
+            local group = { start }
+            for j = call, last do
+                group[#group + 1] = j
+            end
+
+            local cost = 0
+            for _, j in ipairs(group) do
+                if not keep[j] then
+                    cost = cost + M.estimate(msgs[j])
+                end
+            end
+
+            if used + cost <= budget then
+                for _, j in ipairs(group) do
+                    keep[j] = true
+                end
+                used = used + cost
+                pinned = pinned + (last - call)
+            end
+        end
+
+        i = call - 1
+    end
+
+    -- 4) Assemble the view
+    local view = {}
+    for k, v in pairs(chat) do
+        if k ~= "messages" then
+            view[k] = v
+        end
+    end
+    view.messages = {}
+
+    local summary = nil
+    if c.summary and (cut > 1) then
+        summary = build_summary(msgs, keep, cut - 1, c.summary_max)
+    end
+
+    stats.used = 0
+
+    -- the summary goes before the first kept turn (pinned results are older than the recent turns)
+    for idx, m in ipairs(msgs) do
+        if summary and keep[idx] and (m.role ~= common.role.system) then
+            view.messages[#view.messages + 1] = summary
+            stats.used = stats.used + M.estimate(summary)
+            summary = nil
+        end
+        if keep[idx] then
+            view.messages[#view.messages + 1] = m
+            stats.used = stats.used + M.estimate(m)
+        else
+            stats.dropped = stats.dropped + 1
+        end
+    end
+
+    debug:log("oasis.log", "context.build", string.format(
+        "budget=%d total=%d used=%d dropped=%d", budget, stats.total, stats.used, stats.dropped))
+
+    return view, stats
+end
+
+return M
@@ -1,10 +1,11 @@
 #!/usr/bin/env lua
 
-local util      = require("luci.util")
 local uci       = require("luci.model.uci").cursor()
 local common    = require("oasis.common")
 local misc      = require("oasis.chat.misc")
 local ous       = require("oasis.unified.chat.schema")
+local storage   = require("oasis.chat.storage")
+local title     = require("oasis.chat.title")
 local debug     = require("oasis.chat.debug")
 
 local M = {}
@@ -108,7 +109,7 @@ function M.load_chat_data(service)
 
     if cfg and cfg.id and (#cfg.id ~= 0) then
         debug:log("oasis.log", "load_chat_data", "load chat data!! (id = )" .. tostring(cfg.id))
-        chat = util.ubus("oasis.chat", "load", {id = cfg.id})
+        chat = storage.load(cfg.id) or {}
     end
 
     chat.model = cfg.model
@@ -128,38 +129,28 @@ function M.create_chat_file(service, chat)
         if idx >= 1 and idx <= count then return chat.messages[idx].role, chat.messages[idx].content end
         return "", ""
     end
-    local message = {}
+    local messages = {}
     if (service.sysmsg_key) and (#service.sysmsg_key > 0) and (service.sysmsg_key == sysmsg_info.fix_key.casual) then
-        local r2, c2 = get(count-1)
-        local r3, c3 = get(count)
-        message.role1, message.content1 = r2, c2
-        message.role2, message.content2 = r3, c3
-        message.role3, message.content3 = "", ""
+        for idx = count - 1, count do
+            local r, c = get(idx)
+            messages[#messages + 1] = { role = r, content = c }
+        end
     else
-        local r1, c1 = get(count-2)
-        local r2, c2 = get(count-1)
-        local r3, c3 = get(count)
-        message.role1, message.content1 = r1, c1
-        message.role2, message.content2 = r2, c2
-        message.role3, message.content3 = r3, c3
+        for idx = count - 2, count do
+            local r, c = get(idx)
+            messages[#messages + 1] = { role = r, content = c }
+        end
     end
 
-    -- os.execute("echo " .. message.role1 .. " >> /tmp/oasis-message.log")
-    -- os.execute("echo \"" .. message.content1 .. "\" >> /tmp/oasis-message.log")
-    -- os.execute("echo " .. message.role2 .. " >> /tmp/oasis-message.log")
-    -- os.execute("echo \"" .. message.content2 .. "\" >> /tmp/oasis-message.log")
-    -- os.execute("echo " .. message.role3 .. " >> /tmp/oasis-message.log")
-    -- os.execute("echo \"" .. message.content3 .. "\" >> /tmp/oasis-message.log")
-
-    local result = util.ubus("oasis.chat", "create", message)
-    service.id = result.id
-    return result.id
+    local id = storage.create(messages)
+    service.id = id
+    return id
 end
 
 function M.set_chat_title(service, chat_id)
-    local request = util.ubus("oasis.title", "auto_set", {id = chat_id})
-
-    if request.status == common.status.error then
+    -- The title is generated by a background job (see oasis.chat.title);
+    -- it shows up in "oasis list" once the AI has answered.
+    if not title.enqueue(chat_id) then
         io.write("\n\27[1;33;41m Title Creation: Error \27[0m\n")
         return
     end
@@ -167,7 +158,7 @@ function M.set_chat_title(service, chat_id)
     service:set_chat_id(chat_id)
 
     local announce =  "\n" .. "\27[1;37;44m" .. "Title:"
-    announce = announce  .. "\27[1;33;44m" .. request.title
+    announce = announce  .. "\27[1;33;44m" .. "(generating...)"
     announce = announce .. "  \27[1;37;44m" .. "ID:"
     announce = announce .. "\27[1;33;44m" .. chat_id
     announce = announce .. "\27[0m"
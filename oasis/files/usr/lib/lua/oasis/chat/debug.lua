@@ -12,19 +12,42 @@ Additionally, to set the log output destination to a static area (/etc/oasis), u
 
 If volatile=1 (default), logs will be output to /tmp.
 
+The amount of output is selected by oasis.debug.level (default 'debug'):
+ error < warn < info < debug
+log() and dump() write at the debug level.
+
 Note:
 Currently, when debug logs are enabled, only the processing of Oasis UBUS objects is logged.
 To enable logging for the Lua script being debugged, add calls to the log or dump functions.
+
+[Cost]
+With logging disabled a call returns after one branch, but its arguments are
+still evaluated by the caller. Build expensive messages lazily:
+- debug:log("oasis.log", "caller", function() return jsonc.stringify(tbl, true) end)
+- debug:logf("oasis.log", "caller", "n=%d body=%s", n, body)   (format only when enabled)
+- if debug:enabled() then ... end
+
+Lines are buffered per file and written when the buffer grows past
+BUFFER_MAX bytes, with the first line logged FLUSH_INTERVAL seconds after the
+last write, on warn/error, on debug:flush() and when the process ends
+(os.exit or normal end of the interpreter).
 ]]
 
 local uci = require("luci.model.uci").cursor()
 
+local LEVELS = { error = 1, warn = 2, info = 3, debug = 4 }
+local BUFFER_MAX        = 4096
+local FLUSH_INTERVAL    = 1
+
 local debug = {}
 debug.new = function()
 
     local obj = {}
 
     obj.disabled = uci:get_bool("oasis", "debug", "disabled")
+    obj.level = LEVELS[uci:get("oasis", "debug", "level") or ""] or LEVELS.debug
+    -- log/logf/dump test this single flag
+    obj.quiet = obj.disabled or (obj.level < LEVELS.debug)
 
     obj.dest = "/etc/oasis/"
 
@@ -32,31 +55,100 @@ debug.new = function()
         obj.dest = "/tmp/"
     end
 
-    --- Write a log line.
-    -- @param filename string output file name
-    -- @param ... any message parts
-    obj.log = function(self, filename, ...)
-        if self.disabled then return end
+    local buffers = {}      -- filename -> array of lines
+    local buffered = 0      -- bytes held in buffers
+    local last_flush = os.time()
+
+    --- Write every buffered line to its file.
+    obj.flush = function(self)
+        for filename, lines in pairs(buffers) do
+            local file = io.open(self.dest .. filename, "a")
+            if file then
+                file:write(table.concat(lines, "\n"), "\n")
+                file:close()
+            end
+        end
+        buffers = {}
+        buffered = 0
+        last_flush = os.time()
+    end
 
-        local args = {...}
-        local msg = ""
+    if not obj.disabled then
+        -- Flush when the interpreter closes the state (normal end, uncaught error)
+        local guard = newproxy(true)
+        getmetatable(guard).__gc = function() obj:flush() end
+        obj.guard = guard
+
+        -- os.exit() ends the process without closing the state
+        local exit = os.exit
+        os.exit = function(...)
+            obj:flush()
+            return exit(...)
+        end
+    end
 
-        if #args == 1 then
-            msg = tostring(args[1])
-        elseif #args >= 2 then
+    local function write(self, filename, level, msg)
+        local lines = buffers[filename]
+        if not lines then
+            lines = {}
+            buffers[filename] = lines
+        end
+        lines[#lines + 1] = msg
+        buffered = buffered + #msg + 1
+
+        if (buffered >= BUFFER_MAX) or (level <= LEVELS.warn) or (os.time() - last_flush >= FLUSH_INTERVAL) then
+            self:flush()
+        end
+    end
+
+    local function emit(self, level, filename, ...)
+        local n = select("#", ...)
+        local a1, a2 = ...
+        local msg
+
+        if type(a2) == "function" then
+            a2 = a2()
+        end
+        if type(a1) == "function" then
+            a1 = a1()
+        end
+
+        if n == 1 then
+            msg = tostring(a1)
+        elseif n >= 2 then
             -- second arg is caller function name, third is the message
-            msg = "[" .. tostring(args[1]) .. "] " .. tostring(args[2])
+            msg = "[" .. tostring(a1) .. "] " .. tostring(a2)
         else
             msg = ""
         end
 
-        local path = self.dest .. filename
-        local file = io.open(path, "a")
-        if not file then
-            return
-        end
-        file:write(msg .. "\n")
-        file:close()
+        write(self, filename, level, msg)
+    end
+
+    --- Check whether a level is written (to guard expensive log code).
+    -- @param level string|nil "error", "warn", "info" or "debug" (default)
+    -- @return boolean
+    obj.enabled = function(self, level)
+        return (not self.disabled) and ((LEVELS[level or "debug"] or LEVELS.debug) <= self.level)
+    end
+
+    --- Write a log line (debug level).
+    -- A message part may be a function; it is only called when the line is written.
+    -- @param filename string output file name
+    -- @param ... any message parts
+    obj.log = function(self, filename, ...)
+        if self.quiet then return end
+        emit(self, LEVELS.debug, filename, ...)
+    end
+
+    --- Write a formatted log line (debug level); the format runs only when enabled.
+    -- @param filename string
+    -- @param caller string caller function name
+    -- @param fmt string string.format pattern
+    -- @param ... any format arguments
+    obj.logf = function(self, filename, caller, fmt, ...)
+        if self.quiet then return end
+        write(self, filename, LEVELS.debug, "[" .. tostring(caller) .. "] " .. string.format(fmt, ...))
     end
 
     obj.recursive_dump = function(self, filename, tbl, path)
@@ -64,49 +156,54 @@ debug.new = function()
             local key_path = path .. "[" .. tostring(k) .. "]"
             local vt = type(v)
             if vt == "string" or vt == "number" or vt == "boolean" or vt == "nil" then
-                self:log(filename, key_path .. "=" .. tostring(v))
+                write(self, filename, LEVELS.debug, key_path .. "=" .. tostring(v))
             elseif vt == "table" then
                 self:recursive_dump(filename, v, key_path)
             else
-                self:log(filename, key_path .. "=<" .. vt .. ">")
+                write(self, filename, LEVELS.debug, key_path .. "=<" .. vt .. ">")
             end
         end
     end
 
-    --- Dump a table recursively.
+    --- Dump a table recursively (debug level).
     -- @param filename string
     -- @param data table|any
     obj.dump = function(self, filename, data)
-        if self.disabled then return end
+        if self.quiet then return end
         if type(data) ~= "table" then
-            self:log(filename, tostring(data))
+            write(self, filename, LEVELS.debug, tostring(data))
             return
         end
         self:recursive_dump(filename, data, "data")
     end
 
-    --- Convenience: info level log (alias to log)
+    --- Info level log
     -- @param filename string
-    -- @param msg string
+    -- @param msg string|function
     obj.info = function(self, filename, msg)
-        self:log(filename, msg)
+        if self.disabled then return end
+        if self.level < LEVELS.info then return end
+        emit(self, LEVELS.info, filename, msg)
     end
 
-    --- Convenience: warn level log (alias to log with prefix)
+    --- Warn level log (prefixed with WARN, written at once)
     -- @param filename string
-    -- @param msg string
+    -- @param msg string|function
     obj.warn = function(self, filename, msg)
-        self:log(filename, "WARN", msg)
+        if self.disabled then return end
+        if self.level < LEVELS.warn then return end
+        emit(self, LEVELS.warn, filename, "WARN", msg)
     end
 
-    --- Convenience: error level log (alias to log with prefix)
+    --- Error level log (prefixed with ERROR, written at once)
     -- @param filename string
-    -- @param msg string
+    -- @param msg string|function
     obj.error = function(self, filename, msg)
-        self:log(filename, "ERROR", msg)
+        if self.disabled then return end
+        emit(self, LEVELS.error, filename, "ERROR", msg)
     end
 
     return obj
 end
 
-return debug.new()
\ No newline at end of file
+return debug.new()
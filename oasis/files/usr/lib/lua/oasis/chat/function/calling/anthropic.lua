@@ -4,6 +4,7 @@ local jsonc  = require("luci.jsonc")
 local common = require("oasis.common")
 local uci    = require("luci.model.uci").cursor()
 local debug  = require("oasis.chat.debug")
+local misc   = require("oasis.chat.misc")
 local ous    = require("oasis.unified.chat.schema")
 
 local M = {}
@@ -62,6 +63,23 @@ function M.process(self, message)
     local reboot = false
     local shutdown = false
 
+    -- Calls are collected first: they run concurrently and are joined in order.
+    -- Calls without an id are not deduplicated and get no tool_call_id.
+    local calls = {}
+
+    local function add_call(func, args, call_id, check_flags, log_label)
+        if self and self.processed_tool_call_ids and call_id ~= "" then
+            if self.processed_tool_call_ids[call_id] then
+                debug:log("oasis.log", log_label, "skip duplicate tool_call id = " .. call_id)
+                return
+            end
+            self.processed_tool_call_ids[call_id] = true
+            calls[#calls + 1] = { id = call_id, name = func, args = args, check_flags = check_flags }
+        else
+            calls[#calls + 1] = { id = "", name = func, args = args, anonymous = true }
+        end
+    end
+
     -- Case 1: OpenAI-like tool_calls (fallback)
     if message.tool_calls and type(message.tool_calls) == "table" and #message.tool_calls > 0 then
         for _, tc in ipairs(message.tool_calls) do
@@ -71,51 +89,7 @@ function M.process(self, message)
                 local ok, parsed = pcall(jsonc.parse, tc["function"].arguments)
                 if ok and parsed then args = parsed end
             end
-
-            local call_id = tostring(tc.id or "")
-            if self and self.processed_tool_call_ids and call_id ~= "" then
-                if self.processed_tool_call_ids[call_id] then
-                    debug:log("oasis.log", "process", "skip duplicate tool_call id = " .. call_id)
-                else
-                    self.processed_tool_call_ids[call_id] = true
-                    local result = client.exec_server_tool(self:get_format(), func, args)
-
-                    if result.reboot then
-                        debug:log("oasis.log", "process", "result.reboot = true")
-                        reboot = result.reboot
-                    end
-                    if result.shutdown then
-                        debug:log("oasis.log", "process", "result.shutdown = true")
-                        shutdown = result.shutdown
-                    end
-
-                    local output = jsonc.stringify(result, false)
-                    table.insert(function_call.tool_outputs, {
-                        tool_call_id = call_id,
-                        output = output,
-                        name = func
-                    })
-                    table.insert(speaker.tool_calls, {
-                        id = call_id,
-                        type = "function",
-                        ["function"] = {
-                            name = func,
-                            arguments = jsonc.stringify(args or {}, false)
-                        }
-                    })
-                    if first_output_str == "" then first_output_str = output end
-                end
-            else
-                local result = client.exec_server_tool(self:get_format(), func, args)
-                local output = jsonc.stringify(result, false)
-                table.insert(function_call.tool_outputs, { output = output, name = func })
-                table.insert(speaker.tool_calls, {
-                    id = "",
-                    type = "function",
-                    ["function"] = { name = func, arguments = jsonc.stringify(args or {}, false) }
-                })
-                if first_output_str == "" then first_output_str = output end
-            end
+            add_call(func, args, tostring(tc.id or ""), true, "process")
         end
     end
 
@@ -129,46 +103,51 @@ function M.process(self, message)
                     local ok, parsed = pcall(jsonc.parse, tostring(args or ""))
                     if ok and parsed then args = parsed else args = {} end
                 end
-                local call_id = tostring(part.id or "")
-
-                if self and self.processed_tool_call_ids and call_id ~= "" then
-                    if self.processed_tool_call_ids[call_id] then
-                        debug:log("oasis.log", "recv_ai_msg", "skip duplicate tool_use id = " .. call_id)
-                    else
-                        self.processed_tool_call_ids[call_id] = true
-                        local result = client.exec_server_tool(self:get_format(), func, args)
-                        local output = jsonc.stringify(result, false)
-                        table.insert(function_call.tool_outputs, {
-                            tool_call_id = call_id,
-                            output = output,
-                            name = func
-                        })
-                        table.insert(speaker.tool_calls, {
-                            id = call_id,
-                            type = "function",
-                            ["function"] = {
-                                name = func,
-                                arguments = jsonc.stringify(args or {}, false)
-                            }
-                        })
-                        if first_output_str == "" then first_output_str = output end
-                    end
-                else
-                    local result = client.exec_server_tool(self:get_format(), func, args)
-                    local output = jsonc.stringify(result, false)
-                    table.insert(function_call.tool_outputs, { output = output, name = func })
-                    table.insert(speaker.tool_calls, {
-                        id = "",
-                        type = "function",
-                        ["function"] = { name = func, arguments = jsonc.stringify(args or {}, false) }
-                    })
-                    if first_output_str == "" then first_output_str = output end
-                end
+                add_call(func, args, tostring(part.id or ""), false, "recv_ai_msg")
             end
         end
     end
 
+    local results, cache_info = client.exec_server_tools(self:get_format(), calls)
+
+    for i, call in ipairs(calls) do
+        local result = results[i]
+
+        if call.check_flags then
+            if result.reboot then
+                debug:log("oasis.log", "process", "result.reboot = true")
+                reboot = result.reboot
+            end
+            if result.shutdown then
+                debug:log("oasis.log", "process", "result.shutdown = true")
+                shutdown = result.shutdown
+            end
+        end
+
+        local output = jsonc.stringify(result, false)
+        if call.anonymous then
+            table.insert(function_call.tool_outputs, { output = output, name = call.name, cache = cache_info[i] })
+        else
+            table.insert(function_call.tool_outputs, {
+                tool_call_id = call.id,
+                output = output,
+                name = call.name,
+                cache = cache_info[i]
+            })
+        end
+        table.insert(speaker.tool_calls, {
+            id = call.id,
+            type = "function",
+            ["function"] = {
+                name = call.name,
+                arguments = jsonc.stringify(call.args or {}, false)
+            }
+        })
+        if first_output_str == "" then first_output_str = output end
+    end
+
     local plain_text_for_console = first_output_str
+    function_call.tool_cache = { hits = cache_info.hits, misses = cache_info.misses }
     function_call.reboot = reboot
     function_call.shutdown = shutdown
     local response_ai_json = jsonc.stringify(function_call, false)
@@ -177,7 +156,10 @@ function M.process(self, message)
 end
 
 -- Inject tool definitions into the Anthropic request (beta tools schema)
-function M.inject_schema(self, body)
+-- Returns body and the splice holding the cached tools JSON; the caller
+-- applies it to the serialized body (misc.apply_json_splice).
+-- chat (unified schema) is used to select the tools relevant to the request.
+function M.inject_schema(self, body, chat)
     local is_use_tool = uci:get_bool(common.db.uci.cfg, common.db.uci.sect.support, "local_tool")
     if not is_use_tool then
         return body
@@ -187,30 +169,18 @@ function M.inject_schema(self, body)
     end
 
     local client = require("oasis.local.tool.client")
-    local schema = client.get_function_call_schema()
-
-    body.tools = body.tools or {}
-    for _, tool_def in ipairs(schema or {}) do
-        local params = tool_def.parameters or {}
-        table.insert(body.tools, {
-            type = "custom",
-            name = tool_def.name,
-            description = tool_def.description or "",
-            input_schema = {
-                type = params.type or "object",
-                properties = params.properties or {},
-                required = params.required or {}
-            }
-        })
-    end
+    local tools_json, count = client.get_tool_schema_json("anthropic", chat)
 
     -- Add tool_choice only when tools exist; otherwise remove both
-    if body.tools and (#body.tools > 0) then
+    if tools_json and (count > 0) then
+        local splice = misc.json_splice(tools_json)
+        body.tools = splice.placeholder
         body.tool_choice = { type = "auto" }
-    else
-        body.tools = nil
-        body.tool_choice = nil
+        return body, splice
     end
+
+    body.tools = nil
+    body.tool_choice = nil
     return body
 end
 
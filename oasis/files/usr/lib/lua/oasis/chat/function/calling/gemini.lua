@@ -4,6 +4,7 @@ local jsonc  = require("luci.jsonc")
 local common = require("oasis.common")
 local uci    = require("luci.model.uci").cursor()
 local debug  = require("oasis.chat.debug")
+local misc   = require("oasis.chat.misc")
 local ous	 = require("oasis.unified.chat.schema")
 
 local M = {}
@@ -67,6 +68,9 @@ function M.process(self, message)
     local reboot = false
     local shutdown = false
 
+	-- Calls are collected first: they run concurrently and are joined in order
+	local calls = {}
+
 	local function handle_one_call(name, args, id)
 		local call_id = id or ""
 		if self and self.processed_tool_call_ids and call_id ~= "" then
@@ -76,33 +80,7 @@ function M.process(self, message)
 			end
 			self.processed_tool_call_ids[call_id] = true
 		end
-        local result = client.exec_server_tool(self:get_format(), name or "", args or {})
-		debug:log("oasis.log", "process", "tool exec result (pretty) [gemini] = " .. jsonc.stringify(result, true))
-
-		if result.reboot then
-			debug:log("oasis.log", "process", "result.reboot = true")
-			reboot = result.reboot
-		end
-        if result.shutdown then
-            debug:log("oasis.log", "process", "result.shutdown = true")
-            shutdown = result.shutdown
-        end
-
-		local output = jsonc.stringify(result, false)
-		table.insert(function_call.tool_outputs, {
-			tool_call_id = call_id,
-			output = output,
-			name = name or ""
-		})
-		table.insert(speaker.tool_calls, {
-			id = call_id,
-			type = "function",
-			["function"] = {
-				name = name or "",
-				arguments = jsonc.stringify(args or {}, false)
-			}
-		})
-		if first_output_str == "" then first_output_str = output end
+		calls[#calls + 1] = { id = call_id, name = name or "", args = args or {} }
 	end
 
 	-- Case 1: OpenAI-like tool_calls (rare in Gemini path, but keep compatibility)
@@ -141,7 +119,41 @@ function M.process(self, message)
 		end
 	end
 
+	local results, cache_info = client.exec_server_tools(self:get_format(), calls)
+
+	for i, call in ipairs(calls) do
+		local result = results[i]
+		debug:log("oasis.log", "process", function() return "tool exec result (pretty) [gemini] = " .. (jsonc.stringify(result, true) or "") end)
+
+		if result.reboot then
+			debug:log("oasis.log", "process", "result.reboot = true")
+			reboot = result.reboot
+		end
+		if result.shutdown then
+			debug:log("oasis.log", "process", "result.shutdown = true")
+			shutdown = result.shutdown
+		end
+
+		local output = jsonc.stringify(result, false)
+		table.insert(function_call.tool_outputs, {
+			tool_call_id = call.id,
+			output = output,
+			name = call.name,
+			cache = cache_info[i]
+		})
+		table.insert(speaker.tool_calls, {
+			id = call.id,
+			type = "function",
+			["function"] = {
+				name = call.name,
+				arguments = jsonc.stringify(call.args, false)
+			}
+		})
+		if first_output_str == "" then first_output_str = output end
+	end
+
     local plain_text_for_console = first_output_str
+    function_call.tool_cache = { hits = cache_info.hits, misses = cache_info.misses }
     function_call.reboot = reboot
     function_call.shutdown = shutdown
     local response_ai_json = jsonc.stringify(function_call, false)
@@ -154,7 +166,10 @@ function M.process(self, message)
 	return plain_text_for_console, response_ai_json, speaker, true
 end
 
-function M.inject_schema(self, user_msg)
+-- Returns user_msg and the splice holding the cached functionDeclarations entry;
+-- the caller applies it to the serialized body (misc.apply_json_splice).
+-- chat (unified schema) is used to select the tools relevant to the request.
+function M.inject_schema(self, user_msg, chat)
 	-- Gemini attaches tools.functionDeclarations to the GenerateContent body.
 	local is_use_tool = uci:get_bool(common.db.uci.cfg, common.db.uci.sect.support, "local_tool")
 	if not is_use_tool then
@@ -165,25 +180,14 @@ function M.inject_schema(self, user_msg)
 	end
 
 	local client = require("oasis.local.tool.client")
-	local schema = client.get_function_call_schema()
+	local tools_json, count = client.get_tool_schema_json("gemini", chat)
 
 	user_msg = user_msg or {}
 	user_msg.tools = user_msg.tools or {}
-	local fdecl = {}
-	for _, tool_def in ipairs(schema or {}) do
-		local params = tool_def.parameters or {}
-		table.insert(fdecl, {
-			name = tool_def.name,
-			description = tool_def.description or "",
-			parameters = {
-				type = params.type or "object",
-				properties = params.properties or {},
-				required = params.required or {}
-			}
-		})
-	end
-	if #fdecl > 0 then
-		user_msg.tools[#user_msg.tools + 1] = { functionDeclarations = fdecl }
+	if tools_json and (count > 0) then
+		local splice = misc.json_splice(tools_json)
+		user_msg.tools[#user_msg.tools + 1] = splice.placeholder
+		return user_msg, splice
 	end
 	return user_msg
 end
@@ -4,6 +4,7 @@ local jsonc  = require("luci.jsonc")
 local common = require("oasis.common")
 local uci    = require("luci.model.uci").cursor()
 local debug  = require("oasis.chat.debug")
+local misc   = require("oasis.chat.misc")
 local ous	 = require("oasis.unified.chat.schema")
 
 local M = {}
@@ -42,6 +43,8 @@ function M.process(self, message)
 	local reboot = false
     local shutdown = false
 
+	-- Collect the calls first: they run concurrently and are joined in order
+	local calls = {}
 	for _, tc in ipairs(message.tool_calls or {}) do
 		local func = tc["function"] and tc["function"].name or ""
 		local args = {}
@@ -55,39 +58,47 @@ function M.process(self, message)
 			debug:log("oasis.log", "process", "skip duplicate tool_call id = " .. tostring(call_id))
 		else
 			self.processed_tool_call_ids[call_id] = true
-			local result = client.exec_server_tool(self:get_format(), func, args)
-			debug:log("oasis.log", "process", "tool exec result (pretty) = " .. jsonc.stringify(result, true))
+			calls[#calls + 1] = { id = tc.id, name = func, args = args }
+		end
+	end
 
-			if result.reboot then
-				debug:log("oasis.log", "process", "result.reboot = true")
-				reboot = result.reboot
-			end
-            if result.shutdown then
-                debug:log("oasis.log", "process", "result.shutdown = true")
-                shutdown = result.shutdown
-            end
-
-			local output = jsonc.stringify(result, false)
-			table.insert(function_call.tool_outputs, {
-				tool_call_id = tc.id,
-				output = output,
-				name = func
-			})
-
-			table.insert(speaker.tool_calls, {
-				id = tc.id,
-				type = "function",
-				["function"] = {
-					name = func,
-					arguments = jsonc.stringify(args, false)
-				}
-			})
-
-			if first_output_str == "" then first_output_str = output end
+	local results, cache_info = client.exec_server_tools(self:get_format(), calls)
+
+	for i, call in ipairs(calls) do
+		local result = results[i]
+		debug:log("oasis.log", "process", function() return "tool exec result (pretty) = " .. (jsonc.stringify(result, true) or "") end)
+
+		if result.reboot then
+			debug:log("oasis.log", "process", "result.reboot = true")
+			reboot = result.reboot
 		end
+		if result.shutdown then
+			debug:log("oasis.log", "process", "result.shutdown = true")
+			shutdown = result.shutdown
+		end
+
+		local output = jsonc.stringify(result, false)
+		table.insert(function_call.tool_outputs, {
+			tool_call_id = call.id,
+			output = output,
+			name = call.name,
+			cache = cache_info[i]
+		})
+
+		table.insert(speaker.tool_calls, {
+			id = call.id,
+			type = "function",
+			["function"] = {
+				name = call.name,
+				arguments = jsonc.stringify(call.args, false)
+			}
+		})
+
+		if first_output_str == "" then first_output_str = output end
 	end
 
 	local plain_text_for_console = first_output_str
+	function_call.tool_cache = { hits = cache_info.hits, misses = cache_info.misses }
 	function_call.reboot = reboot
     function_call.shutdown = shutdown
 	local response_ai_json = jsonc.stringify(function_call, false)
@@ -100,6 +111,9 @@ function M.process(self, message)
 	return plain_text_for_console, response_ai_json, speaker, true
 end
 
+-- Returns user_msg and the splice holding the cached tools JSON; the caller
+-- applies it to the serialized body (misc.apply_json_splice).
+-- user_msg (unified schema) is also used to select the tools relevant to the request.
 function M.inject_schema(self, user_msg)
 	local is_use_tool = uci:get_bool(common.db.uci.cfg, common.db.uci.sect.support, "local_tool")
 	if not is_use_tool then
@@ -110,21 +124,12 @@ function M.inject_schema(self, user_msg)
 	end
 
 	local client = require("oasis.local.tool.client")
-	local schema = client.get_function_call_schema()
+	local tools_json = client.get_tool_schema_json("openai", user_msg)
 
-	user_msg["tools"] = {}
-	for _, tool_def in ipairs(schema) do
-		table.insert(user_msg["tools"], {
-			type = "function",
-			["function"] = {
-				name = tool_def.name,
-				description = tool_def.description or "",
-				parameters = tool_def.parameters
-			}
-		})
-	end
+	local splice = misc.json_splice(tools_json or "[]")
+	user_msg["tools"] = splice.placeholder
 	user_msg["tool_choice"] = "auto"
-	return user_msg
+	return user_msg, splice
 end
 
 -----------------------------------
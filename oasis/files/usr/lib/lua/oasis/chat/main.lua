@@ -7,6 +7,7 @@ local jsonc             = require("luci.jsonc")
 local misc              = require("oasis.chat.misc")
 local transfer          = require("oasis.chat.transfer")
 local datactrl          = require("oasis.chat.datactrl")
+local storage           = require("oasis.chat.storage")
 local common            = require("oasis.common")
 local console           = require("oasis.console")
 local ous               = require("oasis.unified.chat.schema")
@@ -953,18 +954,7 @@ function M.delchat(arg)
         return
     end
 
-    local storage_path = uci:get(common.db.uci.cfg, common.db.uci.sect.storage, "path")
-    local prefix = uci:get(common.db.uci.cfg, common.db.uci.sect.storage, "prefix")
-    local file_path = storage_path .. "/" .. prefix .. arg.id
-    os.remove(file_path)
-
-    uci:foreach(common.db.uci.cfg, common.db.uci.sect.chat, function(tbl)
-        if tbl.id == arg.id then
-            uci:delete(common.db.uci.cfg, tbl[".name"])
-        end
-    end)
-
-    uci:commit(common.db.uci.cfg)
+    storage.delete(arg.id)
 
     console.print("Delete chat data no=" .. arg.no)
 end
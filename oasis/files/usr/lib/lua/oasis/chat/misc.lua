@@ -5,41 +5,240 @@ local util  = require("luci.util")
 
 local M = {}
 
-local function apply_markdown_tokens(msg, counters)
+--[[
+[Markdown -> ANSI (console)]
+Replies are streamed in pieces, and a marker ("```", "**", "- " at the start
+of a line, ...) may be split over two pieces. The renderer is a state machine
+that walks each piece once; bytes that may still turn into a marker are held
+back (carry) and rendered with the next piece, or by markdown_flush() at the
+end of the reply.
+
+ ```lang ... ```    code block (the fence line itself is not printed)
+ `code`             inline code (ends at the end of the line)
+ **text**           bold
+ # .. ######        heading (to the end of the line)
+ - / * / + / 1.     list item marker
+]]
+
+local MD_STYLE = {
+    code_block  = "\27[1;32;47m",
+    inline_code = "\27[1;32m",
+    bold        = "\27[1;33m",
+    heading     = "\27[1;36m",
+    list        = "\27[1;34m",
+    reset       = "\27[0m",
+}
+
+local BYTE_NL       = string.byte("\n")
+local BYTE_STAR     = string.byte("*")
+
+local function md_new_state()
+    return { carry = "", bol = true, code = false, inline = false, bold = false, heading = false }
+end
+
+-- Reset, then re-apply the styles that are still open
+local function md_restyle(st)
+    local seq = MD_STYLE.reset
+    if st.heading then
+        seq = seq .. MD_STYLE.heading
+    end
+    if st.bold then
+        seq = seq .. MD_STYLE.bold
+    end
+    return seq
+end
+
+-- Markers at the start of a line. Returns the next position, or nil when the
+-- line start is still ambiguous and has to wait for more bytes.
+local function md_line_start(st, s, i, out, final)
+
+    local has_nl = s:find("\n", i, true)
 
-    counters.code_block = counters.code_block or 0
-    counters.bold_text = counters.bold_text or 0
+    if (not final) and (not has_nl) then
+        -- "  -", "##", "12.", "``" ... may still become a marker
+        if s:find("^ *[-*+#%d`]*%.?$", i) or s:find("^ *```", i) then
+            return nil
+        end
+    end
 
-    while msg:find("```", 1, true) do
-        counters.code_block = counters.code_block + 1
-        if (counters.code_block % 2) == 1 then
-            msg = msg:gsub("```", "\27[1;32;47m", 1)
+    st.bol = false
+
+    -- Fence line: open or close a code block, the line itself is dropped
+    local _, fe = s:find("^ *```", i)
+    if fe then
+        if st.code then
+            st.code = false
+            out[#out + 1] = md_restyle(st)
         else
-            msg = msg:gsub("```", "\27[0m", 1)
+            st.code = true
+            out[#out + 1] = MD_STYLE.code_block
         end
+        st.bol = true
+        return has_nl and (has_nl + 1) or (#s + 1)
+    end
+
+    if st.code then
+        return i
+    end
+
+    local _, he, hashes = s:find("^(#+) +", i)
+    if he and (#hashes <= 6) then
+        st.heading = true
+        out[#out + 1] = MD_STYLE.heading
+        return he + 1
     end
 
-    while msg:find("%*%*") do
-        counters.bold_text = counters.bold_text + 1
-        if (counters.bold_text % 2) == 1 then
-            msg = msg:gsub("%*%*", "\27[1;33m", 1)
+    local marker = "\226\128\162"      -- bullet
+    local _, le, indent = s:find("^( *)[-*+] +", i)
+    if not le then
+        _, le, indent, marker = s:find("^( *)(%d+%.) +", i)
+    end
+    if le then
+        out[#out + 1] = indent .. MD_STYLE.list .. marker .. md_restyle(st) .. " "
+        return le + 1
+    end
+
+    return i
+end
+
+-- Render s (carry of the previous piece + new text) in a single pass.
+local function md_render(st, text, final)
+
+    local s = st.carry .. text
+    local n = #s
+    local i = 1
+    local out = {}
+
+    st.carry = ""
+
+    while i <= n do
+
+        if st.bol and (not st.inline) then
+            local next_i = md_line_start(st, s, i, out, final)
+            if not next_i then
+                st.carry = s:sub(i)
+                break
+            end
+            i = next_i
+
         else
-            msg = msg:gsub("%*%*", "\27[0m", 1)
+            -- no bold inside code
+            local j = s:find((st.code or st.inline) and "[`\n]" or "[`*\n]", i)
+
+            if not j then
+                out[#out + 1] = s:sub(i)
+                break
+            end
+
+            out[#out + 1] = s:sub(i, j - 1)
+
+            local c = s:byte(j)
+
+            if c == BYTE_NL then
+                if st.inline or st.heading then
+                    st.inline = false
+                    st.heading = false
+                    out[#out + 1] = md_restyle(st)
+                end
+                out[#out + 1] = "\n"
+                st.bol = true
+                i = j + 1
+
+            elseif c == BYTE_STAR then
+                if (j == n) and (not final) then
+                    st.carry = "*"
+                    break
+                end
+                if s:byte(j + 1) == BYTE_STAR then
+                    st.bold = not st.bold
+                    out[#out + 1] = st.bold and MD_STYLE.bold or md_restyle(st)
+                    i = j + 2
+                else
+                    out[#out + 1] = "*"
+                    i = j + 1
+                end
+
+            else
+                local _, re = s:find("^`+", j)
+                if (re == n) and (not final) then
+                    st.carry = s:sub(j)
+                    break
+                end
+                local len = re - j + 1
+                if st.code then
+                    -- closing fence in the middle of a line
+                    if len >= 3 then
+                        st.code = false
+                        out[#out + 1] = md_restyle(st)
+                    else
+                        out[#out + 1] = s:sub(j, re)
+                    end
+                elseif st.inline then
+                    if len == 1 then
+                        st.inline = false
+                        out[#out + 1] = md_restyle(st)
+                    else
+                        out[#out + 1] = s:sub(j, re)
+                    end
+                elseif len >= 3 then
+                    st.code = true
+                    out[#out + 1] = MD_STYLE.code_block
+                elseif len == 1 then
+                    st.inline = true
+                    out[#out + 1] = MD_STYLE.inline_code
+                else
+                    out[#out + 1] = s:sub(j, re)
+                end
+                i = re + 1
+            end
         end
     end
 
-    return msg
+    if final then
+        if st.code or st.inline or st.bold or st.heading then
+            out[#out + 1] = MD_STYLE.reset
+        end
+        local fresh = md_new_state()
+        for k, v in pairs(fresh) do
+            st[k] = v
+        end
+    end
+
+    return table.concat(out)
 end
 
+--- Convert markdown to ANSI escape sequences for the console.
+-- With a mark table the text is one piece of a streamed reply: the state and
+-- any held-back bytes are kept in mark until the next piece or markdown_flush().
+-- Without a mark the text is a complete message.
+-- @param mark table|nil per-reply state (service.mark)
+-- @param message string
+-- @return string
 function M.markdown(mark, message)
 
+    message = tostring(message or "")
+
     if not mark then
-        local local_counters = { code_block = 0, bold_text = 0 }
-        return apply_markdown_tokens(message, local_counters)
+        return md_render(md_new_state(), message, true)
     end
 
-    mark.cnt = mark.cnt or { code_block = 0, bold_text = 0 }
-    return apply_markdown_tokens(message, mark.cnt)
+    mark.md = mark.md or md_new_state()
+    return md_render(mark.md, message, false)
+end
+
+--- End a streamed reply: render the held-back bytes and close open styles.
+-- @param mark table|nil
+-- @return string
+function M.markdown_flush(mark)
+
+    if (not mark) or (not mark.md) then
+        return ""
+    end
+
+    local tail = md_render(mark.md, "", true)
+    mark.md = nil
+
+    return tail
 end
 
 function M.get_uptime()
@@ -157,4 +356,58 @@ function M.check_init_script_exists(service)
 	return M.check_file_exist(init_script)
 end
 
+local HASH_MOD_1 = 4294967291   -- largest primes below 2^32
+local HASH_MOD_2 = 4294967279
+
+--- Content hash of a text (two 32-bit polynomial hashes and the length).
+-- @param text string
+-- @return string
+function M.hash(text)
+
+    local h1, h2 = 0, 0
+    local len = #text
+    local byte = string.byte
+
+    -- h * 257 + b stays below 2^53, so the arithmetic is exact with Lua numbers
+    for i = 1, len, 16 do
+        local b = { byte(text, i, i + 15) }
+        for j = 1, #b do
+            h1 = (h1 * 257 + b[j]) % HASH_MOD_1
+            h2 = (h2 * 263 + b[j]) % HASH_MOD_2
+        end
+    end
+
+    return string.format("%08x%08x-%x", h1, h2, len)
+end
+
+--- Prepare a pre-serialized JSON value for a request body.
+-- Put splice.placeholder where the value belongs, stringify the body, then
+-- call apply_json_splice() to replace the placeholder with the JSON text.
+-- @param json string serialized JSON value
+-- @return table { placeholder = string, json = string }
+function M.json_splice(json)
+    -- Unique per call, so text inside the messages can never be taken for it
+    local seed = tostring({}) .. tostring(os.clock()) .. tostring(os.time())
+    return { placeholder = "oasis-splice-" .. M.hash(seed), json = json }
+end
+
+--- Replace the placeholder of a splice in a serialized body.
+-- @param body string JSON text
+-- @param splice table|nil from json_splice()
+-- @return string
+function M.apply_json_splice(body, splice)
+
+    if (not splice) or (not body) then
+        return body
+    end
+
+    local s, e = body:find('"' .. splice.placeholder .. '"', 1, true)
+
+    if not s then
+        return body
+    end
+
+    return body:sub(1, s - 1) .. splice.json .. body:sub(e + 1)
+end
+
 return M
@@ -3,8 +3,8 @@
 local jsonc     = require("luci.jsonc")
 local common    = require("oasis.common")
 local uci       = require("luci.model.uci").cursor()
-local util      = require("luci.util")
 local datactrl  = require("oasis.chat.datactrl")
+local storage   = require("oasis.chat.storage")
 local misc      = require("oasis.chat.misc")
 local ous       = require("oasis.unified.chat.schema")
 local debug     = require("oasis.chat.debug")
@@ -127,7 +127,8 @@ anthropic.new = function()
             end
 
             -- Inject tools schema if local tools are enabled
-            body = calling.inject_schema(self, body)
+            local tools_splice
+            body, tools_splice = calling.inject_schema(self, body, chat)
 
             local user_msg_json = jsonc.stringify(body, false)
             -- NOTE (why this replacement is required): Anthropic requires tool arguments ("input"/"arguments") to be a JSON object (dictionary).
@@ -137,6 +138,7 @@ anthropic.new = function()
                 :gsub('"input"%s*:%s*%[%s*%]', '"input":{}')
                 :gsub('"arguments"%s*:%s*%[%s*%]', '"arguments":{}')
                 :gsub('"properties"%s*:%s*%[%]', '"properties":{}')
+            user_msg_json = misc.apply_json_splice(user_msg_json, tools_splice)
             debug:log("oasis.log", "anthropic.convert_schema", string.format("messages=%d, json_len=%d", #(messages or {}), #user_msg_json))
             debug:log("oasis.log", "anthropic.convert_schema", user_msg_json)
             return user_msg_json
@@ -204,14 +206,14 @@ anthropic.new = function()
             local msg_tbl = { message = { role = common.role.assistant, content = text } }
             local response_ai_json = jsonc.stringify(msg_tbl, false)
 
-            if (not plain_text_for_console) or (#plain_text_for_console == 0) then
+            if #text == 0 then
                 return "", "", self.recv_raw_msg, false
             end
 
             return plain_text_for_console, response_ai_json, self.recv_raw_msg, false
         end
 
-        -- Append last two turns to storage via ubus
+        -- Append last two turns to storage
         obj.append_chat_data = function(self, chat)
             local message = {}
             message.id = self.cfg.id
@@ -219,7 +221,10 @@ anthropic.new = function()
             message.content1 = chat.messages[#chat.messages - 1].content
             message.role2 = chat.messages[#chat.messages].role
             message.content2 = chat.messages[#chat.messages].content
-            util.ubus("oasis.chat", "append", message)
+            storage.append(message.id, {
+                { role = message.role1, content = message.content1 },
+                { role = message.role2, content = message.content2 },
+            })
         end
 
         obj.get_config = function(self)
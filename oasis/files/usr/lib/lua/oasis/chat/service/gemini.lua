@@ -3,8 +3,8 @@
 local jsonc     = require("luci.jsonc")
 local common    = require("oasis.common")
 local uci       = require("luci.model.uci").cursor()
-local util      = require("luci.util")
 local datactrl  = require("oasis.chat.datactrl")
+local storage   = require("oasis.chat.storage")
 local misc      = require("oasis.chat.misc")
 local debug     = require("oasis.chat.debug")
 local ous      = require("oasis.unified.chat.schema")
@@ -139,11 +139,13 @@ gemini.new = function()
 
         obj.convert_schema = function(self, chat)
             local body = self:transform_unified_schema_to_gemini(chat)
-            body = calling.inject_schema(self, body)
+            local tools_splice
+            body, tools_splice = calling.inject_schema(self, body, chat)
             local user_msg_json = jsonc.stringify(body, false)
             -- normalize empty arrays in schemas and functionCall args
             user_msg_json = user_msg_json:gsub('"properties"%s*:%s*%[%]', '"properties":{}')
             user_msg_json = user_msg_json:gsub('"args"%s*:%s*%[%s*%]', '"args":{}')
+            user_msg_json = misc.apply_json_splice(user_msg_json, tools_splice)
             debug:log("oasis.log", "gemini.convert_schema", string.format("contents=%d, json_len=%d", #(body.contents or {}), #user_msg_json))
 
             -- Add: Detailed JSON log sent to Gemini
@@ -238,7 +240,7 @@ gemini.new = function()
 
             local response_ai_json = jsonc.stringify(msg_tbl, false)
 
-            if (not plain_text_for_console) or (#plain_text_for_console == 0) then
+            if #text == 0 then
                 return "", "", self.recv_raw_msg, false
             end
 
@@ -335,7 +337,10 @@ gemini.new = function()
             message.content1 = chat.messages[#chat.messages - 1].content
             message.role2 = chat.messages[#chat.messages].role
             message.content2 = chat.messages[#chat.messages].content
-            util.ubus("oasis.chat", "append", message)
+            storage.append(message.id, {
+                { role = message.role1, content = message.content1 },
+                { role = message.role2, content = message.content2 },
+            })
             debug:log("oasis.log", "gemini.append_chat_data",
                 string.format("id=%s, r1=%s, r2=%s",
                     tostring(self.cfg.id), tostring(message.role1), tostring(message.role2)))
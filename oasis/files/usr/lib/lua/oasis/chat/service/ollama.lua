@@ -3,8 +3,8 @@
 local jsonc     = require("luci.jsonc")
 local common    = require("oasis.common")
 local uci       = require("luci.model.uci").cursor()
-local util      = require("luci.util")
 local datactrl  = require("oasis.chat.datactrl")
+local storage   = require("oasis.chat.storage")
 local misc      = require("oasis.chat.misc")
 local debug     = require("oasis.chat.debug")
 local calling   = require("oasis.chat.function.calling.ollama")
@@ -94,6 +94,8 @@ ollama.new = function()
 			local first_output_str = ""
 			local speaker = { role = "assistant", tool_calls = {} }
 
+			-- Collect the calls first: they run concurrently and are joined in order
+			local calls = {}
 			for _, tc in ipairs(message.tool_calls or {}) do
 				local func = tc["function"] and tc["function"].name or ""
 				local args = {}
@@ -105,13 +107,20 @@ ollama.new = function()
 				end
 
 				debug:log("oasis.log", "recv_ai_msg", "ollama func = " .. tostring(func))
-				local result = client.exec_server_tool(self:get_format(), func, args)
-				debug:log("oasis.log", "recv_ai_msg", jsonc.stringify(result, true))
+				calls[#calls + 1] = { name = func, args = args }
+			end
+
+			local results, cache_info = client.exec_server_tools(self:get_format(), calls)
+
+			for i, call in ipairs(calls) do
+				local result = results[i]
+				debug:log("oasis.log", "recv_ai_msg", function() return jsonc.stringify(result, true) end)
 
 				local output = jsonc.stringify(result, false)
 				table.insert(function_call.tool_outputs, {
 					output = output,
-					name = func
+					name = call.name,
+					cache = cache_info[i]
 				})
 
 				local tool_id = nil
@@ -119,8 +128,8 @@ ollama.new = function()
 					id = tool_id,
 					type = "function",
 					["function"] = {
-						name = func,
-						arguments = jsonc.stringify(args, false)
+						name = call.name,
+						arguments = jsonc.stringify(call.args, false)
 					}
 				})
 
@@ -128,6 +137,7 @@ ollama.new = function()
 			end
 
 			local plain_text_for_console = first_output_str
+			function_call.tool_cache = { hits = cache_info.hits, misses = cache_info.misses }
 			local response_ai_json = jsonc.stringify(function_call, false)
 			debug:log("oasis.log", "recv_ai_msg", response_ai_json)
 			return plain_text_for_console, response_ai_json, speaker, true
@@ -151,7 +161,7 @@ ollama.new = function()
 			local plain_text_for_console = misc.markdown(self.mark, tostring(chunk_json.message.content))
 			local response_ai_json = jsonc.stringify(chunk_json, false)
 
-			if (not plain_text_for_console) or (#plain_text_for_console == 0) then
+			if #tostring(chunk_json.message.content) == 0 then
 				return "", "", self.recv_raw_msg, false
 			end
 
@@ -205,7 +215,10 @@ ollama.new = function()
             message.content1 = chat.messages[#chat.messages - 1].content
             message.role2 = chat.messages[#chat.messages].role
             message.content2 = chat.messages[#chat.messages].content
-            util.ubus("oasis.chat", "append", message)
+            storage.append(message.id, {
+                { role = message.role1, content = message.content1 },
+                { role = message.role2, content = message.content2 },
+            })
         end
 
         obj.get_config = function(self)
@@ -236,28 +249,19 @@ ollama.new = function()
             end
 
             -- Inject tools schema for function calling (Ollama)
+            local tools_splice
             if is_use_tool and supports_tool and (self:get_format() ~= common.ai.format.title) then
                 local client = require("oasis.local.tool.client")
-                local schema = client.get_function_call_schema()
+                tools_splice = misc.json_splice(client.get_tool_schema_json("ollama", user_msg) or "[]")
 
-                user_msg["tools"] = {}
+                user_msg["tools"] = tools_splice.placeholder
                 -- Prefer non-streaming single JSON response for function calling
                 user_msg["stream"] = false
-
-                for _, tool_def in ipairs(schema) do
-                    table.insert(user_msg["tools"], {
-                        type = "function",
-                        ["function"] = {
-                            name = tool_def.name,
-                            description = tool_def.description or "",
-                            parameters = tool_def.parameters
-                        }
-                    })
-                end
             end
 
             local user_msg_json = jsonc.stringify(user_msg, false)
             user_msg_json = user_msg_json:gsub('"properties"%s*:%s*%[%]', '"properties":{}')
+            user_msg_json = misc.apply_json_splice(user_msg_json, tools_splice)
 
             debug:log("oasis.log", "prepare_post_to_server", user_msg_json)
 
@@ -91,7 +91,7 @@ openai.new = function()
             local plain_text_for_console = misc.markdown(self.mark, content)
             local response_ai_json = jsonc.stringify(reply, false)
 
-            if (not plain_text_for_console) or (#plain_text_for_console == 0) then
+            if #content == 0 then
                 return "", "", self.recv_raw_msg, false
             end
             return plain_text_for_console, response_ai_json, self.recv_raw_msg, false
@@ -171,7 +171,8 @@ openai.new = function()
             end
 
             -- Function Calling Schema injection moved to calling module
-            user_msg = calling.inject_schema(self, user_msg)
+            local tools_splice
+            user_msg, tools_splice = calling.inject_schema(self, user_msg)
 
             -- TODO: Move the following logic later or extract into a dedicated function
             -- Inject title-related generation parameters
@@ -222,7 +223,7 @@ openai.new = function()
 
             local user_msg_json = jsonc.stringify(user_msg, false)
             user_msg_json = user_msg_json:gsub('"properties"%s*:%s*%[%]', '"properties":{}')
-            return user_msg_json
+            return misc.apply_json_splice(user_msg_json, tools_splice)
         end
 
         obj.handle_tool_result = function(self, chat, speaker, msg)
@@ -0,0 +1,352 @@
+#!/usr/bin/env lua
+
+local jsonc     = require("luci.jsonc")
+local fs        = require("nixio.fs")
+local uci       = require("luci.model.uci").cursor()
+local sys       = require("luci.sys")
+local common    = require("oasis.common")
+local misc      = require("oasis.chat.misc")
+local debug     = require("oasis.chat.debug")
+
+--[[
+[Rollback Snapshot Store]
+Content-addressed storage for the UCI configs saved before an AI-driven apply.
+
+ /etc/oasis/backup/
+   blobs/<hash>          exported config (uci export format), one file per content
+                         (<hash>-<n> when another content already has the hash)
+   manifest.json         snapshot of the apply waiting for finalize/rollback
+   list<N>/manifest.json rollback point N (rollback.list in UCI)
+
+ A manifest only names blobs:
+   { "configs": [ { "name": "network", "blob": "<hash>" }, ... ], "uci_list": { ... } }
+
+ Unchanged configs hash to a blob that already exists, so a snapshot writes only
+ the configs whose content changed since any earlier snapshot, and moving a
+ rollback point just renames its small manifest.
+ Blobs are reference counted over all manifests; gc() deletes the ones no
+ manifest refers to any more (e.g. after list_max_num evicts the oldest point).
+
+ Rollback points written by older versions (listN/backup_uci_list.json with a
+ full copy of each config) are still read, and converted when they are moved.
+]]
+
+local M = {}
+
+local MANIFEST      = "manifest.json"
+local BLOB_DIR      = "blobs/"
+
+--- Content hash of a text (see misc.hash).
+-- @param text string
+-- @return string
+M.hash = misc.hash
+
+local function quote(value)
+    return "'" .. tostring(value):gsub("'", "'\\''") .. "'"
+end
+
+--- Export a UCI config in "uci export" format without spawning the uci command.
+-- @param config string
+-- @return string|nil
+function M.export(config)
+
+    local all = uci:get_all(config)
+
+    if type(all) ~= "table" then
+        return nil
+    end
+
+    local sections = {}
+    for name, sect in pairs(all) do
+        sections[#sections + 1] = { name = name, sect = sect }
+    end
+
+    table.sort(sections, function(a, b)
+        local ia = tonumber(a.sect[".index"])
+        local ib = tonumber(b.sect[".index"])
+        if ia and ib and (ia ~= ib) then
+            return ia < ib
+        end
+        return a.name < b.name
+    end)
+
+    local out = { "package " .. config, "" }
+
+    for _, s in ipairs(sections) do
+
+        local anonymous = (s.sect[".anonymous"] == true) or (s.sect[".anonymous"] == "1")
+
+        if anonymous then
+            out[#out + 1] = "config " .. s.sect[".type"]
+        else
+            out[#out + 1] = "config " .. s.sect[".type"] .. " " .. quote(s.name)
+        end
+
+        local options = {}
+        for key, _ in pairs(s.sect) do
+            if key:sub(1, 1) ~= "." then
+                options[#options + 1] = key
+            end
+        end
+        table.sort(options)
+
+        for _, key in ipairs(options) do
+            local value = s.sect[key]
+            if type(value) == "table" then
+                for _, item in ipairs(value) do
+                    out[#out + 1] = "\tlist " .. key .. " " .. quote(item)
+                end
+            else
+                out[#out + 1] = "\toption " .. key .. " " .. quote(value)
+            end
+        end
+
+        out[#out + 1] = ""
+    end
+
+    return table.concat(out, "\n")
+end
+
+local function blob_path(hash)
+    return common.rollback.dir .. BLOB_DIR .. hash
+end
+
+--- Store a text as a blob; nothing is written when the same content is already stored.
+-- misc.hash is not collision resistant: a blob of the same hash but another
+-- content is never overwritten (other manifests name it), the text goes to
+-- <hash>-1, <hash>-2, ... instead.
+-- @param text string
+-- @return string|nil blob name (the hash, or the hash with a suffix)
+function M.store_blob(text)
+
+    local hash = M.hash(text)
+    local name = hash
+    local path = blob_path(name)
+    local suffix = 0
+
+    while misc.check_file_exist(path) do
+        if misc.read_file(path) == text then
+            return name
+        end
+        suffix = suffix + 1
+        name = hash .. "-" .. suffix
+        path = blob_path(name)
+        debug:log("oasis.log", "snapshot.store_blob", "hash collision, trying " .. name)
+    end
+
+    fs.mkdirr(common.rollback.dir .. BLOB_DIR)
+
+    -- write + rename, so a power cut never leaves a truncated blob behind
+    local tmp = path .. ".tmp"
+    if not misc.write_file(tmp, text) then
+        os.remove(tmp)
+        return nil
+    end
+    os.rename(tmp, path)
+
+    return name
+end
+
+local function manifest_path(dir)
+    return misc.normalize_path(dir) .. MANIFEST
+end
+
+--- Export the configs, store them as blobs and write the manifest of dir.
+-- @param dir string snapshot directory
+-- @param configs table array of config names
+-- @param uci_list table uci command list applied after this snapshot
+-- @return table|nil manifest
+function M.create(dir, configs, uci_list)
+
+    local manifest = { configs = {}, uci_list = uci_list }
+
+    for _, config in ipairs(configs) do
+        local text = M.export(config)
+        local hash = text and M.store_blob(text)
+        if not hash then
+            debug:log("oasis.log", "snapshot.create", "export failed: " .. config)
+            return nil
+        end
+        manifest.configs[#manifest.configs + 1] = { name = config, blob = hash }
+    end
+
+    if not M.save(dir, manifest) then
+        return nil
+    end
+
+    return manifest
+end
+
+--- Write a manifest (blobs are shared, not copied).
+-- @param dir string
+-- @param manifest table
+-- @return boolean
+function M.save(dir, manifest)
+    fs.mkdirr(dir)
+    local path = manifest_path(dir)
+    if not misc.write_file(path .. ".tmp", jsonc.stringify(manifest, false)) then
+        return false
+    end
+    return os.rename(path .. ".tmp", path) and true or false
+end
+
+local function load_legacy(dir, targets)
+
+    dir = misc.normalize_path(dir)
+
+    if not targets then
+        local list_json = misc.read_file(dir .. common.rollback.backup_uci_list)
+        targets = list_json and jsonc.parse(list_json)
+    end
+
+    if type(targets) ~= "table" then
+        return nil
+    end
+
+    local manifest = { configs = {}, legacy = true }
+
+    for _, config in ipairs(targets) do
+        manifest.configs[#manifest.configs + 1] = { name = config, file = dir .. config }
+    end
+
+    local uci_list_json = misc.read_file(dir .. common.rollback.uci_cmd_json)
+    manifest.uci_list = uci_list_json and jsonc.parse(uci_list_json)
+
+    return manifest
+end
+
+--- Load the manifest of dir.
+-- @param dir string
+-- @param legacy_targets table|nil config names of an old-format snapshot in dir
+-- @return table|nil manifest
+function M.load(dir, legacy_targets)
+
+    local json = misc.read_file(manifest_path(dir))
+
+    if json then
+        local manifest = jsonc.parse(json)
+        if type(manifest) == "table" then
+            manifest.configs = manifest.configs or {}
+            return manifest
+        end
+    end
+
+    return load_legacy(dir, legacy_targets)
+end
+
+--- File holding the saved content of one manifest entry.
+-- @param entry table
+-- @return string
+function M.entry_file(entry)
+    return entry.file or blob_path(entry.blob)
+end
+
+--- Restore one config of a manifest.
+-- @param entry table { name = string, blob|file = string }
+function M.restore(entry)
+    local cmd = "uci -f " .. M.entry_file(entry) .. " import " .. entry.name
+    debug:log("oasis.log", "snapshot.restore", cmd)
+    sys.exec(cmd)
+end
+
+--- Remove the manifest of dir (and the files of an old-format snapshot).
+-- Blobs are left to gc().
+-- @param dir string
+-- @param legacy_targets table|nil
+function M.remove(dir, legacy_targets)
+
+    local manifest = M.load(dir, legacy_targets)
+
+    if manifest and manifest.legacy then
+        for _, entry in ipairs(manifest.configs) do
+            os.remove(entry.file)
+        end
+        os.remove(misc.normalize_path(dir) .. common.rollback.backup_uci_list)
+    end
+
+    os.remove(misc.normalize_path(dir) .. common.rollback.uci_cmd_json)
+    os.remove(manifest_path(dir))
+end
+
+--- Move a rollback point to another directory.
+-- Old-format snapshots are converted to blobs on the way.
+-- @param src string
+-- @param dst string
+-- @return boolean
+function M.move(src, dst)
+
+    local manifest = M.load(src)
+
+    if not manifest then
+        return false
+    end
+
+    if manifest.legacy then
+        for _, entry in ipairs(manifest.configs) do
+            local text = misc.read_file(entry.file)
+            entry.blob = text and M.store_blob(text)
+            entry.file = nil
+            if not entry.blob then
+                return false
+            end
+        end
+        manifest.legacy = nil
+    end
+
+    if not M.save(dst, manifest) then
+        return false
+    end
+
+    M.remove(src)
+
+    return true
+end
+
+--- Reference count of every blob over all manifests.
+-- @return table hash -> count
+function M.refcount()
+
+    local refs = {}
+    local dirs = { common.rollback.dir }
+
+    for name in (fs.dir(common.rollback.dir) or function() return nil end) do
+        if name:match("^" .. common.rollback.list_item_name .. "%d+$") then
+            dirs[#dirs + 1] = common.rollback.dir .. name
+        end
+    end
+
+    for _, dir in ipairs(dirs) do
+        local json = misc.read_file(manifest_path(dir))
+        local manifest = json and jsonc.parse(json)
+        if type(manifest) == "table" then
+            for _, entry in ipairs(manifest.configs or {}) do
+                if entry.blob then
+                    refs[entry.blob] = (refs[entry.blob] or 0) + 1
+                end
+            end
+        end
+    end
+
+    return refs
+end
+
+--- Delete blobs that no manifest refers to.
+-- @return number deleted blobs
+function M.gc()
+
+    local refs = M.refcount()
+    local deleted = 0
+
+    for name in (fs.dir(common.rollback.dir .. BLOB_DIR) or function() return nil end) do
+        if not refs[name] then
+            os.remove(common.rollback.dir .. BLOB_DIR .. name)
+            deleted = deleted + 1
+        end
+    end
+
+    debug:log("oasis.log", "snapshot.gc", "deleted blobs: " .. deleted)
+
+    return deleted
+end
+
+return M
@@ -0,0 +1,344 @@
+#!/usr/bin/env lua
+
+local jsonc     = require("luci.jsonc")
+local fs        = require("nixio.fs")
+local uci       = require("luci.model.uci").cursor()
+local common    = require("oasis.common")
+local misc      = require("oasis.chat.misc")
+local context   = require("oasis.chat.context")
+
+--[[
+ In-process chat storage.
+
+ Both the oasis.chat ubus object and the chat engine (datactrl/schema/service modules)
+ read and write chat files through this module instead of calling back into
+ oasis.chat over ubus. Each chat file is read at most once per process; later
+ loads and appends reuse the decoded document kept in the cache below.
+ Cached entries are checked against the file's mtime/size, so a long-running
+ process (oasis_ubusd) notices chats written by other processes.
+
+ Chat file layout:
+   {
+     "messages": [ { "role": "...", "content": "..." }, ... ],
+     "meta":     { "user_turns": <number>, "tokens": [ <number>, ... ] }
+   }
+
+ The "meta" table holds counters maintained on every write, so the turn limit
+ check (storage.chat_max) does not have to walk the message list.
+ meta.tokens holds the token estimate of each message (same index as messages),
+ used by oasis.chat.context to budget the request without re-measuring history.
+ Files written by older versions have no "meta"; it is rebuilt on first read.
+]]
+
+local M = {}
+
+local conf = nil
+local cache = {}
+
+local function get_conf()
+
+    if conf then
+        return conf
+    end
+
+    local uci_ref = common.db.uci
+
+    conf = {}
+    conf.path       = misc.normalize_path(uci:get(uci_ref.cfg, uci_ref.sect.storage, "path") or "/etc/oasis/chat_data")
+    conf.prefix     = uci:get(uci_ref.cfg, uci_ref.sect.storage, "prefix") or "chat-"
+    conf.chat_max   = tonumber(uci:get(uci_ref.cfg, uci_ref.sect.storage, "chat_max") or "0") or 0
+
+    return conf
+end
+
+local function count_user_turns(messages)
+    local cnt = 0
+    for _, m in ipairs(messages or {}) do
+        if m.role == common.role.user then
+            cnt = cnt + 1
+        end
+    end
+    return cnt
+end
+
+local function find_section(id)
+
+    local unnamed_section = ""
+
+    uci:foreach(common.db.uci.cfg, common.db.uci.sect.chat, function(info)
+        if id == info.id then
+            unnamed_section = info[".name"]
+        end
+    end)
+
+    return unnamed_section
+end
+
+local function normalize_doc(doc)
+    doc.messages = doc.messages or {}
+    doc.meta = doc.meta or {}
+    if not tonumber(doc.meta.user_turns) then
+        doc.meta.user_turns = count_user_turns(doc.messages)
+    end
+    if (type(doc.meta.tokens) ~= "table") or (#doc.meta.tokens ~= #doc.messages) then
+        doc.meta.tokens = {}
+        for i, m in ipairs(doc.messages) do
+            doc.meta.tokens[i] = context.estimate(m)
+        end
+    end
+    return doc
+end
+
+local function read_entry(id)
+
+    local path = M.file_path(id)
+    local st = fs.stat(path)
+    local entry = cache[id]
+
+    if entry and st and (entry.mtime == st.mtime) and (entry.size == st.size) then
+        return entry
+    end
+
+    local raw = misc.read_file(path)
+
+    if (not raw) or (#raw == 0) then
+        return nil
+    end
+
+    local doc = jsonc.parse(raw)
+
+    if type(doc) ~= "table" then
+        return nil
+    end
+
+    entry = { raw = raw, doc = normalize_doc(doc), mtime = st and st.mtime, size = st and st.size }
+    cache[id] = entry
+
+    return entry
+end
+
+local function write_entry(id, doc)
+
+    local path = M.file_path(id)
+    local raw = jsonc.stringify(doc, false)
+    local ok, err = misc.write_file(path, raw)
+
+    if not ok then
+        cache[id] = nil
+        return false, err
+    end
+
+    local st = fs.stat(path)
+    cache[id] = { raw = raw, doc = doc, mtime = st and st.mtime, size = st and st.size }
+
+    return true
+end
+
+--- Drop cached chats and UCI state (for long-running processes).
+function M.refresh()
+    uci:unload(common.db.uci.cfg)
+    cache = {}
+    conf = nil
+end
+
+--- Full path of the chat file for id.
+-- @param id string
+-- @return string
+function M.file_path(id)
+    local c = get_conf()
+    return c.path .. c.prefix .. tostring(id)
+end
+
+--- Check whether a chat with id is registered in UCI.
+-- @param id string
+-- @return boolean
+function M.exists(id)
+    if (not id) or (#id == 0) then
+        return false
+    end
+    return #find_section(id) > 0
+end
+
+--- Raw chat file contents (as returned by oasis.chat load).
+-- @param id string
+-- @return string|nil
+function M.read(id)
+    local entry = read_entry(id)
+    return entry and entry.raw or nil
+end
+
+--- Load a chat as a table owned by the caller.
+-- Only "messages" is returned; storage metadata never leaks into request payloads.
+-- @param id string
+-- @return table|nil
+function M.load(id)
+
+    local entry = read_entry(id)
+
+    if not entry then
+        return nil
+    end
+
+    local messages = {}
+    for i, m in ipairs(entry.doc.messages) do
+        local copy = {}
+        for k, v in pairs(m) do
+            copy[k] = v
+        end
+        context.remember(copy, entry.doc.meta.tokens[i])
+        messages[i] = copy
+    end
+
+    return { messages = messages }
+end
+
+--- Number of user messages stored for id (maintained counter).
+-- @param id string
+-- @return number
+function M.user_turns(id)
+    local entry = read_entry(id)
+    if not entry then
+        return 0
+    end
+    return tonumber(entry.doc.meta.user_turns) or 0
+end
+
+--- Check the per-chat turn limit (storage.chat_max).
+-- @param id string
+-- @return boolean
+function M.is_turns_exceeded(id)
+
+    local max = get_conf().chat_max
+
+    if (max <= 0) or (not id) or (#id == 0) then
+        return false
+    end
+
+    return M.user_turns(id) >= max
+end
+
+--- Create a new chat file and register it in UCI.
+-- Messages without a role are skipped.
+-- @param messages table array of { role = string, content = string }
+-- @return string|nil id
+function M.create(messages)
+
+    local id = common.generate_chat_id()
+
+    if #id == 0 then
+        return nil
+    end
+
+    local doc = { messages = {}, meta = { tokens = {} } }
+
+    for _, m in ipairs(messages or {}) do
+        if m.role and (#m.role > 0) then
+            local msg = { role = m.role, content = m.content }
+            doc.messages[#doc.messages + 1] = msg
+            doc.meta.tokens[#doc.messages] = context.estimate(msg)
+        end
+    end
+
+    doc.meta.user_turns = count_user_turns(doc.messages)
+
+    if not write_entry(id, doc) then
+        return nil
+    end
+
+    local unnamed_section = uci:add(common.db.uci.cfg, common.db.uci.sect.chat)
+    uci:set(common.db.uci.cfg, unnamed_section, "id", id)
+    uci:commit(common.db.uci.cfg)
+
+    return id
+end
+
+--- Append messages to an existing chat and update its counters.
+-- @param id string
+-- @param messages table array of { role = string, content = string }
+-- @return boolean ok, string|nil status
+function M.append(id, messages)
+
+    if not M.exists(id) then
+        return false, common.status.not_found
+    end
+
+    local entry = read_entry(id)
+
+    if not entry then
+        return false, common.status.error
+    end
+
+    local doc = entry.doc
+
+    for _, m in ipairs(messages or {}) do
+        local msg = { role = m.role, content = m.content }
+        doc.messages[#doc.messages + 1] = msg
+        doc.meta.tokens[#doc.messages] = context.estimate(msg)
+        if m.role == common.role.user then
+            doc.meta.user_turns = doc.meta.user_turns + 1
+        end
+    end
+
+    if not write_entry(id, doc) then
+        return false, common.status.error
+    end
+
+    return true, common.status.ok
+end
+
+--- Save the title of a chat.
+-- @param id string
+-- @param title string
+-- @return boolean
+function M.set_title(id, title)
+
+    local unnamed_section = find_section(id)
+
+    if (#unnamed_section == 0) or (not title) or (#title == 0) then
+        return false
+    end
+
+    uci:set(common.db.uci.cfg, unnamed_section, "title", title)
+    uci:commit(common.db.uci.cfg)
+
+    return true
+end
+
+--- Title of a chat as stored in UCI.
+-- @param id string
+-- @return string|nil
+function M.get_title(id)
+
+    local unnamed_section = find_section(id)
+
+    if #unnamed_section == 0 then
+        return nil
+    end
+
+    return uci:get(common.db.uci.cfg, unnamed_section, "title")
+end
+
+--- Delete a chat file and its UCI section.
+-- @param id string
+-- @return boolean ok, string status
+function M.delete(id)
+
+    local unnamed_section = find_section(id)
+
+    if #unnamed_section == 0 then
+        return false, common.status.not_found
+    end
+
+    cache[id] = nil
+
+    if not os.remove(M.file_path(id)) then
+        return false, common.status.error
+    end
+
+    uci:delete(common.db.uci.cfg, unnamed_section)
+    uci:commit(common.db.uci.cfg)
+
+    return true, common.status.ok
+end
+
+return M
@@ -0,0 +1,195 @@
+#!/usr/bin/env lua
+
+local fs        = require("nixio.fs")
+local common    = require("oasis.common")
+local misc      = require("oasis.chat.misc")
+local storage   = require("oasis.chat.storage")
+local debug     = require("oasis.chat.debug")
+
+--[[
+[Chat Title Jobs]
+Title generation needs a second AI request. Running it inline made the first
+reply of every new chat wait for two round trips, so new chats are saved with a
+placeholder title and a job is queued instead.
+
+ - enqueue(id) drops an empty file named after the chat id into the queue
+   directory (a pending job for the same chat is simply overwritten) and starts
+   a worker unless one is already running.
+ - run_queue() is the worker. It takes the lock directory, then drains the queue
+   in batches within one process, so modules and configuration are loaded once.
+ - When a title is saved, an "oasis.title" ubus event ({ id, title }) is sent.
+   LuCI picks the title up by polling oasis.title status (or the chat list).
+]]
+
+local M = {}
+
+M.placeholder = "--"
+
+local queue_dir = common.file.title.queue
+local lock_dir  = common.file.title.lock
+
+local function pending_jobs()
+    local jobs = {}
+    local iter = fs.dir(queue_dir)
+    if not iter then
+        return jobs
+    end
+    for name in iter do
+        if name:match("^%d+$") then
+            jobs[#jobs + 1] = name
+        end
+    end
+    table.sort(jobs)
+    return jobs
+end
+
+local function worker_alive()
+    local pid = (misc.read_file(lock_dir .. "/pid") or ""):match("%d+")
+    return (pid ~= nil) and misc.check_file_exist("/proc/" .. pid .. "/stat")
+end
+
+local function acquire_lock()
+
+    if fs.mkdir(lock_dir) then
+        misc.write_file(lock_dir .. "/pid", tostring(fs.readlink("/proc/self") or ""))
+        return true
+    end
+
+    -- Stale lock left by a worker that was killed
+    if misc.check_file_exist(lock_dir .. "/pid") and (not worker_alive()) then
+        os.remove(lock_dir .. "/pid")
+        fs.rmdir(lock_dir)
+        return acquire_lock()
+    end
+
+    return false
+end
+
+local function release_lock()
+    os.remove(lock_dir .. "/pid")
+    fs.rmdir(lock_dir)
+end
+
+local function notify(id, title)
+    local ubus = require("ubus")
+    local conn = ubus.connect(nil, 1000)
+    if not conn then
+        return
+    end
+    conn:send(common.db.ubus.object.oasis_title, { id = id, title = title })
+    conn:close()
+end
+
+--- Generate and save the title of a chat (blocking, one AI request).
+-- @param id string chat id
+-- @return string|nil title, string|nil status on error
+function M.generate(id)
+
+    local transfer = require("oasis.chat.transfer")
+
+    debug:log("oasis.log", "title.generate", "id = " .. tostring(id))
+
+    -- The worker outlives the requests that queued it; pick up chats created since.
+    storage.refresh()
+
+    local service = common.select_service_obj()
+
+    if not service then
+        return nil, common.status.not_found
+    end
+
+    service:initialize(nil, common.ai.format.title)
+
+    if not storage.exists(id) then
+        return nil, common.status.error
+    end
+
+    local chat = storage.load(id)
+
+    if not chat then
+        return nil, common.status.error
+    end
+
+    chat.model = service:get_config().model
+
+    local _, title = transfer.chat_with_ai(service, chat)
+
+    if (not title) or (#title == 0) then
+        return nil, common.status.error
+    end
+
+    if not storage.set_title(id, title) then
+        return nil, common.status.error
+    end
+
+    notify(id, title)
+
+    return title
+end
+
+--- Queue title generation for a chat and make sure a worker is running.
+-- @param id string chat id
+-- @return boolean
+function M.enqueue(id)
+
+    if (not id) or (not tostring(id):match("^%d+$")) then
+        return false
+    end
+
+    os.execute("mkdir -p " .. queue_dir)
+
+    if not misc.touch(queue_dir .. id) then
+        return false
+    end
+
+    if worker_alive() then
+        return true
+    end
+
+    -- Detach completely so rpcd/uhttpd do not wait on our stdout
+    os.execute("lua -e 'require(\"oasis.chat.title\").run_queue()' </dev/null >/dev/null 2>&1 &")
+
+    return true
+end
+
+--- Check whether a title job is still pending for a chat.
+-- @param id string
+-- @return boolean
+function M.is_pending(id)
+    return misc.check_file_exist(queue_dir .. tostring(id))
+end
+
+--- Worker: drain the title queue. Returns the number of processed jobs.
+-- @return number
+function M.run_queue()
+
+    local done = 0
+
+    while acquire_lock() do
+
+        local jobs = pending_jobs()
+
+        while #jobs > 0 do
+            for _, id in ipairs(jobs) do
+                local ok, title = pcall(M.generate, id)
+                -- Removed after the run: requests for the same chat queued meanwhile are served by it
+                os.remove(queue_dir .. id)
+                debug:log("oasis.log", "title.run_queue",
+                    string.format("id=%s ok=%s title=%s", id, tostring(ok), tostring(title)))
+                done = done + 1
+            end
+            jobs = pending_jobs()
+        end
+
+        release_lock()
+
+        -- A job queued between the last scan and the unlock would be stranded; look again.
+        if #pending_jobs() == 0 then
+            break
+        end
+    end
+
+    return done
+end
+
+return M
@@ -6,9 +6,10 @@ local common    = require("oasis.common")
 local console   = require("oasis.console")
 local jsonc     = require("luci.jsonc")
 local datactrl  = require("oasis.chat.datactrl")
-local util      = require("luci.util")
+local title     = require("oasis.chat.title")
 local ous       = require("oasis.unified.chat.schema")
 local misc      = require("oasis.chat.misc")
+local context   = require("oasis.chat.context")
 local debug     = require("oasis.chat.debug")
 
 local M = {}
@@ -90,7 +91,7 @@ local output_response_msg = function(format, text_for_console, response_ai_json,
             console.write(LABEL .. "Tool Used: ")
             for idx, tbl in ipairs(tool_info.tool_outputs) do
 
-                debug:log("oasis.log", "output_response_msg", jsonc.stringify(tbl, true))
+                debug:log("oasis.log", "output_response_msg", function() return jsonc.stringify(tbl, true) end)
 
                 if idx > 1 then
                     console.write(LABEL .. ", ")
@@ -146,11 +147,12 @@ function M.send_user_msg(service, chat)
     local recv_raw_msg = ""
     local tool_used = false
 
-    local usr_msg_json = service:convert_schema(chat)
+    -- Keep the request within the model's token budget (the saved chat is untouched)
+    local view = context.build(service, chat)
+    local usr_msg_json = service:convert_schema(view)
 
     -- Debug Message Json Log
-    local debug_msg_json = jsonc.stringify(chat, true)
-    debug:log("oasis.log", "send_user_msg", debug_msg_json)
+    debug:log("oasis.log", "send_user_msg", function() return jsonc.stringify(chat, true) end)
 
     local format = service:get_format()
     service:init_msg_buffer()
@@ -166,6 +168,12 @@ function M.send_user_msg(service, chat)
         output_response_msg(format, text_for_console, response_ai_json, tool_used)
     end)
 
+    -- Markup held back at the end of the stream (e.g. a trailing "*") and style reset
+    local tail = misc.markdown_flush(service.mark)
+    if #tail > 0 then
+        output_response_msg(format, tail, "", false)
+    end
+
     return response_ai_json, recv_raw_msg, tool_used
 end
 
@@ -244,8 +252,10 @@ function M.chat_with_ai(service, chat)
                     local save_chat = clone_chat_without_tool_messages(chat)
                     local chat_info = {}
                     chat_info.id = datactrl.create_chat_file(service, save_chat)
-                    local result = util.ubus("oasis.title", "auto_set", {id = chat_info.id}) or {}
-                    chat_info.title = result.title or "--"
+                    -- Title generation runs in the background; answer with a placeholder now
+                    title.enqueue(chat_info.id)
+                    chat_info.title = title.placeholder
+                    chat_info.title_pending = true
                     new_chat_info = jsonc.stringify(chat_info, false)
                     debug:log("oasis.log", "chat_with_ai", "new_chat_info = " .. new_chat_info)
                 end
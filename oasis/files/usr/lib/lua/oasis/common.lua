@@ -2,6 +2,7 @@
 local ubus  = require("ubus")
 local uci   = require("luci.model.uci").cursor()
 local sys   = require("luci.sys")
+local fs    = require("nixio.fs")
 local misc  = require("oasis.chat.misc")
 -- local debug = require("oasis.chat.debug")
 
@@ -22,6 +23,10 @@ db.uci.sect.support          = "support"
 db.uci.sect.tool             = "tool"
 db.uci.sect.remote_mcp       = "remote_mcp"
 db.uci.sect.console          = "console"
+db.uci.sect.context          = "context"
+db.uci.sect.resident         = "resident"
+db.uci.sect.tool_select      = "tool_select"
+db.uci.sect.tool_host        = "tool_host"
 
 db.ubus                             = {}
 db.ubus.object                      = {}
@@ -48,6 +53,7 @@ db.ubus.method.create               = "create"
 db.ubus.object.oasis_title          = "oasis.title"
 db.ubus.method.auto_set             = "auto_set"
 db.ubus.method.manual_set           = "manual_set"
+db.ubus.method.status               = "status"
 
 local ai                            = {}
 ai.service                          = {}
@@ -86,6 +92,14 @@ file.console.reboot_required    = "/tmp/oasis/reboot_required"
 file.console.shutdown_required  = "/tmp/oasis/shutdown_required"
 file.service                    = {}
 file.service.restart_required   = "/tmp/oasis/restart_required"
+file.title                      = {}
+file.title.queue                = "/tmp/oasis/title/queue/"
+file.title.lock                 = "/tmp/oasis/title/lock"
+file.resident                   = {}
+file.resident.work              = "/tmp/oasis/resident/"
+file.tool                       = {}
+file.tool.cache                 = "/tmp/oasis/tool_cache/"
+file.tool.host                  = "/tmp/oasis/tool_host/"
 
 local endpoint = {}
 endpoint.type = {}
@@ -131,6 +145,10 @@ rollback.backup_uci_list    = "backup_uci_list.json"
 
 local GENERATE_ID_MAX_RETRY = 5
 
+-- Parsed conf files keyed by path, reused while mtime/size are unchanged.
+-- Matters for the resident ubus server (oasis_ubusd); short-lived scripts parse once anyway.
+local conf_cache = {}
+
 
 local function generate_random_id(method)
 
@@ -208,7 +226,18 @@ function M.search_chat_id(id)
     return is_search
 end
 
-function M.load_conf_file(filename)
+local function copy_conf(data)
+    local copy = {}
+    for section, tbl in pairs(data) do
+        copy[section] = {}
+        for key, value in pairs(tbl) do
+            copy[section][key] = value
+        end
+    end
+    return copy
+end
+
+local function parse_conf_file(filename)
     local iniFile = io.open(filename, "r")
     if not iniFile then return nil, "Cannot open file: " .. filename end
 
@@ -256,7 +285,33 @@ function M.load_conf_file(filename)
     return data
 end
 
+function M.load_conf_file(filename)
+
+    local st = fs.stat(filename)
+    local entry = conf_cache[filename]
+
+    if st and entry and (entry.mtime == st.mtime) and (entry.size == st.size) then
+        -- callers are free to modify the returned table
+        return copy_conf(entry.data)
+    end
+
+    local data, err = parse_conf_file(filename)
+
+    if not data then
+        conf_cache[filename] = nil
+        return nil, err
+    end
+
+    if st then
+        conf_cache[filename] = { mtime = st.mtime, size = st.size, data = copy_conf(data) }
+    end
+
+    return data
+end
+
 function M.update_conf_file(filename, data)
+    conf_cache[filename] = nil
+
     local iniFile = io.open(filename, "w")
     if not iniFile then return nil, "Cannot open file: " .. filename end
 
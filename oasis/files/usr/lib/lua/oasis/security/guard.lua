@@ -1,7 +1,10 @@
 local M = {}
 
+-- C version of detect_encoding_spoof (oasis/files/src/guard); same verdicts and reasons
+local has_native, native = pcall(require, "oasis.security.native")
+
 -- Validate UTF-8 and detect suspicious code points (BOM, BIDI, zero-width, combining marks, etc.)
-local detect_encoding_spoof = function(s)
+local detect_encoding_spoof_lua = function(s)
     if type(s) ~= "string" then return true, "not-string" end
 
     local i = 1
@@ -85,6 +88,16 @@ local detect_encoding_spoof = function(s)
     return false, nil
 end
 
+local detect_encoding_spoof = detect_encoding_spoof_lua
+
+if has_native and (type(native) == "table") and native.detect_encoding_spoof then
+    detect_encoding_spoof = native.detect_encoding_spoof
+end
+
+M.detect_encoding_spoof = detect_encoding_spoof
+M.detect_encoding_spoof_lua = detect_encoding_spoof_lua
+M.native = has_native and native or nil
+
 function M.sanitize(str)
   return str:gsub("[;&|><`]", "")
 end
@@ -0,0 +1,344 @@
+#!/usr/bin/env lua
+
+local jsonc     = require("luci.jsonc")
+local fs        = require("nixio.fs")
+
+-- Track every UCI cursor created by modules loaded into this process (this must
+-- run before they are required), so their cached packages can be unloaded when
+-- the config file changes.
+local cursors = setmetatable({}, { __mode = "k" })
+
+do
+    local model = require("luci.model.uci")
+    local cursor = model.cursor
+    model.cursor = function(...)
+        local c = cursor(...)
+        cursors[c] = true
+        return c
+    end
+end
+
+local common    = require("oasis.common")
+local misc      = require("oasis.chat.misc")
+
+--[[
+[Resident ubus server]
+rpcd runs /usr/libexec/rpcd/oasis, oasis.chat and oasis.title as exec plugins:
+every ubus call starts a new Lua interpreter, loads the LuCI/oasis modules and
+reads UCI and /etc/oasis/oasis.conf again.
+
+When oasis.resident.enable is '1', /usr/bin/oasis_ubusd registers the same
+objects itself and keeps the interpreter, the modules and their caches warm:
+ - the method tables are taken from the rpcd scripts, so the method names,
+   arguments and replies stay the same
+ - the rpcd scripts print nothing for "list" in this mode, so rpcd leaves the
+   objects to this server
+ - methods that wait on an AI service (exec_methods) still run in a child
+   interpreter via the rpcd script, so a slow request does not hold up others
+ - cached data is refreshed when /etc/config/oasis changes; chat files and
+   oasis.conf are validated by mtime/size in storage/common
+
+Switching the mode on or off requires rpcd to re-scan its plugins
+(service rpcd restart); the init script takes care of it.
+]]
+
+local M = {}
+
+local SCRIPT_DIR    = "/usr/libexec/rpcd/"
+local UCI_FILE      = "/etc/config/oasis"
+local CHILD_ENV     = { "PATH=/usr/sbin:/usr/bin:/sbin:/bin" }
+local RPCD_WAIT_MAX = 20
+
+M.objects = {
+    common.db.ubus.object.oasis,
+    common.db.ubus.object.oasis_chat,
+    common.db.ubus.object.oasis_title,
+}
+
+-- Methods that block on an AI request
+local exec_methods = {
+    [common.db.ubus.object.oasis_chat]  = { send = true },
+    [common.db.ubus.object.oasis_title] = { auto_set = true },
+}
+
+-- Modules holding UCI-derived state that must be dropped on a config change
+local refresh_modules = {
+    "oasis.chat.storage",
+    "oasis.chat.context",
+}
+
+local uci_mtime = nil
+local seq = 0
+
+--- Check whether the resident mode is enabled.
+-- @return boolean
+function M.is_enabled()
+    local uci = require("luci.model.uci").cursor()
+    return uci:get(common.db.uci.cfg, common.db.uci.sect.resident, "enable") == "1"
+end
+
+local function refresh_if_changed()
+
+    local st = fs.stat(UCI_FILE)
+    local mtime = st and st.mtime
+
+    if mtime == uci_mtime then
+        return
+    end
+
+    if uci_mtime ~= nil then
+        for c, _ in pairs(cursors) do
+            c:unload(common.db.uci.cfg)
+        end
+        for _, name in ipairs(refresh_modules) do
+            local mod = package.loaded[name]
+            if (type(mod) == "table") and mod.refresh then
+                mod.refresh()
+            end
+        end
+    end
+
+    uci_mtime = mtime
+end
+
+--- Load the methods table of an rpcd script.
+-- @param object string ubus object name (script file name)
+-- @return table|nil methods, string|nil error
+function M.load_methods(object)
+
+    local chunk, err = loadfile(SCRIPT_DIR .. object)
+
+    if not chunk then
+        return nil, err
+    end
+
+    -- Without arg[1] the script neither lists nor calls; it returns its methods table
+    local saved = arg
+    arg = {}
+    local ok, methods = pcall(chunk)
+    arg = saved
+
+    if (not ok) or (type(methods) ~= "table") then
+        return nil, ok and "no methods table" or methods
+    end
+
+    return methods
+end
+
+-- Same checks as validateArgs() in the rpcd scripts
+local function check_args(func, method, args)
+
+    local n = 0
+    for _, _ in pairs(args) do n = n + 1 end
+
+    if method.args and n == 0 then
+        return "Received empty arguments for " .. func ..
+            " but it requires " .. jsonc.stringify(method.args)
+    end
+
+    args.ubus_rpc_session = nil
+
+    local margs = method.args or {}
+    for k, v in pairs(args) do
+        if margs[k] == nil or (v ~= nil and type(v) ~= type(margs[k])) then
+            return "Invalid argument '" .. k .. "' for " .. func ..
+                " it requires " .. jsonc.stringify(method.args)
+        end
+    end
+
+    return nil
+end
+
+local function to_reply(result)
+
+    local reply = jsonc.parse(result or "")
+
+    if type(reply) ~= "table" then
+        return { error = "Invalid response" }
+    end
+
+    return reply
+end
+
+--- Run one method in this process and return its reply table.
+-- @param methods table methods table of an object
+-- @param func string method name
+-- @param args table
+-- @return table
+function M.dispatch(methods, func, args)
+
+    local method = methods[func]
+
+    if not method then
+        return { error = "Method not found in methods table" }
+    end
+
+    args = args or {}
+
+    local err = check_args(func, method, args)
+
+    if err then
+        return { error = err }
+    end
+
+    refresh_if_changed()
+
+    local ok, run = pcall(method.call, args)
+
+    if not ok then
+        return { error = tostring(run) }
+    end
+
+    return to_reply(run.result)
+end
+
+-- Run a blocking method through its rpcd script and answer when the child exits.
+local function dispatch_exec(conn, req, object, func, args)
+
+    local uloop = require("uloop")
+
+    seq = seq + 1
+
+    local base = common.file.resident.work .. tostring(seq)
+    local deferred = conn:defer_request(req)
+
+    args.ubus_rpc_session = nil
+    misc.write_file(base .. ".in", jsonc.stringify(args))
+
+    local cmd = string.format("%s%s call %s <%s.in >%s.out", SCRIPT_DIR, object, func, base, base)
+
+    uloop.process("/bin/sh", { "-c", cmd }, CHILD_ENV, function()
+        local out = misc.read_file(base .. ".out")
+        os.remove(base .. ".in")
+        os.remove(base .. ".out")
+        conn:reply(deferred, to_reply(out))
+        conn:complete_deferred_request(deferred, 0)
+    end)
+end
+
+local function build_object(conn, object, methods)
+
+    local ubus = require("ubus")
+    local obj = {}
+
+    for func, method in pairs(methods) do
+
+        local policy = {}
+        for k, v in pairs(method.args or {}) do
+            if type(v) == "number" then
+                policy[k] = ubus.INT32
+            elseif type(v) == "boolean" then
+                policy[k] = ubus.BOOLEAN
+            elseif type(v) == "table" then
+                policy[k] = ubus.TABLE
+            else
+                policy[k] = ubus.STRING
+            end
+        end
+
+        local is_exec = exec_methods[object] and exec_methods[object][func]
+
+        obj[func] = {
+            function(req, msg)
+                msg = msg or {}
+                if is_exec and (not check_args(func, method, msg)) then
+                    dispatch_exec(conn, req, object, func, msg)
+                    return
+                end
+                conn:reply(req, M.dispatch(methods, func, msg))
+            end,
+            policy
+        }
+    end
+
+    return obj
+end
+
+local function object_registered(conn)
+    local names = {}
+    for _, name in ipairs(conn:objects() or {}) do
+        names[name] = true
+    end
+    for _, object in ipairs(M.objects) do
+        if names[object] then
+            return true
+        end
+    end
+    return false
+end
+
+-- rpcd registered the objects before the resident mode was enabled:
+-- restart it so that it re-lists the scripts (which now print nothing).
+local function take_over_from_rpcd(conn)
+
+    if not object_registered(conn) then
+        return true
+    end
+
+    os.execute("/etc/init.d/rpcd restart >/dev/null 2>&1")
+
+    local nixio = require("nixio")
+
+    for _ = 1, RPCD_WAIT_MAX do
+        if not object_registered(conn) then
+            return true
+        end
+        nixio.nanosleep(0, 500000000)
+    end
+
+    return false
+end
+
+--- Daemon entry point (/usr/bin/oasis_ubusd). Returns only on error.
+-- @return boolean, string
+function M.run()
+
+    local ubus  = require("ubus")
+    local uloop = require("uloop")
+
+    if not M.is_enabled() then
+        return false, "resident mode is disabled (oasis.resident.enable)"
+    end
+
+    os.execute("mkdir -p " .. common.file.resident.work)
+
+    uloop.init()
+
+    local conn = ubus.connect()
+
+    if not conn then
+        return false, "Failed to connect to ubus"
+    end
+
+    if not take_over_from_rpcd(conn) then
+        conn:close()
+        return false, "ubus objects are still owned by rpcd"
+    end
+
+    local objects = {}
+
+    for _, object in ipairs(M.objects) do
+        local methods, err = M.load_methods(object)
+        if not methods then
+            conn:close()
+            return false, object .. ": " .. tostring(err)
+        end
+        objects[object] = build_object(conn, object, methods)
+    end
+
+    -- Warm up the modules used by the fast methods
+    require("oasis.ubus.util")
+    require("oasis.chat.storage")
+    require("oasis.chat.title")
+    refresh_if_changed()
+
+    conn:add(objects)
+
+    uloop.run()
+
+    conn:close()
+
+    return true
+end
+
+return M
@@ -1,9 +1,9 @@
 #!/usr/bin/env lua
 
-local util      = require("luci.util")
 local uci       = require("luci.model.uci").cursor()
 local common    = require("oasis.common")
 local jsonc     = require("luci.jsonc")
+local storage   = require("oasis.chat.storage")
 local debug     = require("oasis.chat.debug")
 
 local M = {}
@@ -237,12 +237,10 @@ function M.append_chat_data(service, chat)
         role2, content2 = msgs[count].role,     msgs[count].content
     end
 
-    local message = {
-        id = cfg.id,
-        role1 = role1, content1 = content1,
-        role2 = role2, content2 = content2
-    }
-    util.ubus("oasis.chat", "append", message)
+    storage.append(cfg.id, {
+        { role = role1, content = content1 },
+        { role = role2, content = content2 },
+    })
 end
 
 return M